@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2018 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "PothosUtil.hpp"
@@ -62,6 +62,16 @@ protected:
             .repeatable(false)
             .callback(Poco::Util::OptionCallback<PothosUtil>(this, &PothosUtil::listModules)));
 
+        options.addOption(Poco::Util::Option("startup-profile", "",
+            "Profile the library initialization and print a report\n"
+            "of module loads, plugin registration, and event handling sorted by time. "
+            "Specify an optional file to write a Chrome trace JSON. "
+            "Set POTHOS_STARTUP_PROFILE=1 to include the library's own plugins.")
+            .required(false)
+            .repeatable(false)
+            .argument("traceFile", false/*optional*/)
+            .callback(Poco::Util::OptionCallback<PothosUtil>(this, &PothosUtil::startupProfile)));
+
         options.addOption(Poco::Util::Option("device-info", "", "display device information")
             .required(false)
             .repeatable(false)
@@ -74,7 +84,7 @@ protected:
             .argument("pluginPath", false/*optional*/)
             .callback(Poco::Util::OptionCallback<PothosUtil>(this, &PothosUtil::printPluginTree)));
 
-        options.addOption(Poco::Util::Option("proxy-server", "", "run the proxy server, tcp://bindHost:bindPort")
+        options.addOption(Poco::Util::Option("proxy-server", "", "run the proxy server, tcp://bindHost:bindPort or ipc://name")
             .required(false)
             .repeatable(false)
             .argument("URI", false/*optional*/)
@@ -86,6 +96,15 @@ protected:
             .argument("modulePath")
             .callback(Poco::Util::OptionCallback<PothosUtil>(this, &PothosUtil::loadModule)));
 
+        options.addOption(Poco::Util::Option("load-modules", "",
+            "Test load a list of library modules, one path per line in the list file.\n"
+            "Each module is loaded and unloaded in turn, "
+            "and the load time of each module is reported on stdout.")
+            .required(false)
+            .repeatable(false)
+            .argument("listFile")
+            .callback(Poco::Util::OptionCallback<PothosUtil>(this, &PothosUtil::loadModules)));
+
         options.addOption(Poco::Util::Option("run-topology", "", "run a topology from a JSON description")
             .required(false)
             .repeatable(false)
@@ -108,6 +127,25 @@ protected:
             .argument("idleTime")
             .binding("idleTime"));
 
+        options.addOption(Poco::Util::Option("bottlenecks", "",
+            "Analyze the running topology for bottlenecks.\n"
+            "Use with --run-topology to print a ranked report of rate-limiting blocks "
+            "and starved or backpressured edges. The stats are sampled over the optional "
+            "sample time in seconds (default 1.0) from the start of the run.")
+            .required(false)
+            .repeatable(false)
+            .argument("sampleTime", false/*optional*/)
+            .binding("bottlenecks"));
+
+        options.addOption(Poco::Util::Option("no-snapshot", "",
+            "Disable the compiled topology snapshot cache.\n"
+            "By default, --run-topology stores the evaluated design in a binary snapshot "
+            "keyed by a hash of the file, variables, and installed modules, so that subsequent runs "
+            "skip JSON parsing and expression evaluation.")
+            .required(false)
+            .repeatable(false)
+            .binding("noSnapshot"));
+
         options.addOption(Poco::Util::Option("var", "",
             "Specify an arbitrary keyword + value variable\n"
             "using the format --var=name:value\n"
@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2018 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
@@ -20,9 +20,11 @@ public:
     void selfTestOne(const std::string &, const std::string &);
     void proxyServer(const std::string &, const std::string &);
     void loadModule(const std::string &, const std::string &);
+    void loadModules(const std::string &, const std::string &);
     void runTopology(void);
     void docParse(const std::vector<std::string> &);
     void listModules(const std::string &, const std::string &);
+    void startupProfile(const std::string &, const std::string &);
 
     //! Variables passed in via the --vars option
     std::vector<std::pair<std::string, std::string>> _vars;
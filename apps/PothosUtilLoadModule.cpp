@@ -1,10 +1,14 @@
-// Copyright (c) 2013-2015 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "PothosUtil.hpp"
 #include <Pothos/Plugin/Module.hpp>
+#include <Pothos/Exception.hpp>
 #include <iostream>
+#include <fstream>
 #include <cstdlib>
+#include <chrono>
+#include <string>
 
 //remove outer quotes if they exist
 static std::string unquote(const std::string &s)
@@ -25,3 +29,37 @@ void PothosUtilBase::loadModule(const std::string &, const std::string &path)
     }
     std::cout << "success!" << std::endl;
 }
+
+/***********************************************************************
+ * Load a list of modules from a file, one path per line.
+ * Each module is reported on stdout in a tab separated line
+ * that starts with "pothos-load-modules" to tell it apart
+ * from anything else that a module prints to stdout:
+ *  - "loading", path -- before the load starts
+ *  - "loaded" or "failed", microseconds, path -- after the load
+ * A "loading" line without a result means that the module crashed.
+ **********************************************************************/
+void PothosUtilBase::loadModules(const std::string &, const std::string &listPath)
+{
+    std::ifstream listFile(unquote(listPath));
+    std::string path;
+    while (std::getline(listFile, path))
+    {
+        if (path.empty()) continue;
+        std::cout << "pothos-load-modules\tloading\t" << path << std::endl;
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        std::string status("loaded");
+        try
+        {
+            Pothos::PluginModule module(path);
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            std::cerr << ex.displayText() << std::endl;
+            status = "failed";
+        }
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1-t0).count();
+        std::cout << "pothos-load-modules\t" << status << "\t" << us << "\t" << path << std::endl;
+    }
+}
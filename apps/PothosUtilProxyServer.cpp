@@ -1,37 +1,37 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "PothosUtil.hpp"
 #include <Pothos/Init.hpp>
 #include <Pothos/Remote.hpp>
 #include <Pothos/Util/Network.hpp>
-#include <Poco/Net/ServerSocket.h>
-#include <Poco/Net/SocketStream.h>
-#include <Poco/Net/TCPServer.h>
 #include <Poco/Process.h>
 #include <Poco/URI.h>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
 #include <mutex>
 #include <cassert>
 #include <iostream>
 
 /***********************************************************************
- * TCP connection factory
- *  - create connection handler threads
+ * Connection monitor
  *  - monitor connection start and stop
  *  - kill process in require active mode
  **********************************************************************/
-class MyTCPServerConnectionFactory : public Poco::Net::TCPServerConnectionFactory
+class ConnectionMonitor
 {
 public:
-    MyTCPServerConnectionFactory(const bool requireActive):
+    ConnectionMonitor(const bool requireActive):
         _numConnections(0),
         _requireActive(requireActive)
     {
         return;
     }
 
-    Poco::Net::TCPServerConnection *createConnection(const Poco::Net::StreamSocket &socket);
-
     void connectionStart(void)
     {
         std::unique_lock<std::mutex> lock(_mutex);
@@ -43,7 +43,12 @@ public:
         std::unique_lock<std::mutex> lock(_mutex);
         assert(_numConnections != 0);
         _numConnections--;
-        if (_numConnections == 0 and _requireActive)
+        this->connectionsChanged(_numConnections);
+    }
+
+    void connectionsChanged(const size_t numConnections)
+    {
+        if (numConnections == 0 and _requireActive)
         {
             std::cerr << "Proxy server: No active connections - terminating" << std::endl;
             Poco::Process::requestTermination(Poco::Process::id());
@@ -57,45 +62,47 @@ private:
 };
 
 /***********************************************************************
- * TCP connection thread
- *  - create the remote handler for the connection
- *  - service the remote handler until disconnect
+ * IPC accept loop
+ *  - create a handler thread for each shared memory connection
+ *  - use the monitor for connection start and stop
+ *  - join the handler threads once the connections are closed
  **********************************************************************/
-class MyTCPServerConnection : public Poco::Net::TCPServerConnection
+static void ipcAcceptLoop(Pothos::RemoteIpcListener &listener, std::shared_ptr<ConnectionMonitor> monitor, std::atomic<bool> &running)
 {
-public:
-    MyTCPServerConnection(MyTCPServerConnectionFactory &factory, const Poco::Net::StreamSocket &socket):
-        Poco::Net::TCPServerConnection(socket),
-        _factory(factory),
-        _handler(Pothos::RemoteHandler(socket.peerAddress().host().toString()))
+    std::vector<std::pair<std::thread, std::shared_ptr<std::atomic<bool>>>> handlers;
+    const auto joinHandlers = [&handlers](const bool all)
     {
-        _factory.connectionStart();
-    }
-
-    ~MyTCPServerConnection(void)
-    {
-        _factory.connectionStop();
-    }
+        for (auto it = handlers.begin(); it != handlers.end();)
+        {
+            if (not all and not *it->second) {++it; continue;}
+            it->first.join();
+            it = handlers.erase(it);
+        }
+    };
 
-    void run(void)
+    while (running)
     {
-        this->socket().setNoDelay(true);
-        Poco::Net::SocketStream socketStream(this->socket());
-        _handler.runHandler(socketStream, socketStream);
+        joinHandlers(false);
+        auto io = listener.accept(100000);
+        if (not io) continue;
+        monitor->connectionStart();
+        std::shared_ptr<std::atomic<bool>> done(new std::atomic<bool>(false));
+        handlers.emplace_back(std::thread([monitor, io, done]
+        {
+            Pothos::RemoteHandler handler("127.0.0.1");
+            handler.runHandler(*io);
+            monitor->connectionStop();
+            *done = true;
+        }), done);
     }
 
-private:
-    MyTCPServerConnectionFactory &_factory;
-    Pothos::RemoteHandler _handler;
-};
-
-Poco::Net::TCPServerConnection *MyTCPServerConnectionFactory::createConnection(const Poco::Net::StreamSocket &socket)
-{
-    return new MyTCPServerConnection(*this, socket);
+    //unblock the handlers on the open connections and wait for them
+    listener.closeConnections();
+    joinHandlers(true);
 }
 
 /***********************************************************************
- * Spawn TCP proxy server given server URI
+ * Spawn proxy server given server URI
  **********************************************************************/
 void PothosUtilBase::proxyServer(const std::string &, const std::string &uriStr)
 {
@@ -123,22 +130,36 @@ void PothosUtilBase::proxyServer(const std::string &, const std::string &uriStr)
     Poco::URI uri(uriStr.empty()?defaultUri:uriStr);
     const std::string &host = uri.getHost();
     const std::string &port = std::to_string(uri.getPort());
+    const bool requireActive = this->config().hasOption("requireActive");
+
+    //serve connections through shared memory on this host
+    if (uri.getScheme() == "ipc")
+    {
+        Pothos::RemoteIpcListener listener(host);
+        std::shared_ptr<ConnectionMonitor> monitor(new ConnectionMonitor(requireActive));
+        std::atomic<bool> running(true);
+        std::thread acceptThread(&ipcAcceptLoop, std::ref(listener), monitor, std::ref(running));
+        std::cout << "Host: " << listener.getName() << std::endl;
+        std::cout << "Port: " << listener.getName() << std::endl;
+
+        //wait here until the term signal is received
+        this->waitForTerminationRequest();
+        running = false;
+        acceptThread.join();
+        return;
+    }
+
     if (uri.getScheme() != "tcp")
     {
         throw Pothos::Exception("PothosUtil::proxyServer("+uriStr+")", "unsupported URI scheme");
     }
 
-    //create server socket
-    Poco::Net::SocketAddress sa(host, port);
-    Poco::Net::ServerSocket serverSocket(sa);
-    Poco::Net::TCPServerConnectionFactory::Ptr factory;
-    factory = new MyTCPServerConnectionFactory(this->config().hasOption("requireActive"));
-    Poco::Net::TCPServer tcpServer(factory, serverSocket);
-
-    //start the server
-    tcpServer.start();
-    std::cout << "Host: " << serverSocket.address().host().toString() << std::endl;
-    std::cout << "Port: " << serverSocket.address().port() << std::endl;
+    //start the server: one poller thread for all clients and a pool of workers
+    ConnectionMonitor monitor(requireActive);
+    Pothos::RemoteHandlerPool handlerPool(host, port, 0,
+        std::bind(&ConnectionMonitor::connectionsChanged, &monitor, std::placeholders::_1));
+    std::cout << "Host: " << handlerPool.getActualHost() << std::endl;
+    std::cout << "Port: " << handlerPool.getActualPort() << std::endl;
 
     //wait here until the term signal is received
     this->waitForTerminationRequest();
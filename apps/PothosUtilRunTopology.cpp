@@ -1,37 +1,88 @@
-// Copyright (c) 2014-2017 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "PothosUtil.hpp"
 #include <Pothos/Framework.hpp>
 #include <Pothos/Exception.hpp>
+#include <Pothos/System.hpp>
 #include <Poco/Path.h>
+#include <Poco/File.h>
+#include <Poco/TemporaryFile.h>
+#include <Poco/SHA1Engine.h>
+#include <Poco/DigestEngine.h>
 #include <fstream>
+#include <algorithm> //sort
+#include <iomanip>
+#include <map>
 #include <thread>
+#include <future>
 #include <iostream>
 #include <json.hpp>
 
 using json = nlohmann::json;
 
-void PothosUtilBase::runTopology(void)
+static void printBottlenecks(const json &reportObj)
 {
-    Pothos::ScopedInit init;
+    //lookup block names by ID for the report
+    std::map<std::string, std::string> names;
+    for (const auto &blockObj : reportObj["blocks"])
+    {
+        names[blockObj["id"].get<std::string>()] = blockObj["blockName"].get<std::string>();
+    }
 
-    //sanity check the file
-    const auto path = this->config().getString("inputFile");
-    if (Poco::Path(path).getExtension() == "pothos" or
-        Poco::Path(path).getExtension() == "pth")
+    if (reportObj.count("bottleneck") != 0)
     {
-        throw Pothos::DataFormatException("Cannot load "+path+"!\n"
-            "Please export the design to the JSON topology format.");
+        std::cout << "  Rate-limiting block: " << names[reportObj["bottleneck"].get<std::string>()] << std::endl;
+        std::cout << "  Critical path:";
+        for (const auto &id : reportObj["criticalPath"]) std::cout << " [" << names[id.get<std::string>()] << "]";
+        std::cout << std::endl;
     }
-    std::ifstream ifs(Poco::Path::expand(path));
-    if (not ifs) throw Pothos::FileException("Cant open "+path+" for reading!");
 
+    std::cout << "  Ranked blocks:" << std::endl;
+    size_t rank = 0;
+    for (const auto &blockObj : reportObj["blocks"])
+    {
+        std::cout << "    " << (++rank) << ") " << blockObj["blockName"].get<std::string>()
+            << ": work " << std::fixed << std::setprecision(1) << (100*blockObj["workUtilization"].get<double>()) << "%"
+            << ", limited by " << blockObj["limitedBy"].get<std::string>() << std::endl;
+    }
+
+    std::cout << "  Ranked edges:" << std::endl;
+    rank = 0;
+    for (const auto &edgeObj : reportObj["edges"])
+    {
+        std::cout << "    " << (++rank) << ") "
+            << names[edgeObj["srcId"].get<std::string>()] << "[" << edgeObj["srcName"].get<std::string>() << "] -> "
+            << names[edgeObj["dstId"].get<std::string>()] << "[" << edgeObj["dstName"].get<std::string>() << "]: "
+            << edgeObj["state"].get<std::string>()
+            << ", " << std::setprecision(3) << std::scientific << edgeObj["consumerRate"].get<double>() << " elements/s"
+            << ", " << std::fixed << std::setprecision(0) << edgeObj["occupancy"].get<double>() << " bytes queued" << std::endl;
+    }
+}
+
+//! Stamp a file or every file under a directory by path, modification time, and size
+static void updateFileStamps(Poco::DigestEngine &engine, const Poco::Path &path)
+{
+    const Poco::File file(path);
+    if (not file.exists()) return;
+    if (file.isDirectory())
+    {
+        std::vector<std::string> files; file.list(files);
+        std::sort(files.begin(), files.end());
+        for (const auto &name : files) updateFileStamps(engine, Poco::Path(path, name));
+        return;
+    }
+    engine.update(path.toString() + ":" + std::to_string(file.getLastModified().epochMicroseconds())
+        + ":" + std::to_string(file.getSize()) + "\n");
+}
+
+static std::string applyGlobalOverlays(const std::string &jsonStr, const std::vector<std::pair<std::string, std::string>> &vars)
+{
     //parse the json formatted string into a JSON object
     json topObj;
     try
     {
-        topObj = json::parse(ifs);
+        topObj = json::parse(jsonStr);
     }
     catch (const std::exception &ex)
     {
@@ -41,7 +92,7 @@ void PothosUtilBase::runTopology(void)
     //apply the global variable overlays
     if (topObj.count("globals") == 0) topObj["globals"] = json::array();
     auto &globalsArray = topObj["globals"];
-    for (const auto &pair : _vars)
+    for (const auto &pair : vars)
     {
         //look for a match in the existing globals and override its value
         for (auto &globalVarObj : globalsArray)
@@ -65,9 +116,104 @@ void PothosUtilBase::runTopology(void)
         nextVar: continue;
     }
 
-    //create the topology from the JSON string
-    std::cout << ">>> Create Topology: " << path << std::endl;
-    auto topology = Pothos::Topology::make(topObj.dump());
+    return topObj.dump();
+}
+
+void PothosUtilBase::runTopology(void)
+{
+    Pothos::ScopedInit init;
+
+    //sanity check the file
+    const auto path = this->config().getString("inputFile");
+    if (Poco::Path(path).getExtension() == "pothos" or
+        Poco::Path(path).getExtension() == "pth")
+    {
+        throw Pothos::DataFormatException("Cannot load "+path+"!\n"
+            "Please export the design to the JSON topology format.");
+    }
+    std::ifstream ifs(Poco::Path::expand(path));
+    if (not ifs) throw Pothos::FileException("Cant open "+path+" for reading!");
+    const std::string jsonStr((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+    //the snapshot is keyed by the file contents, variable overlays, library version,
+    //and the installed modules, so that an upgraded toolkit invalidates the snapshot
+    const bool useSnapshot = not this->config().has("noSnapshot");
+    Poco::Path snapshotPath(Pothos::System::getUserDataPath());
+    snapshotPath.append("topologies");
+    if (useSnapshot)
+    {
+        Poco::SHA1Engine sha1;
+        sha1.update(Pothos::System::getLibVersion());
+        sha1.update(jsonStr);
+        for (const auto &pair : _vars) sha1.update(pair.first + ":" + pair.second + "\n");
+        updateFileStamps(sha1, Pothos::System::getPothosRuntimeLibraryPath());
+        for (const auto &searchPath : Pothos::System::getPothosModuleSearchPaths())
+        {
+            updateFileStamps(sha1, searchPath);
+        }
+        Poco::File(snapshotPath).createDirectories();
+        snapshotPath.append(Poco::DigestEngine::digestToHex(sha1.digest()) + ".bin");
+    }
+
+    //load the topology from a previously compiled snapshot
+    std::shared_ptr<Pothos::Topology> topology;
+    if (useSnapshot and Poco::File(snapshotPath).exists())
+    {
+        std::cout << ">>> Load Snapshot: " << snapshotPath.toString() << std::endl;
+        std::ifstream snapshotIfs(snapshotPath.toString(), std::ios::binary);
+        const std::string snapshot((std::istreambuf_iterator<char>(snapshotIfs)), std::istreambuf_iterator<char>());
+        try
+        {
+            topology = Pothos::Topology::makeFromSnapshot(snapshot);
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            std::cerr << ">>> Ignoring invalid snapshot: " << ex.displayText() << std::endl;
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << ">>> Ignoring invalid snapshot: " << ex.what() << std::endl;
+        }
+    }
+
+    //otherwise evaluate the JSON description and compile a new snapshot
+    if (not topology)
+    {
+        const auto topJSON = applyGlobalOverlays(jsonStr, _vars);
+        std::cout << ">>> Create Topology: " << path << std::endl;
+        if (useSnapshot) try
+        {
+            //write to a temporary file and rename for atomicity across processes
+            const auto snapshot = Pothos::Topology::compileSnapshot(topJSON);
+            Poco::TemporaryFile tempFile(snapshotPath.parent().toString());
+            {
+                std::ofstream snapshotOfs(tempFile.path(), std::ios::binary);
+                snapshotOfs << snapshot;
+            }
+            tempFile.keep();
+            tempFile.renameTo(snapshotPath.toString());
+            topology = Pothos::Topology::makeFromSnapshot(snapshot);
+        }
+        catch (const Pothos::ObjectSerializeError &ex)
+        {
+            std::cerr << ">>> Snapshot not supported: " << ex.displayText() << std::endl;
+        }
+        if (not topology) topology = Pothos::Topology::make(topJSON);
+    }
+
+    //analyze the bottlenecks while the topology runs if specified,
+    //sampling starts at commit so that it sees the graph under load
+    std::future<std::string> bottlenecks;
+    const auto commitTopology = [&](void)
+    {
+        topology->commit();
+        if (not this->config().has("bottlenecks")) return;
+        const auto sampleTime = this->config().getString("bottlenecks");
+        json requestObj;
+        requestObj["sampleTime"] = sampleTime.empty()?1.0:std::stod(sampleTime);
+        std::cout << ">>> Analyzing bottlenecks for " << requestObj["sampleTime"] << " seconds" << std::endl;
+        bottlenecks = std::async(std::launch::async, &Pothos::Topology::queryBottlenecks, topology.get(), requestObj.dump());
+    };
 
     //commit the topology and wait for specified time for CTRL+C
     if (this->config().has("idleTime"))
@@ -81,7 +227,7 @@ void PothosUtilBase::runTopology(void)
             timeoutMsg = "timeout " + std::to_string(timeout) + " seconds";
         }
         std::cout << ">>> Running topology until idle with " << timeoutMsg << std::endl;
-        topology->commit();
+        commitTopology();
         if (not topology->waitInactive(idleTime, timeout))
         {
             throw Pothos::RuntimeException("Topology::waitInactive() reached timeout");
@@ -91,16 +237,23 @@ void PothosUtilBase::runTopology(void)
     {
         const auto runDuration = this->config().getDouble("runDuration");
         std::cout << ">>> Running topology for " << runDuration << " seconds" << std::endl;
-        topology->commit();
+        commitTopology();
         std::this_thread::sleep_for(std::chrono::milliseconds(long(runDuration*1000)));
     }
     else
     {
         std::cout << ">>> Running topology, press CTRL+C to exit" << std::endl;
-        topology->commit();
+        commitTopology();
         this->waitForTerminationRequest();
     }
 
+    //report the bottlenecks sampled during the run
+    if (bottlenecks.valid())
+    {
+        std::cout << ">>> Bottlenecks:" << std::endl;
+        printBottlenecks(json::parse(bottlenecks.get()));
+    }
+
     //dump the stats to file if specified
     if (this->config().has("outputFile"))
     {
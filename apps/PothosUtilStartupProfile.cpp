@@ -0,0 +1,70 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "PothosUtil.hpp"
+#include <Pothos/Plugin.hpp>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <map>
+
+//! How many of the most expensive entries to print per category
+static const size_t REPORT_TOP_ENTRIES = 15;
+
+struct ProfileTotal
+{
+    ProfileTotal(void):
+        count(0),
+        totalUs(0){}
+    size_t count;
+    long long totalUs;
+};
+
+void PothosUtilBase::startupProfile(const std::string &, const std::string &traceFile)
+{
+    Pothos::PluginProfile::setEnabled(true);
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    Pothos::ScopedInit init;
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    Pothos::PluginProfile::setEnabled(false);
+
+    //totals per category and per name in each category
+    std::map<std::string, ProfileTotal> categories;
+    std::map<std::string, std::map<std::string, ProfileTotal>> names;
+    for (const auto &record : Pothos::PluginProfile::getRecords())
+    {
+        auto &category = categories[record.category];
+        category.count++;
+        category.totalUs += record.durationUs;
+        auto &name = names[record.category][record.name];
+        name.count++;
+        name.totalUs += record.durationUs;
+    }
+
+    std::cout << "Startup time: " << std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0).count() << " ms" << std::endl;
+    std::cout << "Times are inclusive: plugin times contain their event handlers." << std::endl;
+    for (const auto &category : categories)
+    {
+        std::cout << std::endl << "== " << category.first << ": " << category.second.count << " records, "
+            << (category.second.totalUs/1000) << " ms total" << std::endl;
+
+        //sort by total time, most expensive first
+        std::vector<std::pair<std::string, ProfileTotal>> sorted(names[category.first].begin(), names[category.first].end());
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, ProfileTotal> &a, const std::pair<std::string, ProfileTotal> &b)
+        {
+            return a.second.totalUs > b.second.totalUs;
+        });
+        if (sorted.size() > REPORT_TOP_ENTRIES) sorted.resize(REPORT_TOP_ENTRIES);
+        for (const auto &entry : sorted)
+        {
+            std::cout << "  " << std::setw(10) << std::fixed << std::setprecision(3) << (entry.second.totalUs/1e3) << " ms"
+                << std::setw(7) << entry.second.count << "x  " << entry.first << std::endl;
+        }
+    }
+
+    if (traceFile.empty()) return;
+    std::ofstream(traceFile.c_str()) << Pothos::PluginProfile::toChromeTrace();
+    std::cout << std::endl << "Wrote trace to " << traceFile << std::endl;
+}
@@ -5,7 +5,7 @@
 /// Entries are used for polymorphic factories.
 ///
 /// \copyright
-/// Copyright (c) 2016-2017 Josh Blum
+/// Copyright (c) 2016-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -31,7 +31,7 @@ public:
     //! Create and register an entry given the type and unique ID
     ArchiveEntry(const std::type_info &type, const std::string &id);
 
-    //! Virtual destructor for derived type classes
+    //! Virtual destructor unregisters the entry
     virtual ~ArchiveEntry(void);
 
     //! Save a pointer to the archive in a derived class
@@ -52,7 +52,7 @@ public:
     //! Get the associated unique ID
     const std::string &getId(void) const;
 
-    //! Get a reproducible hash for this entry
+    //! Get a reproducible hash for this entry, written to archives
     const unsigned long long &getHash(void) const;
 
 private:
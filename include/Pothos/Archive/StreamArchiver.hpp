@@ -4,7 +4,7 @@
 /// Archive implementation on top of streaming interfaces.
 ///
 /// \copyright
-/// Copyright (c) 2016-2017 Josh Blum
+/// Copyright (c) 2016-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -51,6 +51,13 @@ public:
      */
     void writeBytes(const void *buff, const size_t len);
 
+    /*!
+     * Write an array of bytes that remains valid until the stream is consumed.
+     * Output streams that support it reference the bytes rather than copy them;
+     * otherwise the bytes are written to the stream like writeBytes().
+     */
+    void writeBytesNoCopy(const void *buff, const size_t len);
+
 private:
 
     std::ostream &os;
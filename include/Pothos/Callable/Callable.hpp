@@ -4,7 +4,7 @@
 /// Callable provides an opaque proxy for function or method calls.
 ///
 /// \copyright
-/// Copyright (c) 2013-2019 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 ///                    2019 Nicholas Corgan
 /// SPDX-License-Identifier: BSL-1.0
 ///
@@ -55,6 +55,23 @@ public:
      */
     Object opaqueCall(const Object *inputArgs, const size_t numArgs) const;
 
+    /*!
+     * Call into the function/method with typed arguments.
+     * When the template arguments exactly match the signature of the
+     * bound function and no arguments are bound, the function is called
+     * directly without creating Objects or looking up conversions.
+     * Otherwise, this falls back to the conversions of call<ReturnType>().
+     * The entire pack must be specified, and methods take the class
+     * instance as the first argument, ex: callTyped<int, MyClass &, long>().
+     * \throws CallableNullError if the Callable is null
+     * \throws CallableArgumentError for bad arguments in number or type
+     * \throws CallableReturnError when the return cannot be converted
+     * \param args the call arguments matching ArgsType
+     * \return the return value of the call
+     */
+    template <typename ReturnType, typename... ArgsType>
+    ReturnType callTyped(ArgsType... args) const;
+
     /*!
      * Get the number of arguments for this call.
      * For methods, the class instance also counts
@@ -4,7 +4,7 @@
 /// Template implementation details for Callable.
 ///
 /// \copyright
-/// Copyright (c) 2013-2019 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -17,6 +17,8 @@
 #include <functional> //std::function
 #include <type_traits> //std::type_info, std::is_void
 #include <utility> //std::forward
+#include <typeinfo> //typeid
+#include <array>
 
 namespace Pothos {
 namespace Detail {
@@ -69,6 +71,11 @@ public:
         return call(args, Pothos::Util::index_sequence_for<ArgsType...>{});
     }
 
+    FcnRType callTyped(ArgsType... args) const
+    {
+        return _fcn(std::forward<ArgsType>(args)...);
+    }
+
 private:
 
     //! implement recursive type() tail-case
@@ -144,6 +151,49 @@ Object CallableFactoryNewWrapper(ArgsType&&... args)
     return Object(new ClassType(std::forward<ArgsType>(args)...));
 }
 
+//! Make an Object for a typed call fallback, mutable references are not copied
+template <typename ArgType, bool isMutableRef = std::is_lvalue_reference<ArgType>::value and
+    not std::is_const<typename std::remove_reference<ArgType>::type>::value>
+struct CallableTypedArg
+{
+    static Object make(ArgType arg)
+    {
+        return Object(std::forward<ArgType>(arg));
+    }
+};
+
+template <typename ArgType>
+struct CallableTypedArg<ArgType, true>
+{
+    static Object make(ArgType arg)
+    {
+        return Object(std::ref(arg));
+    }
+};
+
+//! Convert the opaque return of a typed call fallback
+template <typename ReturnType>
+struct CallableTypedReturn
+{
+    static ReturnType convert(const Object &r)
+    {
+        try
+        {
+            return r.convert<ReturnType>();
+        }
+        catch(const Exception &ex)
+        {
+            throw CallableReturnError("Pothos::Callable::callTyped()", ex);
+        }
+    }
+};
+
+template <>
+struct CallableTypedReturn<void>
+{
+    static void convert(const Object &){}
+};
+
 } //namespace Detail
 
 /***********************************************************************
@@ -223,6 +273,24 @@ Callable Callable::factoryShared(void)
         &std::make_shared<ClassType, ArgsType...>));
 }
 
+/***********************************************************************
+ * Typed call with variable args
+ **********************************************************************/
+template <typename ReturnType, typename... ArgsType>
+ReturnType Callable::callTyped(ArgsType... args) const
+{
+    //an exact container type match means the signature is identical
+    using ContainerType = Detail::CallableFunctionContainer<ReturnType, ReturnType, ArgsType...>;
+    const auto impl = _impl.get();
+    if (impl != nullptr and _boundArgs.empty() and typeid(*impl) == typeid(ContainerType))
+    {
+        return static_cast<const ContainerType *>(impl)->callTyped(std::forward<ArgsType>(args)...);
+    }
+
+    const std::array<Object, sizeof...(ArgsType)> objArgs{{Detail::CallableTypedArg<ArgsType>::make(std::forward<ArgsType>(args))...}};
+    return Detail::CallableTypedReturn<ReturnType>::convert(this->opaqueCall(objArgs.data(), sizeof...(args)));
+}
+
 inline Callable::Callable(Detail::CallableContainer *impl):
     _impl(impl)
 {
@@ -4,7 +4,7 @@
 /// This file contains inline definitions for Block members.
 ///
 /// \copyright
-/// Copyright (c) 2014-2016 Josh Blum
+/// Copyright (c) 2014-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -77,6 +77,10 @@ void Pothos::Block::emitSignal(const std::string &name, ArgsType&&... args)
     if (it == _namedOutputs.end() or not it->second->isSignal()) throw PortAccessError(
         "Pothos::Block::emitSignal("+name+")", "signal port does not exist");
 
-    const ObjectVector objArgs{{Object(std::forward<ArgsType>(args))...}};
+    //construct the arguments in place, an initializer list would copy each one
+    ObjectVector objArgs;
+    objArgs.reserve(sizeof...(ArgsType));
+    const int expand[] = {0, (objArgs.emplace_back(std::forward<ArgsType>(args)), 0)...};
+    (void)expand;
     it->second->postMessage(std::move(objArgs));
 }
@@ -0,0 +1,70 @@
+///
+/// \file Framework/BufferCodec.hpp
+///
+/// BufferCodec compresses buffers for network flows.
+///
+/// \copyright
+/// Copyright (c) 2020 Josh Blum
+/// SPDX-License-Identifier: BSL-1.0
+///
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <Pothos/Framework/BufferChunk.hpp>
+#include <memory>
+#include <string>
+
+namespace Pothos {
+
+/*!
+ * A BufferCodec encodes buffers into a compact representation
+ * for transport between processes and decodes them on the other end.
+ * The network blocks use a codec per flow when the topology
+ * configures one with Topology::setNetworkOptions().
+ *
+ * Codecs are lossless: decode(encode(buffer)) restores the bytes
+ * and the data type of the original buffer.
+ *
+ * Builtin codecs:
+ *  - "none": the buffer is passed through without encoding
+ *  - "delta": integer samples are stored as variable length differences
+ *    between consecutive samples of the same channel; this suits slowly
+ *    varying integer streams such as ADC samples and counters.
+ *    Other data types pass through with a small header.
+ */
+class POTHOS_API BufferCodec
+{
+public:
+
+    typedef std::shared_ptr<BufferCodec> Sptr;
+
+    //! Virtual destructor for derived codecs
+    virtual ~BufferCodec(void);
+
+    /*!
+     * The BufferCodec factory -- makes a new BufferCodec given the factory name.
+     * Plugins for custom BufferCodecs should be located in
+     * the plugin registry: /framework/buffer_codec/[name]
+     * \throws BufferCodecError if the factory function fails.
+     * \param name the name of a BufferCodec factory in the plugin tree
+     * \return a new shared pointer to a buffer codec
+     */
+    static Sptr make(const std::string &name);
+
+    /*!
+     * Encode a buffer into a new buffer of bytes.
+     * \param buffer the input buffer with data type
+     * \return the encoded buffer
+     */
+    virtual BufferChunk encode(const BufferChunk &buffer) = 0;
+
+    /*!
+     * Decode a buffer that was produced by encode().
+     * \throws BufferCodecError if the encoded buffer is malformed
+     * \param buffer the encoded buffer
+     * \return the original buffer with data type
+     */
+    virtual BufferChunk decode(const BufferChunk &buffer) = 0;
+};
+
+} //namespace Pothos
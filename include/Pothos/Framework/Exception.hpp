@@ -4,7 +4,7 @@
 /// Exceptions thrown by the Framework methods.
 ///
 /// \copyright
-/// Copyright (c) 2013-2014 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -24,6 +24,11 @@ POTHOS_DECLARE_EXCEPTION(POTHOS_API, SharedBufferError, RuntimeException)
  */
 POTHOS_DECLARE_EXCEPTION(POTHOS_API, BufferManagerFactoryError, RuntimeException)
 
+/*!
+ * A BufferCodecError is thrown when a codec cant be made or cant decode.
+ */
+POTHOS_DECLARE_EXCEPTION(POTHOS_API, BufferCodecError, RuntimeException)
+
 /*!
  * A BufferPushError is thrown when buffers are pushed to the wrong queue.
  */
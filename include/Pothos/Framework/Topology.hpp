@@ -4,7 +4,7 @@
 /// This file contains the interface for creating a topology of blocks.
 ///
 /// \copyright
-/// Copyright (c) 2014-2019 Josh Blum
+/// Copyright (c) 2014-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -54,6 +54,11 @@ public:
      * The special thread pool with empty name "" will apply
      * to all blocks that do not specify the "threadPool" key.
      *
+     * <h3>Automatic placement</h3>
+     * The "autoPlacement" field is an optional JSON object
+     * which contains the request for setAutoPlacement().
+     * Example: "autoPlacement" : {"mode" : "NUMA"}
+     *
      * <h3>Global variables</h3>
      * The "globals" field is an optional JSON array
      * where each entry is an object containing a variable name
@@ -71,6 +76,9 @@ public:
      * - The "calls" is a list of ordered method calls.
      *   Each specified by the call name then arguments.
      * - The "threadPool" specifies an optional thread pool by name
+     * - The "host" specifies an optional remote server URI for the block.
+     *   The block is made in an environment from RemoteEnvironmentPool,
+     *   so repeated make and commit calls reuse the connection.
      *
      * <h3>Connections</h3>
      * The "connections" field is an array of JSON arrays,
@@ -81,6 +89,10 @@ public:
      *  - source port
      *  - destination ID
      *  - destination port
+     *  - optional network options object (see setNetworkOptions())
+     *
+     * Example connection with network options:
+     * ["id0", "out0", "id1", "in0", {"codec" : "delta", "checksum" : true}]
      *
      * <h2>Using expressions</h2>
      *
@@ -145,6 +157,28 @@ public:
      */
     static std::shared_ptr<Topology> make(const std::string &json);
 
+    /*!
+     * Compile a JSON topology description into a binary snapshot.
+     * The snapshot holds the structure of the design, the list of
+     * block factories, and the evaluated constructor and call arguments.
+     * Creating a topology from the snapshot skips JSON parsing and
+     * expression evaluation, which dominate the load time of large designs.
+     * All evaluated arguments must be serializable Object types.
+     * \throws DataFormatException if the description is malformed
+     * \throws ObjectSerializeError if an argument cannot be serialized
+     * \param json a JSON formatted string (see make())
+     * \return the opaque binary snapshot
+     */
+    static std::string compileSnapshot(const std::string &json);
+
+    /*!
+     * Create a topology from a snapshot made by compileSnapshot().
+     * \throws DataFormatException if the snapshot is invalid
+     * \param snapshot the opaque binary snapshot
+     * \return a new topology with the blocks created and connected
+     */
+    static std::shared_ptr<Topology> makeFromSnapshot(const std::string &snapshot);
+
     //! Create a new empty topology
     Topology(void);
 
@@ -202,6 +236,84 @@ public:
      */
     bool waitInactive(const double idleDuration = 0.1, const double timeout = 1.0);
 
+    /*!
+     * Enable automatic placement of blocks onto thread pools.
+     * When enabled, every commit() partitions the blocks of the flow graph
+     * into thread pools pinned to CPU cores or NUMA nodes (see NumaInfo).
+     * Connected blocks are grouped into the same pool so that they share
+     * caches and memory, and buffer managers allocate on the pool's node.
+     * Automatic placement overrides the thread pools set on the blocks
+     * and the thread pool set on this topology with setThreadPool().
+     *
+     * Example request object {"mode" : "CPU", "priority" : 0.5}
+     *
+     * Request options:
+     *  - "mode": "NONE" to disable (default), "CPU" for one pinned thread per core,
+     *    or "NUMA" for a pool per NUMA node pinned to the node's CPUs.
+     *  - "priority": the priority for the created thread pools (see ThreadPoolArgs).
+     *  - "yieldMode": the yield mode for the created thread pools (see ThreadPoolArgs).
+     *
+     * \param request a JSON object string with configuration parameters
+     */
+    void setAutoPlacement(const std::string &request);
+
+    /*!
+     * Re-plan the automatic placement of a running topology.
+     * The load of each block and the traffic on each connection
+     * is measured over the sample time from the block's work stats,
+     * and the blocks are re-partitioned so that the load is balanced.
+     * This call requires automatic placement to be enabled.
+     * \param sampleTime the time in seconds to measure load (0 for no measurement)
+     * \return a JSON formatted array of the placement per environment
+     */
+    std::string replanPlacement(const double sampleTime = 1.0);
+
+    /*!
+     * Configure the network flows of a source port.
+     * When a connection from this port crosses between processes,
+     * the network blocks that carry the flow use these options.
+     * Both network blocks must support the options, otherwise
+     * the commit logs a warning and the flow sends unencoded buffers.
+     * The options apply to the network flows created by the next commit().
+     *
+     * Example request object {"codec" : "delta", "checksum" : true}
+     *
+     * Options:
+     *  - "codec": the name of a BufferCodec (default "none")
+     *  - "checksum": true to verify each buffer with a CRC-32C (default false)
+     *
+     * \throws BufferCodecError if the codec is unknown
+     * \param src the data source (local/remote block)
+     * \param srcPort an identifier for the source port (string or index)
+     * \param options a JSON object string with the network options
+     */
+    template <typename SrcType, typename SrcPortType>
+    void setNetworkOptions(SrcType &&src, const SrcPortType &srcPort, const std::string &options);
+
+    /*!
+     * Annotate the network links between hosts.
+     * When a source port streams to several hosts, the commit plans
+     * a route where each host receives the stream across the network once.
+     * The environment with the most consumers on a host receives the stream,
+     * and relays it to the other environments on the same host.
+     * A host also relays the stream to another host when that link
+     * is cheaper than the link from the source host, for example
+     * when two remote hosts share a fast local network.
+     * Links without an annotation are assumed to be 1 Gbit/s with 0.5 ms latency.
+     *
+     * Example request [{"hosts" : ["192.168.1.10", "192.168.1.11"], "bandwidth" : 1.25e9, "latency" : 0.0001}]
+     *
+     * Link options:
+     *  - "hosts": a pair of hosts by IP address or node ID (see ProxyEnvironment::getNodeId())
+     *  - "bandwidth": the link bandwidth in bytes per second
+     *  - "latency": the link latency in seconds
+     *
+     * The links apply to the network flows created by the next commit().
+     * \throws DataFormatException if the request is malformed
+     * \param request a JSON array string of link objects
+     */
+    void setNetworkLinks(const std::string &request);
+
     /*!
      * Create a connection between a source port and a destination port.
      * \param src the data source (local/remote block/topology)
@@ -239,6 +351,23 @@ public:
      */
     void disconnectAll(const bool recursive = false);
 
+    /*!
+     * Replace a block in this topology with another block.
+     * Every connection to the old block is moved to the new block.
+     * When the topology is active, the swap happens immediately
+     * without a commit and without draining the data flow:
+     * The queued input buffers, labels, and messages of the old block,
+     * and the buffer managers of its output ports are transferred
+     * to the replacement while the neighboring blocks are locked.
+     * The replacement runs in the thread pool of the old block.
+     * Connected ports must have the same names, element sizes, and domains.
+     * \throws TopologyConnectError if the replacement is not possible
+     * \param oldBlock the block to remove (local/remote block)
+     * \param newBlock the replacement block in the same environment
+     */
+    template <typename OldType, typename NewType>
+    void replaceBlock(OldType &&oldBlock, NewType &&newBlock);
+
     //! Create a connection between a source port and a destination port.
     void _connect(
         const Object &src, const std::string &srcPort,
@@ -249,6 +378,12 @@ public:
         const Object &src, const std::string &srcPort,
         const Object &dst, const std::string &dstPort);
 
+    //! Replace a block in this topology with another block.
+    void _replaceBlock(const Object &oldBlock, const Object &newBlock);
+
+    //! Configure the network flows of a source port.
+    void _setNetworkOptions(const Object &src, const std::string &srcPort, const std::string &options);
+
     /*!
      * Export a function call on this topology to set/get parameters.
      * This call will automatically register a slot of the same name.
@@ -286,6 +421,44 @@ public:
      */
     std::string queryJSONStats(void);
 
+    /*!
+     * Analyze the running topology for bottlenecks.
+     * This call samples the block statistics over a period of time,
+     * and computes per-edge occupancy and producer/consumer rates.
+     * The result identifies the rate-limiting block, the critical path
+     * of blocks whose rate it limits, and starved or backpressured edges.
+     * The blocks and edges are ranked by severity in the report.
+     *
+     * Example request object {"sampleTime" : 1.0, "numSamples" : 10}
+     *
+     * Request options:
+     *  - "sampleTime": The time in seconds over which to sample the stats.
+     *  - "numSamples": The number of times to sample the stats (minimum 2).
+     *
+     * Example JSON markup for the bottleneck report:
+     * (The actual report markup has many more fields.)
+     * \code {.json}
+     * {
+     *     "bottleneck" : "unique_id_of_blockB",
+     *     "criticalPath" : ["unique_id_of_blockA", "unique_id_of_blockB"],
+     *     "blocks" : [
+     *         {"id" : "unique_id_of_blockB", "workUtilization" : 0.97, "limitedBy" : "work"},
+     *         {"id" : "unique_id_of_blockA", "workUtilization" : 0.12, "limitedBy" : "downstream"}
+     *     ],
+     *     "edges" : [
+     *         {"srcId" : "unique_id_of_blockA", "srcName" : "0",
+     *          "dstId" : "unique_id_of_blockB", "dstName" : "0",
+     *          "producerRate" : 1e6, "consumerRate" : 1e6,
+     *          "occupancy" : 65536, "state" : "backpressured"}
+     *     ]
+     * }
+     * \endcode
+     *
+     * \param request a JSON object string with configuration parameters
+     * \return a JSON formatted object string
+     */
+    std::string queryBottlenecks(const std::string &request = "{}");
+
     /*!
      * Dump the topology state to a JSON formatted string.
      * This call provides a structured view of the hierarchy.
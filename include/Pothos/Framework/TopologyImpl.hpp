@@ -4,7 +4,7 @@
 /// Templated implementation details for the Topology class.
 ///
 /// \copyright
-/// Copyright (c) 2014-2014 Josh Blum
+/// Copyright (c) 2014-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -100,7 +100,7 @@ portNameToStr(const T &value)
 } //namespace Pothos
 
 /***********************************************************************
- * templated implementation for connect and disconnect
+ * templated implementation for connect, disconnect, replace, and options
  **********************************************************************/
 template <
     typename SrcType, typename SrcPortType,
@@ -125,3 +125,19 @@ void Pothos::Topology::disconnect(
         Detail::connObjToObject(src), Detail::portNameToStr(srcPort),
         Detail::connObjToObject(dst), Detail::portNameToStr(dstPort));
 }
+
+template <typename OldType, typename NewType>
+void Pothos::Topology::replaceBlock(OldType &&oldBlock, NewType &&newBlock)
+{
+    this->_replaceBlock(
+        Detail::connObjToObject(oldBlock),
+        Detail::connObjToObject(newBlock));
+}
+
+template <typename SrcType, typename SrcPortType>
+void Pothos::Topology::setNetworkOptions(SrcType &&src, const SrcPortType &srcPort, const std::string &options)
+{
+    this->_setNetworkOptions(
+        Detail::connObjToObject(src),
+        Detail::portNameToStr(srcPort), options);
+}
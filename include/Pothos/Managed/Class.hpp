@@ -4,7 +4,7 @@
 /// Interface definition for a ManagedClass.
 ///
 /// \copyright
-/// Copyright (c) 2013-2016 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -242,6 +242,34 @@ public:
      */
     const std::vector<Callable> &getConstructors(void) const;
 
+    /*!
+     * Does the class have static methods with the given name?
+     * \param name the name of the static method to look for
+     * \return true when getStaticMethods(name) will not throw
+     */
+    bool hasStaticMethod(const std::string &name) const;
+
+    /*!
+     * Does the class have methods with the given name?
+     * \param name the name of the method to look for
+     * \return true when getMethods(name) will not throw
+     */
+    bool hasMethod(const std::string &name) const;
+
+    /*!
+     * Does the class have an opaque static method with the given name?
+     * \param name the name of the static method to look for
+     * \return true when getOpaqueStaticMethod(name) will not throw
+     */
+    bool hasOpaqueStaticMethod(const std::string &name) const;
+
+    /*!
+     * Does the class have an opaque method with the given name?
+     * \param name the name of the method to look for
+     * \return true when getOpaqueMethod(name) will not throw
+     */
+    bool hasOpaqueMethod(const std::string &name) const;
+
     /*!
      * Get a list of available static methods for the given method name.
      * \throws ManagedClassNameError if the name does not exist in the registry
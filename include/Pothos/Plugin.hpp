@@ -4,7 +4,7 @@
 /// Top level include wrapper for Plugin classes.
 ///
 /// \copyright
-/// Copyright (c) 2013-2016 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -17,3 +17,4 @@
 #include <Pothos/Plugin/Module.hpp>
 #include <Pothos/Plugin/Static.hpp>
 #include <Pothos/Plugin/Exception.hpp>
+#include <Pothos/Plugin/Profile.hpp>
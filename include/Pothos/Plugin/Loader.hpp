@@ -4,7 +4,7 @@
 /// The loader is responsible for loading runtime modules into the plugin registry.
 ///
 /// \copyright
-/// Copyright (c) 2013-2015 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -23,6 +23,13 @@ public:
      * Load all modules in the system install paths.
      * The caller should hold onto the module handles.
      * Releasing the handles will unload the plugins.
+     *
+     * When the environment variable POTHOS_LAZY_MODULES is set to 1,
+     * the plugin paths of each loaded module are recorded in an index,
+     * and indexed modules that only provide block factories are not loaded.
+     * Instead, such a module is loaded the first time that
+     * the plugin registry is asked for one of its paths.
+     * The index entry is ignored when the module file changes.
      * \return a list of loaded module handles
      */
     static std::vector<PluginModule> loadModules(void);
@@ -0,0 +1,82 @@
+///
+/// \file Plugin/Profile.hpp
+///
+/// Timing of module loads and plugin registration during startup.
+///
+/// \copyright
+/// Copyright (c) 2020 Josh Blum
+/// SPDX-License-Identifier: BSL-1.0
+///
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <string>
+#include <vector>
+
+namespace Pothos {
+
+/*!
+ * The plugin profile records how long module loads and plugin registration take.
+ * Profiling is disabled by default, and a disabled profile costs one flag check.
+ * Enable the profile before Pothos::init() to see the costs of a cold start,
+ * or set the environment variable POTHOS_STARTUP_PROFILE=1 to also
+ * record the static initialization of the library itself:
+ *  - "module" records cover the load of each module and its static blocks
+ *  - "plugin" records cover each PluginRegistry::add() including its events
+ *  - "event" records cover one call of a plugin event handler
+ *  - "subtree" records cover the replay of add events for a new event handler
+ *  - "managed" records cover each ManagedClass::commit()
+ */
+class POTHOS_API PluginProfile
+{
+public:
+
+    //! A timed span of work
+    struct POTHOS_API Record
+    {
+        Record(void);
+        std::string category; //!< the kind of work, see above
+        std::string name; //!< module file path, plugin path, or class path
+        std::string detail; //!< extra information, ex the plugin that an event handled
+        size_t threadIndex; //!< a small number for the recording thread
+        long long startUs; //!< the start time in microseconds since profiling was enabled
+        long long durationUs; //!< the duration in microseconds
+    };
+
+    //! Enable or disable recording, enabling a disabled profile starts over with no records
+    static void setEnabled(const bool enabled);
+
+    //! Is recording enabled?
+    static bool isEnabled(void);
+
+    //! Get a copy of all completed records in order of completion
+    static std::vector<Record> getRecords(void);
+
+    /*!
+     * Get the records in the Chrome trace event JSON format.
+     * Load the output into chrome://tracing or a compatible viewer.
+     * \return a JSON string with a traceEvents array
+     */
+    static std::string toChromeTrace(void);
+
+    /*!
+     * Scope records a span from construction to destruction.
+     * Nothing is recorded when profiling is disabled.
+     */
+    class POTHOS_API Scope
+    {
+    public:
+        Scope(const char *category, const std::string &name, const std::string &detail = "");
+        ~Scope(void);
+
+        //! Set the detail string of the record, ex after the work completes
+        void setDetail(const std::string &detail);
+
+    private:
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+        Record *_record;
+    };
+};
+
+} //namespace Pothos
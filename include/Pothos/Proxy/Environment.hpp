@@ -4,18 +4,20 @@
 /// Definitions for the ProxyEnvironment interface class.
 ///
 /// \copyright
-/// Copyright (c) 2013-2016 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
 #pragma once
 #include <Pothos/Config.hpp>
 #include <Pothos/Object/Object.hpp>
+#include <Pothos/Object/Containers.hpp>
 #include <Pothos/Proxy/Proxy.hpp>
 #include <Pothos/Util/RefHolder.hpp>
 #include <Pothos/Callable/Callable.hpp>
 #include <utility> //std::forward
 #include <memory>
+#include <future>
 #include <string>
 #include <vector>
 #include <map>
@@ -30,6 +32,42 @@ typedef std::map<std::string, std::string> ProxyEnvironmentArgs;
  */
 typedef std::pair<std::string, Pothos::Callable> ProxyConvertPair;
 
+/*!
+ * A call to be made as part of a batch, see ProxyEnvironment::callBatch().
+ * The call is made on a proxy object in the environment of the batch,
+ * or on the result of an earlier call in the same batch.
+ */
+struct POTHOS_API ProxyBatchCall
+{
+    //! Make a call on a proxy object in the batch environment
+    ProxyBatchCall(const Proxy &object, const std::string &name, const ObjectVector &args = ObjectVector());
+
+    //! Make a call on the result of an earlier call in the batch
+    ProxyBatchCall(const size_t resultIndex, const std::string &name, const ObjectVector &args = ObjectVector());
+
+    //! The object to make the call on (null to use resultIndex)
+    Proxy object;
+
+    //! The index of an earlier call whose result is the object
+    size_t resultIndex;
+
+    //! The name of the method to call
+    std::string name;
+
+    /*!
+     * The call arguments:
+     * an Object holding a Proxy passes the proxy as the argument,
+     * any other Object is converted into the batch environment.
+     */
+    ObjectVector args;
+
+    /*!
+     * Convert the result to a local object rather than a proxy.
+     * A converted result cannot be used by later calls in the batch.
+     */
+    bool toLocal;
+};
+
 /*!
  * A ProxyEnvironment is the interaction point for dealing with managed objects.
  * Managed objects can take a variety of forms. For example:
@@ -138,6 +176,18 @@ public:
      * \return a new proxy from the serialized data
      */
     virtual Proxy deserialize(std::istream &is) = 0;
+
+    /*!
+     * Make a batch of calls in this environment.
+     * The calls are made in order and a failed call does not stop the batch,
+     * however calls on the result of a failed call will fail as well.
+     * Remote environments send the entire batch in a single request,
+     * so the batch costs one round trip rather than one per call.
+     * \param calls the list of calls to make
+     * \return a future per call with the result as an Object which holds
+     * the result Proxy, or the local result when the call specified toLocal
+     */
+    virtual std::vector<std::future<Object>> callBatch(const std::vector<ProxyBatchCall> &calls);
 };
 
 } //namespace Pothos
@@ -4,16 +4,18 @@
 /// Definitions for the ProxyHandle interface class.
 ///
 /// \copyright
-/// Copyright (c) 2013-2014 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
 #pragma once
 #include <Pothos/Config.hpp>
 #include <Pothos/Proxy/Proxy.hpp>
+#include <Pothos/Object/Object.hpp>
 #include <typeinfo>
 #include <string>
 #include <memory>
+#include <future>
 
 namespace Pothos {
 
@@ -84,6 +86,23 @@ public:
      * This name is used to help convert proxies to local objects.
      */
     virtual std::string getClassName(void) const = 0;
+
+    /*!
+     * Make an asynchronous call on this handle given method name and args.
+     * The default implementation makes the call and returns a ready future.
+     * Remote environments override this call to pipeline requests,
+     * so several calls can be outstanding without waiting on each reply.
+     *
+     * Each argument is either an Object holding a Proxy, or a local Object.
+     * Local objects are converted by the environment, so a remote environment
+     * can send them along with the request rather than as a separate conversion.
+     *
+     * \param name the name of the method
+     * \param args an array of Proxy or local object arguments
+     * \param numArgs the number of arguments in the array
+     * \return a future for the Proxy result (get throws ProxyHandleCallError)
+     */
+    virtual std::future<Proxy> callAsync(const std::string &name, const Object *args, const size_t numArgs);
 };
 
 } //namespace Pothos
@@ -4,7 +4,7 @@
 /// Definitions for the Proxy wrapper class.
 ///
 /// \copyright
-/// Copyright (c) 2013-2017 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 ///                    2019 Nicholas Corgan
 /// SPDX-License-Identifier: BSL-1.0
 ///
@@ -13,6 +13,7 @@
 #include <Pothos/Config.hpp>
 #include <Pothos/Object/Object.hpp>
 #include <memory>
+#include <future>
 #include <string>
 
 namespace Pothos {
@@ -87,6 +88,15 @@ public:
     template <typename... ArgsType>
     Proxy call(const std::string &name, ArgsType&&... args) const;
 
+    /*!
+     * Call a method asynchronously with variable args.
+     * Remote environments send the request without waiting for the reply,
+     * so that several calls can be pipelined over a single connection.
+     * \return a future for the Proxy result of the call
+     */
+    template <typename... ArgsType>
+    std::future<Proxy> callAsync(const std::string &name, ArgsType&&... args) const;
+
     /*!
      * Call a method with a Proxy return and variable args
      * \deprecated use call overload without return type
@@ -4,7 +4,7 @@
 /// Top level include wrapper for remote client/server proxies.
 ///
 /// \copyright
-/// Copyright (c) 2013-2014 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -13,4 +13,7 @@
 #include <Pothos/Remote/Client.hpp>
 #include <Pothos/Remote/Server.hpp>
 #include <Pothos/Remote/Handler.hpp>
+#include <Pothos/Remote/HandlerPool.hpp>
+#include <Pothos/Remote/EnvironmentPool.hpp>
+#include <Pothos/Remote/Ipc.hpp>
 #include <Pothos/Remote/Exception.hpp>
@@ -4,7 +4,7 @@
 /// Remote access proxy client interface.
 ///
 /// \copyright
-/// Copyright (c) 2013-2016 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -33,6 +33,7 @@ public:
      * Make a client handle to interact with a remote server.
      * A unspecified port means use the default locator port.
      * URI format: tcp://resolvable_hostname:optional_port
+     * or ipc://name to connect through shared memory on this host.
      * \param uri a formatted string which specifies a server
      * \param timeoutUs the timeout to connect in microseconds
      */
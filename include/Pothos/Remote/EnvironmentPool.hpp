@@ -0,0 +1,65 @@
+///
+/// \file Remote/EnvironmentPool.hpp
+///
+/// Process-wide pool of connected remote proxy environments.
+///
+/// \copyright
+/// Copyright (c) 2020 Josh Blum
+/// SPDX-License-Identifier: BSL-1.0
+///
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <Pothos/Proxy/Environment.hpp>
+#include <string>
+
+namespace Pothos {
+
+/*!
+ * The environment pool keeps remote proxy environments connected
+ * so that repeated requests for the same server reuse the connection.
+ * Each new environment costs a DNS lookup, a connect, and a handshake,
+ * but a pooled environment is returned immediately.
+ *
+ * Environments are keyed by URI, environment name, and arguments.
+ * Before an environment that was idle for a while is returned,
+ * the pool checks its health with a round trip to the server.
+ * A broken environment is dropped and replaced by a new connection.
+ *
+ * Topology::make() gets the environments of blocks with a "host" URI
+ * from the pool, and clients that connect to servers by URI, such as
+ * a graphical designer, can share it through the managed class
+ * Pothos/RemoteEnvironmentPool. Pothos::deinit() clears the pool.
+ */
+class POTHOS_API RemoteEnvironmentPool
+{
+public:
+
+    /*!
+     * Get a connected environment from the pool or connect a new one.
+     * Concurrent requests for the same key share a single connection attempt.
+     * \throws RemoteClientError when the server cannot be reached
+     * \param uri the server URI (see RemoteClient)
+     * \param name the name of the proxy environment, ex "managed"
+     * \param args the proxy environment arguments
+     * \param timeoutUs the timeout to connect in microseconds
+     * \return the proxy environment shared with other users of the pool
+     */
+    static ProxyEnvironment::Sptr get(const std::string &uri, const std::string &name = "managed",
+        const ProxyEnvironmentArgs &args = ProxyEnvironmentArgs(), const long timeoutUs = 100000);
+
+    /*!
+     * Drop the pooled environments for a server.
+     * Environments in use stay connected until released by their users.
+     * \param uri the server URI
+     */
+    static void remove(const std::string &uri);
+
+    //! Drop all pooled environments
+    static void clear(void);
+
+    //! Get the number of pooled environments
+    static size_t size(void);
+};
+
+} //namespace Pothos
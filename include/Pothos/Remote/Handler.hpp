@@ -4,19 +4,30 @@
 /// Proxy server instance handler.
 ///
 /// \copyright
-/// Copyright (c) 2013-2014 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
 #pragma once
 #include <Pothos/Config.hpp>
 #include <string>
+#include <memory>
 #include <iosfwd>
 
 namespace Pothos {
 
 /*!
  * A server handler runs the Proxy service over an iostream.
+ * The handler serves a single client connection:
+ * environments that the client leaves open are released
+ * along with all of their objects when the handler destructs.
+ *
+ * Object IDs carry a generation so that a handle that was deleted
+ * is rejected rather than aliasing a new object in the same slot.
+ * Clients of the legacy protocol may hold IDs in a 32-bit size_t,
+ * so they get untagged IDs: the handler cannot detect a stale ID
+ * from a legacy client, which then refers to whatever object now
+ * occupies the slot.
  */
 class POTHOS_API RemoteHandler
 {
@@ -28,6 +39,9 @@ public:
     //! Make a new handler given the peer address
     RemoteHandler(const std::string &peerAddr);
 
+    //! Release the environments that the client did not close
+    ~RemoteHandler(void);
+
     /*!
      * Run a handler for a remote proxy that is interfaced over an iostream.
      * This call blocks until the client's remote environment session destructs.
@@ -47,7 +61,8 @@ public:
     bool runHandlerOnce(std::istream &is, std::ostream &os);
 
 private:
-    const std::string _peerAddr;
+    struct Impl;
+    std::shared_ptr<Impl> _impl;
 };
 
 } //namespace Pothos
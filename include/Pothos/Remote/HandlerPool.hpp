@@ -0,0 +1,67 @@
+///
+/// \file Remote/HandlerPool.hpp
+///
+/// Multiplexed proxy server with a pool of handler threads.
+///
+/// \copyright
+/// Copyright (c) 2020 Josh Blum
+/// SPDX-License-Identifier: BSL-1.0
+///
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace Pothos {
+
+/*!
+ * A handler pool serves remote proxy clients on a TCP socket.
+ * A single thread waits on the sockets of every connection
+ * (epoll on linux) and buffers requests until they are complete.
+ * A pool of worker threads runs the remote handler on each request.
+ * Requests from one connection are processed in the order received,
+ * while requests from different connections are processed concurrently,
+ * so an idle or slow client does not hold up the other clients.
+ */
+class POTHOS_API RemoteHandlerPool
+{
+public:
+
+    //! Callback with the number of connections when a client connects or disconnects
+    typedef std::function<void(const size_t numConnections)> ConnectionCallback;
+
+    /*!
+     * Bind the server socket and start serving clients.
+     * \throws RemoteServerError when the socket cannot be bound
+     * \param host the bind address, a wildcard address binds to all interfaces
+     * \param port the bind port or "0" to automatically choose a port
+     * \param numWorkers the initial number of worker threads, 0 for the number of CPUs;
+     * the pool adds workers when every worker is busy, so that requests which
+     * block inside of a call do not starve the requests of other connections
+     * \param callback an optional callback when the number of connections changes
+     */
+    RemoteHandlerPool(const std::string &host, const std::string &port,
+        const size_t numWorkers = 0, const ConnectionCallback &callback = ConnectionCallback());
+
+    /*!
+     * Stop serving and close all connections.
+     * Connections are shut down to unblock workers that are reading or
+     * writing the socket, but the destructor waits on a request that is
+     * blocked inside of the called code until that call returns.
+     */
+    ~RemoteHandlerPool(void);
+
+    //! Get the actual host address that the server is bound to
+    std::string getActualHost(void) const;
+
+    //! Get the actual port that the server is bound to
+    std::string getActualPort(void) const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+} //namespace Pothos
@@ -0,0 +1,74 @@
+///
+/// \file Remote/Ipc.hpp
+///
+/// Shared memory transport for remote proxies on the same host.
+///
+/// \copyright
+/// Copyright (c) 2020 Josh Blum
+/// SPDX-License-Identifier: BSL-1.0
+///
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+namespace Pothos {
+
+/*!
+ * The IPC transport connects two processes on the same host
+ * with a pair of byte rings in shared memory instead of a socket.
+ * Each connection is exposed as an iostream, so the remote handler
+ * and the remote client run over it without modification.
+ *
+ * The transport is selected with the ipc URI scheme: ipc://name
+ * The name identifies a listener, similar to a port for TCP.
+ * The transport is only supported on unix platforms.
+ */
+class POTHOS_API RemoteIpcListener
+{
+public:
+
+    /*!
+     * Create a listener that clients can connect to by name.
+     * \throws RemoteServerError when the name is already in use
+     * \param name the listener name or empty to pick a unique name
+     */
+    RemoteIpcListener(const std::string &name);
+
+    //! Close the listener, connections that were accepted stay open
+    ~RemoteIpcListener(void);
+
+    //! Get the name that clients use to connect
+    const std::string &getName(void) const;
+
+    /*!
+     * Wait for a client to connect to this listener.
+     * \param timeoutUs the maximum time to wait in microseconds
+     * \return the connection stream or null on timeout
+     */
+    std::shared_ptr<std::iostream> accept(const long timeoutUs);
+
+    /*!
+     * Close every connection that was accepted by this listener.
+     * Reads and writes on the closed streams fail, so that the
+     * handler threads servicing the connections can return.
+     */
+    void closeConnections(void);
+
+    /*!
+     * Connect to a listener on this host.
+     * \throws RemoteClientError when the listener cannot be reached
+     * \param name the name of the listener
+     * \param timeoutUs the maximum time to wait in microseconds
+     * \return the connection stream
+     */
+    static std::shared_ptr<std::iostream> connect(const std::string &name, const long timeoutUs);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+} //namespace Pothos
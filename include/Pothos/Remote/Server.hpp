@@ -4,7 +4,7 @@
 /// Remote access proxy server interface.
 ///
 /// \copyright
-/// Copyright (c) 2013-2016 Josh Blum
+/// Copyright (c) 2013-2020 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -32,6 +32,8 @@ public:
      * URI format: tcp://resolvable_hostname:optional_port
      * A host address of 0.0.0.0 or [::] will bind the server to all interfaces.
      * An unspecified port means that an available port will be automatically chosen.
+     * URI format: ipc://optional_name serves through shared memory on this host.
+     * An unspecified name means that a unique name will be chosen (see getActualPort()).
      * \param uri a formatted string which tells the server what kind of service to run
      * \param closePipes true to close stdout/err pipes (keep open for syslog forwarding)
      * \return a handle that when deleted, will cause the server/process to exit
@@ -51,7 +53,7 @@ public:
      */
     static std::string getLocatorPort(void);
 
-    //! Get the actual port that the server is running on
+    //! Get the actual port that the server is running on (the name for ipc)
     std::string getActualPort(void) const;
 
     /*!
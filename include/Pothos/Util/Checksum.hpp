@@ -0,0 +1,31 @@
+///
+/// \file Util/Checksum.hpp
+///
+/// Checksum utilities for data integrity.
+///
+/// \copyright
+/// Copyright (c) 2020 Josh Blum
+/// SPDX-License-Identifier: BSL-1.0
+///
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace Pothos {
+namespace Util {
+
+/*!
+ * Compute the CRC-32C (Castagnoli) checksum of a block of memory.
+ * A running checksum over several blocks is computed by passing
+ * the result of the previous call as the initial value.
+ * \param data a pointer to the start of the memory
+ * \param size the number of bytes
+ * \param crc the checksum of the previous blocks or 0 to start
+ * \return the checksum including this block
+ */
+POTHOS_API uint32_t crc32c(const void *data, const size_t size, const uint32_t crc = 0);
+
+} //namespace Util
+} //namespace Pothos
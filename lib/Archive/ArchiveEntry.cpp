@@ -1,26 +1,57 @@
-// Copyright (c) 2016-2017 Josh Blum
+// Copyright (c) 2016-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "Util/PublishedTable.hpp"
 #include <Pothos/Archive/ArchiveEntry.hpp>
 #include <Pothos/Archive/Exception.hpp>
 #include <Pothos/Util/TypeInfo.hpp>
+#include <Poco/Logger.h>
+#include <mutex>
 #include <map>
 
+//from lib/Plugin/Module.cpp
+void pluginModuleNoteArchiveEntry(void);
+
+/***********************************************************************
+ * Entry lookup tables
+ **********************************************************************/
+
+/*!
+ * Entries are added during static initialization of the library and modules,
+ * and removed when a module unloads, lookups happen for every polymorphic object.
+ * A removed entry is published as null. Use a 64-bit number and not size_t.
+ */
+typedef PublishedTable<unsigned long long, Pothos::Archive::ArchiveEntry *> ArchiveTable;
+
 /*!
- * Store both type info hashes and string ID hashes.
- * Archive entries are added during static initialization.
- * Therefore we don't protect the access with any locks.
- * Use a 64-bit number and not size_t which may be 32-bits.
+ * Type info hashes and string ID hashes are kept apart
+ * so that a type hash can never match the hash of an unrelated string ID.
+ * The type hash of each entry is remembered to remove it on unload.
  */
-static std::map<unsigned long long, Pothos::Archive::ArchiveEntry *> &getArchiveEntryMap(void)
+struct ArchiveTables
 {
-    static std::map<unsigned long long, Pothos::Archive::ArchiveEntry *> map;
-    return map;
+    std::mutex mutex;
+    ArchiveTable byType;
+    ArchiveTable byHash;
+    std::map<const Pothos::Archive::ArchiveEntry *, unsigned long long> typeHashes;
+};
+
+static ArchiveTables &getArchiveTables(void)
+{
+    static ArchiveTables tables;
+    return tables;
 }
 
-/*!
+static Pothos::Archive::ArchiveEntry *tableFind(const ArchiveTable &table, const unsigned long long key)
+{
+    const auto entry = table.find(key);
+    return (entry == nullptr)?nullptr:*entry;
+}
+
+/***********************************************************************
  * Reproducible hash from string to unsigned 64-bit integer.
- */
+ * This hash is written to archives, peers must agree on it.
+ **********************************************************************/
 static unsigned long long hashString64(const std::string &str)
 {
     unsigned long long h = 0;
@@ -31,40 +62,65 @@ static unsigned long long hashString64(const std::string &str)
     return h;
 }
 
+/***********************************************************************
+ * Archive entry implementation
+ **********************************************************************/
 Pothos::Archive::ArchiveEntry::ArchiveEntry(const std::type_info &type, const std::string &id):
     _id(id),
     _hash(hashString64(id))
 {
-    getArchiveEntryMap()[type.hash_code()] = this;
-    getArchiveEntryMap()[_hash] = this;
+    auto &tables = getArchiveTables();
+    std::lock_guard<std::mutex> lock(tables.mutex);
+
+    //the same ID may be registered again, a different ID is a collision:
+    //the first entry keeps the hash and this entry is not registered
+    const auto previous = tableFind(tables.byHash, _hash);
+    if (previous != nullptr and previous->getId() != id)
+    {
+        poco_error(Poco::Logger::get("Pothos.ArchiveEntry"),
+            "hash collision between "+previous->getId()+" and "+id+", "+id+" is not registered");
+        return;
+    }
+
+    tables.byType.publish(type.hash_code(), this);
+    tables.byHash.publish(_hash, this);
+    tables.typeHashes[this] = type.hash_code();
+
+    //modules with entries are looked up by hash and cannot be loaded lazily
+    pluginModuleNoteArchiveEntry();
 }
 
 Pothos::Archive::ArchiveEntry::~ArchiveEntry(void)
 {
-    return;
+    //entries in modules are removed when the module unloads
+    auto &tables = getArchiveTables();
+    std::lock_guard<std::mutex> lock(tables.mutex);
+    const auto it = tables.typeHashes.find(this);
+    if (it == tables.typeHashes.end()) return;
+    if (tableFind(tables.byType, it->second) == this) tables.byType.publish(it->second, nullptr);
+    if (tableFind(tables.byHash, _hash) == this) tables.byHash.publish(_hash, nullptr);
+    tables.typeHashes.erase(it);
 }
 
 const Pothos::Archive::ArchiveEntry &Pothos::Archive::ArchiveEntry::find(const std::type_info &type)
 {
-    const auto &map = getArchiveEntryMap();
-    const auto it = map.find(type.hash_code());
-    if (it != map.end()) return *it->second;
+    const auto entry = tableFind(getArchiveTables().byType, type.hash_code());
+    if (entry != nullptr) return *entry;
     const auto typeStr = Pothos::Util::typeInfoToString(type);
     throw Pothos::ArchiveException("ArchiveEntry::find("+typeStr+")", "no entry registered for type");
 }
 
 const Pothos::Archive::ArchiveEntry &Pothos::Archive::ArchiveEntry::find(const std::string &id)
 {
-    const auto &map = getArchiveEntryMap();
-    const auto it = map.find(hashString64(id));
-    if (it != map.end()) return *it->second;
+    //the hash may belong to a different ID that was registered first
+    const auto entry = tableFind(getArchiveTables().byHash, hashString64(id));
+    if (entry != nullptr and entry->getId() == id) return *entry;
     throw Pothos::ArchiveException("ArchiveEntry::find("+id+")", "no entry registered for GUID");
 }
 
 const Pothos::Archive::ArchiveEntry &Pothos::Archive::ArchiveEntry::find(const unsigned long long &hash)
 {
-    const auto &map = getArchiveEntryMap();
-    const auto it = map.find(hash);
-    if (it != map.end()) return *it->second;
+    const auto entry = tableFind(getArchiveTables().byHash, hash);
+    if (entry != nullptr) return *entry;
     throw Pothos::ArchiveException("ArchiveEntry::find("+std::to_string(hash)+")", "no entry registered for hash");
 }
@@ -0,0 +1,25 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <streambuf>
+#include <cstddef> //size_t
+
+/*!
+ * An output stream buffer that can reference stable memory.
+ * OStreamArchiver::writeBytesNoCopy() hands large payloads
+ * to this interface instead of copying them into the stream.
+ * The buffer must not have a put area, so that referenced
+ * bytes stay ordered with respect to the regular writes.
+ */
+class NoCopyStreamBuf : public std::streambuf
+{
+public:
+    virtual ~NoCopyStreamBuf(void)
+    {
+        return;
+    }
+
+    //! Reference bytes that stay valid until the stream is consumed
+    virtual void putNoCopy(const char *s, const size_t n) = 0;
+};
@@ -1,8 +1,9 @@
-// Copyright (c) 2016-2018 Josh Blum
+// Copyright (c) 2016-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Archive/StreamArchiver.hpp>
 #include <Pothos/Archive/Numbers.hpp>
+#include "Archive/NoCopyStreamBuf.hpp"
 #include <iostream>
 
 #define POTHOS_ARCHIVE_VERSION 2
@@ -19,6 +20,14 @@ void Pothos::Archive::OStreamArchiver::writeBytes(const void *buff, const size_t
     os.write(reinterpret_cast<const char *>(buff), len);
 }
 
+void Pothos::Archive::OStreamArchiver::writeBytesNoCopy(const void *buff, const size_t len)
+{
+    if (len == 0) return;
+    auto noCopyBuf = dynamic_cast<NoCopyStreamBuf *>(os.rdbuf());
+    if (noCopyBuf == nullptr) return this->writeBytes(buff, len);
+    noCopyBuf->putNoCopy(reinterpret_cast<const char *>(buff), len);
+}
+
 Pothos::Archive::IStreamArchiver::IStreamArchiver(std::istream &is):
     is(is), ver(0)
 {
@@ -6,6 +6,7 @@
 #include <Pothos/Testing.hpp>
 #include <Pothos/Archive.hpp>
 #include <sstream>
+#include <memory>
 #include <iostream>
 
 namespace PothosTesting {
@@ -64,3 +65,47 @@ POTHOS_TEST_BLOCK("/archive/tests", test_polymorphic_type)
     delete x;
     delete y;
 }
+
+namespace PothosTesting {
+
+    struct CollisionEntry : Pothos::Archive::ArchiveEntry
+    {
+        CollisionEntry(const std::type_info &type, const std::string &id):
+            Pothos::Archive::ArchiveEntry(type, id){}
+        void save(Pothos::Archive::OStreamArchiver &, const void *) const{}
+        void *load(Pothos::Archive::IStreamArchiver &) const{return nullptr;}
+    };
+
+    struct CollisionTypeA{};
+    struct CollisionTypeB{};
+
+} //namespace PothosTesting
+
+POTHOS_TEST_BLOCK("/archive/tests", test_archive_entry_collision)
+{
+    //leading null bytes do not change the ID hash written to archives
+    const std::string idA("PothosTesting/collision");
+    const std::string idB(std::string(1, '\0')+idA);
+
+    std::unique_ptr<PothosTesting::CollisionEntry> entryA(new PothosTesting::CollisionEntry(typeid(PothosTesting::CollisionTypeA), idA));
+    POTHOS_TEST_EQUAL(&Pothos::Archive::ArchiveEntry::find(idA), entryA.get());
+    POTHOS_TEST_EQUAL(&Pothos::Archive::ArchiveEntry::find(entryA->getHash()), entryA.get());
+
+    //the first entry keeps the hash, the colliding entry is not registered
+    std::unique_ptr<PothosTesting::CollisionEntry> entryB(new PothosTesting::CollisionEntry(typeid(PothosTesting::CollisionTypeB), idB));
+    POTHOS_TEST_EQUAL(entryA->getHash(), entryB->getHash());
+    POTHOS_TEST_EQUAL(&Pothos::Archive::ArchiveEntry::find(entryB->getHash()), entryA.get());
+    POTHOS_TEST_THROWS(Pothos::Archive::ArchiveEntry::find(idB), Pothos::ArchiveException);
+    POTHOS_TEST_THROWS(Pothos::Archive::ArchiveEntry::find(typeid(PothosTesting::CollisionTypeB)), Pothos::ArchiveException);
+
+    //removing the colliding entry leaves the first one in place
+    entryB.reset();
+    POTHOS_TEST_EQUAL(&Pothos::Archive::ArchiveEntry::find(typeid(PothosTesting::CollisionTypeA)), entryA.get());
+
+    //removed entries are no longer found
+    const auto hash = entryA->getHash();
+    entryA.reset();
+    POTHOS_TEST_THROWS(Pothos::Archive::ArchiveEntry::find(idA), Pothos::ArchiveException);
+    POTHOS_TEST_THROWS(Pothos::Archive::ArchiveEntry::find(hash), Pothos::ArchiveException);
+    POTHOS_TEST_THROWS(Pothos::Archive::ArchiveEntry::find(typeid(PothosTesting::CollisionTypeA)), Pothos::ArchiveException);
+}
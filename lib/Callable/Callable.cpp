@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2018 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Callable/CallableImpl.hpp>
@@ -14,6 +14,12 @@ Pothos::Callable::Callable(void)
     assert(not *this);
 }
 
+/*!
+ * Calls with up to this many arguments build the argument list
+ * on the stack rather than allocating a vector on each call.
+ */
+static const size_t CALL_ARGS_STACK_SIZE = 8;
+
 Pothos::Object Pothos::Callable::opaqueCall(const Object *inputArgs, const size_t numArgs) const
 {
     if (_impl == nullptr)
@@ -21,10 +27,28 @@ Pothos::Object Pothos::Callable::opaqueCall(const Object *inputArgs, const size_
         throw Pothos::CallableNullError("Pothos::Callable::call()", "null Callable");
     }
 
+    const size_t numCallArgs = _impl->getNumArgs();
+
+    //fast path: no bindings and the input arguments are already the exact types
+    if (_boundArgs.empty() and numArgs == numCallArgs)
+    {
+        size_t i = 0;
+        while (i < numArgs and inputArgs[i].type() == _impl->type(int(i))) i++;
+        if (i == numArgs) return _impl->call(inputArgs);
+    }
+
     //Create callArgs which is a combination of inputArgs and boundArgs
-    std::vector<Object> callArgs(_impl->getNumArgs());
+    Object stackArgs[CALL_ARGS_STACK_SIZE];
+    std::vector<Object> heapArgs;
+    Object *callArgs = stackArgs;
+    if (numCallArgs > CALL_ARGS_STACK_SIZE)
+    {
+        heapArgs.resize(numCallArgs);
+        callArgs = heapArgs.data();
+    }
+
     size_t inputArgsIndex = 0;
-    for (size_t i = 0; i < callArgs.size(); i++)
+    for (size_t i = 0; i < numCallArgs; i++)
     {
         //is there a binding? if so use it
         if (_boundArgs.size() > i and _boundArgs[i])
@@ -44,9 +68,11 @@ Pothos::Object Pothos::Callable::opaqueCall(const Object *inputArgs, const size_
         }
 
         //perform conversion on arg to get an Object of the exact type
+        const auto &argType = _impl->type(int(i));
+        if (callArgs[i].type() == argType) continue;
         try
         {
-            callArgs[i] = callArgs[i].convert(_impl->type(int(i)));
+            callArgs[i] = callArgs[i].convert(argType);
         }
         catch(const Pothos::ObjectConvertError &ex)
         {
@@ -55,7 +81,7 @@ Pothos::Object Pothos::Callable::opaqueCall(const Object *inputArgs, const size_
         }
     }
 
-    return _impl->call(callArgs.data());
+    return _impl->call(callArgs);
 }
 
 size_t Pothos::Callable::getNumArgs(void) const
@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2019 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Callable.hpp>
@@ -292,6 +292,42 @@ POTHOS_TEST_BLOCK("/callable/tests", test_callable_bind)
     POTHOS_TEST_THROWS(addMany.type(3), Pothos::CallableArgumentError);
 }
 
+/***********************************************************************
+ * Test typed calls
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/callable/tests", test_callable_typed)
+{
+    //exact signature matches call directly
+    TestClass test;
+    Pothos::Callable setBar(&TestClass::setBar);
+    Pothos::Callable getBar(&TestClass::getBar);
+    setBar.callTyped<void, TestClass &, int>(test, 42);
+    POTHOS_TEST_EQUAL(42, (getBar.callTyped<int, TestClass &>(test)));
+
+    Pothos::Callable strLen(&TestClass::strLen);
+    POTHOS_TEST_EQUAL(5, (strLen.callTyped<long, const std::string &>("hello")));
+
+    //mismatched signatures fall back to conversions
+    setBar.callTyped<void, TestClass &, long>(test, 21);
+    POTHOS_TEST_EQUAL(21, test._bar);
+    POTHOS_TEST_EQUAL(21, (getBar.callTyped<long, TestClass &>(test)));
+    POTHOS_TEST_EQUAL(32, (Pothos::Callable(&TestClass::add).callTyped<long, int, int>(10, 22)));
+    POTHOS_TEST_THROWS((strLen.callTyped<long, int>(1)), Pothos::CallableArgumentError);
+    POTHOS_TEST_THROWS((getBar.callTyped<NonsenseClass, TestClass &>(test)), Pothos::CallableReturnError);
+
+    //bound arguments fall back to the opaque call
+    Pothos::Callable add(&TestClass::add);
+    add.bind(unsigned(11), 1);
+    POTHOS_TEST_EQUAL(21, (add.callTyped<long, int>(10)));
+
+    //the opaque call with exact types and a stack argument list
+    Pothos::Callable addMany(&TestClass::addMany);
+    POTHOS_TEST_EQUAL(15, addMany.call<long long>(int(1), unsigned(2), long(3), char(4), short(5)));
+    POTHOS_TEST_EQUAL(15, addMany.call<long long>(1, 2, 3, 4, 5));
+
+    POTHOS_TEST_THROWS(Pothos::Callable().callTyped<void>(), Pothos::CallableNullError);
+}
+
 /***********************************************************************
  * Test throwing
  **********************************************************************/
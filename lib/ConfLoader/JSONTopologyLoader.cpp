@@ -1,4 +1,4 @@
-// Copyright (c) 2016-2017 Josh Blum
+// Copyright (c) 2016-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Plugin.hpp>
@@ -6,32 +6,72 @@
 #include <Poco/Path.h>
 #include <Poco/File.h>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <map>
 #include <json.hpp>
 
 using json = nlohmann::json;
 
+/***********************************************************************
+ * The JSON description is parsed once when the loader runs.
+ * Factory calls without args reuse a compiled snapshot,
+ * so that expressions are only evaluated on the first call.
+ **********************************************************************/
+struct JSONTopologyCache
+{
+    JSONTopologyCache(void):
+        notSerializable(false)
+    {}
+    std::mutex mutex;
+    json topObj;
+    std::string snapshot;
+    bool notSerializable; //!< the compile failed, evaluate on every call
+};
+
 /***********************************************************************
  * The topology factory loads args into a JSON description
  * and creates and returns an instance of the topology
  **********************************************************************/
 static Pothos::Object opaqueJSONTopologyFactory(
-    const std::string &jsonStr,
+    const std::shared_ptr<JSONTopologyCache> &cache,
     const Pothos::Object *args,
     const size_t numArgs)
 {
-    //parse the json formatted string into a JSON object
-    json topObj;
-    try
+    //no overlays: create the topology from the compiled snapshot
+    if (numArgs == 0)
     {
-        topObj = json::parse(jsonStr);
-    }
-    catch (const std::exception &ex)
-    {
-        throw Pothos::DataFormatException(ex.what());
+        std::string snapshot;
+        bool notSerializable = false;
+        {
+            std::lock_guard<std::mutex> lock(cache->mutex);
+            snapshot = cache->snapshot;
+            notSerializable = cache->notSerializable;
+        }
+
+        //compile outside of the lock, concurrent first calls may compile twice
+        if (snapshot.empty() and not notSerializable)
+        {
+            try
+            {
+                snapshot = Pothos::Topology::compileSnapshot(cache->topObj.dump());
+            }
+            catch (const Pothos::ObjectSerializeError &)
+            {
+                notSerializable = true;
+            }
+            std::lock_guard<std::mutex> lock(cache->mutex);
+            cache->snapshot = snapshot;
+            cache->notSerializable = notSerializable;
+        }
+
+        //arguments that cannot be serialized are evaluated on every call
+        if (notSerializable) return Pothos::Object(Pothos::Topology::make(cache->topObj.dump()));
+        return Pothos::Object(Pothos::Topology::makeFromSnapshot(snapshot));
     }
 
     //apply the global variable overlays
+    auto topObj = cache->topObj;
     auto &globalsArray = topObj["globals"];
     if (numArgs > globalsArray.size())
     {
@@ -78,12 +118,20 @@ static std::vector<Pothos::PluginPath> JSONTopologyLoader(const std::map<std::st
         throw Pothos::Exception("missing plugin path");
     const auto pluginPath = Pothos::PluginPath("/blocks", pathIt->second);
 
-    //parse the file into a string
+    //parse the file into a JSON object
+    std::shared_ptr<JSONTopologyCache> cache(new JSONTopologyCache());
     std::ifstream ifs(Poco::Path::expand(jsonPath.toString()));
-    const std::string json((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    try
+    {
+        cache->topObj = json::parse(ifs);
+    }
+    catch (const std::exception &ex)
+    {
+        throw Pothos::DataFormatException(jsonPath.toString(), ex.what());
+    }
 
     //create an entry for the factory
-    const auto factory = Pothos::Callable(&opaqueJSONTopologyFactory).bind(json, 0);
+    const auto factory = Pothos::Callable(&opaqueJSONTopologyFactory).bind(cache, 0);
     Pothos::PluginRegistry::addCall(pluginPath, factory);
 
     entries.push_back(pluginPath);
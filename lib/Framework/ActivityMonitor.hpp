@@ -0,0 +1,140 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <algorithm> //max, find
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*!
+ * The activity monitor is shared between a flattened topology
+ * and the worker actors of all blocks that it has activated.
+ * Each actor bumps its own slot when work() produces or consumes,
+ * so that busy actors on different cores never share a cache line.
+ * The topology aggregates the slots to implement waitInactive()
+ * without having to poll each block through the proxy layer.
+ */
+class ActivityMonitor
+{
+public:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    /*!
+     * The activity counters of a single actor.
+     * Padding keeps the counters of neighboring slots apart.
+     */
+    struct Slot
+    {
+        Slot(void):
+            counter(0),
+            lastActivity(Clock::now().time_since_epoch().count())
+        {
+            return;
+        }
+
+        /*!
+         * Record an activity event at the specified time.
+         * This is called by the worker actor in the work context.
+         */
+        void bump(const Clock::time_point &now)
+        {
+            lastActivity.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+            counter.fetch_add(1, std::memory_order_release);
+        }
+
+        char paddingFront[64];
+        std::atomic<unsigned long long> counter;
+        std::atomic<Clock::rep> lastActivity;
+        char paddingBack[64];
+    };
+
+    ActivityMonitor(void):
+        _retiredCounter(0),
+        _retiredLastActivity(Clock::now().time_since_epoch().count())
+    {
+        return;
+    }
+
+    //! Create a slot for an actor that joins the topology
+    std::shared_ptr<Slot> attach(void)
+    {
+        std::shared_ptr<Slot> slot(new Slot());
+        std::lock_guard<std::mutex> lock(_mutex);
+        _slots.push_back(slot);
+        return slot;
+    }
+
+    //! Remove the slot of an actor, its events remain counted
+    void detach(const std::shared_ptr<Slot> &slot)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = std::find(_slots.begin(), _slots.end(), slot);
+        if (it == _slots.end()) return;
+        _slots.erase(it);
+        _retiredCounter += slot->counter.load(std::memory_order_acquire);
+        _retiredLastActivity = std::max(_retiredLastActivity, slot->lastActivity.load(std::memory_order_relaxed));
+    }
+
+    //! The number of activity events recorded so far
+    unsigned long long count(void) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        unsigned long long total(_retiredCounter);
+        for (const auto &slot : _slots) total += slot->counter.load(std::memory_order_acquire);
+        return total;
+    }
+
+    //! Get the time point of the most recent activity
+    Clock::time_point lastActivity(void) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Clock::rep last(_retiredLastActivity);
+        for (const auto &slot : _slots) last = std::max(last, slot->lastActivity.load(std::memory_order_relaxed));
+        return Clock::time_point(Clock::duration(last));
+    }
+
+    /*!
+     * Block until the monitor has been idle for the specified duration.
+     * There is no need to wake the waiter when activity occurs,
+     * since activity can only push the idle deadline further out.
+     * Instead, sleep until the deadline computed from the last event,
+     * and check the counter to determine if activity occurred meanwhile.
+     * \param idleDuration the required period of inactivity
+     * \param timeout the maximum time to wait or zero to wait forever
+     * \return true if the monitor became inactive before the timeout
+     */
+    bool waitInactive(const Clock::duration &idleDuration, const Clock::duration &timeout)
+    {
+        const auto entryTime = Clock::now();
+        const auto exitTime = entryTime + timeout;
+        while (true)
+        {
+            const auto lastCount = this->count();
+            const auto deadline = std::max(entryTime, this->lastActivity()) + idleDuration;
+            const auto now = Clock::now();
+
+            //idle duration reached with no intermediate activity
+            if (now >= deadline and lastCount == this->count()) return true;
+
+            //the deadline lies beyond the timeout, sleep out the timeout
+            if (timeout != Clock::duration::zero() and deadline > exitTime)
+            {
+                std::this_thread::sleep_until(exitTime);
+                return false;
+            }
+
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::vector<std::shared_ptr<Slot>> _slots;
+    unsigned long long _retiredCounter;
+    Clock::rep _retiredLastActivity;
+};
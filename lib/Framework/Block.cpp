@@ -7,6 +7,7 @@
 #include <Pothos/Framework/InputPortImpl.hpp>
 #include <Pothos/Framework/OutputPortImpl.hpp>
 #include <Poco/String.h>
+#include <iterator> //next
 
 /***********************************************************************
  * threadpool calls
@@ -33,6 +34,9 @@ void Pothos::Block::setThreadPool(const ThreadPool &newThreadPool)
         //configure the actor interface based on thread pool args
         //all we support for now is the default (wait) or spin mode
         _actor->enableWaitMode(threads->isWaitingEnabled());
+
+        //buffers allocated for this block should be local to its threads
+        _actor->bufferNodeAffinity = threads->getNodeAffinity();
     }
 
     //and save the reference to the new pool
@@ -173,16 +177,15 @@ void Pothos::Block::registerProbe(
 Pothos::Object Pothos::Block::opaqueCallHandler(const std::string &name, const Pothos::Object *inputArgs, const size_t numArgs)
 {
     //check if the name is a registered call
-    const size_t numMatches = _calls.count(name);
+    const auto ret = _calls.equal_range(name);
 
     //no matches throw error
-    if (numMatches == 0) throw Pothos::BlockCallNotFound("Pothos::Block::call("+name+")", "method does not exist in registry");
+    if (ret.first == ret.second) throw Pothos::BlockCallNotFound("Pothos::Block::call("+name+")", "method does not exist in registry");
 
     //only one match, try the call and let it error out
-    if (numMatches == 1) return _calls.find(name)->second.opaqueCall(inputArgs, numArgs);
+    if (std::next(ret.first) == ret.second) return ret.first->second.opaqueCall(inputArgs, numArgs);
 
     //otherwise try a match
-    const auto ret = _calls.equal_range(name);
     for (auto it = ret.first; it != ret.second; ++it)
     {
         const auto &call = it->second;
@@ -1,6 +1,7 @@
-// Copyright (c) 2014-2017 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "Util/PublishedTable.hpp"
 #include <Pothos/Framework/Block.hpp>
 #include <Pothos/Framework/Topology.hpp>
 #include <Pothos/Framework/BlockRegistry.hpp>
@@ -8,6 +9,8 @@
 #include <Pothos/Plugin.hpp>
 #include <Poco/Logger.h>
 #include <iostream>
+#include <atomic>
+#include <mutex>
 
 //! Helper function to check the signature of an "opaque" call
 static bool isOpaqueFactory(const Pothos::Callable &factory)
@@ -69,14 +72,65 @@ Pothos::BlockRegistry::BlockRegistry(const std::string &path, const Callable &fa
     }
 }
 
+/***********************************************************************
+ * Cache of resolved factories keyed by the block path
+ **********************************************************************/
+struct BlockFactoryEntry
+{
+    Pothos::Callable factory;
+    Pothos::PluginModule module;
+    size_t generation; //the cache generation when resolved
+};
+
+static std::mutex &getFactoryCacheMutex(void)
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static PublishedTable<std::string, BlockFactoryEntry> &getFactoryCache(void)
+{
+    static PublishedTable<std::string, BlockFactoryEntry> cache;
+    return cache;
+}
+
+//! Incremented when a block plugin is removed, older entries are resolved again
+static std::atomic<size_t> &getFactoryCacheGeneration(void)
+{
+    static std::atomic<size_t> generation(0);
+    return generation;
+}
+
+//called by the plugin registry after removing a plugin under /blocks
+void invalidateBlockFactoryCache(void)
+{
+    getFactoryCacheGeneration()++;
+}
+
+static const BlockFactoryEntry &lookupBlockFactory(const std::string &path)
+{
+    //an entry resolved before a removal is never current, even when published after it
+    const size_t generation = getFactoryCacheGeneration().load(std::memory_order_acquire);
+    const auto cached = getFactoryCache().find(path);
+    if (cached != nullptr and cached->generation == generation) return *cached;
+
+    const auto plugin = Pothos::PluginRegistry::get(Pothos::PluginPath("/blocks", path));
+    BlockFactoryEntry entry;
+    entry.factory = plugin.getObject().extract<Pothos::Callable>();
+    entry.module = plugin.getModule();
+    entry.generation = generation;
+
+    std::lock_guard<std::mutex> lock(getFactoryCacheMutex());
+    return getFactoryCache().publish(path, entry);
+}
+
 /***********************************************************************
  * BlockRegistry factory - retrieve factory and instantiate with args
  **********************************************************************/
 static Pothos::Object blockRegistryMake(const std::string &path, const Pothos::Object *args, const size_t numArgs)
 {
-    const auto pluginPath = Pothos::PluginPath("/blocks", path);
-    const auto plugin = Pothos::PluginRegistry::get(pluginPath);
-    const auto factory = plugin.getObject().extract<Pothos::Callable>();
+    const auto &entry = lookupBlockFactory(path);
+    const auto &factory = entry.factory;
 
     //handle opaque factory case
     if (isOpaqueFactory(factory)) return factory.call<Pothos::Object>(args, numArgs);
@@ -92,7 +146,7 @@ static Pothos::Object blockRegistryMake(const std::string &path, const Pothos::O
     {
         Pothos::Block *element = factory.opaqueCall(args, numArgs);
         if (element->getName().empty()) element->setName(path); //a better name
-        element->holdRef(Pothos::Object(plugin.getModule()));
+        element->holdRef(Pothos::Object(entry.module));
         return Pothos::Object(std::shared_ptr<Pothos::Block>(element));
     }
 
@@ -101,7 +155,7 @@ static Pothos::Object blockRegistryMake(const std::string &path, const Pothos::O
     {
         std::shared_ptr<Pothos::Block> element = factory.opaqueCall(args, numArgs);
         if (element->getName().empty()) element->setName(path); //a better name
-        element->holdRef(Pothos::Object(plugin.getModule()));
+        element->holdRef(Pothos::Object(entry.module));
         return Pothos::Object(element);
     }
 
@@ -110,7 +164,7 @@ static Pothos::Object blockRegistryMake(const std::string &path, const Pothos::O
     {
         Pothos::Topology *element = factory.opaqueCall(args, numArgs);
         if (element->getName().empty()) element->setName(path); //a better name
-        element->holdRef(Pothos::Object(plugin.getModule()));
+        element->holdRef(Pothos::Object(entry.module));
         return Pothos::Object(std::shared_ptr<Pothos::Topology>(element));
     }
 
@@ -119,7 +173,7 @@ static Pothos::Object blockRegistryMake(const std::string &path, const Pothos::O
     {
         std::shared_ptr<Pothos::Topology> element = factory.opaqueCall(args, numArgs);
         if (element->getName().empty()) element->setName(path); //a better name
-        element->holdRef(Pothos::Object(plugin.getModule()));
+        element->holdRef(Pothos::Object(entry.module));
         return Pothos::Object(element);
     }
 
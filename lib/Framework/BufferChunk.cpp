@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Framework/BufferChunk.hpp>
@@ -103,8 +103,8 @@ void save(Archive & ar, const Pothos::BufferChunk &t, const unsigned int)
     if (is_null) return;
     const Poco::UInt32 length = Poco::UInt32(t.length);
     ar << length;
-    Pothos::serialization::BinaryObject bo(t.as<void *>(), t.length);
-    ar << bo;
+    //the chunk owns its memory, the stream may reference it rather than copy
+    ar.writeBytesNoCopy(t.as<const void *>(), t.length);
     ar << t.dtype;
 }
 
@@ -117,6 +117,8 @@ void load(Archive & ar, Pothos::BufferChunk &t, const unsigned int)
     if (is_null) return;
     Poco::UInt32 length = 0;
     ar >> length;
+    //copied rather than referenced from the received stream:
+    //a new chunk keeps the alignment of freshly allocated buffer memory
     t = Pothos::BufferChunk(size_t(length));
     Pothos::serialization::BinaryObject bo(t.as<void *>(), t.length);
     ar >> bo;
@@ -0,0 +1,28 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Framework/BufferCodec.hpp>
+#include <Pothos/Framework/Exception.hpp>
+#include <Pothos/Callable.hpp>
+#include <Pothos/Plugin.hpp>
+
+Pothos::BufferCodec::~BufferCodec(void)
+{
+    return;
+}
+
+Pothos::BufferCodec::Sptr Pothos::BufferCodec::make(const std::string &name)
+{
+    Sptr codec;
+    try
+    {
+        const auto plugin = Pothos::PluginRegistry::get(Pothos::PluginPath("/framework/buffer_codec").join(name));
+        const auto &callable = plugin.getObject().extract<Pothos::Callable>();
+        codec = callable.call();
+    }
+    catch(const Exception &ex)
+    {
+        throw Pothos::BufferCodecError("Pothos::BufferCodec::make()", ex);
+    }
+    return codec;
+}
@@ -0,0 +1,227 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Framework/BufferCodec.hpp>
+#include <Pothos/Framework/Exception.hpp>
+#include <Pothos/Plugin.hpp>
+#include <cstring> //memcpy
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************************
+ * Pass-through codec
+ **********************************************************************/
+class NoneBufferCodec : public Pothos::BufferCodec
+{
+public:
+    Pothos::BufferChunk encode(const Pothos::BufferChunk &buffer)
+    {
+        return buffer;
+    }
+
+    Pothos::BufferChunk decode(const Pothos::BufferChunk &buffer)
+    {
+        return buffer;
+    }
+};
+
+/***********************************************************************
+ * Delta codec format:
+ *  - u8 version, u8 mode (raw or delta)
+ *  - varint dtype markup length, dtype markup
+ *  - varint original length in bytes
+ *  - payload: raw bytes or zig-zag varint deltas
+ **********************************************************************/
+static const uint8_t DELTA_CODEC_VERSION = 1;
+static const uint8_t DELTA_MODE_RAW = 0;
+static const uint8_t DELTA_MODE_DELTA = 1;
+
+static inline uint8_t *writeVarint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = uint8_t(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = uint8_t(v);
+    return p;
+}
+
+static inline uint64_t readVarint(const uint8_t *&p, const uint8_t *end)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (p == end) throw Pothos::BufferCodecError("DeltaBufferCodec::decode()", "truncated buffer");
+        const uint8_t b = *p++;
+        v |= uint64_t(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return v;
+    }
+    throw Pothos::BufferCodecError("DeltaBufferCodec::decode()", "malformed varint");
+}
+
+//! Load a native sample of the given width into 64 bits with sign or zero extension
+static inline uint64_t loadSample(const uint8_t *p, const size_t width, const bool isSigned)
+{
+    uint64_t v = 0;
+    switch (width)
+    {
+    case 1: v = p[0]; break;
+    case 2: {uint16_t x; std::memcpy(&x, p, 2); v = x;} break;
+    case 4: {uint32_t x; std::memcpy(&x, p, 4); v = x;} break;
+    case 8: std::memcpy(&v, p, 8); break;
+    default: throw Pothos::BufferCodecError("DeltaBufferCodec", "unsupported sample width " + std::to_string(width));
+    }
+    if (isSigned and width < 8 and ((v >> (width*8-1)) & 1) != 0) v |= ~uint64_t(0) << (width*8);
+    return v;
+}
+
+//! Store the low bits of a 64-bit value as a native sample of the given width
+static inline void storeSample(uint8_t *p, const uint64_t v, const size_t width)
+{
+    switch (width)
+    {
+    case 1: p[0] = uint8_t(v); break;
+    case 2: {const auto x = uint16_t(v); std::memcpy(p, &x, 2);} break;
+    case 4: {const auto x = uint32_t(v); std::memcpy(p, &x, 4);} break;
+    case 8: std::memcpy(p, &v, 8); break;
+    default: throw Pothos::BufferCodecError("DeltaBufferCodec", "unsupported sample width " + std::to_string(width));
+    }
+}
+
+//! Integer samples of these widths are delta coded
+static inline bool isSampleWidth(const size_t width)
+{
+    return width == 1 or width == 2 or width == 4 or width == 8;
+}
+
+class DeltaBufferCodec : public Pothos::BufferCodec
+{
+public:
+    Pothos::BufferChunk encode(const Pothos::BufferChunk &buffer)
+    {
+        const auto &dtype = buffer.dtype;
+        const auto markup = dtype.toMarkup();
+
+        //integer samples in whole elements are delta coded, everything else is raw
+        const size_t width = dtype.isComplex()?dtype.elemSize()/2:dtype.elemSize();
+        const bool delta = dtype.isInteger() and isSampleWidth(width) and
+            dtype.size() != 0 and (buffer.length % dtype.size()) == 0;
+
+        //worst case size: header + 10 bytes per varint sample
+        const size_t numSamples = delta?(buffer.length/width):0;
+        Pothos::BufferChunk out(2 + 10 + markup.size() + 10 + (delta?numSamples*10:buffer.length));
+        auto p = out.as<uint8_t *>();
+        *p++ = DELTA_CODEC_VERSION;
+        *p++ = delta?DELTA_MODE_DELTA:DELTA_MODE_RAW;
+        p = writeVarint(p, markup.size());
+        std::memcpy(p, markup.data(), markup.size());
+        p += markup.size();
+        p = writeVarint(p, buffer.length);
+
+        if (not delta)
+        {
+            std::memcpy(p, buffer.as<const void *>(), buffer.length);
+            p += buffer.length;
+        }
+        else
+        {
+            //each channel of the element is differenced against its previous sample
+            const size_t numChannels = dtype.size()/width;
+            std::vector<uint64_t> last(numChannels, 0);
+            auto in = buffer.as<const uint8_t *>();
+            for (size_t i = 0; i < numSamples; i++)
+            {
+                const size_t ch = i % numChannels;
+                const uint64_t v = loadSample(in + i*width, width, dtype.isSigned());
+                const int64_t d = int64_t(v - last[ch]);
+                last[ch] = v;
+                p = writeVarint(p, (uint64_t(d) << 1) ^ uint64_t(d >> 63));
+            }
+        }
+
+        out.length = size_t(p - out.as<uint8_t *>());
+        return out;
+    }
+
+    Pothos::BufferChunk decode(const Pothos::BufferChunk &buffer)
+    {
+        auto p = buffer.as<const uint8_t *>();
+        const auto end = p + buffer.length;
+        if (buffer.length < 2 or p[0] != DELTA_CODEC_VERSION) throw Pothos::BufferCodecError(
+            "DeltaBufferCodec::decode()", "unknown format");
+        const uint8_t mode = p[1];
+        if (mode != DELTA_MODE_RAW and mode != DELTA_MODE_DELTA) throw Pothos::BufferCodecError(
+            "DeltaBufferCodec::decode()", "unknown mode " + std::to_string(mode));
+        p += 2;
+
+        const size_t markupLen = size_t(readVarint(p, end));
+        if (markupLen > size_t(end - p)) throw Pothos::BufferCodecError("DeltaBufferCodec::decode()", "truncated buffer");
+        Pothos::DType dtype;
+        try
+        {
+            dtype = Pothos::DType(std::string(reinterpret_cast<const char *>(p), markupLen));
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            throw Pothos::BufferCodecError("DeltaBufferCodec::decode()", ex.displayText());
+        }
+        p += markupLen;
+        const uint64_t length = readVarint(p, end);
+
+        //validate the length against the remaining input before allocating:
+        //raw mode copies the bytes, and every delta sample takes at least one byte
+        const size_t width = dtype.isComplex()?dtype.elemSize()/2:dtype.elemSize();
+        if (mode == DELTA_MODE_DELTA and (not isSampleWidth(width) or dtype.size() % width != 0 or length % width != 0)) throw Pothos::BufferCodecError(
+            "DeltaBufferCodec::decode()", "bad data type " + dtype.toString());
+        const uint64_t minInput = (mode == DELTA_MODE_DELTA)?(length/width):length;
+        if (minInput > uint64_t(end - p)) throw Pothos::BufferCodecError("DeltaBufferCodec::decode()", "truncated buffer");
+
+        Pothos::BufferChunk out{size_t(length)};
+        out.dtype = dtype;
+        auto o = out.as<uint8_t *>();
+
+        if (mode == DELTA_MODE_RAW)
+        {
+            std::memcpy(o, p, size_t(length));
+        }
+        else
+        {
+            const size_t numChannels = dtype.size()/width;
+            std::vector<uint64_t> last(numChannels, 0);
+            for (size_t i = 0; i < length/width; i++)
+            {
+                const size_t ch = i % numChannels;
+                const uint64_t z = readVarint(p, end);
+                last[ch] += (z >> 1) ^ (~(z & 1) + 1);
+                storeSample(o + i*width, last[ch], width);
+            }
+        }
+
+        return out;
+    }
+};
+
+/***********************************************************************
+ * factory and registration
+ **********************************************************************/
+Pothos::BufferCodec::Sptr makeNoneBufferCodec(void)
+{
+    return std::make_shared<NoneBufferCodec>();
+}
+
+Pothos::BufferCodec::Sptr makeDeltaBufferCodec(void)
+{
+    return std::make_shared<DeltaBufferCodec>();
+}
+
+pothos_static_block(pothosFrameworkRegisterDeltaBufferCodec)
+{
+    Pothos::PluginRegistry::addCall(
+        "/framework/buffer_codec/none",
+        &makeNoneBufferCodec);
+    Pothos::PluginRegistry::addCall(
+        "/framework/buffer_codec/delta",
+        &makeDeltaBufferCodec);
+}
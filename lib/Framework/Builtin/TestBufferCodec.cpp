@@ -0,0 +1,73 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Testing.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Util/Checksum.hpp>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+
+static void checkRoundTrip(Pothos::BufferCodec::Sptr codec, const Pothos::BufferChunk &in)
+{
+    const auto encoded = codec->encode(in);
+    const auto out = codec->decode(encoded);
+    POTHOS_TEST_EQUAL(out.dtype, in.dtype);
+    POTHOS_TEST_EQUAL(out.length, in.length);
+    POTHOS_TEST_EQUAL(std::memcmp(out.as<const void *>(), in.as<const void *>(), in.length), 0);
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_buffer_codec_delta)
+{
+    auto codec = Pothos::BufferCodec::make("delta");
+
+    //slowly varying integer samples compress well
+    Pothos::BufferChunk ramp("int16", 4096);
+    for (size_t i = 0; i < ramp.elements(); i++) ramp.as<int16_t *>()[i] = int16_t(i*3 - 2000);
+    checkRoundTrip(codec, ramp);
+    POTHOS_TEST_TRUE(codec->encode(ramp).length < ramp.length/2);
+
+    //random samples with negative values, multiple channels, and wrap-around
+    for (const auto &dtype : {"int8", "uint16", "complex_int16", "int32", "uint64", "int64"})
+    {
+        Pothos::BufferChunk noise(Pothos::DType(dtype), 1000);
+        for (size_t i = 0; i < noise.length; i++) noise.as<uint8_t *>()[i] = uint8_t(std::rand());
+        checkRoundTrip(codec, noise);
+    }
+
+    //non-integer types and partial elements pass through
+    Pothos::BufferChunk floats("float32", 100);
+    for (size_t i = 0; i < floats.elements(); i++) floats.as<float *>()[i] = float(i)/3;
+    checkRoundTrip(codec, floats);
+    Pothos::BufferChunk partial("int32", 10);
+    partial.length -= 1;
+    checkRoundTrip(codec, partial);
+    checkRoundTrip(codec, Pothos::BufferChunk("int16", 0));
+
+    //malformed buffers are rejected
+    auto bad = codec->encode(ramp);
+    bad.length /= 2;
+    POTHOS_TEST_THROWS(codec->decode(bad), Pothos::BufferCodecError);
+    POTHOS_TEST_THROWS(Pothos::BufferCodec::make("doesNotExist"), Pothos::BufferCodecError);
+
+    //the none codec passes the buffer through
+    checkRoundTrip(Pothos::BufferCodec::make("none"), ramp);
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_crc32c)
+{
+    //standard check value for the Castagnoli polynomial
+    const std::string check("123456789");
+    POTHOS_TEST_EQUAL(Pothos::Util::crc32c(check.data(), check.size()), 0xE3069283u);
+    POTHOS_TEST_EQUAL(Pothos::Util::crc32c(check.data(), 0), 0u);
+
+    //a running checksum over split blocks matches the whole
+    std::string data(1000, '\0');
+    for (auto &ch : data) ch = char(std::rand());
+    const auto whole = Pothos::Util::crc32c(data.data(), data.size());
+    for (const size_t split : {0, 1, 7, 8, 9, 500, 999, 1000})
+    {
+        const auto first = Pothos::Util::crc32c(data.data(), split);
+        POTHOS_TEST_EQUAL(Pothos::Util::crc32c(data.data()+split, data.size()-split, first), whole);
+    }
+}
@@ -2,9 +2,15 @@
 //                    2020 Nicholas Corgan
 // SPDX-License-Identifier: BSL-1.0
 
+#include "Framework/TopologyImpl.hpp"
 #include <Pothos/Testing.hpp>
 #include <Pothos/Framework.hpp>
+#include <algorithm> //min
 #include <iostream>
+#include <cstring> //memset, memcpy
+#include <chrono>
+#include <atomic>
+#include <thread>
 #include <json.hpp>
 
 using json = nlohmann::json;
@@ -589,3 +595,311 @@ POTHOS_TEST_BLOCK("/framework/tests/topology", test_independent_passthrough)
         POTHOS_TEST_TRUE(connectionsHave(connsArray, pingInner->uid(), "out0", pongInner->uid(), "in0"));
     }
 }
+
+/***********************************************************************
+ * Test the bottleneck analysis report
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_bottleneck_report)
+{
+    auto ping = std::shared_ptr<Ping>(new Ping());
+    auto passer = std::shared_ptr<Passer>(new Passer());
+    auto pong = std::shared_ptr<Pong>(new Pong());
+
+    Pothos::Topology topology;
+    topology.connect(ping, "out0", passer, "in0");
+    topology.connect(passer, "out0", pong, "in0");
+    topology.commit();
+    POTHOS_TEST_TRUE(topology.waitInactive());
+
+    //every block and edge is ranked in the report
+    const auto reportObj = json::parse(topology.queryBottlenecks("{\"sampleTime\":0.1, \"numSamples\":3}"));
+    POTHOS_TEST_EQUAL(reportObj["numSamples"].get<size_t>(), 3);
+    POTHOS_TEST_EQUAL(reportObj["blocks"].size(), 3);
+    POTHOS_TEST_EQUAL(reportObj["edges"].size(), 2);
+    POTHOS_TEST_TRUE(reportObj.count("bottleneck"));
+
+    //the critical path always contains the bottleneck
+    bool found = false;
+    for (const auto &id : reportObj["criticalPath"])
+    {
+        if (id == reportObj["bottleneck"]) found = true;
+    }
+    POTHOS_TEST_TRUE(found);
+}
+
+/***********************************************************************
+ * Streaming blocks with a deliberately slow block in the middle
+ **********************************************************************/
+struct StreamSource : Pothos::Block
+{
+    StreamSource(void)
+    {
+        this->setupOutput(0, "float32");
+        this->setName("StreamSource");
+    }
+
+    void work(void)
+    {
+        auto out0 = this->output(0);
+        std::memset(out0->buffer().as<void *>(), 0, out0->buffer().length);
+        out0->produce(out0->elements());
+    }
+};
+
+struct SlowCopier : Pothos::Block
+{
+    SlowCopier(void)
+    {
+        this->setupInput(0, "float32");
+        this->setupOutput(0, "float32");
+        this->setName("SlowCopier");
+    }
+
+    void work(void)
+    {
+        const size_t elems = std::min<size_t>(this->workInfo().minElements, 64);
+        if (elems == 0) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::memcpy(this->output(0)->buffer().as<void *>(), this->input(0)->buffer().as<const void *>(), elems*sizeof(float));
+        this->input(0)->consume(elems);
+        this->output(0)->produce(elems);
+    }
+};
+
+struct StreamSink : Pothos::Block
+{
+    StreamSink(void)
+    {
+        this->setupInput(0, "float32");
+        this->setName("StreamSink");
+    }
+
+    void work(void)
+    {
+        this->input(0)->consume(this->input(0)->elements());
+    }
+};
+
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_bottleneck_slow_block)
+{
+    auto source = std::shared_ptr<StreamSource>(new StreamSource());
+    auto slow = std::shared_ptr<SlowCopier>(new SlowCopier());
+    auto sink = std::shared_ptr<StreamSink>(new StreamSink());
+
+    Pothos::Topology topology;
+    topology.connect(source, 0, slow, 0);
+    topology.connect(slow, 0, sink, 0);
+    topology.commit();
+
+    //sample while the flow is running, the slow block sets the rate
+    const auto reportObj = json::parse(topology.queryBottlenecks("{\"sampleTime\":0.5, \"numSamples\":10}"));
+    topology.disconnectAll();
+    topology.commit();
+
+    POTHOS_TEST_EQUAL(reportObj["bottleneck"].get<std::string>(), slow->uid());
+    POTHOS_TEST_EQUAL(reportObj["blocks"][0]["id"].get<std::string>(), slow->uid());
+    POTHOS_TEST_TRUE(reportObj["blocks"][0]["workUtilization"].get<double>() > 0.5);
+    POTHOS_TEST_EQUAL(reportObj["blocks"][0]["limitedBy"].get<std::string>(), "work");
+}
+
+/***********************************************************************
+ * Test automatic thread pool placement
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_auto_placement)
+{
+    auto ping = std::shared_ptr<Ping>(new Ping());
+    auto passer = std::shared_ptr<Passer>(new Passer());
+    auto pong = std::shared_ptr<Pong>(new Pong());
+
+    Pothos::Topology topology;
+    topology.setAutoPlacement("{\"mode\":\"CPU\"}");
+    topology.connect(ping, "out0", passer, "in0");
+    topology.connect(passer, "out0", pong, "in0");
+    topology.commit();
+
+    //check that the message flowed with the placed thread pools
+    POTHOS_TEST_TRUE(topology.waitInactive());
+    POTHOS_TEST_EQUAL(pong->triggered, 1);
+
+    //the idle chain of light blocks is grouped into a single pool
+    const auto plansArray = json::parse(topology.replanPlacement(0.1));
+    POTHOS_TEST_EQUAL(plansArray.size(), 1);
+    POTHOS_TEST_EQUAL(plansArray[0]["pools"].size(), 1);
+    const auto &poolObj = plansArray[0]["pools"][0];
+    POTHOS_TEST_EQUAL(poolObj["numThreads"].get<size_t>(), 1);
+    POTHOS_TEST_EQUAL(poolObj["blocks"].size(), 3);
+    POTHOS_TEST_TRUE(ping->getThreadPool() == pong->getThreadPool());
+    POTHOS_TEST_TRUE(passer->getThreadPool() == pong->getThreadPool());
+}
+
+/***********************************************************************
+ * Test compiled topology snapshots
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_topology_snapshot)
+{
+    //a design without blocks evaluates and loads from the snapshot
+    const auto snapshot = Pothos::Topology::compileSnapshot(
+        "{\"globals\":[{\"name\":\"x\",\"value\":\"1+1\"}], \"blocks\":[]}");
+    POTHOS_TEST_TRUE(Pothos::Topology::makeFromSnapshot(snapshot));
+
+    //the factory list is resolved before any blocks are created
+    const auto missing = Pothos::Topology::compileSnapshot(
+        "{\"blocks\":[{\"id\":\"b0\", \"path\":\"/framework/tests/no_such_block\", \"args\":[\"1+1\"]}]}");
+    POTHOS_TEST_THROWS(Pothos::Topology::makeFromSnapshot(missing), Pothos::DataFormatException);
+
+    //invalid snapshot data is reported as a format error
+    POTHOS_TEST_THROWS(Pothos::Topology::makeFromSnapshot("not a snapshot"), Pothos::DataFormatException);
+}
+
+/***********************************************************************
+ * Test hot swap of a block in an active topology
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_replace_block)
+{
+    auto ping = std::shared_ptr<Ping>(new Ping());
+    auto passer = std::shared_ptr<Passer>(new Passer("0"));
+    auto passer1 = std::shared_ptr<Passer>(new Passer("1"));
+    auto pong = std::shared_ptr<Pong>(new Pong());
+
+    Pothos::Topology topology;
+    topology.connect(ping, "out0", passer, "in0");
+    topology.connect(passer, "out0", pong, "in0");
+    topology.commit();
+    POTHOS_TEST_TRUE(topology.waitInactive());
+    POTHOS_TEST_EQUAL(pong->triggered, 1);
+
+    //swap without a commit, the replacement takes over the connections
+    topology.replaceBlock(passer, passer1);
+    const auto connsArray = json::parse(topology.dumpJSON("{\"mode\":\"flat\"}"))["connections"];
+    POTHOS_TEST_TRUE(connectionsHave(connsArray, ping->uid(), "out0", passer1->uid(), "in0"));
+    POTHOS_TEST_TRUE(connectionsHave(connsArray, passer1->uid(), "out0", pong->uid(), "in0"));
+
+    //data into the replacement flows to the downstream block
+    passer1->input("in0")->pushMessage(Pothos::Object(42));
+    POTHOS_TEST_TRUE(topology.waitInactive());
+    POTHOS_TEST_EQUAL(pong->triggered, 2);
+
+    //the old block was detached and a re-commit makes no changes
+    passer->input("in0")->pushMessage(Pothos::Object(42));
+    topology.commit();
+    POTHOS_TEST_TRUE(topology.waitInactive());
+    POTHOS_TEST_EQUAL(pong->triggered, 2);
+
+    //blocks that are not in the topology cannot be replaced
+    POTHOS_TEST_THROWS(topology.replaceBlock(passer, passer1), Pothos::TopologyConnectError);
+}
+
+/***********************************************************************
+ * Test hot swap with a replacement that provides its own buffer manager
+ **********************************************************************/
+struct CustomCopier : Pothos::Block
+{
+    CustomCopier(void):
+        usedManager(false)
+    {
+        this->setupInput(0, "float32");
+        this->setupOutput(0, "float32");
+        this->setName("CustomCopier");
+    }
+
+    Pothos::BufferManager::Sptr getOutputBufferManager(const std::string &, const std::string &)
+    {
+        manager = Pothos::BufferManager::make("generic", Pothos::BufferManagerArgs());
+        return manager;
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        auto out0 = this->output(0);
+        const size_t elems = this->workInfo().minElements;
+        if (elems == 0) return;
+        if (out0->buffer().getManagedBuffer().getBufferManager() == manager) usedManager = true;
+        std::memcpy(out0->buffer().as<void *>(), in0->buffer().as<const void *>(), elems*sizeof(float));
+        in0->consume(elems);
+        out0->produce(elems);
+    }
+
+    Pothos::BufferManager::Sptr manager;
+    std::atomic<bool> usedManager;
+};
+
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_replace_block_buffer_mode)
+{
+    auto source = std::shared_ptr<StreamSource>(new StreamSource());
+    auto slow = std::shared_ptr<SlowCopier>(new SlowCopier());
+    auto custom = std::shared_ptr<CustomCopier>(new CustomCopier());
+    auto sink = std::shared_ptr<StreamSink>(new StreamSink());
+
+    Pothos::Topology topology;
+    topology.connect(source, 0, slow, 0);
+    topology.connect(slow, 0, sink, 0);
+    topology.commit();
+
+    //the replacement output produces into its custom manager, not the moved one
+    topology.replaceBlock(slow, custom);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    topology.disconnectAll();
+    topology.commit();
+    POTHOS_TEST_TRUE(custom->manager);
+    POTHOS_TEST_TRUE(custom->usedManager);
+}
+
+/***********************************************************************
+ * Test network options for source ports
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_network_options)
+{
+    auto ping = std::shared_ptr<Ping>(new Ping());
+    auto pong = std::shared_ptr<Pong>(new Pong());
+
+    //options only apply to flows between processes, local flows are unchanged
+    Pothos::Topology topology;
+    topology.connect(ping, "out0", pong, "in0");
+    topology.setNetworkOptions(ping, "out0", "{\"codec\":\"delta\", \"checksum\":true}");
+    topology.commit();
+    POTHOS_TEST_TRUE(topology.waitInactive());
+    POTHOS_TEST_EQUAL(pong->triggered, 1);
+
+    //the request is validated when it is set
+    POTHOS_TEST_THROWS(topology.setNetworkOptions(ping, "out0", "{\"codec\":\"doesNotExist\"}"), Pothos::BufferCodecError);
+    POTHOS_TEST_THROWS(topology.setNetworkOptions(ping, "out0", "[]"), Pothos::DataFormatException);
+
+    //the JSON format accepts an options object after the connection
+    const auto snapshot = Pothos::Topology::compileSnapshot(
+        "{\"blocks\":[], \"connections\":[[\"self\", \"in\", \"self\", \"out\", {\"codec\":\"delta\"}]]}");
+    POTHOS_TEST_TRUE(Pothos::Topology::makeFromSnapshot(snapshot));
+    POTHOS_TEST_THROWS(Pothos::Topology::compileSnapshot(
+        "{\"blocks\":[], \"connections\":[[\"self\", \"in\", \"self\", \"out\", \"delta\"]]}"), Pothos::DataFormatException);
+}
+
+/***********************************************************************
+ * Test network route planning between hosts
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_network_route)
+{
+    //uniform links: every host is fed directly by the source
+    const auto uniform = [](const std::string &, const std::string &){return 1.0;};
+    auto parents = planNetworkRoute("A", {"A", "B", "C"}, uniform);
+    POTHOS_TEST_EQUAL(parents.size(), 2);
+    POTHOS_TEST_EQUAL(parents.at("B"), "A");
+    POTHOS_TEST_EQUAL(parents.at("C"), "A");
+
+    //a slow link from the source: B and C share a fast link, so B relays to C
+    const auto relay = [](const std::string &a, const std::string &b)
+    {
+        const auto link = std::minmax(a, b);
+        if (link == std::minmax(std::string("A"), std::string("C"))) return 10.0;
+        if (link == std::minmax(std::string("B"), std::string("C"))) return 0.1;
+        return 1.0;
+    };
+    parents = planNetworkRoute("A", {"B", "C"}, relay);
+    POTHOS_TEST_EQUAL(parents.at("B"), "A");
+    POTHOS_TEST_EQUAL(parents.at("C"), "B");
+
+    //link annotations are validated when they are set
+    Pothos::Topology topology;
+    topology.setNetworkLinks("[{\"hosts\":[\"10.0.0.1\", \"10.0.0.2\"], \"bandwidth\":1e9, \"latency\":1e-4}]");
+    POTHOS_TEST_THROWS(topology.setNetworkLinks("[{\"hosts\":[\"10.0.0.1\"]}]"), Pothos::DataFormatException);
+    POTHOS_TEST_THROWS(topology.setNetworkLinks("[{\"hosts\":[\"a\", \"b\"], \"bandwidth\":0}]"), Pothos::DataFormatException);
+}
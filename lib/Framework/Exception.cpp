@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2014 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Framework/Exception.hpp>
@@ -7,6 +7,7 @@
 namespace Pothos {
 POTHOS_IMPLEMENT_EXCEPTION(SharedBufferError, RuntimeException, "Framework Shared Buffer Error")
 POTHOS_IMPLEMENT_EXCEPTION(BufferManagerFactoryError, RuntimeException, "Framework Buffer Manager Factory Error")
+POTHOS_IMPLEMENT_EXCEPTION(BufferCodecError, RuntimeException, "Framework Buffer Codec Error")
 POTHOS_IMPLEMENT_EXCEPTION(BufferPushError, RuntimeException, "Framework Buffer Push Error")
 POTHOS_IMPLEMENT_EXCEPTION(PortAccessError, RangeException, "Framework Worker Port Access Error")
 POTHOS_IMPLEMENT_EXCEPTION(DTypeUnknownError, RuntimeException, "Framework DType Unknown Identifier Error")
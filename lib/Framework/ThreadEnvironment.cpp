@@ -2,13 +2,33 @@
 // SPDX-License-Identifier: BSL-1.0
 
 #include "Framework/ThreadEnvironment.hpp"
+#include <Pothos/System/NumaInfo.hpp>
 #include <Poco/Logger.h>
+#include <algorithm>
 #include <iostream>
 #include <cassert>
 
+/*!
+ * Determine the single NUMA node that contains the affinity,
+ * or return -1 when the threads may run on multiple nodes.
+ */
+static long affinityToNumaNode(const Pothos::ThreadPoolArgs &args)
+{
+    if (args.affinityMode == "NUMA" and args.affinity.size() == 1) return long(args.affinity.front());
+    if (args.affinityMode != "CPU" or args.affinity.empty()) return -1;
+    for (const auto &info : Pothos::System::NumaInfo::get())
+    {
+        if (std::all_of(args.affinity.begin(), args.affinity.end(), [&info](const size_t cpu)
+            {return std::find(info.cpus.begin(), info.cpus.end(), cpu) != info.cpus.end();}))
+            return long(info.nodeNumber);
+    }
+    return -1;
+}
+
 ThreadEnvironment::ThreadEnvironment(const Pothos::ThreadPoolArgs &args):
     _args(args),
     _waitModeEnabled(_args.yieldMode != "SPIN"),
+    _nodeAffinity(affinityToNumaNode(_args)),
     _configurationSignature(0)
 {
     return;
@@ -72,6 +72,16 @@ public:
         return _waitModeEnabled;
     }
 
+    /*!
+     * Get the NUMA node that the threads are pinned to.
+     * This is used to allocate buffers local to the threads.
+     * \return the node number or -1 when unspecified
+     */
+    long getNodeAffinity(void) const
+    {
+        return _nodeAffinity;
+    }
+
 private:
     /*!
      * Process loop used in thread pool mode:
@@ -108,6 +118,9 @@ private:
     //whether or not waiting is allowed based on args
     bool _waitModeEnabled;
 
+    //the NUMA node containing the affinitized threads
+    long _nodeAffinity;
+
     //map of handle handles to tasks
     std::map<void *, std::shared_ptr<TaskData>> _handleToTask;
 
@@ -1,4 +1,4 @@
-// Copyright (c) 2014-2019 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "Framework/TopologyImpl.hpp"
@@ -261,46 +261,49 @@ void Pothos::Topology::disconnectAll(const bool recursive)
 
 bool Pothos::Topology::waitInactive(const double idleDuration, const double timeout)
 {
-    //how long to sleep between idle checks?
+    typedef ActivityMonitor::Clock Clock;
     const std::chrono::nanoseconds idleDurationNs((long long)(idleDuration*1e9));
-    const std::chrono::nanoseconds pollSleepTime(idleDurationNs/3);
+    const std::chrono::nanoseconds timeoutNs((long long)(timeout*1e9));
 
-    //get a list of blocks to poll for idle time
-    const auto blocks = getObjSetFromFlowList(_impl->activeFlatFlows);
+    //a flattened sub-topology waits directly on the activity monitor,
+    //which the actors of all activated blocks bump when they do work
+    if (_impl->remoteTopologies.empty())
+    {
+        if (_impl->activeFlatFlows.empty()) return true;
+        return _impl->activityMonitor->waitInactive(idleDurationNs, timeoutNs);
+    }
 
-    //track block activity indicators and activity time stamps
-    std::vector<std::chrono::high_resolution_clock::time_point> lastActivityTime(blocks.size());
-    std::vector<int> lastActivityIndicator(blocks.size(), 0);
+    //a single environment performs the entire wait in that environment
+    if (_impl->remoteTopologies.size() == 1)
+    {
+        return _impl->remoteTopologies.begin()->second.call<bool>("waitInactive", idleDuration, timeout);
+    }
 
     //loop until exit time
-    const auto entryTime = std::chrono::high_resolution_clock::now();
-    const auto exitTime = entryTime + std::chrono::nanoseconds((long long)(timeout*1e9));
-    do
+    const auto entryTime = Clock::now();
+    const auto exitTime = entryTime + timeoutNs;
+    while (true)
     {
-        //check each worker for idle time from the activity indicator
-        bool allIdle = true;
-        for (size_t i = 0; i < blocks.size(); i++)
+        //the least idle environment determines the idle time of the whole flow graph
+        auto minIdleTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - entryTime);
+        for (const auto &pair : _impl->remoteTopologies)
         {
-            const auto &block = blocks[i];
-            const int activityIndicator = block.get("_actor").call("queryActivityIndicator");
-            if (lastActivityIndicator[i] != activityIndicator)
-            {
-                lastActivityTime[i] = std::chrono::high_resolution_clock::now();
-                lastActivityIndicator[i] = activityIndicator;
-            }
-            const auto workerIdleDuration = std::chrono::high_resolution_clock::now() - std::max(entryTime, lastActivityTime[i]);
-            if (workerIdleDuration < idleDurationNs) allIdle = false;
+            const double idleTime = pair.second.call("queryIdleTime");
+            minIdleTime = std::min(minIdleTime, std::chrono::nanoseconds((long long)(idleTime*1e9)));
         }
 
-        //all workers reached the max idle time specified
-        if (allIdle) return true;
+        //all environments reached the idle time specified
+        if (minIdleTime >= idleDurationNs) return true;
 
-        //idle time not reached on any workers, therefore sleep
-        else std::this_thread::sleep_for(pollSleepTime);
+        //otherwise sleep until the idle time could be reached
+        const auto wakeTime = Clock::now() + (idleDurationNs - minIdleTime);
+        if (timeout != 0.0 and wakeTime > exitTime)
+        {
+            std::this_thread::sleep_until(exitTime);
+            return false; //timeout
+        }
+        std::this_thread::sleep_until(wakeTime);
     }
-    while (std::chrono::high_resolution_clock::now() < exitTime or timeout == 0.0);
-
-    return false; //timeout
 }
 
 void Pothos::Topology::registerCallable(const std::string &name, const Callable &call)
@@ -335,17 +338,30 @@ static Pothos::ProxyVector getFlowsFromTopology(const Pothos::Topology &t)
     return flows;
 }
 
+static double queryIdleTimeFromTopology(const Pothos::Topology &t)
+{
+    const auto idleTime = ActivityMonitor::Clock::now() - t._impl->activityMonitor->lastActivity();
+    return std::chrono::duration<double>(idleTime).count();
+}
+
 std::vector<Port> resolvePortsFromTopology(const Pothos::Topology &t, const std::string &portName, const bool isSource);
 std::vector<Flow> resolveFlowsFromTopology(const Pothos::Topology &t);
 void topologySubCommit(Pothos::Topology &topology);
+std::string topologyApplyPlacement(Pothos::Topology &topology, const std::string &request);
+std::string queryBlockStatsJSON(const Pothos::Object &obj);
 
 static auto managedTopology = Pothos::ManagedClass()
     .registerClass<Pothos::Topology>()
     .registerBaseClass<Pothos::Topology, Pothos::Connectable>()
     .registerStaticMethod("make", (std::shared_ptr<Pothos::Topology>(*)(void))&Pothos::Topology::make)
     .registerStaticMethod<std::shared_ptr<Pothos::Topology>, const std::string &>(POTHOS_FCN_TUPLE(Pothos::Topology, make))
+    .registerStaticMethod(POTHOS_FCN_TUPLE(Pothos::Topology, compileSnapshot))
+    .registerStaticMethod(POTHOS_FCN_TUPLE(Pothos::Topology, makeFromSnapshot))
+    .registerStaticMethod("queryBlockStats", &queryBlockStatsJSON)
     .registerMethod("getFlows", &getFlowsFromTopology)
+    .registerMethod("queryIdleTime", &queryIdleTimeFromTopology)
     .registerMethod("subCommit", &topologySubCommit)
+    .registerMethod("applyPlacement", &topologyApplyPlacement)
     .registerMethod("resolvePorts", &resolvePortsFromTopology)
     .registerMethod("resolveFlows", &resolveFlowsFromTopology)
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, setThreadPool))
@@ -357,10 +373,17 @@ static auto managedTopology = Pothos::ManagedClass()
     //and bind defaults into waitInactive for optional trailing arguments
     .registerMethod("waitInactive", Pothos::Callable(&Pothos::Topology::waitInactive).bind(1.0, 2))
     .registerMethod("waitInactive", Pothos::Callable(&Pothos::Topology::waitInactive).bind(1.0, 2).bind(0.1, 1))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, setAutoPlacement))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, replanPlacement))
+    .registerMethod("replanPlacement", Pothos::Callable(&Pothos::Topology::replanPlacement).bind(1.0, 1))
     .registerMethod("connect", &Pothos::Topology::_connect)
     .registerMethod("disconnect", &Pothos::Topology::_disconnect)
+    .registerMethod("replaceBlock", &Pothos::Topology::_replaceBlock)
+    .registerMethod("setNetworkOptions", &Pothos::Topology::_setNetworkOptions)
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, setNetworkLinks))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, toDotMarkup))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, queryJSONStats))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, queryBottlenecks))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, dumpJSON))
     .commit("Pothos/Topology");
 
@@ -0,0 +1,321 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/TopologyImpl.hpp"
+#include <Pothos/Framework/Exception.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <set>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+/***********************************************************************
+ * helpers to extract values from the stats objects
+ **********************************************************************/
+static const json &findPortStats(const json &blockStats, const std::string &key, const std::string &portName)
+{
+    static const json empty;
+    if (blockStats.count(key) == 0) return empty;
+    for (const auto &portStats : blockStats[key])
+    {
+        if (portStats.value("portName", "") == portName) return portStats;
+    }
+    return empty;
+}
+
+static double ticksToSeconds(const json &blockStats, const double ticks)
+{
+    const double num = blockStats.value("tickRatioNum", 1.0);
+    const double den = blockStats.value("tickRatioDen", 1.0);
+    return ticks*num/den;
+}
+
+static double deltaOf(const json &first, const json &last, const std::string &key)
+{
+    return last.value(key, 0.0) - first.value(key, 0.0);
+}
+
+/***********************************************************************
+ * analysis results for blocks and edges
+ **********************************************************************/
+struct BlockAnalysis
+{
+    BlockAnalysis(void):
+        workUtilization(0.0),
+        workCallRate(0.0),
+        inputBackpressure(0.0),
+        inputStarved(0.0),
+        outputBackpressure(0.0),
+        outputStarved(0.0),
+        score(0.0){}
+    std::string id;
+    std::string blockName;
+    double workUtilization;
+    double workCallRate;
+    double inputBackpressure;
+    double inputStarved;
+    double outputBackpressure;
+    double outputStarved;
+    double score;
+};
+
+struct EdgeAnalysis
+{
+    EdgeAnalysis(void):
+        producerRate(0.0),
+        consumerRate(0.0),
+        byteRate(0.0),
+        occupancy(0.0),
+        starvedRatio(0.0),
+        backpressureRatio(0.0){}
+    std::string srcId, srcName;
+    std::string dstId, dstName;
+    double producerRate;
+    double consumerRate;
+    double byteRate;
+    double occupancy;
+    double starvedRatio;
+    double backpressureRatio;
+    std::string state(void) const
+    {
+        if (backpressureRatio >= 0.5 and backpressureRatio >= starvedRatio) return "backpressured";
+        if (starvedRatio >= 0.5) return "starved";
+        return "flowing";
+    }
+    double severity(void) const
+    {
+        return std::max(starvedRatio, backpressureRatio);
+    }
+};
+
+/***********************************************************************
+ * trace the path of blocks whose rate is set by the bottleneck
+ **********************************************************************/
+static const EdgeAnalysis *worstEdge(const std::vector<EdgeAnalysis> &edges, const std::string &id, const bool upstream, const std::set<std::string> &visited)
+{
+    const EdgeAnalysis *worst = nullptr;
+    for (const auto &edge : edges)
+    {
+        //upstream producers are backpressured by the bottleneck,
+        //downstream consumers are starved by the bottleneck
+        if (upstream and (edge.dstId != id or edge.state() != "backpressured")) continue;
+        if (not upstream and (edge.srcId != id or edge.state() != "starved")) continue;
+        if (visited.count(upstream?edge.srcId:edge.dstId) != 0) continue;
+        if (worst == nullptr or edge.severity() > worst->severity()) worst = &edge;
+    }
+    return worst;
+}
+
+static json traceCriticalPath(const std::vector<EdgeAnalysis> &edges, const std::string &bottleneckId)
+{
+    std::set<std::string> visited;
+    visited.insert(bottleneckId);
+
+    std::vector<std::string> upstreamPath;
+    for (auto id = bottleneckId; const auto edge = worstEdge(edges, id, true, visited);)
+    {
+        id = edge->srcId;
+        visited.insert(id);
+        upstreamPath.push_back(id);
+    }
+
+    json path(json::array());
+    for (auto it = upstreamPath.rbegin(); it != upstreamPath.rend(); ++it) path.push_back(*it);
+    path.push_back(bottleneckId);
+
+    for (auto id = bottleneckId; const auto edge = worstEdge(edges, id, false, visited);)
+    {
+        id = edge->dstId;
+        visited.insert(id);
+        path.push_back(id);
+    }
+    return path;
+}
+
+/***********************************************************************
+ * bottleneck analysis implementation
+ **********************************************************************/
+std::string Pothos::Topology::queryBottlenecks(const std::string &request)
+{
+    //extract input request
+    const auto configObj = json::parse(request.empty()?"{}":request);
+    const double sampleTime = configObj.value("sampleTime", 1.0);
+    const size_t numSamples = std::max<size_t>(2, configObj.value("numSamples", 10));
+    if (sampleTime <= 0.0) throw Pothos::RangeException("Pothos::Topology::queryBottlenecks()", "sampleTime must be positive");
+
+    //the flattened connections are keyed by the same IDs as the stats
+    const auto flatObj = json::parse(this->dumpJSON("{\"mode\":\"flat\"}"));
+    const auto &connsArray = flatObj["connections"];
+
+    //sample the stats over time at a regular interval
+    std::vector<json> samples;
+    const auto interval = std::chrono::nanoseconds((long long)(1e9*sampleTime/(numSamples-1)));
+    auto sampleTimePoint = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        if (i != 0) std::this_thread::sleep_until(sampleTimePoint += interval);
+        samples.push_back(json::parse(this->queryJSONStats()));
+    }
+    const auto &firstSample = samples.front();
+    const auto &lastSample = samples.back();
+
+    //compute per-edge occupancy and producer/consumer rates
+    std::vector<EdgeAnalysis> edges;
+    for (const auto &connObj : connsArray)
+    {
+        EdgeAnalysis edge;
+        edge.srcId = connObj["srcId"];
+        edge.srcName = connObj["srcName"];
+        edge.dstId = connObj["dstId"];
+        edge.dstName = connObj["dstName"];
+        if (firstSample.count(edge.srcId) == 0 or firstSample.count(edge.dstId) == 0) continue;
+        if (lastSample.count(edge.srcId) == 0 or lastSample.count(edge.dstId) == 0) continue;
+
+        //signals and slots have no port stats, skip these edges
+        const auto &srcFirst = findPortStats(firstSample[edge.srcId], "outputStats", edge.srcName);
+        const auto &dstFirst = findPortStats(firstSample[edge.dstId], "inputStats", edge.dstName);
+        const auto &srcLast = findPortStats(lastSample[edge.srcId], "outputStats", edge.srcName);
+        const auto &dstLast = findPortStats(lastSample[edge.dstId], "inputStats", edge.dstName);
+        if (srcFirst.is_null() or dstFirst.is_null() or srcLast.is_null() or dstLast.is_null()) continue;
+
+        //rates use the time between stats queries as reported by each block
+        const auto srcTime = ticksToSeconds(lastSample[edge.srcId], deltaOf(firstSample[edge.srcId], lastSample[edge.srcId], "timeStatsQuery"));
+        const auto dstTime = ticksToSeconds(lastSample[edge.dstId], deltaOf(firstSample[edge.dstId], lastSample[edge.dstId], "timeStatsQuery"));
+        if (srcTime > 0.0) edge.producerRate = deltaOf(srcFirst, srcLast, "totalElements")/srcTime;
+        if (dstTime > 0.0) edge.consumerRate = deltaOf(dstFirst, dstLast, "totalElements")/dstTime;
+        edge.byteRate = edge.consumerRate*dstLast.value("dtypeSize", 1.0);
+
+        //occupancy and starvation come from the consumer's queue,
+        //backpressure comes from the producer's available resources
+        for (const auto &sample : samples)
+        {
+            if (sample.count(edge.srcId) == 0 or sample.count(edge.dstId) == 0) continue;
+            const auto &srcStats = findPortStats(sample[edge.srcId], "outputStats", edge.srcName);
+            const auto &dstStats = findPortStats(sample[edge.dstId], "inputStats", edge.dstName);
+            if (srcStats.is_null() or dstStats.is_null()) continue;
+            const double enqueuedBytes = dstStats.value("enqueuedBytes", 0.0);
+            edge.occupancy += enqueuedBytes/samples.size();
+            if (enqueuedBytes == 0.0) edge.starvedRatio += 1.0/samples.size();
+            if (srcStats.value("tokensEmpty", false) or srcStats.value("frontBytes", 0) == 0)
+            {
+                edge.backpressureRatio += 1.0/samples.size();
+            }
+        }
+
+        edges.push_back(edge);
+    }
+
+    //compute the per-block work utilization and edge summaries
+    std::vector<BlockAnalysis> blocks;
+    for (auto it = lastSample.begin(); it != lastSample.end(); ++it)
+    {
+        if (firstSample.count(it.key()) == 0) continue;
+        const auto &first = firstSample[it.key()];
+        const auto &last = it.value();
+
+        BlockAnalysis block;
+        block.id = it.key();
+        block.blockName = last.value("blockName", block.id);
+        const auto elapsed = ticksToSeconds(last, deltaOf(first, last, "timeStatsQuery"));
+        if (elapsed > 0.0)
+        {
+            block.workUtilization = ticksToSeconds(last, deltaOf(first, last, "totalTimeWork"))/elapsed;
+            block.workCallRate = deltaOf(first, last, "numWorkCalls")/elapsed;
+        }
+
+        size_t numInputs(0), numOutputs(0);
+        for (const auto &edge : edges)
+        {
+            if (edge.dstId == block.id)
+            {
+                numInputs++;
+                block.inputBackpressure += edge.backpressureRatio;
+                block.inputStarved += edge.starvedRatio;
+            }
+            if (edge.srcId == block.id)
+            {
+                numOutputs++;
+                block.outputBackpressure += edge.backpressureRatio;
+                block.outputStarved += edge.starvedRatio;
+            }
+        }
+        if (numInputs != 0) block.inputBackpressure /= numInputs;
+        if (numInputs != 0) block.inputStarved /= numInputs;
+        if (numOutputs != 0) block.outputBackpressure /= numOutputs;
+        if (numOutputs != 0) block.outputStarved /= numOutputs;
+
+        //A rate limiting block is busy in work(), backpressures its producers,
+        //and starves its consumers. A block that is itself starved at its inputs
+        //or backpressured at its outputs is limited by another block in the flow.
+        block.score = block.workUtilization
+            + block.inputBackpressure + block.outputStarved
+            - block.inputStarved - block.outputBackpressure;
+        blocks.push_back(block);
+    }
+
+    //rank the blocks and edges by severity
+    std::stable_sort(blocks.begin(), blocks.end(), [](const BlockAnalysis &a, const BlockAnalysis &b)
+    {
+        return a.score > b.score;
+    });
+    std::stable_sort(edges.begin(), edges.end(), [](const EdgeAnalysis &a, const EdgeAnalysis &b)
+    {
+        return a.severity() > b.severity();
+    });
+
+    //create the report
+    json reportObj;
+    reportObj["sampleTime"] = sampleTime;
+    reportObj["numSamples"] = numSamples;
+
+    json blocksArray(json::array());
+    for (const auto &block : blocks)
+    {
+        json blockObj;
+        blockObj["id"] = block.id;
+        blockObj["blockName"] = block.blockName;
+        blockObj["workUtilization"] = block.workUtilization;
+        blockObj["workCallRate"] = block.workCallRate;
+        blockObj["inputBackpressure"] = block.inputBackpressure;
+        blockObj["inputStarved"] = block.inputStarved;
+        blockObj["outputBackpressure"] = block.outputBackpressure;
+        blockObj["outputStarved"] = block.outputStarved;
+        blockObj["score"] = block.score;
+        if (block.inputStarved >= 0.5) blockObj["limitedBy"] = "upstream";
+        else if (block.outputBackpressure >= 0.5) blockObj["limitedBy"] = "downstream";
+        else blockObj["limitedBy"] = "work";
+        blocksArray.push_back(blockObj);
+    }
+    reportObj["blocks"] = blocksArray;
+
+    json edgesArray(json::array());
+    for (const auto &edge : edges)
+    {
+        json edgeObj;
+        edgeObj["srcId"] = edge.srcId;
+        edgeObj["srcName"] = edge.srcName;
+        edgeObj["dstId"] = edge.dstId;
+        edgeObj["dstName"] = edge.dstName;
+        edgeObj["producerRate"] = edge.producerRate;
+        edgeObj["consumerRate"] = edge.consumerRate;
+        edgeObj["byteRate"] = edge.byteRate;
+        edgeObj["occupancy"] = edge.occupancy;
+        edgeObj["starvedRatio"] = edge.starvedRatio;
+        edgeObj["backpressureRatio"] = edge.backpressureRatio;
+        edgeObj["state"] = edge.state();
+        edgesArray.push_back(edgeObj);
+    }
+    reportObj["edges"] = edgesArray;
+
+    //the rate limiting block and the path of blocks that it limits
+    if (not blocks.empty())
+    {
+        reportObj["bottleneck"] = blocks.front().id;
+        reportObj["criticalPath"] = traceCriticalPath(edges, blocks.front().id);
+    }
+
+    //return the string-formatted result
+    return reportObj.dump(4);
+}
@@ -1,4 +1,4 @@
-// Copyright (c) 2014-2017 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "Framework/TopologyImpl.hpp"
@@ -54,7 +54,7 @@ static void setOutputBufferManager(const Port &src, const Pothos::Proxy &manager
     src.obj.get("_actor").call("setOutputBufferManager", src.name, manager);
 }
 
-static void installBufferManagers(const std::vector<Flow> &flatFlows)
+void installBufferManagers(const std::vector<Flow> &flatFlows)
 {
     //map of a source port to all destination ports
     std::unordered_map<Port, std::vector<Port>> srcs;
@@ -199,17 +199,30 @@ static std::vector<Flow> completePassThroughFlows(const std::vector<Flow> &flows
 /***********************************************************************
  * Sub Topology commit on flattened flows
  **********************************************************************/
-static void setActiveState(const Pothos::Proxy &block, const bool state)
+static void setActiveState(const Pothos::Proxy &block, const bool state, const std::shared_ptr<ActivityMonitor> &monitor)
 {
-    block.get("_actor").call(state?"setActiveStateOn":"setActiveStateOff");
+    auto actor = block.get("_actor");
+
+    //the monitor is installed before activation and removed after deactivation
+    //so that the activity caused by the state change itself is always recorded
+    if (state) actor.call("setActivityMonitor", monitor);
+    actor.call(state?"setActiveStateOn":"setActiveStateOff");
+    if (not state) actor.call("setActivityMonitor", std::shared_ptr<ActivityMonitor>());
 }
 
+void topologyPlaceNewBlocks(Pothos::Topology &topology);
+
 void topologySubCommit(Pothos::Topology &topology)
 {
     auto &_impl = topology._impl;
     const auto &activeFlatFlows = _impl->activeFlatFlows;
     const auto &flatFlows = _impl->flows;
 
+    //automatic placement is applied before buffer managers are installed,
+    //so that the buffers are allocated on the NUMA node of the thread pool;
+    //the stored plan is kept and only blocks new to the design are placed
+    if (not _impl->placementRequest.empty()) topologyPlaceNewBlocks(topology);
+
     //new flows are in flat flows but not in current
     std::vector<Flow> newFlows;
     for (const auto &flow : flatFlows)
@@ -240,7 +253,7 @@ void topologySubCommit(Pothos::Topology &topology)
     //send activate to all new blocks not already in active flows
     for (auto block : getObjSetFromFlowList(newFlows, activeFlatFlows))
     {
-        std::shared_future<void> result(std::async(std::launch::async, setActiveState, block, true));
+        std::shared_future<void> result(std::async(std::launch::async, setActiveState, block, true, _impl->activityMonitor));
         infoFutures.push_back(FutureInfo("activate()", block, result));
     }
 
@@ -250,7 +263,7 @@ void topologySubCommit(Pothos::Topology &topology)
     //send deactivate to all old blocks not in current active flows
     for (auto block : getObjSetFromFlowList(oldFlows, _impl->activeFlatFlows))
     {
-        std::shared_future<void> result(std::async(std::launch::async, setActiveState, block, false));
+        std::shared_future<void> result(std::async(std::launch::async, setActiveState, block, false, _impl->activityMonitor));
         infoFutures.push_back(FutureInfo("deactivate()", block, result));
     }
 
@@ -267,6 +280,11 @@ static void subCommitFutureTask(const Pothos::Proxy &proxy)
     proxy.call("subCommit");
 }
 
+static void configFutureTask(const Pothos::Proxy &proxy, const std::vector<Pothos::ProxyBatchCall> &calls)
+{
+    for (auto &result : proxy.getEnvironment()->callBatch(calls)) result.get();
+}
+
 void Pothos::Topology::commit(void)
 {
     //0) flatten the topology
@@ -289,16 +307,35 @@ void Pothos::Topology::commit(void)
         _impl->remoteTopologies[upid] = obj.getEnvironment()->findProxy("Pothos/Topology").call("make");
     }
 
-    //clear connections on old topologies
-    for (const auto &pair : _impl->remoteTopologies) pair.second.call("disconnectAll");
-
-    //load each topology with connections from flat flows
+    //Configure each sub-topology with a single batch of calls,
+    //so a remote environment costs one round trip rather than one per connection:
+    //clear connections on old topologies, load each topology with connections
+    //from flat flows, and forward the automatic placement configuration.
+    std::map<std::string, std::vector<Pothos::ProxyBatchCall>> configCalls;
+    for (const auto &pair : _impl->remoteTopologies)
+    {
+        configCalls[pair.first].emplace_back(pair.second, "disconnectAll");
+    }
     for (const auto &flow : flatFlows)
     {
         auto upid = flow.src.obj.getEnvironment()->getUniquePid();
         assert(upid == flow.dst.obj.getEnvironment()->getUniquePid());
-        _impl->remoteTopologies[upid].call("connect", flow.src.obj, flow.src.name, flow.dst.obj, flow.dst.name);
+        configCalls[upid].emplace_back(_impl->remoteTopologies[upid], "connect", Pothos::ObjectVector{
+            Pothos::Object(flow.src.obj), Pothos::Object(flow.src.name),
+            Pothos::Object(flow.dst.obj), Pothos::Object(flow.dst.name)});
+    }
+    for (const auto &pair : _impl->remoteTopologies)
+    {
+        configCalls[pair.first].emplace_back(pair.second, "setAutoPlacement", Pothos::ObjectVector{Pothos::Object(_impl->placementRequest)});
+    }
+
+    std::vector<std::future<void>> configFutures;
+    for (auto &pair : configCalls)
+    {
+        for (auto &call : pair.second) call.toLocal = true;
+        configFutures.push_back(std::async(std::launch::async, &configFutureTask, _impl->remoteTopologies.at(pair.first), pair.second));
     }
+    for (auto &future : configFutures) future.get();
 
     //Call commit on all sub-topologies:
     //Use futures so all sub-topologies commit at the same time,
@@ -321,8 +358,8 @@ void Pothos::Topology::commit(void)
     }
     if (not errors.empty()) throw Pothos::TopologyConnectError("Pothos::Topology::commit()", errors);
 
-    //set thread pools for all blocks in this process
-    if (this->getThreadPool()) for (auto block : getObjSetFromFlowList(flatFlows))
+    //set thread pools for all blocks in this process (unless placed automatically)
+    if (this->getThreadPool() and _impl->placementRequest.empty()) for (auto block : getObjSetFromFlowList(flatFlows))
     {
         if (block.getEnvironment()->getUniquePid() != Pothos::ProxyEnvironment::getLocalUniquePid()) continue; //is the block local?
         block.call<Block *>("getPointer")->setThreadPool(this->getThreadPool());
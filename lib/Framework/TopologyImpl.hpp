@@ -1,11 +1,14 @@
-// Copyright (c) 2014-2017 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
 #include <Pothos/Framework/Topology.hpp>
 #include "Framework/PortsAndFlows.hpp"
+#include "Framework/ActivityMonitor.hpp"
 #include <unordered_map>
+#include <functional>
 #include <map>
+#include <set>
 #include <vector>
 #include <string>
 
@@ -20,17 +23,49 @@ static inline Port envTagPort(const Port &port, const Port &other)
     return envTagged;
 }
 
+/*!
+ * Bandwidth and latency annotation for a link between two hosts.
+ * Links without an annotation are assumed to be gigabit ethernet.
+ */
+struct NetworkLink
+{
+    NetworkLink(void): bandwidth(125e6), latency(0.5e-3){}
+    double bandwidth; //!< bytes per second
+    double latency; //!< seconds
+};
+
+//! The number of bytes used to weigh bandwidth against latency
+static const double NETWORK_LINK_COST_BYTES = 1024*1024;
+
+/*!
+ * Plan the route of a stream from the source host to the destination hosts.
+ * \return a map of each destination host to the host that sends it the stream
+ */
+std::map<std::string, std::string> planNetworkRoute(
+    const std::string &srcHost,
+    const std::set<std::string> &dstHosts,
+    const std::function<double(const std::string &, const std::string &)> &linkCost);
+
+/*!
+ * Negotiate the buffer mode of each source port in the flat flows,
+ * and install the resulting buffer manager into the source port.
+ */
+void installBufferManagers(const std::vector<Flow> &flatFlows);
+
 /***********************************************************************
  * implementation guts
  **********************************************************************/
 struct Pothos::Topology::Impl
 {
-    Impl(Topology *self): self(self){}
+    Impl(Topology *self): self(self), activityMonitor(new ActivityMonitor()){}
     Topology *self;
     ThreadPool threadPool;
     std::vector<Flow> flows;
     std::vector<Flow> activeFlatFlows;
     std::unordered_map<Port, std::pair<Pothos::Proxy, Pothos::Proxy>> srcToNetgressCache;
+    std::unordered_map<Port, std::string> srcToNetworkOptions;
+    std::map<std::pair<std::string, std::string>, NetworkLink> networkLinks;
+    double networkLinkCost(const std::string &nodeA, const std::string &nodeB) const;
     std::vector<Flow> squashFlows(const std::vector<Flow> &);
     std::vector<Flow> createNetworkFlows(const std::vector<Flow> &);
     std::vector<Flow> rectifyDomainFlows(const std::vector<Flow> &);
@@ -40,6 +75,16 @@ struct Pothos::Topology::Impl
     std::map<std::string, PortInfo> outputPortInfo;
     std::map<std::string, Callable> calls;
 
+    //! activity monitor shared with the actors of activated blocks
+    std::shared_ptr<ActivityMonitor> activityMonitor;
+
+    //! automatic placement configuration or empty when disabled
+    std::string placementRequest;
+
+    //! the request and per-block thread pools of the last applied placement plan
+    std::string placedRequest;
+    std::map<std::string, Pothos::ThreadPool> placedPools;
+
     //! remote topology per unique environment
     std::map<std::string, Pothos::Proxy> remoteTopologies;
 
@@ -1,11 +1,17 @@
-// Copyright (c) 2014-2017 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Framework/TopologyImpl.hpp>
 #include <Pothos/Util/EvalEnvironment.hpp>
+#include <Pothos/Object/Containers.hpp>
+#include <Pothos/Plugin.hpp>
 #include <Pothos/Proxy.hpp>
+#include <Pothos/Remote/EnvironmentPool.hpp>
 #include <Poco/Format.h>
+#include <algorithm>
+#include <sstream>
 #include <map>
+#include <set>
 #include <json.hpp>
 
 using json = nlohmann::json;
@@ -35,17 +41,24 @@ static Pothos::Object evalExpression(
     return evaluator.eval(arg.dump());
 }
 
-static std::vector<Pothos::Proxy> evalArgsArray(
+static Pothos::ObjectVector evalArgsArray(
     Pothos::Util::EvalEnvironment &evaluator,
     const json &argsArray,
     const size_t offset = 0)
 {
-    std::vector<Pothos::Object> args;
+    Pothos::ObjectVector args;
     for (size_t i = offset; i < argsArray.size(); i++)
     {
         args.push_back(evalExpression(evaluator, argsArray.at(i)));
     }
-    return Pothos::Object(args);
+    return args;
+}
+
+static std::string argsToString(const Pothos::ObjectVector &args)
+{
+    std::string argsStr;
+    for (const auto &arg : args) argsStr += (argsStr.empty()?"":", ") + arg.toString();
+    return argsStr;
 }
 
 typedef std::vector<std::pair<std::string, json>> OrderedVarMap;
@@ -83,18 +96,56 @@ static OrderedVarMap extractVariableMap(const json &obj, const std::string &key,
 }
 
 /***********************************************************************
- * block factory - make blocks from JSON object
+ * Compiled topology: the JSON description with all of the
+ * variables and arguments evaluated into concrete objects.
+ * A compiled topology can be instantiated many times
+ * and stored in a binary snapshot, so that parsing and
+ * expression evaluation only happen once per design.
  **********************************************************************/
-static Pothos::Proxy makeBlock(
-    const Pothos::Proxy &registry,
+struct CompiledCall
+{
+    std::string name;
+    Pothos::ObjectVector args;
+};
+
+struct CompiledBlock
+{
+    std::string id;
+    std::string path;
+    std::string threadPool;
+    std::string host; //remote server URI or empty for local
+    Pothos::ObjectVector args;
+    std::vector<CompiledCall> calls;
+};
+
+struct CompiledTopology
+{
+    std::vector<std::pair<std::string, std::string>> threadPools; //name to args JSON
+    std::vector<std::string> factories; //unique block paths of local blocks
+    std::vector<CompiledBlock> blocks;
+    std::string autoPlacement;
+    std::vector<std::vector<std::string>> connections;
+};
+
+static const std::string SNAPSHOT_FORMAT("Pothos::Topology::snapshot");
+static const int SNAPSHOT_VERSION(1);
+
+/***********************************************************************
+ * compile a block from a JSON object
+ **********************************************************************/
+static CompiledBlock compileBlock(
     const OrderedVarMap &globals,
     const json &blockObj)
 {
-    const std::string id = blockObj["id"];
+    CompiledBlock block;
+    block.id = blockObj["id"].get<std::string>();
+    const auto &id = block.id;
 
     if (blockObj.count("path") == 0) throw Pothos::DataFormatException(
         "Pothos::Topology::make()", "blocks["+id+"] missing 'path' field");
-    const std::string path = blockObj["path"];
+    block.path = blockObj["path"].get<std::string>();
+    block.threadPool = blockObj.value<std::string>("threadPool", "");
+    block.host = blockObj.value<std::string>("host", "");
 
     //parse the local variables
     auto locals = extractVariableMap(blockObj, "locals", id+".locals");
@@ -110,51 +161,27 @@ static Pothos::Proxy makeBlock(
         evaluator.registerConstantObj(pair.first, result);
     }
 
-    //load up the constructor args
+    //evaluate the constructor args
     const auto &argsArray = blockObj.value("args", json::array());
-    const auto ctorArgs = evalArgsArray(evaluator, argsArray);
+    block.args = evalArgsArray(evaluator, argsArray);
 
-    //create the block
-    Pothos::Proxy block;
-    try
-    {
-        block = registry.getHandle()->call(path, ctorArgs.data(), ctorArgs.size());
-    }
-    catch (const Pothos::Exception &ex)
-    {
-        std::string argsStr;
-        for (const auto &arg : ctorArgs) argsStr += arg.toString() + (argsStr.empty()?"":", ");
-        throw Pothos::RuntimeException(Poco::format("%s = %s(%s)", id, path, argsStr), ex);
-    }
-
-    //set the name of the block as supplied by the ID field
-    block.call("setName", id);
-
-    //make the calls
+    //evaluate the calls
     const auto &callsArray = blockObj.value("calls", json::array());
     for (const auto &callArray : callsArray)
     {
-        auto name = callArray[0].get<std::string>();
-        const auto callArgs = evalArgsArray(evaluator, callArray, 1/*offset*/);
-        try
-        {
-            block.getHandle()->call(name, callArgs.data(), callArgs.size());
-        }
-        catch (const Pothos::Exception &ex)
-        {
-            std::string argsStr;
-            for (const auto &arg : callArgs) argsStr += arg.toString() + (argsStr.empty()?"":", ");
-            throw Pothos::RuntimeException(Poco::format("%s.%s(%s)", id, name, argsStr), ex);
-        }
+        CompiledCall call;
+        call.name = callArray[0].get<std::string>();
+        call.args = evalArgsArray(evaluator, callArray, 1/*offset*/);
+        block.calls.push_back(call);
     }
 
     return block;
 }
 
 /***********************************************************************
- * make topology from JSON string - implementation
+ * compile a topology from a JSON string
  **********************************************************************/
-std::shared_ptr<Pothos::Topology> Pothos::Topology::make(const std::string &jsonStr)
+static CompiledTopology compileTopology(const std::string &jsonStr)
 {
     //parse the json formatted string into a JSON object
     json topObj;
@@ -167,32 +194,25 @@ std::shared_ptr<Pothos::Topology> Pothos::Topology::make(const std::string &json
         throw Pothos::DataFormatException("Pothos::Topology::make()", ex.what());
     }
 
-    //create the proxy environment (local) and the registry
-    auto env = Pothos::ProxyEnvironment::make("managed");
-    auto registry = env->findProxy("Pothos/BlockRegistry");
-    auto evaluator = Pothos::Util::EvalEnvironment();
+    CompiledTopology compiled;
 
-    //create thread pools
-    std::map<std::string, Pothos::Proxy> threadPools;
+    //thread pool arguments
     const auto &threadPoolObj = topObj.value("threadPools", json::object());
     for (auto it = threadPoolObj.begin(); it != threadPoolObj.end(); ++it)
     {
-        Pothos::ThreadPoolArgs args(it.value().dump());
-        threadPools[it.key()] = env->findProxy("Pothos/ThreadPool")(args);
+        compiled.threadPools.emplace_back(it.key(), it.value().dump());
     }
 
     //parse global variables
     const auto globals = extractVariableMap(topObj, "globals", "globals");
 
-    //create the topology and add it to the blocks
-    //the IDs 'self', 'this', and '' can be used
-    std::map<std::string, Pothos::Proxy> blocks;
-    auto topology = Pothos::Topology::make();
-    blocks["self"] = env->makeProxy(topology);
-    blocks["this"] = env->makeProxy(topology);
-    blocks[""] = env->makeProxy(topology);
+    //the IDs 'self', 'this', and '' refer to the topology
+    std::set<std::string> ids;
+    ids.insert("self");
+    ids.insert("this");
+    ids.insert("");
 
-    //create the blocks
+    //compile the blocks
     const auto &blockArray = topObj.value("blocks", json::array());
     for (size_t i = 0; i < blockArray.size(); i++)
     {
@@ -201,26 +221,38 @@ std::shared_ptr<Pothos::Topology> Pothos::Topology::make(const std::string &json
             "Pothos::Topology::make()", "blocks["+std::to_string(i)+"] must be an object");
         if (not blockObj.count("id")) throw Pothos::DataFormatException(
             "Pothos::Topology::make()", "blocks["+std::to_string(i)+"] missing 'id' field");
-        const auto id = blockObj["id"].get<std::string>();
-        blocks[id] = makeBlock(registry, globals, blockObj);
+        compiled.blocks.push_back(compileBlock(globals, blockObj));
+        const auto &block = compiled.blocks.back();
+        ids.insert(block.id);
 
-        //set the thread pool
-        const auto threadPoolName = blockObj.value<std::string>("threadPool", "");
-        auto threadPoolIt = threadPools.find(threadPoolName);
-        if (threadPoolIt != threadPools.end()) blocks[id].call("setThreadPool", threadPoolIt->second);
-        else if (not threadPoolName.empty()) throw Pothos::DataFormatException(
-            "Pothos::Topology::make()", "blocks["+id+"] unknown threadPool = " + threadPoolName);
+        //record the factory path once, remote servers check their own factories
+        if (block.host.empty() and std::find(compiled.factories.begin(), compiled.factories.end(), block.path) == compiled.factories.end())
+        {
+            compiled.factories.push_back(block.path);
+        }
+
+        //check the thread pool
+        bool foundPool = block.threadPool.empty();
+        for (const auto &pair : compiled.threadPools) foundPool = foundPool or (pair.first == block.threadPool);
+        if (not foundPool) throw Pothos::DataFormatException(
+            "Pothos::Topology::make()", "blocks["+block.id+"] unknown threadPool = " + block.threadPool);
     }
 
-    //create the topology and connect the blocks
+    //automatic placement onto thread pools
+    if (topObj.count("autoPlacement") != 0)
+    {
+        compiled.autoPlacement = topObj["autoPlacement"].dump();
+    }
+
+    //compile the connections
     const auto &connArray = topObj.value("connections", json::array());
     for (size_t i = 0; i < connArray.size(); i++)
     {
         const auto &connArgs = connArray.at(i);
         if (not connArgs.is_array()) throw Pothos::DataFormatException(
             "Pothos::Topology::make()", "connections["+std::to_string(i)+"] must be an array");
-        if (connArgs.size() != 4) throw Pothos::DataFormatException(
-            "Pothos::Topology::make()", "connections["+std::to_string(i)+"] must be size 4");
+        if (connArgs.size() != 4 and connArgs.size() != 5) throw Pothos::DataFormatException(
+            "Pothos::Topology::make()", "connections["+std::to_string(i)+"] must be size 4 or 5");
 
         //get string value or dump the value to a string
         auto optStr = [](const json &v) -> std::string
@@ -235,14 +267,272 @@ std::shared_ptr<Pothos::Topology> Pothos::Topology::make(const std::string &json
         const auto dstPort = optStr(connArgs.at(3));
 
         //check that the block IDs exist
-        if (blocks.count(srcId) == 0) throw Pothos::DataFormatException(
+        if (ids.count(srcId) == 0) throw Pothos::DataFormatException(
             "Pothos::Topology::make()", "connections["+std::to_string(i)+"] no such ID: " + srcId);
-        if (blocks.count(dstId) == 0) throw Pothos::DataFormatException(
+        if (ids.count(dstId) == 0) throw Pothos::DataFormatException(
             "Pothos::Topology::make()", "connections["+std::to_string(i)+"] no such ID: " + dstId);
 
-        //make the connection
-        topology->connect(blocks.at(srcId), srcPort, blocks.at(dstId), dstPort);
+        compiled.connections.push_back({srcId, srcPort, dstId, dstPort});
+
+        //optional network options for the source port
+        if (connArgs.size() == 5)
+        {
+            if (not connArgs.at(4).is_object()) throw Pothos::DataFormatException(
+                "Pothos::Topology::make()", "connections["+std::to_string(i)+"] network options must be an object");
+            compiled.connections.back().push_back(connArgs.at(4).dump());
+        }
+    }
+
+    return compiled;
+}
+
+/***********************************************************************
+ * instantiate a topology from the compiled representation
+ **********************************************************************/
+static std::shared_ptr<Pothos::Topology> instantiateTopology(const CompiledTopology &compiled)
+{
+    //create the proxy environment (local) and the registry
+    auto env = Pothos::ProxyEnvironment::make("managed");
+    auto registry = env->findProxy("Pothos/BlockRegistry");
+
+    //resolve the factory list up-front to report missing blocks
+    for (const auto &path : compiled.factories)
+    {
+        if (not Pothos::PluginRegistry::exists(Pothos::PluginPath("/blocks", path)))
+        {
+            throw Pothos::DataFormatException("Pothos::Topology::make()", "no factory for block path " + path);
+        }
+    }
+
+    //blocks with a host are made in a pooled remote environment,
+    //so that repeated make and commit calls reuse the connection
+    std::map<std::string, Pothos::ProxyEnvironment::Sptr> envs;
+    envs[""] = env;
+    auto getEnv = [&envs](const std::string &host)
+    {
+        auto &hostEnv = envs[host];
+        if (not hostEnv) hostEnv = Pothos::RemoteEnvironmentPool::get(host);
+        return hostEnv;
+    };
+
+    //create thread pools, remote hosts get their own on first use
+    std::map<std::pair<std::string, std::string>, Pothos::Proxy> threadPools;
+    auto threadPoolClass = env->findProxy("Pothos/ThreadPool");
+    for (const auto &pair : compiled.threadPools)
+    {
+        threadPools[std::make_pair(std::string(), pair.first)] = threadPoolClass(Pothos::ThreadPoolArgs(pair.second));
+    }
+    auto getThreadPool = [&](const std::string &host, const std::string &name)
+    {
+        auto &pool = threadPools[std::make_pair(host, name)];
+        if (not pool) for (const auto &pair : compiled.threadPools)
+        {
+            if (pair.first != name) continue;
+            pool = getEnv(host)->findProxy("Pothos/ThreadPool")(Pothos::ThreadPoolArgs(pair.second));
+        }
+        return pool;
+    };
+
+    //create the topology and add it to the blocks
+    std::map<std::string, Pothos::Proxy> blocks;
+    auto topology = Pothos::Topology::make();
+    blocks["self"] = env->makeProxy(topology);
+    blocks["this"] = blocks["self"];
+    blocks[""] = blocks["self"];
+
+    //helper to convert evaluated args into proxies
+    auto toProxies = [](const Pothos::ProxyEnvironment::Sptr &env, const Pothos::ObjectVector &args)
+    {
+        std::vector<Pothos::Proxy> proxies;
+        for (const auto &arg : args) proxies.push_back(env->convertObjectToProxy(arg));
+        return proxies;
+    };
+
+    //create the blocks
+    for (const auto &compiledBlock : compiled.blocks)
+    {
+        const auto &id = compiledBlock.id;
+        const auto &path = compiledBlock.path;
+        Pothos::Proxy block;
+
+        //create the block
+        const auto blockEnv = getEnv(compiledBlock.host);
+        const auto blockRegistry = compiledBlock.host.empty()?registry:blockEnv->findProxy("Pothos/BlockRegistry");
+        const auto ctorArgs = toProxies(blockEnv, compiledBlock.args);
+        try
+        {
+            block = blockRegistry.getHandle()->call(path, ctorArgs.data(), ctorArgs.size());
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            throw Pothos::RuntimeException(Poco::format("%s = %s(%s)", id, path, argsToString(compiledBlock.args)), ex);
+        }
+
+        //set the name of the block as supplied by the ID field
+        block.call("setName", id);
+
+        //make the calls
+        for (const auto &call : compiledBlock.calls)
+        {
+            const auto callArgs = toProxies(blockEnv, call.args);
+            try
+            {
+                block.getHandle()->call(call.name, callArgs.data(), callArgs.size());
+            }
+            catch (const Pothos::Exception &ex)
+            {
+                throw Pothos::RuntimeException(Poco::format("%s.%s(%s)", id, call.name, argsToString(call.args)), ex);
+            }
+        }
+
+        //set the thread pool
+        if (not compiledBlock.threadPool.empty())
+        {
+            block.call("setThreadPool", getThreadPool(compiledBlock.host, compiledBlock.threadPool));
+        }
+        blocks[id] = block;
+    }
+
+    //enable automatic placement onto thread pools
+    if (not compiled.autoPlacement.empty())
+    {
+        topology->setAutoPlacement(compiled.autoPlacement);
+    }
+
+    //connect the blocks
+    for (const auto &conn : compiled.connections)
+    {
+        topology->connect(blocks.at(conn[0]), conn[1], blocks.at(conn[2]), conn[3]);
+        if (conn.size() > 4) topology->setNetworkOptions(blocks.at(conn[0]), conn[1], conn[4]);
     }
 
     return topology;
 }
+
+/***********************************************************************
+ * snapshot serialization - the compiled topology is stored
+ * as a tree of object containers using the object serializer
+ **********************************************************************/
+static Pothos::Object compiledToObject(const CompiledTopology &compiled)
+{
+    Pothos::ObjectKwargs topObj;
+    topObj["format"] = Pothos::Object(SNAPSHOT_FORMAT);
+    topObj["version"] = Pothos::Object(SNAPSHOT_VERSION);
+
+    Pothos::ObjectVector threadPools;
+    for (const auto &pair : compiled.threadPools)
+    {
+        threadPools.emplace_back(Pothos::ObjectVector{Pothos::Object(pair.first), Pothos::Object(pair.second)});
+    }
+    topObj["threadPools"] = Pothos::Object(threadPools);
+    topObj["factories"] = Pothos::Object(compiled.factories);
+
+    Pothos::ObjectVector blocks;
+    for (const auto &block : compiled.blocks)
+    {
+        Pothos::ObjectKwargs blockObj;
+        blockObj["id"] = Pothos::Object(block.id);
+        blockObj["path"] = Pothos::Object(block.path);
+        blockObj["threadPool"] = Pothos::Object(block.threadPool);
+        blockObj["host"] = Pothos::Object(block.host);
+        blockObj["args"] = Pothos::Object(block.args);
+        Pothos::ObjectVector calls;
+        for (const auto &call : block.calls)
+        {
+            calls.emplace_back(Pothos::ObjectVector{Pothos::Object(call.name), Pothos::Object(call.args)});
+        }
+        blockObj["calls"] = Pothos::Object(calls);
+        blocks.emplace_back(blockObj);
+    }
+    topObj["blocks"] = Pothos::Object(blocks);
+    topObj["autoPlacement"] = Pothos::Object(compiled.autoPlacement);
+
+    Pothos::ObjectVector connections;
+    for (const auto &conn : compiled.connections) connections.emplace_back(conn);
+    topObj["connections"] = Pothos::Object(connections);
+
+    return Pothos::Object(topObj);
+}
+
+static CompiledTopology objectToCompiled(const Pothos::Object &obj)
+{
+    if (not obj.canConvert(typeid(Pothos::ObjectKwargs))) throw Pothos::DataFormatException(
+        "Pothos::Topology::makeFromSnapshot()", "not a topology snapshot");
+    const auto topObj = obj.convert<Pothos::ObjectKwargs>();
+    const auto formatIt = topObj.find("format");
+    const auto versionIt = topObj.find("version");
+    if (formatIt == topObj.end() or formatIt->second.toString() != SNAPSHOT_FORMAT) throw Pothos::DataFormatException(
+        "Pothos::Topology::makeFromSnapshot()", "not a topology snapshot");
+    if (versionIt == topObj.end() or versionIt->second.convert<int>() != SNAPSHOT_VERSION) throw Pothos::DataFormatException(
+        "Pothos::Topology::makeFromSnapshot()", "unsupported snapshot version");
+
+    CompiledTopology compiled;
+    for (const auto &poolObj : topObj.at("threadPools").extract<Pothos::ObjectVector>())
+    {
+        const auto &pair = poolObj.extract<Pothos::ObjectVector>();
+        compiled.threadPools.emplace_back(pair.at(0).extract<std::string>(), pair.at(1).extract<std::string>());
+    }
+    compiled.factories = topObj.at("factories").extract<std::vector<std::string>>();
+
+    for (const auto &blockObj : topObj.at("blocks").extract<Pothos::ObjectVector>())
+    {
+        const auto &kwargs = blockObj.extract<Pothos::ObjectKwargs>();
+        CompiledBlock block;
+        block.id = kwargs.at("id").extract<std::string>();
+        block.path = kwargs.at("path").extract<std::string>();
+        block.threadPool = kwargs.at("threadPool").extract<std::string>();
+        const auto hostIt = kwargs.find("host"); //optional in older snapshots
+        if (hostIt != kwargs.end()) block.host = hostIt->second.extract<std::string>();
+        block.args = kwargs.at("args").extract<Pothos::ObjectVector>();
+        for (const auto &callObj : kwargs.at("calls").extract<Pothos::ObjectVector>())
+        {
+            const auto &pair = callObj.extract<Pothos::ObjectVector>();
+            CompiledCall call;
+            call.name = pair.at(0).extract<std::string>();
+            call.args = pair.at(1).extract<Pothos::ObjectVector>();
+            block.calls.push_back(call);
+        }
+        compiled.blocks.push_back(block);
+    }
+    compiled.autoPlacement = topObj.at("autoPlacement").extract<std::string>();
+
+    for (const auto &connObj : topObj.at("connections").extract<Pothos::ObjectVector>())
+    {
+        compiled.connections.push_back(connObj.extract<std::vector<std::string>>());
+    }
+
+    return compiled;
+}
+
+/***********************************************************************
+ * make topology from JSON string - implementation
+ **********************************************************************/
+std::shared_ptr<Pothos::Topology> Pothos::Topology::make(const std::string &jsonStr)
+{
+    return instantiateTopology(compileTopology(jsonStr));
+}
+
+/***********************************************************************
+ * snapshot API - implementation
+ **********************************************************************/
+std::string Pothos::Topology::compileSnapshot(const std::string &jsonStr)
+{
+    std::ostringstream oss;
+    compiledToObject(compileTopology(jsonStr)).serialize(oss);
+    return oss.str();
+}
+
+std::shared_ptr<Pothos::Topology> Pothos::Topology::makeFromSnapshot(const std::string &snapshot)
+{
+    std::istringstream iss(snapshot);
+    Pothos::Object obj;
+    try
+    {
+        obj.deserialize(iss);
+    }
+    catch (const Pothos::ObjectSerializeError &ex)
+    {
+        throw Pothos::DataFormatException("Pothos::Topology::makeFromSnapshot()", ex.message());
+    }
+    return instantiateTopology(objectToCompiled(obj));
+}
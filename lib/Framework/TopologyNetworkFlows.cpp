@@ -1,17 +1,96 @@
-// Copyright (c) 2014-2015 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "Framework/TopologyImpl.hpp"
+#include <Pothos/Framework/BufferCodec.hpp>
+#include <Pothos/Framework/Exception.hpp>
 #include <Pothos/System/HostInfo.hpp>
 #include <Pothos/Remote.hpp>
 #include <Poco/Net/SocketAddress.h>
+#include <Poco/Logger.h>
 #include <Poco/URI.h>
+#include <algorithm>
+#include <functional>
 #include <future>
+#include <set>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+/***********************************************************************
+ * network options for a source port
+ **********************************************************************/
+struct NetworkOptions
+{
+    NetworkOptions(const std::string &request):
+        codec("none"),
+        checksum(false)
+    {
+        if (request.empty()) return;
+        json config;
+        try
+        {
+            config = json::parse(request);
+        }
+        catch (const std::exception &ex)
+        {
+            throw Pothos::DataFormatException("Pothos::Topology::setNetworkOptions()", ex.what());
+        }
+        if (not config.is_object()) throw Pothos::DataFormatException(
+            "Pothos::Topology::setNetworkOptions()", "options must be an object");
+        codec = config.value<std::string>("codec", codec);
+        checksum = config.value<bool>("checksum", checksum);
+    }
+
+    std::string codec;
+    bool checksum;
+};
+
+void Pothos::Topology::_setNetworkOptions(const Object &src, const std::string &srcPort, const std::string &options)
+{
+    if (not checkObj(src)) throw Pothos::TopologyConnectError("Pothos::Topology::setNetworkOptions()",
+        "source port of type " + src.toString());
+
+    //validate the request and the codec name up-front
+    const NetworkOptions config(options);
+    Pothos::BufferCodec::make(config.codec);
+
+    const auto port = _impl->makePort(src, srcPort);
+    if (config.codec == "none" and not config.checksum) _impl->srcToNetworkOptions.erase(port);
+    else _impl->srcToNetworkOptions[port] = options;
+}
+
+/***********************************************************************
+ * negotiate the network options with both network blocks
+ **********************************************************************/
+static void negotiateNetworkOptions(const Pothos::Proxy &netSink, const Pothos::Proxy &netSource, const NetworkOptions &config, const std::string &name)
+{
+    try
+    {
+        for (const auto &netBlock : {netSink, netSource})
+        {
+            netBlock.call("setCodec", config.codec);
+            netBlock.call("setChecksum", config.checksum);
+        }
+    }
+    catch (const Pothos::Exception &ex)
+    {
+        //one side lacks support: both sides fall back to unencoded buffers
+        poco_warning(Poco::Logger::get("Pothos.Topology.createNetworkFlow"),
+            name + " network options not supported, using unencoded buffers - " + ex.message());
+        for (const auto &netBlock : {netSink, netSource}) try
+        {
+            netBlock.call("setCodec", "none");
+            netBlock.call("setChecksum", false);
+        }
+        catch (const Pothos::Exception &){}
+    }
+}
 
 /***********************************************************************
  * helpers to create network iogress flows
  **********************************************************************/
-std::pair<Pothos::Proxy, Pothos::Proxy> createNetworkFlow(const Flow &flow)
+std::pair<Pothos::Proxy, Pothos::Proxy> createNetworkFlow(const Flow &flow, const Port &origin, const std::string &options)
 {
     //default behaviour: the sink binds, the source connects
     auto bindEnv = flow.src.obj.getEnvironment();
@@ -43,20 +122,132 @@ std::pair<Pothos::Proxy, Pothos::Proxy> createNetworkFlow(const Flow &flow)
     uri.setPort(std::stoi(connectPort));
     netConn = connEnv->findProxy("Pothos/BlockRegistry").call(netConnPath, uri.toString(), "CONNECT");
 
-    //return the pair of network blocks
-    const auto name = flow.src.obj.call<std::string>("getName")+"["+flow.src.name+"]";
+    //return the pair of network blocks, relays are named after the original source
+    const auto name = origin.obj.call<std::string>("getName")+"["+origin.name+"]";
     netSink.get().call("setName", "NetTo: "+name);
     netSource.get().call("setName", "NetFrom: "+name);
+
+    //the codec and checksum are only configured when requested,
+    //so network blocks without support work with default flows
+    if (not options.empty()) negotiateNetworkOptions(netSink, netSource, NetworkOptions(options), name);
     return std::make_pair(netSource, netSink);
 }
 
+/***********************************************************************
+ * network link annotations
+ **********************************************************************/
+void Pothos::Topology::setNetworkLinks(const std::string &request)
+{
+    json linksArray;
+    try
+    {
+        linksArray = json::parse(request.empty()?"[]":request);
+    }
+    catch (const std::exception &ex)
+    {
+        throw Pothos::DataFormatException("Pothos::Topology::setNetworkLinks()", ex.what());
+    }
+    if (not linksArray.is_array()) throw Pothos::DataFormatException(
+        "Pothos::Topology::setNetworkLinks()", "links must be an array");
+
+    std::map<std::pair<std::string, std::string>, NetworkLink> links;
+    for (const auto &linkObj : linksArray)
+    {
+        if (not linkObj.is_object() or linkObj.count("hosts") == 0 or linkObj["hosts"].size() != 2)
+        {
+            throw Pothos::DataFormatException("Pothos::Topology::setNetworkLinks()", "link must specify two hosts: " + linkObj.dump());
+        }
+        NetworkLink link;
+        link.bandwidth = linkObj.value<double>("bandwidth", link.bandwidth);
+        link.latency = linkObj.value<double>("latency", link.latency);
+        if (link.bandwidth <= 0.0 or link.latency < 0.0) throw Pothos::DataFormatException(
+            "Pothos::Topology::setNetworkLinks()", "link bandwidth and latency out of range: " + linkObj.dump());
+        const std::string hostA = linkObj["hosts"][0];
+        const std::string hostB = linkObj["hosts"][1];
+        links[std::minmax(hostA, hostB)] = link;
+    }
+    _impl->networkLinks = links;
+}
+
+double Pothos::Topology::Impl::networkLinkCost(const std::string &nodeA, const std::string &nodeB) const
+{
+    //hosts are annotated by node ID or by IP address
+    NetworkLink link;
+    const std::string namesA[] = {nodeA, Pothos::RemoteClient::lookupIpFromNodeId(nodeA)};
+    const std::string namesB[] = {nodeB, Pothos::RemoteClient::lookupIpFromNodeId(nodeB)};
+    for (const auto &a : namesA) for (const auto &b : namesB)
+    {
+        const auto it = networkLinks.find(std::minmax(a, b));
+        if (it != networkLinks.end()) link = it->second;
+    }
+
+    //the time to move a reference amount of data over the link
+    return link.latency + NETWORK_LINK_COST_BYTES/link.bandwidth;
+}
+
+/***********************************************************************
+ * network route planning
+ **********************************************************************/
+std::map<std::string, std::string> planNetworkRoute(
+    const std::string &srcHost,
+    const std::set<std::string> &dstHosts,
+    const std::function<double(const std::string &, const std::string &)> &linkCost)
+{
+    //Prim's algorithm: grow a tree from the source host,
+    //attaching the destination host with the cheapest link to the tree.
+    //Each host receives the stream once, and a destination host
+    //relays to another host when that link is cheaper than the others.
+    std::map<std::string, std::string> parents;
+    std::map<std::string, std::pair<double, std::string>> best; //host to cost, parent
+    for (const auto &host : dstHosts)
+    {
+        if (host != srcHost) best[host] = std::make_pair(linkCost(srcHost, host), srcHost);
+    }
+
+    while (not best.empty())
+    {
+        auto next = best.begin();
+        for (auto it = best.begin(); it != best.end(); ++it)
+        {
+            if (it->second.first < next->second.first) next = it;
+        }
+        const auto host = next->first;
+        parents[host] = next->second.second;
+        best.erase(next);
+
+        for (auto &pair : best)
+        {
+            const auto cost = linkCost(host, pair.first);
+            if (cost < pair.second.first) pair.second = std::make_pair(cost, host);
+        }
+    }
+    return parents;
+}
+
 /***********************************************************************
  * network crossing implementation
  **********************************************************************/
+struct NetworkHop
+{
+    int from; //index of the hop that feeds this hop, or -1 for the source
+    Port origin; //the original source port
+    std::vector<Flow> flows; //the flows delivered in the destination environment
+};
+
+std::vector<Port> resolveSourcePorts(const Port &port);
+
 std::vector<Flow> Pothos::Topology::Impl::createNetworkFlows(const std::vector<Flow> &flatFlows)
 {
     std::vector<Flow> networkAwareFlows;
 
+    //options are set on the port that the user connected,
+    //which may be the port of a hierarchical topology, so key them by the flattened ports
+    std::unordered_map<Port, std::string> flatSrcToNetworkOptions;
+    for (const auto &pair : this->srcToNetworkOptions)
+    {
+        for (const auto &src : resolveSourcePorts(pair.first)) flatSrcToNetworkOptions[src] = pair.second;
+    }
+
     //locate all of the source endpoints
     std::unordered_map<Port, std::vector<Flow>> srcToFlows;
     for (const auto &flow : flatFlows)
@@ -67,39 +258,114 @@ std::vector<Flow> Pothos::Topology::Impl::createNetworkFlows(const std::vector<F
             networkAwareFlows.push_back(flow);
             continue;
         }
-        srcToFlows[envTagPort(flow.src, flow.dst)].push_back(flow);
+        srcToFlows[flow.src].push_back(flow);
     }
-    //look in the cache or create network iogress for every source endpoint
-    std::unordered_map<Port, std::shared_future<std::pair<Pothos::Proxy, Pothos::Proxy>>> srcToFutures;
+
+    //plan the hops for each source endpoint:
+    //the stream crosses to each host once, into the environment with the most consumers,
+    //and that environment relays the stream to the other environments on its host
+    //and to the next hosts in the planned route.
+    std::vector<NetworkHop> hops;
+    const auto linkCost = [this](const std::string &a, const std::string &b){return this->networkLinkCost(a, b);};
     for (const auto &pair : srcToFlows)
     {
-        assert(not pair.second.empty());
-        if (this->srcToNetgressCache.count(pair.first) != 0) continue;
-        srcToFutures[pair.first] = std::async(std::launch::async, &createNetworkFlow, pair.second.at(0));
+        const auto &src = pair.first;
+        const auto srcHost = src.obj.getEnvironment()->getNodeId();
+
+        //group the flows by destination environment and host
+        std::map<std::string, std::vector<Flow>> envToFlows;
+        std::map<std::string, std::vector<std::string>> hostToEnvs;
+        for (const auto &flow : pair.second)
+        {
+            const auto env = flow.dst.obj.getEnvironment();
+            auto &flows = envToFlows[env->getUniquePid()];
+            if (flows.empty()) hostToEnvs[env->getNodeId()].push_back(env->getUniquePid());
+            flows.push_back(flow);
+        }
+        for (auto &hostPair : hostToEnvs) std::stable_sort(hostPair.second.begin(), hostPair.second.end(),
+            [&envToFlows](const std::string &a, const std::string &b){return envToFlows[a].size() > envToFlows[b].size();});
+
+        std::set<std::string> dstHosts;
+        for (const auto &hostPair : hostToEnvs) dstHosts.insert(hostPair.first);
+        const auto parents = planNetworkRoute(srcHost, dstHosts, linkCost);
+
+        //visit the hosts in route order so the hop into a host precedes its relays
+        std::vector<std::string> order(1, srcHost);
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            for (const auto &parent : parents) if (parent.second == order[i]) order.push_back(parent.first);
+        }
+
+        std::map<std::string, int> hostEntry; //host to the hop that enters the host
+        for (const auto &host : order)
+        {
+            if (hostToEnvs.count(host) == 0) continue;
+            const auto &envs = hostToEnvs.at(host);
+            for (size_t i = 0; i < envs.size(); i++)
+            {
+                NetworkHop hop;
+                if (host == srcHost) hop.from = -1;
+                else if (i == 0) hop.from = hostEntry.at(parents.at(host));
+                else hop.from = hostEntry.at(host);
+                hop.origin = src;
+                hop.flows = envToFlows.at(envs[i]);
+                hops.push_back(hop);
+                if (host != srcHost and i == 0) hostEntry[host] = int(hops.size()-1);
+            }
+        }
     }
 
-    //load all futures into the cache
-    for (const auto &pair : srcToFutures)
+    //create the network blocks in waves, a relay hop is created after the hop that feeds it
+    std::vector<Port> hopSources(hops.size()); //the port that feeds the hop's network sink
+    std::vector<Port> hopKeys(hops.size()); //the cache key for the hop
+    std::vector<bool> created(hops.size(), false);
+    for (size_t numCreated = 0; numCreated < hops.size();)
     {
-        this->srcToNetgressCache[pair.first] = pair.second.get();
+        std::map<size_t, std::shared_future<std::pair<Pothos::Proxy, Pothos::Proxy>>> hopToFutures;
+        for (size_t i = 0; i < hops.size(); i++)
+        {
+            const auto &hop = hops[i];
+            if (created[i] or (hop.from != -1 and not created[hop.from])) continue;
+            hopSources[i] = (hop.from == -1)?hop.origin:this->makePort(this->srcToNetgressCache.at(hopKeys[hop.from]).first, "0");
+            hopKeys[i] = envTagPort(hopSources[i], hop.flows.at(0).dst);
+
+            //look in the cache or create network iogress for the hop
+            if (this->srcToNetgressCache.count(hopKeys[i]) != 0) continue;
+            Flow flow;
+            flow.src = hopSources[i];
+            flow.dst = hop.flows.at(0).dst;
+            const auto optionsIt = flatSrcToNetworkOptions.find(hop.origin);
+            const auto options = (optionsIt == flatSrcToNetworkOptions.end())?"":optionsIt->second;
+            hopToFutures[i] = std::async(std::launch::async, &createNetworkFlow, flow, hop.origin, options);
+        }
+
+        //load all futures into the cache
+        for (const auto &pair : hopToFutures)
+        {
+            this->srcToNetgressCache[hopKeys[pair.first]] = pair.second.get();
+        }
+        for (size_t i = 0; i < hops.size(); i++)
+        {
+            if (created[i] or hopKeys[i].uid.empty()) continue;
+            created[i] = true;
+            numCreated++;
+        }
     }
 
     //append network flows from the cache
-    for (const auto &pair : srcToFlows)
+    for (size_t i = 0; i < hops.size(); i++)
     {
-        assert(not pair.second.empty());
-        const auto &netBlocks = this->srcToNetgressCache.at(pair.first);
+        const auto &netBlocks = this->srcToNetgressCache.at(hopKeys[i]);
 
         //append the source to netSink flow
         Flow srcFlow;
-        srcFlow.src = pair.second.at(0).src;
+        srcFlow.src = hopSources[i];
         srcFlow.dst = makePort(netBlocks.second, "0");
         networkAwareFlows.push_back(srcFlow);
 
         //append the netSource to dest flows
-        for (const auto &flow : pair.second)
+        for (const auto &flow : hops[i].flows)
         {
-            assert(flow.src == srcFlow.src);
             Flow dstFlow;
             dstFlow.src = makePort(netBlocks.first, "0");
             dstFlow.dst = flow.dst;
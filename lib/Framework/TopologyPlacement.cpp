@@ -0,0 +1,366 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/TopologyImpl.hpp"
+#include "Framework/WorkerActor.hpp"
+#include <Pothos/Framework/Block.hpp>
+#include <Pothos/Framework/Exception.hpp>
+#include <Pothos/System/NumaInfo.hpp>
+#include <algorithm>
+#include <numeric>
+#include <future>
+#include <set>
+#include <thread>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+/***********************************************************************
+ * placement graph: blocks are weighted by load, edges by traffic
+ **********************************************************************/
+//! Loads are fractions of one core, this share is assumed before measurement
+static const double NOMINAL_BLOCK_LOAD = 0.25;
+
+struct PlacementNode
+{
+    std::string uid;
+    Pothos::Block *block;
+    double load;
+};
+
+struct PlacementEdge
+{
+    size_t src, dst;
+    double weight;
+};
+
+struct PlacementBin
+{
+    PlacementBin(void): node(0), load(0.0){}
+    size_t node; //NUMA node number
+    std::vector<size_t> cpus;
+    std::vector<size_t> members;
+    double load;
+};
+
+static size_t findRoot(std::vector<size_t> &parents, size_t i)
+{
+    while (parents[i] != i) i = parents[i] = parents[parents[i]];
+    return i;
+}
+
+//! Switch pools with the actor locked, so buffer setup sees the new node affinity
+static void setPlacedThreadPool(Pothos::Block *block, const Pothos::ThreadPool &threadPool)
+{
+    ActorInterfaceLock lock(block->_actor.get());
+    block->setThreadPool(threadPool);
+}
+
+/***********************************************************************
+ * measure the load and traffic from the work stats
+ **********************************************************************/
+static void measureLoad(std::vector<PlacementNode> &nodes, std::vector<PlacementEdge> &edges, const std::vector<Flow> &flows, const double sampleTime)
+{
+    std::vector<json> firstStats, lastStats;
+    for (const auto &node : nodes) firstStats.push_back(json::parse(node.block->_actor->queryWorkStats()));
+    std::this_thread::sleep_for(std::chrono::nanoseconds((long long)(sampleTime*1e9)));
+    for (const auto &node : nodes) lastStats.push_back(json::parse(node.block->_actor->queryWorkStats()));
+
+    //the block load is the fraction of time spent in work()
+    double totalLoad(0.0);
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const auto elapsed = lastStats[i].value("timeStatsQuery", 0.0) - firstStats[i].value("timeStatsQuery", 0.0);
+        const auto work = lastStats[i].value("totalTimeWork", 0.0) - firstStats[i].value("totalTimeWork", 0.0);
+        nodes[i].load = (elapsed > 0.0)?(work/elapsed):0.0;
+        totalLoad += nodes[i].load;
+    }
+
+    //an idle topology has no meaningful load, use uniform weights
+    if (totalLoad == 0.0) for (auto &node : nodes) node.load = NOMINAL_BLOCK_LOAD;
+
+    //the edge weight is the number of bytes consumed across the edge
+    auto inputBytes = [&flows](const json &stats, const std::string &portName)
+    {
+        for (const auto &portStats : stats.value("inputStats", json::array()))
+        {
+            if (portStats.value("portName", "") != portName) continue;
+            return portStats.value("totalElements", 0.0)*portStats.value("dtypeSize", 1.0);
+        }
+        return 0.0;
+    };
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        auto &edge = edges[i];
+        const auto &portName = flows[i].dst.name;
+        edge.weight = inputBytes(lastStats[edge.dst], portName) - inputBytes(firstStats[edge.dst], portName);
+    }
+}
+
+/***********************************************************************
+ * plan and apply placement to the local blocks of a sub-topology
+ **********************************************************************/
+std::string topologyApplyPlacement(Pothos::Topology &topology, const std::string &request)
+{
+    const auto configObj = json::parse(request.empty()?"{}":request);
+    const std::string mode = configObj.value("mode", "NONE");
+    const double sampleTime = configObj.value("sampleTime", 0.0);
+    json planObj;
+    planObj["mode"] = mode;
+    planObj["pools"] = json::array();
+    auto &_impl = topology._impl;
+    _impl->placedRequest = _impl->placementRequest;
+    _impl->placedPools.clear();
+    if (mode == "NONE") return planObj.dump();
+    if (mode != "CPU" and mode != "NUMA") throw Pothos::ThreadPoolError(
+        "Pothos::Topology::setAutoPlacement()", "unknown placement mode " + mode);
+
+    //gather the local blocks and the connections between them
+    std::vector<PlacementNode> nodes;
+    std::map<std::string, size_t> uidToIndex;
+    for (const auto &obj : getObjSetFromFlowList(topology._impl->flows))
+    {
+        if (obj.getEnvironment()->getUniquePid() != Pothos::ProxyEnvironment::getLocalUniquePid()) continue;
+        PlacementNode node;
+        node.uid = obj.call<std::string>("uid");
+        node.block = obj.call<Pothos::Block *>("getPointer");
+        node.load = NOMINAL_BLOCK_LOAD;
+        uidToIndex[node.uid] = nodes.size();
+        nodes.push_back(node);
+    }
+
+    std::vector<Flow> edgeFlows;
+    std::vector<PlacementEdge> edges;
+    for (const auto &flow : topology._impl->flows)
+    {
+        if (uidToIndex.count(flow.src.uid) == 0 or uidToIndex.count(flow.dst.uid) == 0) continue;
+        PlacementEdge edge;
+        edge.src = uidToIndex.at(flow.src.uid);
+        edge.dst = uidToIndex.at(flow.dst.uid);
+        edge.weight = 1.0;
+        edgeFlows.push_back(flow);
+        edges.push_back(edge);
+    }
+    if (nodes.empty()) return planObj.dump();
+
+    //re-planning uses measured load rather than the graph structure alone
+    if (sampleTime > 0.0) measureLoad(nodes, edges, edgeFlows, sampleTime);
+
+    //create a bin for every core or for every NUMA node
+    std::vector<PlacementBin> bins;
+    for (const auto &info : Pothos::System::NumaInfo::get())
+    {
+        if (mode == "NUMA")
+        {
+            bins.emplace_back();
+            bins.back().node = info.nodeNumber;
+            bins.back().cpus = info.cpus;
+        }
+        else for (const auto cpu : info.cpus)
+        {
+            bins.emplace_back();
+            bins.back().node = info.nodeNumber;
+            bins.back().cpus.push_back(cpu);
+        }
+    }
+    if (bins.empty()) throw Pothos::ThreadPoolError(
+        "Pothos::Topology::setAutoPlacement()", "no CPUs reported by NumaInfo");
+
+    //The capacity of a bin is the number of cores that it has,
+    //or the fair share of the total load when the load exceeds all cores.
+    //Tightly coupled blocks are grouped when the group fits a bin,
+    //by merging along the heaviest edges of the flow graph first.
+    double totalLoad(0.0), totalCores(0.0);
+    for (const auto &node : nodes) totalLoad += node.load;
+    for (const auto &bin : bins) totalCores += bin.cpus.size();
+    const double capacity = std::max(totalCores, totalLoad)/bins.size();
+
+    std::vector<size_t> parents(nodes.size());
+    std::vector<double> groupLoads(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        parents[i] = i;
+        groupLoads[i] = nodes[i].load;
+    }
+
+    std::stable_sort(edges.begin(), edges.end(), [](const PlacementEdge &a, const PlacementEdge &b)
+    {
+        return a.weight > b.weight;
+    });
+    for (const auto &edge : edges)
+    {
+        const auto a = findRoot(parents, edge.src);
+        const auto b = findRoot(parents, edge.dst);
+        if (a == b or groupLoads[a]+groupLoads[b] > capacity) continue;
+        parents[b] = a;
+        groupLoads[a] += groupLoads[b];
+    }
+
+    //assign the largest groups first to the least loaded bin
+    std::map<size_t, std::vector<size_t>> groups;
+    for (size_t i = 0; i < nodes.size(); i++) groups[findRoot(parents, i)].push_back(i);
+    std::vector<size_t> groupOrder;
+    for (const auto &pair : groups) groupOrder.push_back(pair.first);
+    std::stable_sort(groupOrder.begin(), groupOrder.end(), [&groupLoads](const size_t a, const size_t b)
+    {
+        return groupLoads[a] > groupLoads[b];
+    });
+    for (const auto root : groupOrder)
+    {
+        auto &bin = *std::min_element(bins.begin(), bins.end(), [](const PlacementBin &a, const PlacementBin &b)
+        {
+            return a.load < b.load;
+        });
+        bin.members.insert(bin.members.end(), groups[root].begin(), groups[root].end());
+        bin.load += groupLoads[root];
+    }
+
+    //create a pinned thread pool per bin and apply it to the members
+    for (const auto &bin : bins)
+    {
+        if (bin.members.empty()) continue;
+        Pothos::ThreadPoolArgs args;
+        args.priority = configObj.value("priority", 0.0);
+        args.yieldMode = configObj.value("yieldMode", "");
+        if (mode == "CPU")
+        {
+            args.numThreads = 1;
+            args.affinityMode = "CPU";
+            args.affinity = bin.cpus;
+        }
+        else
+        {
+            args.numThreads = std::min(bin.cpus.size(), bin.members.size());
+            args.affinityMode = "NUMA";
+            args.affinity.push_back(bin.node);
+        }
+        Pothos::ThreadPool threadPool(args);
+
+        json poolObj;
+        poolObj["numThreads"] = args.numThreads;
+        poolObj["affinityMode"] = args.affinityMode;
+        poolObj["affinity"] = args.affinity;
+        poolObj["load"] = bin.load;
+        auto &blocksArray = poolObj["blocks"];
+        for (const auto index : bin.members)
+        {
+            const auto &node = nodes[index];
+            setPlacedThreadPool(node.block, threadPool);
+            _impl->placedPools[node.uid] = threadPool;
+            json blockObj;
+            blockObj["id"] = node.uid;
+            blockObj["name"] = node.block->getName();
+            blocksArray.push_back(blockObj);
+        }
+        planObj["pools"].push_back(poolObj);
+    }
+
+    return planObj.dump();
+}
+
+/***********************************************************************
+ * keep the last plan and only place blocks that are new to the design
+ **********************************************************************/
+void topologyPlaceNewBlocks(Pothos::Topology &topology)
+{
+    auto &_impl = topology._impl;
+
+    //plan the whole design on the first commit or when the request changes
+    if (_impl->placedRequest != _impl->placementRequest or _impl->placedPools.empty())
+    {
+        topologyApplyPlacement(topology, _impl->placementRequest);
+        return;
+    }
+
+    //forget blocks that left the design and count the members per pool
+    std::set<std::string> localUids;
+    std::vector<Pothos::Proxy> newBlocks;
+    for (const auto &obj : getObjSetFromFlowList(_impl->flows))
+    {
+        if (obj.getEnvironment()->getUniquePid() != Pothos::ProxyEnvironment::getLocalUniquePid()) continue;
+        const auto uid = obj.call<std::string>("uid");
+        localUids.insert(uid);
+        if (_impl->placedPools.count(uid) == 0) newBlocks.push_back(obj);
+    }
+    std::vector<std::pair<Pothos::ThreadPool, size_t>> pools;
+    for (auto it = _impl->placedPools.begin(); it != _impl->placedPools.end();)
+    {
+        if (localUids.count(it->first) == 0)
+        {
+            it = _impl->placedPools.erase(it);
+            continue;
+        }
+        auto poolIt = std::find_if(pools.begin(), pools.end(), [&it](const std::pair<Pothos::ThreadPool, size_t> &pair)
+        {
+            return pair.first == it->second;
+        });
+        if (poolIt == pools.end()) pools.emplace_back(it->second, 1);
+        else poolIt->second++;
+        it++;
+    }
+
+    //a design that only has new blocks left is planned again from scratch
+    if (pools.empty())
+    {
+        topologyApplyPlacement(topology, _impl->placementRequest);
+        return;
+    }
+
+    //new blocks join the pool with the fewest members,
+    //until the next replanPlacement() measures their load
+    for (const auto &obj : newBlocks)
+    {
+        auto &pool = *std::min_element(pools.begin(), pools.end(), [](const std::pair<Pothos::ThreadPool, size_t> &a, const std::pair<Pothos::ThreadPool, size_t> &b)
+        {
+            return a.second < b.second;
+        });
+        setPlacedThreadPool(obj.call<Pothos::Block *>("getPointer"), pool.first);
+        _impl->placedPools[obj.call<std::string>("uid")] = pool.first;
+        pool.second++;
+    }
+}
+
+/***********************************************************************
+ * automatic placement API
+ **********************************************************************/
+void Pothos::Topology::setAutoPlacement(const std::string &request)
+{
+    //validate the request so errors are reported at configuration time
+    const auto configObj = json::parse(request.empty()?"{}":request);
+    const std::string mode = configObj.value("mode", "NONE");
+    if (mode != "NONE" and mode != "CPU" and mode != "NUMA") throw Pothos::ThreadPoolError(
+        "Pothos::Topology::setAutoPlacement()", "unknown placement mode " + mode);
+    _impl->placementRequest = (mode == "NONE")?"":request;
+}
+
+static std::string applyPlacementFutureTask(const Pothos::Proxy &proxy, const std::string &request)
+{
+    return proxy.call<std::string>("applyPlacement", request);
+}
+
+std::string Pothos::Topology::replanPlacement(const double sampleTime)
+{
+    if (_impl->placementRequest.empty()) throw Pothos::ThreadPoolError(
+        "Pothos::Topology::replanPlacement()", "automatic placement is not enabled");
+
+    auto configObj = json::parse(_impl->placementRequest);
+    configObj["sampleTime"] = sampleTime;
+    const auto request = configObj.dump();
+
+    //a flattened sub-topology plans for its own local blocks
+    json plansArray(json::array());
+    if (_impl->remoteTopologies.empty())
+    {
+        plansArray.push_back(json::parse(topologyApplyPlacement(*this, request)));
+        return plansArray.dump(4);
+    }
+
+    //measure and plan in all environments at the same time
+    std::vector<std::future<std::string>> futures;
+    for (const auto &pair : _impl->remoteTopologies)
+    {
+        futures.push_back(std::async(std::launch::async, &applyPlacementFutureTask, pair.second, request));
+    }
+    for (auto &future : futures) plansArray.push_back(json::parse(future.get()));
+    return plansArray.dump(4);
+}
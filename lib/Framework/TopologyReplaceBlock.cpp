@@ -0,0 +1,187 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/TopologyImpl.hpp"
+#include "Framework/WorkerActor.hpp"
+#include <Pothos/Framework/Block.hpp>
+#include <Pothos/Framework/Exception.hpp>
+#include <algorithm>
+
+/***********************************************************************
+ * helpers to rewrite flows with the replacement block
+ **********************************************************************/
+static bool flowsHaveBlock(const std::vector<Flow> &flows, const std::string &uid)
+{
+    for (const auto &flow : flows)
+    {
+        if (flow.src.uid == uid or flow.dst.uid == uid) return true;
+    }
+    return false;
+}
+
+static void replaceFlowsBlock(std::vector<Flow> &flows, const std::string &oldUid, const Port &newPort)
+{
+    for (auto &flow : flows)
+    {
+        for (auto port : {&flow.src, &flow.dst})
+        {
+            if (port->uid != oldUid) continue;
+            port->obj = newPort.obj;
+            port->uid = newPort.uid;
+            port->objName = newPort.objName;
+        }
+    }
+}
+
+/***********************************************************************
+ * re-negotiate buffer managers for the ports of the replacement
+ **********************************************************************/
+static bool isCustomBufferMode(const Port &port, const Port &other, const bool isInput)
+{
+    const auto portObj = other.obj.call(isInput?"output":"input", other.name);
+    const std::string otherDomain = portObj.call("domain");
+    const std::string mode = port.obj.get("_actor").call("getBufferMode", port.name, otherDomain, isInput);
+    return mode == "CUSTOM";
+}
+
+static void reinstallBufferManagers(const std::vector<Flow> &oldFlows, const std::vector<Flow> &newFlows, const std::string &newUid)
+{
+    //the moved managers stay in place unless the old or new block provides its own
+    std::vector<Port> srcs;
+    for (size_t i = 0; i < newFlows.size(); i++)
+    {
+        const auto &oldFlow = oldFlows.at(i);
+        const auto &newFlow = newFlows.at(i);
+        bool custom = false;
+        if (newFlow.src.uid == newUid) custom = isCustomBufferMode(oldFlow.src, oldFlow.dst, false) or isCustomBufferMode(newFlow.src, newFlow.dst, false);
+        else if (newFlow.dst.uid == newUid) custom = isCustomBufferMode(oldFlow.dst, oldFlow.src, true) or isCustomBufferMode(newFlow.dst, newFlow.src, true);
+        if (custom and std::find(srcs.begin(), srcs.end(), newFlow.src) == srcs.end()) srcs.push_back(newFlow.src);
+    }
+
+    //install with all of the destinations of each affected source port
+    std::vector<Flow> flows;
+    for (const auto &flow : newFlows)
+    {
+        if (std::find(srcs.begin(), srcs.end(), flow.src) != srcs.end()) flows.push_back(flow);
+    }
+    if (not flows.empty()) installBufferManagers(flows);
+}
+
+/***********************************************************************
+ * hot swap the block inside of an active flattened topology
+ **********************************************************************/
+static void swapActiveBlock(Pothos::Topology::Impl &impl, const Pothos::Proxy &oldBlock, const Pothos::Proxy &newBlock, const std::vector<Flow> &newFlatFlows)
+{
+    auto oldPtr = oldBlock.call<Pothos::Block *>("getPointer");
+    auto newPtr = newBlock.call<Pothos::Block *>("getPointer");
+
+    //the replacement runs where the old block was placed
+    newPtr->setThreadPool(oldPtr->getThreadPool());
+    newPtr->_actor->setActivityMonitor(impl.activityMonitor);
+
+    //move connections, queued data, and buffer managers under the actor locks,
+    //then negotiate buffer modes that differ between the old and new blocks
+    try
+    {
+        oldPtr->_actor->replaceWith(newPtr->_actor.get());
+        reinstallBufferManagers(impl.activeFlatFlows, newFlatFlows, newPtr->uid());
+    }
+    catch (const Pothos::Exception &ex)
+    {
+        newPtr->_actor->setActivityMonitor(std::shared_ptr<ActivityMonitor>());
+        throw Pothos::TopologyConnectError("Pothos::Topology::replaceBlock()", ex);
+    }
+
+    //start the replacement, then retire the old block which is now detached
+    newPtr->_actor->setActiveStateOn();
+    oldPtr->_actor->setActiveStateOff();
+    oldPtr->_actor->setActivityMonitor(std::shared_ptr<ActivityMonitor>());
+}
+
+/***********************************************************************
+ * replace block implementation
+ **********************************************************************/
+void Pothos::Topology::_replaceBlock(const Object &oldBlock, const Object &newBlock)
+{
+    if (not checkObj(oldBlock)) throw Pothos::TopologyConnectError("Pothos::Topology::replaceBlock()",
+        "old block of type " + oldBlock.toString());
+    if (not checkObj(newBlock)) throw Pothos::TopologyConnectError("Pothos::Topology::replaceBlock()",
+        "new block of type " + newBlock.toString());
+
+    const auto oldPort = _impl->makePort(oldBlock, "");
+    const auto newPort = _impl->makePort(newBlock, "");
+    const auto oldConn = getConnectable(oldBlock);
+    const auto newConn = getConnectable(newBlock);
+
+    if (not flowsHaveBlock(_impl->flows, oldPort.uid)) throw Pothos::TopologyConnectError(
+        "Pothos::Topology::replaceBlock()", oldPort.objName + " is not connected in this topology");
+    if (flowsHaveBlock(_impl->flows, newPort.uid)) throw Pothos::TopologyConnectError(
+        "Pothos::Topology::replaceBlock()", newPort.objName + " is already connected in this topology");
+    if (oldConn.getEnvironment()->getUniquePid() != newConn.getEnvironment()->getUniquePid()) throw Pothos::TopologyConnectError(
+        "Pothos::Topology::replaceBlock()", "the replacement must be in the same environment as " + oldPort.objName);
+
+    //only blocks have actors that can be swapped, not topologies
+    try
+    {
+        oldConn.get("_actor");
+        newConn.get("_actor");
+    }
+    catch (const Pothos::Exception &)
+    {
+        throw Pothos::TopologyConnectError("Pothos::Topology::replaceBlock()", "only blocks can be replaced");
+    }
+
+    //validate that the replacement has all of the connected ports
+    std::vector<std::string> ins, outs;
+    for (const auto &flow : _impl->flows)
+    {
+        if (flow.src.uid == oldPort.uid) outs.push_back(flow.src.name);
+        if (flow.dst.uid == oldPort.uid) ins.push_back(flow.dst.name);
+    }
+    for (const auto &name : outs) try{newConn.get("_actor").call("autoAllocateOutput", name);}catch(const Exception &){}
+    for (const auto &name : ins) try{newConn.get("_actor").call("autoAllocateInput", name);}catch(const Exception &){}
+    const std::vector<std::string> newOuts = newConn.call("outputPortNames");
+    const std::vector<std::string> newIns = newConn.call("inputPortNames");
+    for (const auto &name : outs)
+    {
+        if (std::find(newOuts.begin(), newOuts.end(), name) == newOuts.end()) throw Pothos::TopologyConnectError(
+            "Pothos::Topology::replaceBlock()", newPort.objName + " has no output port named " + name);
+    }
+    for (const auto &name : ins)
+    {
+        if (std::find(newIns.begin(), newIns.end(), name) == newIns.end()) throw Pothos::TopologyConnectError(
+            "Pothos::Topology::replaceBlock()", newPort.objName + " has no input port named " + name);
+    }
+
+    //swap the block in the active data flow without a commit
+    if (flowsHaveBlock(_impl->activeFlatFlows, oldPort.uid))
+    {
+        Port newFlatPort = newPort;
+        newFlatPort.obj = newConn;
+        auto newFlatFlows = _impl->activeFlatFlows;
+        replaceFlowsBlock(newFlatFlows, oldPort.uid, newFlatPort);
+
+        //a flattened sub-topology swaps its local blocks directly
+        if (_impl->remoteTopologies.empty()) swapActiveBlock(*_impl, oldConn, newConn, newFlatFlows);
+
+        //otherwise forward to the sub-topology of the block's environment
+        else
+        {
+            const auto upid = oldConn.getEnvironment()->getUniquePid();
+            _impl->remoteTopologies.at(upid).call("replaceBlock", oldConn, newConn);
+        }
+        _impl->activeFlatFlows = newFlatFlows;
+
+        //re-key cached network iogress blocks on the output ports of the old block
+        std::unordered_map<Port, std::pair<Pothos::Proxy, Pothos::Proxy>> newNetgressCache;
+        for (const auto &pair : _impl->srcToNetgressCache)
+        {
+            auto port = pair.first;
+            if (port.uid == oldPort.uid) port.uid = newPort.uid;
+            newNetgressCache[port] = pair.second;
+        }
+        _impl->srcToNetgressCache = newNetgressCache;
+    }
+
+    replaceFlowsBlock(_impl->flows, oldPort.uid, newPort);
+}
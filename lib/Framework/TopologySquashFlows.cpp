@@ -67,6 +67,12 @@ static std::vector<Port> resolvePorts(const Port &port, const bool isSource)
     return ports;
 }
 
+//! Resolve a source port of a block or sub-topology into the flattened block ports
+std::vector<Port> resolveSourcePorts(const Port &port)
+{
+    return resolvePorts(port, true);
+}
+
 /***********************************************************************
  * helpers to deal with recursive topology comprehension - flows
  **********************************************************************/
@@ -1,10 +1,12 @@
-// Copyright (c) 2014-2017 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Framework/TopologyImpl.hpp>
 #include "Framework/TopologyImpl.hpp"
 #include <Pothos/Proxy.hpp>
+#include <Pothos/Managed.hpp>
 #include <future>
+#include <map>
 #include <json.hpp>
 
 using json = nlohmann::json;
@@ -12,20 +14,56 @@ using json = nlohmann::json;
 /***********************************************************************
  * create JSON stats object
  **********************************************************************/
-static json queryWorkStats(const Pothos::Proxy &block)
+static bool hasQueryJSONStats(const Pothos::Object &obj)
 {
-    //try recursive traversal
     try
     {
-        return json::parse(block.call<std::string>("queryJSONStats"));
+        return Pothos::ManagedClass::lookup(obj.type()).hasMethod("queryJSONStats");
+    }
+    catch (const Pothos::Exception &)
+    {
+        return false;
     }
-    catch (const std::exception &) {}
+}
+
+std::string queryBlockStatsJSON(const Pothos::Object &obj)
+{
+    const auto block = Pothos::ProxyEnvironment::make("managed")->convertObjectToProxy(obj);
+
+    //recursive traversal for topologies
+    if (hasQueryJSONStats(obj)) return block.call<std::string>("queryJSONStats");
 
-    //otherwise, regular block, query stats
-    auto actor = block.get("_actor");
-    auto workStats = json::parse(actor.call<std::string>("queryWorkStats"));
+    //otherwise, regular block, query stats and key it with the UID
     json topStats;
-    topStats[block.call<std::string>("uid")] = workStats;
+    topStats[block.call<std::string>("uid")] = json::parse(block.get("_actor").call<std::string>("queryWorkStats"));
+    return topStats.dump();
+}
+
+static json queryWorkStats(const Pothos::Proxy &block)
+{
+    return json::parse(queryBlockStatsJSON(block.toObject()));
+}
+
+static json queryRemoteWorkStats(const Pothos::ProxyEnvironment::Sptr &env, const std::vector<Pothos::Proxy> &blocks)
+{
+    //query all blocks of a remote environment with a single batch
+    const auto topologyClass = env->findProxy("Pothos/Topology");
+    std::vector<Pothos::ProxyBatchCall> calls;
+    for (const auto &block : blocks)
+    {
+        calls.emplace_back(topologyClass, "queryBlockStats", Pothos::ObjectVector{Pothos::Object(block)});
+        calls.back().toLocal = true;
+    }
+
+    json topStats;
+    for (auto &result : env->callBatch(calls))
+    {
+        const auto subStats = json::parse(result.get().convert<std::string>());
+        for (auto it = subStats.begin(); it != subStats.end(); ++it)
+        {
+            topStats[it.key()] = it.value();
+        }
+    }
     return topStats;
 }
 
@@ -33,11 +71,26 @@ std::string Pothos::Topology::queryJSONStats(void)
 {
     json stats;
 
-    //query each block's work stats and key it with the UID
+    //query local blocks in parallel, and group remote blocks by environment
     std::vector<std::shared_future<json>> results;
+    std::map<std::string, std::pair<Pothos::ProxyEnvironment::Sptr, std::vector<Pothos::Proxy>>> envToBlocks;
     for (const auto &block : getObjSetFromFlowList(_impl->flows))
     {
-        results.push_back(std::async(std::launch::async, queryWorkStats, block));
+        const auto env = block.getEnvironment();
+        if (env->getUniquePid() == Pothos::ProxyEnvironment::getLocalUniquePid())
+        {
+            results.push_back(std::async(std::launch::async, &queryWorkStats, block));
+            continue;
+        }
+        auto &entry = envToBlocks[env->getUniquePid()];
+        entry.first = env;
+        entry.second.push_back(block);
+    }
+
+    //query each remote environment's work stats with one batch
+    for (const auto &pair : envToBlocks)
+    {
+        results.push_back(std::async(std::launch::async, &queryRemoteWorkStats, pair.second.first, pair.second.second));
     }
 
     //wait on the futures and record to the object
@@ -9,6 +9,8 @@
 #include <Poco/Logger.h>
 #include <cassert>
 #include <algorithm> //min/max
+#include <functional>
+#include <memory>
 #include <json.hpp>
 
 using json = nlohmann::json;
@@ -75,8 +77,11 @@ Pothos::BufferManager::Sptr Pothos::WorkerActor::getBufferManagerNoLock(const st
 
     //try to get the manager and make one if its null
     if (not m) m = isInput? block->getInputBufferManager(name, domain) : block->getOutputBufferManager(name, domain);
-    if (not m) m = BufferManager::make("generic", BufferManagerArgs());
-    else if (not m->isInitialized()) m->init(BufferManagerArgs()); //TODO pass this in from somewhere
+    //allocate buffers local to the NUMA node of the block's thread pool
+    BufferManagerArgs args;
+    args.nodeAffinity = this->bufferNodeAffinity;
+    if (not m) m = BufferManager::make("generic", args);
+    else if (not m->isInitialized()) m->init(args);
 
     //store the new buffer manager to the cache
     weakMgr = m;
@@ -173,6 +178,118 @@ void Pothos::WorkerActor::subscribeOutput(const std::string &action, const std::
     this->updatePorts();
 }
 
+/***********************************************************************
+ * hot swap the connections of this actor to a replacement
+ **********************************************************************/
+void Pothos::WorkerActor::replaceWith(Pothos::WorkerActor *replacement)
+{
+    //gather the neighboring actors through the port subscriber lists
+    std::vector<ActorInterface *> actors({this, replacement});
+    for (const auto &entry : this->inputs) for (auto port : entry.second->_subscribers) actors.push_back(port->_actor);
+    for (const auto &entry : this->outputs) for (auto port : entry.second->_subscribers) actors.push_back(port->_actor);
+    std::sort(actors.begin(), actors.end());
+    actors.erase(std::unique(actors.begin(), actors.end()), actors.end());
+
+    //lock all actors in address order so that no work or external call
+    //can touch the ports until all connections have been moved over
+    std::vector<std::unique_ptr<ActorInterfaceLock>> locks;
+    for (auto actor : actors) locks.emplace_back(new ActorInterfaceLock(actor));
+
+    //check compatibility of the replacement ports before making any changes
+    const auto newName = replacement->block->getName();
+    if (replacement->activeState) throw PortAccessError("Pothos::WorkerActor::replaceWith()",
+        Poco::format("replacement %s is already active", newName));
+    for (const auto &entry : this->inputs)
+    {
+        const auto &port = *entry.second;
+        if (port._subscribers.empty()) continue;
+        const auto it = replacement->inputs.find(entry.first);
+        if (it == replacement->inputs.end()) throw PortAccessError("Pothos::WorkerActor::replaceWith()",
+            Poco::format("replacement %s has no input port %s", newName, entry.first));
+        const auto &newPort = *it->second;
+        if (not newPort._subscribers.empty() or newPort.isSlot() != port.isSlot() or
+            newPort.dtype().size() != port.dtype().size() or newPort.domain() != port.domain())
+            throw PortAccessError("Pothos::WorkerActor::replaceWith()",
+            Poco::format("replacement %s input port %s is not compatible", newName, entry.first));
+    }
+    for (const auto &entry : this->outputs)
+    {
+        const auto &port = *entry.second;
+        if (port._subscribers.empty()) continue;
+        const auto it = replacement->outputs.find(entry.first);
+        if (it == replacement->outputs.end()) throw PortAccessError("Pothos::WorkerActor::replaceWith()",
+            Poco::format("replacement %s has no output port %s", newName, entry.first));
+        const auto &newPort = *it->second;
+        if (not newPort._subscribers.empty() or newPort.isSignal() != port.isSignal() or
+            newPort.dtype().size() != port.dtype().size() or newPort.domain() != port.domain())
+            throw PortAccessError("Pothos::WorkerActor::replaceWith()",
+            Poco::format("replacement %s output port %s is not compatible", newName, entry.first));
+    }
+
+    //move input subscriptions and the enqueued buffers, labels, and messages
+    for (const auto &entry : this->inputs)
+    {
+        auto &port = *entry.second;
+        if (port._subscribers.empty()) continue;
+        auto &newPort = *replacement->inputs.at(entry.first);
+        for (auto upstream : port._subscribers)
+        {
+            std::replace(upstream->_subscribers.begin(), upstream->_subscribers.end(), &port, &newPort);
+        }
+        std::swap(port._subscribers, newPort._subscribers);
+        {
+            std::lock_guard<Util::SpinLock> lock0(port._bufferAccumulatorLock);
+            std::lock_guard<Util::SpinLock> lock1(newPort._bufferAccumulatorLock);
+            std::swap(port._bufferAccumulator, newPort._bufferAccumulator);
+            std::swap(port._inputInlineMessages, newPort._inputInlineMessages);
+            std::swap(port._inlineMessages, newPort._inlineMessages);
+        }
+        {
+            std::lock_guard<Util::SpinLock> lock0(port._asyncMessagesLock);
+            std::lock_guard<Util::SpinLock> lock1(newPort._asyncMessagesLock);
+            std::swap(port._asyncMessages, newPort._asyncMessages);
+        }
+        {
+            std::lock_guard<Util::SpinLock> lock0(port._slotCallsLock);
+            std::lock_guard<Util::SpinLock> lock1(newPort._slotCallsLock);
+            std::swap(port._slotCalls, newPort._slotCalls);
+        }
+        this->bufferManagerTmpCache[true].erase(entry.first);
+    }
+
+    //move output subscriptions and the ownership of the buffer managers,
+    //buffers and message tokens in flight are returned to the replacement
+    for (const auto &entry : this->outputs)
+    {
+        auto &port = *entry.second;
+        if (port._subscribers.empty()) continue;
+        auto &newPort = *replacement->outputs.at(entry.first);
+        for (auto downstream : port._subscribers)
+        {
+            std::replace(downstream->_subscribers.begin(), downstream->_subscribers.end(), &port, &newPort);
+        }
+        std::swap(port._subscribers, newPort._subscribers);
+        newPort.bufferManagerSetup(port._bufferManager);
+        {
+            std::lock_guard<Util::SpinLock> lock0(port._tokenManagerLock);
+            std::lock_guard<Util::SpinLock> lock1(newPort._tokenManagerLock);
+            std::swap(port._tokenManager, newPort._tokenManager);
+        }
+        //the neighbor locks hold off downstream work, so no buffer returns race the rebinding
+        for (auto p : {&port, &newPort}) p->_tokenManager->setCallback(std::bind(
+            &Pothos::OutputPort::bufferManagerPush, p, &p->_tokenManagerLock, std::placeholders::_1));
+
+        //the old block keeps a local buffer manager for any output on deactivate
+        this->bufferManagerTmpCache[false].erase(entry.first);
+        this->bufferManagerCache[false].erase(entry.first);
+        port.bufferManagerSetup(BufferManager::Sptr());
+        this->ensureOutputBufferManagerNoLock(entry.first);
+    }
+
+    this->updatePorts();
+    replacement->updatePorts();
+}
+
 /***********************************************************************
  * activate/deactivate
  **********************************************************************/
@@ -191,7 +308,7 @@ void Pothos::WorkerActor::setActiveStateOn(void)
     {
         this->activeState = true;
         this->block->activate();
-        this->activityIndicator.fetch_add(1, std::memory_order_relaxed);
+        this->bumpActivity(std::chrono::high_resolution_clock::now());
     }
     POTHOS_EXCEPTION_CATCH(const Exception &ex)
     {
@@ -209,7 +326,17 @@ void Pothos::WorkerActor::setActiveStateOff(void)
 
     this->activeState = false;
     this->block->deactivate();
-    this->activityIndicator.fetch_add(1, std::memory_order_relaxed);
+    this->bumpActivity(std::chrono::high_resolution_clock::now());
+}
+
+void Pothos::WorkerActor::setActivityMonitor(const std::shared_ptr<ActivityMonitor> &monitor)
+{
+    ActorInterfaceLock lock(this);
+    if (this->activityMonitor == monitor) return;
+    if (this->activityMonitor) this->activityMonitor->detach(this->activitySlot);
+    this->activitySlot.reset();
+    this->activityMonitor = monitor;
+    if (this->activityMonitor) this->activitySlot = this->activityMonitor->attach();
 }
 
 /***********************************************************************
@@ -274,7 +401,7 @@ void Pothos::WorkerActor::handleSlotCalls(InputPort &port)
 
             block->opaqueCallHandler(port.name(), args.data(), args.size());
             this->flagInternalChange();
-            this->activityIndicator.fetch_add(1, std::memory_order_relaxed);
+            this->bumpActivity(std::chrono::high_resolution_clock::now());
         }
         POTHOS_EXCEPTION_CATCH(const Exception &ex)
         {
@@ -448,8 +575,8 @@ void Pothos::WorkerActor::postWorkTasks(void)
     if (inputWorkEvents != 0)
     {
         this->flagInternalChange();
-        this->activityIndicator.fetch_add(1, std::memory_order_relaxed);
         this->timeLastConsumed = std::chrono::high_resolution_clock::now();
+        this->bumpActivity(this->timeLastConsumed);
     }
 
     ///////////////////// output handling ////////////////////////
@@ -532,8 +659,8 @@ void Pothos::WorkerActor::postWorkTasks(void)
     if (outputWorkEvents != 0)
     {
         this->flagInternalChange();
-        this->activityIndicator.fetch_add(1, std::memory_order_relaxed);
         this->timeLastProduced = std::chrono::high_resolution_clock::now();
+        this->bumpActivity(this->timeLastProduced);
     }
 }
 
@@ -636,5 +763,6 @@ static auto managedWorkerActor = Pothos::ManagedClass()
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::WorkerActor, autoDeleteInput))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::WorkerActor, autoDeleteOutput))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::WorkerActor, queryActivityIndicator))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::WorkerActor, setActivityMonitor))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::WorkerActor, queryWorkStats))
     .commit("Pothos/WorkerActor");
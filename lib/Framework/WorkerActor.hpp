@@ -1,8 +1,9 @@
-// Copyright (c) 2014-2017 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
 #include "Framework/ActorInterface.hpp"
+#include "Framework/ActivityMonitor.hpp"
 #include <Pothos/Framework/BlockImpl.hpp>
 #include <Pothos/Framework/Exception.hpp>
 #include <Poco/Format.h>
@@ -21,6 +22,7 @@ public:
         block(block),
         activeState(false),
         activityIndicator(0),
+        bufferNodeAffinity(-1),
         numTaskCalls(0),
         numWorkCalls(0)
     {
@@ -53,6 +55,23 @@ public:
         return this->activityIndicator;
     }
 
+    /*!
+     * Mark that activity occurred: bump the activity indicator,
+     * and notify the topology's activity monitor when installed.
+     */
+    void bumpActivity(const std::chrono::high_resolution_clock::time_point &now)
+    {
+        this->activityIndicator.fetch_add(1, std::memory_order_relaxed);
+        if (this->activitySlot) this->activitySlot->bump(now);
+    }
+
+    /*!
+     * Install the activity monitor of the topology that activates this block.
+     * The topology uses the monitor to implement waitInactive() without polling.
+     * Set an empty monitor to detach the actor from the topology.
+     */
+    void setActivityMonitor(const std::shared_ptr<ActivityMonitor> &monitor);
+
     /*!
      * Query the work stats as a JSON object.
      * This call blocks the work thread context.
@@ -65,6 +84,9 @@ public:
     Block *block;
     bool activeState;
     std::atomic<int> activityIndicator;
+    std::shared_ptr<ActivityMonitor> activityMonitor;
+    std::shared_ptr<ActivityMonitor::Slot> activitySlot; //this actor's counters in the monitor
+    std::atomic<long> bufferNodeAffinity; //NUMA node of the thread pool or -1
     std::set<std::string> automaticSlots;
     std::map<std::string, std::unique_ptr<InputPort>> inputs;
     std::map<std::string, std::unique_ptr<OutputPort>> outputs;
@@ -111,6 +133,7 @@ public:
     void setActiveStateOff(void);
     void subscribeInput(const std::string &action, const std::string &myPortName, InputPort *subscriberPort);
     void subscribeOutput(const std::string &action, const std::string &myPortName, OutputPort *subscriberPort);
+    void replaceWith(WorkerActor *replacement);
     std::string getBufferMode(const std::string &name, const std::string &domain, const bool isInput);
     BufferManager::Sptr getBufferManager(const std::string &name, const std::string &domain, const bool isInput);
     BufferManager::Sptr getBufferManagerNoLock(const std::string &name, const std::string &domain, const bool isInput);
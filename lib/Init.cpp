@@ -1,10 +1,11 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Init.hpp>
 #include <Pothos/Exception.hpp>
 #include <Pothos/System/Paths.hpp>
 #include <Pothos/Plugin.hpp>
+#include <Pothos/Remote/EnvironmentPool.hpp>
 #include <Poco/Path.h>
 #include <Poco/File.h>
 #include <Poco/Format.h>
@@ -12,6 +13,9 @@
 //from lib/Framework/ConfLoader.cpp
 std::vector<Pothos::PluginPath> Pothos_ConfLoader_loadConfFiles(void);
 
+//from lib/Plugin/ModuleIndex.cpp
+void lazyModuleClear(void);
+
 /***********************************************************************
  * Singleton for initialization once per process
  **********************************************************************/
@@ -47,11 +51,15 @@ void Pothos::InitSingleton::load(void)
 
 void Pothos::InitSingleton::unload(void)
 {
+    //disconnect pooled environments before their plugins and loggers go away
+    Pothos::RemoteEnvironmentPool::clear();
+
     for (const auto &path : confLoadedPaths)
     {
         Pothos::PluginRegistry::remove(path);
     }
     confLoadedPaths.clear();
+    lazyModuleClear();
     modules.clear();
 }
 
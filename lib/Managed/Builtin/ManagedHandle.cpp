@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2016 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "ManagedProxy.hpp"
@@ -6,9 +6,76 @@
 #include <Pothos/Object.hpp>
 #include <Pothos/Util/TypeInfo.hpp>
 #include <Poco/Format.h>
+#include <Pothos/Util/SpinLockRW.hpp>
+#include <unordered_map>
+#include <functional> //std::hash
+#include <mutex>
 #include <cassert>
 #include <iostream>
 
+/***********************************************************************
+ * Call-site dispatch cache: the resolved call for a class, call name,
+ * and argument type signature. Lookups take a shared lock, and the
+ * cache is cleared when classes are registered or unloaded,
+ * so that no entry outlives the module that registered the call.
+ **********************************************************************/
+enum DispatchKind {DISPATCH_CONSTRUCTOR, DISPATCH_STATIC_METHOD, DISPATCH_METHOD};
+
+struct DispatchKey
+{
+    const std::type_info *classType; //held type for methods, class type otherwise
+    DispatchKind kind;
+    std::string name;
+    std::vector<const std::type_info *> argTypes;
+};
+
+inline bool operator==(const DispatchKey &lhs, const DispatchKey &rhs)
+{
+    return lhs.classType == rhs.classType and lhs.kind == rhs.kind and
+        lhs.name == rhs.name and lhs.argTypes == rhs.argTypes;
+}
+
+struct DispatchKeyHash
+{
+    size_t operator()(const DispatchKey &key) const
+    {
+        size_t h = std::hash<const void *>()(key.classType) ^ (std::hash<std::string>()(key.name) << 1) ^ size_t(key.kind);
+        for (const auto *type : key.argTypes) h = (h * 31) ^ std::hash<const void *>()(type);
+        return h;
+    }
+};
+
+struct DispatchEntry
+{
+    Pothos::ManagedClass cls;
+    Pothos::Callable call;
+    bool doOpaqueCall;
+    bool doWildcardCall;
+};
+
+//! Bound the cache size, processes with many call sites start over
+static const size_t MAX_DISPATCH_CACHE_ENTRIES = 4096;
+
+typedef std::unordered_map<DispatchKey, DispatchEntry, DispatchKeyHash> DispatchCache;
+
+static Pothos::Util::SpinLockRW &getDispatchCacheMutex(void)
+{
+    static Pothos::Util::SpinLockRW lock;
+    return lock;
+}
+
+static DispatchCache &getDispatchCache(void)
+{
+    static DispatchCache cache;
+    return cache;
+}
+
+void clearManagedDispatchCache(void)
+{
+    std::lock_guard<Pothos::Util::SpinLockRW> lock(getDispatchCacheMutex());
+    getDispatchCache().clear();
+}
+
 ManagedProxyHandle::ManagedProxyHandle(std::shared_ptr<ManagedProxyEnvironment> env, const Pothos::Object &obj):
     env(env), obj(obj)
 {
@@ -35,145 +102,181 @@ Pothos::Proxy ManagedProxyHandle::call(const std::string &name, const Pothos::Pr
     const bool callMethod = not isManagedClass;
 
     /*******************************************************************
-     * Step 1) locate the managed class for the held object
+     * Step 0) convert the arguments and check the dispatch cache
      ******************************************************************/
     Pothos::ManagedClass cls;
     if (isManagedClass) cls = obj.extract<Pothos::ManagedClass>();
-    else
+
+    std::vector<Pothos::Object> argObjs;
+    argObjs.reserve(numArgs+1);
+    if (callMethod) argObjs.emplace_back(); //filled with the instance below
+
+    std::vector<Pothos::Proxy> localArgs(numArgs);
+    DispatchKey key;
+    key.classType = isManagedClass?&cls.type():&obj.type();
+    key.kind = callConstructor?DISPATCH_CONSTRUCTOR:(callStaticMethod?DISPATCH_STATIC_METHOD:DISPATCH_METHOD);
+    key.name = name;
+    key.argTypes.reserve(numArgs);
+
+    //iterate through the other objects in args
+    for (size_t i = 0; i < numArgs; i++)
     {
         try
         {
-            cls = Pothos::ManagedClass::lookup(obj.type());
+            auto handle = env->getHandle(args[i]);
+            argObjs.push_back(handle->obj);
+            key.argTypes.push_back(&handle->obj.type());
+            localArgs[i] = std::static_pointer_cast<Pothos::ProxyHandle>(handle);
         }
-        catch(const Pothos::ManagedClassLookupError &)
+        catch(const Pothos::Exception &ex)
         {
-            if (callMethod) throw;
+            throw Pothos::ProxyHandleCallError(
+                "ManagedProxyHandle::call("+name+")",
+                Poco::format("convert arg %z - %s", i, ex.displayText()));
         }
     }
 
-    /*******************************************************************
-     * Step 2) extract the list of calls
-     ******************************************************************/
-    std::vector<Pothos::Callable> calls;
-    Pothos::Callable opaqueCall;
-    Pothos::Callable wildcardCall;
-
-    if (callConstructor)
-    {
-        calls = cls.getConstructors();
-        opaqueCall = cls.getOpaqueConstructor();
-    }
-    else if (callStaticMethod)
+    Pothos::Callable call;
+    bool doOpaqueCall = false;
+    bool doWildcardCall = false;
+    bool cacheHit = false;
     {
-        try {calls = cls.getStaticMethods(name);}
-        catch (const Pothos::ManagedClassNameError &){}
-        try {opaqueCall = cls.getOpaqueStaticMethod(name);}
-        catch (const Pothos::ManagedClassNameError &){}
-        wildcardCall = cls.getWildcardStaticMethod();
+        Pothos::Util::SpinLockRW::SharedLock lock(getDispatchCacheMutex());
+        const auto it = getDispatchCache().find(key);
+        if (it != getDispatchCache().end())
+        {
+            cacheHit = true;
+            cls = it->second.cls;
+            call = it->second.call;
+            doOpaqueCall = it->second.doOpaqueCall;
+            doWildcardCall = it->second.doWildcardCall;
+        }
     }
-    else if (callMethod)
+
+    /*******************************************************************
+     * Step 1) locate the managed class for the held object
+     ******************************************************************/
+    if (not cacheHit and not isManagedClass)
     {
-        try {calls = cls.getMethods(name);}
-        catch (const Pothos::ManagedClassNameError &){}
-        try {opaqueCall = cls.getOpaqueMethod(name);}
-        catch (const Pothos::ManagedClassNameError &){}
-        wildcardCall = cls.getWildcardMethod();
+        try
+        {
+            cls = Pothos::ManagedClass::lookup(obj.type());
+        }
+        catch(const Pothos::ManagedClassLookupError &)
+        {
+            if (callMethod) throw;
+        }
     }
 
     /*******************************************************************
-     * Step 3) create an argument list
+     * Step 2) create an argument list
      ******************************************************************/
-    std::vector<Pothos::Object> argObjs;
 
     //class method, insert this handle as an instance
     if (callMethod)
     {
         if (this->obj.type() == cls.type())
         {
-            argObjs.push_back(this->obj);
+            argObjs.front() = this->obj;
         }
         else if (this->obj.type() == cls.sharedType())
         {
             const auto &toWrapper = cls.getSharedToWrapper();
-            argObjs.push_back(toWrapper.opaqueCall(&(this->obj), 1));
+            argObjs.front() = toWrapper.opaqueCall(&(this->obj), 1);
         }
         else if (this->obj.type() == cls.pointerType())
         {
             const auto &toWrapper = cls.getPointerToWrapper();
-            argObjs.push_back(toWrapper.opaqueCall(&(this->obj), 1));
+            argObjs.front() = toWrapper.opaqueCall(&(this->obj), 1);
         }
-        assert(not argObjs.empty());
+        assert(argObjs.front());
     }
 
-    //iterate through the other objects in args
-    std::vector<Pothos::Proxy> localArgs(numArgs);
-    for (size_t i = 0; i < numArgs; i++)
+    /*******************************************************************
+     * Step 3) extract the list of calls and find the best match
+     ******************************************************************/
+    if (not cacheHit)
     {
-        try
+        const std::vector<Pothos::Callable> *calls = nullptr;
+        Pothos::Callable opaqueCall;
+        Pothos::Callable wildcardCall;
+
+        //missing names are checked up-front rather than caught as exceptions
+        if (callConstructor)
         {
-            auto handle = env->getHandle(args[i]);
-            argObjs.push_back(handle->obj);
-            localArgs[i] = std::static_pointer_cast<Pothos::ProxyHandle>(handle);
+            calls = &cls.getConstructors();
+            opaqueCall = cls.getOpaqueConstructor();
         }
-        catch(const Pothos::Exception &ex)
+        else if (callStaticMethod)
         {
-            throw Pothos::ProxyHandleCallError(
-                "ManagedProxyHandle::call("+name+")",
-                Poco::format("convert arg %z - %s", i, ex.displayText()));
+            if (cls.hasStaticMethod(name)) calls = &cls.getStaticMethods(name);
+            if (cls.hasOpaqueStaticMethod(name)) opaqueCall = cls.getOpaqueStaticMethod(name);
+            wildcardCall = cls.getWildcardStaticMethod();
+        }
+        else if (callMethod)
+        {
+            if (cls.hasMethod(name)) calls = &cls.getMethods(name);
+            if (cls.hasOpaqueMethod(name)) opaqueCall = cls.getOpaqueMethod(name);
+            wildcardCall = cls.getWildcardMethod();
         }
-    }
-
-    if (callMethod) assert(not argObjs.empty());
 
-    /*******************************************************************
-     * Step 3) find the best match for the call
-     ******************************************************************/
-    Pothos::Callable call;
-    bool doOpaqueCall = false;
-    bool doWildcardCall = false;
-    for (const auto &c : calls)
-    {
-        if (c.getNumArgs() != argObjs.size()) goto failMatch;
-        for (size_t a = 0; a < c.getNumArgs(); a++)
+        if (calls != nullptr) for (const auto &c : *calls)
         {
-            if (not argObjs[a].canConvert(c.type(a))) goto failMatch;
+            if (c.getNumArgs() != argObjs.size()) goto failMatch;
+            for (size_t a = 0; a < c.getNumArgs(); a++)
+            {
+                if (not argObjs[a].canConvert(c.type(a))) goto failMatch;
+            }
+            call = c;
+            failMatch: continue;
+        }
+        if (not call and opaqueCall)
+        {
+            doOpaqueCall = true;
+            call = opaqueCall;
+        }
+        if (not call and wildcardCall)
+        {
+            doWildcardCall = true;
+            call = wildcardCall;
         }
-        call = c;
-        failMatch: continue;
-    }
-    if (not call and opaqueCall)
-    {
-        doOpaqueCall = true;
-        call = opaqueCall;
-    }
-    if (not call and wildcardCall)
-    {
-        doWildcardCall = true;
-        call = wildcardCall;
-    }
 
-    //attempt to make the call on a base class
-    //always try to call the base class first if there is a wildcard handler
-    if (callMethod and (not call or wildcardCall))
-    {
-        for (const auto &toBase : cls.getBaseClassConverters())
+        //attempt to make the call on a base class
+        //always try to call the base class first if there is a wildcard handler
+        if (callMethod and (not call or wildcardCall))
         {
-            try
+            for (const auto &toBase : cls.getBaseClassConverters())
             {
-                return env->makeHandle(toBase.opaqueCall(&argObjs.at(0), 1)).getHandle()->call(name, localArgs.data(), localArgs.size());
+                try
+                {
+                    return env->makeHandle(toBase.opaqueCall(&argObjs.at(0), 1)).getHandle()->call(name, localArgs.data(), localArgs.size());
+                }
+                catch (const Pothos::ProxyHandleCallError &) {}
             }
-            catch (const Pothos::ProxyHandleCallError &) {}
         }
-    }
 
-    //searching base classes failed, so we can error out this way if calls are empty
-    if (calls.empty() and not opaqueCall and not wildcardCall)
-    {
-        throw Pothos::ProxyHandleCallError("ManagedProxyHandle::call("+name+")", "no available calls :" + obj.toString());
-    }
+        //searching base classes failed, so we can error out this way if calls are empty
+        if ((calls == nullptr or calls->empty()) and not opaqueCall and not wildcardCall)
+        {
+            throw Pothos::ProxyHandleCallError("ManagedProxyHandle::call("+name+")", "no available calls :" + obj.toString());
+        }
+
+        //otherwise just assume there was no possible match for the given args
+        if (not call) throw Pothos::ProxyHandleCallError("ManagedProxyHandle::call("+name+")", "method match failed");
 
-    //otherwise just assume there was no possible match for the given args
-    if (not call) throw Pothos::ProxyHandleCallError("ManagedProxyHandle::call("+name+")", "method match failed");
+        //cache the resolved call, unless the base classes are searched on every call
+        if (not (callMethod and wildcardCall and not cls.getBaseClassConverters().empty()))
+        {
+            std::lock_guard<Pothos::Util::SpinLockRW> lock(getDispatchCacheMutex());
+            auto &cache = getDispatchCache();
+            if (cache.size() >= MAX_DISPATCH_CACHE_ENTRIES) cache.clear();
+            DispatchEntry &entry = cache[key];
+            entry.cls = cls;
+            entry.call = call;
+            entry.doOpaqueCall = doOpaqueCall;
+            entry.doWildcardCall = doWildcardCall;
+        }
+    }
 
     /*******************************************************************
      * Step 4) make the call
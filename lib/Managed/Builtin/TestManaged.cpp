@@ -62,3 +62,45 @@ POTHOS_TEST_BLOCK("/proxy/managed/tests", test_containers)
     POTHOS_TEST_NOT_EQUAL(find1, resultDict.end());
     POTHOS_TEST_EQUAL(find1->second.convert<int>(), 2);
 }
+
+struct DispatchTester
+{
+    int echo(const int x){return x;}
+    std::string echo(const std::string &x){return x+"!";}
+};
+
+static int dispatchVersion1(DispatchTester &){return 1;}
+static int dispatchVersion2(DispatchTester &){return 2;}
+
+POTHOS_TEST_BLOCK("/proxy/managed/tests", test_dispatch_cache)
+{
+    Pothos::ManagedClass()
+        .registerConstructor<DispatchTester>()
+        .registerMethod<int, DispatchTester, const int>(POTHOS_FCN_TUPLE(DispatchTester, echo))
+        .registerMethod<std::string, DispatchTester, const std::string &>(POTHOS_FCN_TUPLE(DispatchTester, echo))
+        .registerMethod("version", &dispatchVersion1)
+        .commit("DispatchTester");
+
+    auto env = Pothos::ProxyEnvironment::make("managed");
+    auto tester = env->findProxy("DispatchTester")();
+
+    //repeated calls alternate between overloads by argument type
+    for (int i = 0; i < 3; i++)
+    {
+        POTHOS_TEST_EQUAL(tester.call<int>("echo", i), i);
+        POTHOS_TEST_EQUAL(tester.call<std::string>("echo", "hi"), "hi!");
+        POTHOS_TEST_EQUAL(tester.call<int>("version"), 1);
+    }
+    POTHOS_TEST_THROWS(tester.call("noSuchMethod"), Pothos::ProxyHandleCallError);
+
+    //re-registration replaces the cached resolution
+    Pothos::ManagedClass::unload("DispatchTester");
+    Pothos::ManagedClass()
+        .registerConstructor<DispatchTester>()
+        .registerMethod("version", &dispatchVersion2)
+        .commit("DispatchTester");
+    POTHOS_TEST_EQUAL(tester.call<int>("version"), 2);
+    POTHOS_TEST_THROWS(tester.call("echo", 1), Pothos::ProxyHandleCallError);
+
+    Pothos::ManagedClass::unload("DispatchTester");
+}
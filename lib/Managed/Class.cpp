@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2014 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Plugin.hpp>
@@ -205,6 +205,8 @@ static std::string typeToPluginPath(const std::type_info &type)
 
 Pothos::ManagedClass &Pothos::ManagedClass::commit(const std::string &classPath)
 {
+    PluginProfile::Scope profile("managed", classPath);
+
     //register conversions for constructors that take one argument
     for (const auto &constructor : this->getConstructors())
     {
@@ -269,6 +271,26 @@ const std::vector<Pothos::Callable> &Pothos::ManagedClass::getConstructors(void)
     return _impl->constructors;
 }
 
+bool Pothos::ManagedClass::hasStaticMethod(const std::string &name) const
+{
+    return _impl->staticMethods.count(name) != 0;
+}
+
+bool Pothos::ManagedClass::hasMethod(const std::string &name) const
+{
+    return _impl->methods.count(name) != 0;
+}
+
+bool Pothos::ManagedClass::hasOpaqueStaticMethod(const std::string &name) const
+{
+    return _impl->opaqueStaticMethods.count(name) != 0;
+}
+
+bool Pothos::ManagedClass::hasOpaqueMethod(const std::string &name) const
+{
+    return _impl->opaqueMethods.count(name) != 0;
+}
+
 const std::vector<Pothos::Callable> &Pothos::ManagedClass::getStaticMethods(const std::string &name) const
 {
     auto it = _impl->staticMethods.find(name);
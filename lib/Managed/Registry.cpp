@@ -1,32 +1,16 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "Object/TypeMetadata.hpp"
 #include <Pothos/Managed/Class.hpp>
 #include <Pothos/Managed/Exception.hpp>
-#include <Pothos/Util/SpinLockRW.hpp>
 #include <Pothos/Util/TypeInfo.hpp>
 #include <Pothos/Callable.hpp>
 #include <Pothos/Plugin.hpp>
 #include <Poco/Logger.h>
-#include <mutex>
-#include <map>
 
-/***********************************************************************
- * Global map structure for registry
- **********************************************************************/
-static Pothos::Util::SpinLockRW &getMapMutex(void)
-{
-    static Pothos::Util::SpinLockRW lock;
-    return lock;
-}
-
-//singleton global map for all supported classes
-typedef std::map<size_t, Pothos::Plugin> ClassMapType;
-static ClassMapType &getClassMap(void)
-{
-    static ClassMapType map;
-    return map;
-}
+//! Cached call resolutions are dropped when the set of classes changes
+void clearManagedDispatchCache(void);
 
 /***********************************************************************
  * Conversion registration handling
@@ -40,19 +24,16 @@ static void handlePluginEvent(const Pothos::Plugin &plugin, const std::string &e
         if (plugin.getObject().type() != typeid(Pothos::ManagedClass)) return;
         const auto &reg = plugin.getObject().extract<Pothos::ManagedClass>();
 
-        std::lock_guard<Pothos::Util::SpinLockRW> lock(getMapMutex());
-        if (event == "add")
-        {
-            getClassMap()[reg.type().hash_code()] = plugin;
-            getClassMap()[reg.pointerType().hash_code()] = plugin;
-            getClassMap()[reg.sharedType().hash_code()] = plugin;
-        }
-        if (event == "remove")
+        //the class is found by its type, pointer type, and shared type
+        if (event == "add" or event == "remove")
         {
-            getClassMap()[reg.type().hash_code()] = Pothos::Plugin();
-            getClassMap()[reg.pointerType().hash_code()] = Pothos::Plugin();
-            getClassMap()[reg.sharedType().hash_code()] = Pothos::Plugin();
+            const auto managedClass = (event == "add")?plugin:Pothos::Plugin();
+            const auto update = [&managedClass](TypeMetadata &m){m.managedClass = managedClass;};
+            updateTypeMetadata(reg.type(), update);
+            updateTypeMetadata(reg.pointerType(), update);
+            updateTypeMetadata(reg.sharedType(), update);
         }
+        clearManagedDispatchCache();
     }
     POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
     {
@@ -74,15 +55,14 @@ pothos_static_block(pothosManagedClassRegister)
  **********************************************************************/
 Pothos::ManagedClass Pothos::ManagedClass::lookup(const std::type_info &type)
 {
-    //find the plugin in the map, it will be null if not found
-    Pothos::Util::SpinLockRW::SharedLock lock(getMapMutex());
-    auto it = getClassMap().find(type.hash_code());
+    //find the plugin in the type metadata, it will be null if not found
+    const auto metadata = lookupTypeMetadata(type.hash_code());
 
     //thow an error when the entry is not found
-    if (it == getClassMap().end()) throw ManagedClassLookupError(
+    if (not metadata or not metadata->managedClass.getObject()) throw ManagedClassLookupError(
         "Pothos::ManagedClass::lookup("+Util::typeInfoToString(type)+")",
         "no registration found");
 
     //extract the managed class
-    return it->second.getObject().extract<Pothos::ManagedClass>();
+    return metadata->managedClass.getObject().extract<Pothos::ManagedClass>();
 }
@@ -1,12 +1,16 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 //               2019-2020 Nicholas Corgan
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Object.hpp>
+#include <Pothos/Object/Containers.hpp>
 #include <Pothos/Testing.hpp>
+#include <Pothos/Plugin.hpp>
 #include <vector>
 #include <complex>
 #include <sstream>
+#include <iostream>
+#include <chrono>
 
 class NeverHeardOfFooBar {};
 
@@ -60,6 +64,28 @@ POTHOS_TEST_BLOCK("/object/tests", test_object_mutable)
     POTHOS_TEST_THROWS(intObj.ref<int>(), Pothos::ObjectConvertError);
 }
 
+POTHOS_TEST_BLOCK("/object/tests", test_object_small_values)
+{
+    //extracted references stay valid when the Object moves
+    Pothos::ObjectVector vec;
+    vec.emplace_back(std::complex<double>(1.0, -2.0));
+    const auto &value = vec.front().extract<std::complex<double>>();
+    for (int i = 0; i < 100; i++) vec.emplace_back(i);
+    POTHOS_TEST_TRUE(&value == &vec.front().extract<std::complex<double>>());
+    POTHOS_TEST_TRUE(value == std::complex<double>(1.0, -2.0));
+
+    //copies share the value
+    for (int i = 0; i < 100; i++) POTHOS_TEST_EQUAL(vec[i+1].extract<int>(), i);
+    const Pothos::Object copy = vec.back();
+    POTHOS_TEST_TRUE(copy == vec.back());
+    POTHOS_TEST_TRUE(Pothos::Object(99) != vec.back());
+
+    //assignment from a value owned by the old value
+    Pothos::Object nested(Pothos::ObjectVector{Pothos::Object(7)});
+    nested = nested.extract<Pothos::ObjectVector>()[0];
+    POTHOS_TEST_EQUAL(nested.extract<int>(), 7);
+}
+
 Pothos::Object someFunctionTakesObject(const Pothos::Object &obj)
 {
     return obj;
@@ -106,6 +132,72 @@ POTHOS_TEST_BLOCK("/object/tests", test_convert_complex)
     POTHOS_TEST_THROWS(complexObj.convert<int>(), Pothos::RangeException);
 }
 
+struct ConvertRouteFoo
+{
+    int value;
+};
+
+static int convertRouteFooToInt(const ConvertRouteFoo &foo)
+{
+    return foo.value;
+}
+
+POTHOS_TEST_BLOCK("/object/tests", test_convert_routes)
+{
+    //cached failures are dropped when a conversion is added
+    Pothos::Object fooObj(ConvertRouteFoo{21});
+    POTHOS_TEST_FALSE(fooObj.canConvert(typeid(double)));
+    POTHOS_TEST_THROWS(fooObj.convert<int>(), Pothos::ObjectConvertError);
+    Pothos::PluginRegistry::addCall("/object/convert/tests/foo_to_int", &convertRouteFooToInt);
+
+    //direct and two-hop conversions through int, repeated calls use the cached route
+    for (size_t i = 0; i < 3; i++)
+    {
+        POTHOS_TEST_EQUAL(fooObj.convert<int>(), 21);
+        POTHOS_TEST_TRUE(fooObj.canConvert(typeid(double)));
+        POTHOS_TEST_EQUAL(fooObj.convert<double>(), 21.0);
+    }
+
+    //cached routes are dropped when the conversion is removed
+    Pothos::PluginRegistry::remove("/object/convert/tests/foo_to_int");
+    POTHOS_TEST_FALSE(fooObj.canConvert(typeid(int)));
+    POTHOS_TEST_THROWS(fooObj.convert<double>(), Pothos::ObjectConvertError);
+}
+
+static int compareRouteFoo(const ConvertRouteFoo &a, const ConvertRouteFoo &b)
+{
+    return a.value - b.value;
+}
+
+static size_t hashRouteFoo(const ConvertRouteFoo &foo)
+{
+    return size_t(foo.value);
+}
+
+POTHOS_TEST_BLOCK("/object/tests", test_type_metadata)
+{
+    //names are demangled once and served from the cache after
+    for (size_t i = 0; i < 100; i++)
+    {
+        POTHOS_TEST_EQUAL(Pothos::Object(std::string()).getTypeString(), "std::string");
+        POTHOS_TEST_EQUAL(Pothos::Object(int(0)).getTypeString(), "int");
+    }
+
+    //registered functions are found by type and dropped on removal
+    Pothos::Object foo1(ConvertRouteFoo{1}), foo2(ConvertRouteFoo{2});
+    POTHOS_TEST_THROWS(foo1.compareTo(foo2), Pothos::ObjectCompareError);
+    Pothos::PluginRegistry::addCall("/object/compare/tests/foo", &compareRouteFoo);
+    Pothos::PluginRegistry::addCall("/object/hash/tests/foo", &hashRouteFoo);
+    for (size_t i = 0; i < 100; i++)
+    {
+        POTHOS_TEST_TRUE(foo1.compareTo(foo2) < 0);
+        POTHOS_TEST_EQUAL(foo2.hashCode(), 2);
+    }
+    Pothos::PluginRegistry::remove("/object/compare/tests/foo");
+    Pothos::PluginRegistry::remove("/object/hash/tests/foo");
+    POTHOS_TEST_THROWS(foo1.compareTo(foo2), Pothos::ObjectCompareError);
+}
+
 POTHOS_TEST_BLOCK("/object/tests", test_convert_vectors)
 {
     std::vector<unsigned int> inputVec;
@@ -163,6 +255,47 @@ POTHOS_TEST_BLOCK("/object/tests", test_serialize_obj)
     POTHOS_TEST_EQUAL(int1.extract<int>(), 42);
 }
 
+POTHOS_TEST_BLOCK("/object/tests", test_serialize_kwargs)
+{
+    //an envelope like the remote requests with packet like metadata
+    Pothos::ObjectKwargs metadata;
+    metadata["rxTime"] = Pothos::Object((long long)(1234567890));
+    metadata["freq"] = Pothos::Object(2.4e9);
+    metadata["gain"] = Pothos::Object(std::complex<float>(1.0f, -1.0f));
+    metadata["channel"] = Pothos::Object(size_t(3));
+    metadata["format"] = Pothos::Object("CF32");
+    Pothos::ObjectKwargs message;
+    message["action"] = Pothos::Object("call");
+    message["tid"] = Pothos::Object(size_t(42));
+    message["handleID"] = Pothos::Object(size_t(7));
+    message["name"] = Pothos::Object("setFrequency");
+    message["metadata"] = Pothos::Object(metadata);
+
+    //micro-benchmark: each message is one polymorphic entry per value
+    const size_t numIters = 10000;
+    Pothos::Object result;
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < numIters; i++)
+    {
+        std::stringstream ss;
+        Pothos::Object(message).serialize(ss);
+        result = Pothos::Object();
+        result.deserialize(ss);
+    }
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    const auto nsPerMessage = std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count()/numIters;
+    std::cout << "Serialize and deserialize ObjectKwargs message " << nsPerMessage << " ns" << std::endl;
+
+    const auto &kwargs = result.extract<Pothos::ObjectKwargs>();
+    POTHOS_TEST_EQUAL(kwargs.at("tid").extract<size_t>(), 42);
+    POTHOS_TEST_EQUAL(kwargs.at("name").extract<std::string>(), "setFrequency");
+    const auto &meta = kwargs.at("metadata").extract<Pothos::ObjectKwargs>();
+    POTHOS_TEST_EQUAL(meta.at("rxTime").extract<long long>(), 1234567890);
+    POTHOS_TEST_EQUAL(meta.at("freq").extract<double>(), 2.4e9);
+    POTHOS_TEST_TRUE(meta.at("gain").extract<std::complex<float>>() == std::complex<float>(1.0f, -1.0f));
+    POTHOS_TEST_EQUAL(meta.at("format").extract<std::string>(), "CF32");
+}
+
 POTHOS_TEST_BLOCK("/object/tests", test_compare_to)
 {
     Pothos::Object null0;
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSL-1.0
 
 #include "TypesHashCombine.hpp"
+#include "TypeMetadata.hpp"
 #include <Pothos/Object/Object.hpp>
 #include <Pothos/Object/Exception.hpp>
 #include <Pothos/Util/SpinLockRW.hpp>
@@ -22,7 +23,8 @@ static Pothos::Util::SpinLockRW &getMapMutex(void)
     return lock;
 }
 
-//singleton global map for all supported comparisons
+//singleton global map for comparisons of different types,
+//comparisons of the same type are held in the type metadata
 typedef std::map<size_t, Pothos::Plugin> CompareMapType;
 static CompareMapType &getCompareMap(void)
 {
@@ -48,6 +50,14 @@ static void handleComparePluginEvent(const Pothos::Plugin &plugin, const std::st
         const std::type_info &t0 = call.type(0);
         const std::type_info &t1 = call.type(1);
 
+        if (t0 == t1)
+        {
+            const auto compareFcn = (event == "add")?plugin:Pothos::Plugin();
+            if (event == "add" or event == "remove") updateTypeMetadata(t0,
+                [&compareFcn](TypeMetadata &m){m.compareFcn = compareFcn;});
+            return;
+        }
+
         std::lock_guard<Pothos::Util::SpinLockRW> lock(getMapMutex());
         if (event == "add")
         {
@@ -78,19 +88,30 @@ pothos_static_block(pothosObjectCompareRegister)
  **********************************************************************/
 int Pothos::Object::compareTo(const Pothos::Object &other) const
 {
-    //find the plugin in the map, it will be null if not found
-    Pothos::Util::SpinLockRW::SharedLock lock(getMapMutex());
-    auto it = getCompareMap().find(typesHashCombine(this->type(), other.type()));
+    //find the comparison, the plugin will be null if not found:
+    //the same types look in the type metadata, different types in the map
+    Pothos::Plugin plugin;
+    if (this->type() == other.type())
+    {
+        const auto metadata = lookupTypeMetadata(this->type().hash_code());
+        if (metadata) plugin = metadata->compareFcn;
+    }
+    else
+    {
+        Pothos::Util::SpinLockRW::SharedLock lock(getMapMutex());
+        auto it = getCompareMap().find(typesHashCombine(this->type(), other.type()));
+        if (it != getCompareMap().end()) plugin = it->second;
+    }
 
     //try a number type just in the case that this is possible
-    if (it == getCompareMap().end()) try
+    if (not plugin.getObject()) try
     {
         return Pothos::Util::compareTo(double(*this), double(other));
     }
     catch(const Pothos::ObjectConvertError &){}
 
     //thow an error when the compare is not supported
-    if (it == getCompareMap().end()) throw Pothos::ObjectCompareError(
+    if (not plugin.getObject()) throw Pothos::ObjectCompareError(
         "Pothos::Object::compareTo()",
         Poco::format("not supported for %s, %s",
         this->toString(), other.toString()));
@@ -98,6 +119,6 @@ int Pothos::Object::compareTo(const Pothos::Object &other) const
     Object args[2];
     args[0] = *this;
     args[1] = other;
-    const auto &call = it->second.getObject().extract<Pothos::Callable>();
+    const auto &call = plugin.getObject().extract<Pothos::Callable>();
     return call.opaqueCall(args, 2).extract<int>();
 }
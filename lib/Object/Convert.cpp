@@ -4,27 +4,30 @@
 #include "TypesHashCombine.hpp"
 #include <Pothos/Object/ObjectImpl.hpp>
 #include <Pothos/Object/Exception.hpp>
-#include <Pothos/Util/SpinLockRW.hpp>
 #include <Pothos/Util/TypeInfo.hpp>
 #include <Pothos/Callable.hpp>
 #include <Pothos/Plugin.hpp>
 #include <Poco/Logger.h>
 #include <Poco/Format.h>
 #include <mutex>
+#include <atomic>
 #include <set>
+#include <memory>
+#include <vector>
+#include <utility> //pair
 #include <map>
 
 /***********************************************************************
- * Global map structure for conversions
+ * Global registry of direct conversions
  **********************************************************************/
-static Pothos::Util::SpinLockRW &getMapMutex(void)
+static std::mutex &getRegistryMutex(void)
 {
-    static Pothos::Util::SpinLockRW lock;
-    return lock;
+    static std::mutex mutex;
+    return mutex;
 }
 
-//singleton global map for all supported conversions
-typedef std::map<size_t, Pothos::Plugin> ConvertMapType;
+//singleton global map for all supported conversions: (input hash, output hash) -> call
+typedef std::map<std::pair<size_t, size_t>, Pothos::Callable> ConvertMapType;
 static ConvertMapType &getConvertMap(void)
 {
     static ConvertMapType map;
@@ -38,9 +41,153 @@ static std::map<size_t, std::set<size_t>> &getConvertIoMap(void)
     return map;
 }
 
+/***********************************************************************
+ * Resolved conversion routes
+ **********************************************************************/
+struct ConvertRoute
+{
+    size_t inputHash;
+    size_t outputHash;
+    Pothos::Callable first; //null when the conversion is not supported
+    Pothos::Callable second; //null for a direct conversion
+};
+
+typedef std::shared_ptr<const ConvertRoute> ConvertRouteSptr;
+
+/*!
+ * Open addressing table of resolved routes with linear probing.
+ * Readers probe the published table without locks. Slots only change from
+ * empty to a route, so writers insert in place under the registry mutex,
+ * and a bigger table is published only when the load exceeds one half.
+ * Replaced tables are retired rather than freed, so a reader never holds
+ * a reference count, and a route stays valid for the life of the process.
+ */
+struct ConvertRouteTable
+{
+    ConvertRouteTable(const size_t capacity):
+        numRoutes(0),
+        capacity(capacity),
+        slots(new std::atomic<const ConvertRoute *>[capacity])
+    {
+        for (size_t i = 0; i < capacity; i++) slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    const ConvertRoute *find(const size_t inputHash, const size_t outputHash) const
+    {
+        const size_t mask = capacity-1;
+        for (size_t i = typesHashCombine(inputHash, outputHash) & mask;; i = (i+1) & mask)
+        {
+            const auto route = slots[i].load(std::memory_order_acquire);
+            if (route == nullptr) return nullptr;
+            if (route->inputHash == inputHash and route->outputHash == outputHash) return route;
+        }
+    }
+
+    //! Insert a route that is not in the table, call with the registry mutex held
+    void insert(const ConvertRouteSptr &route)
+    {
+        routes.push_back(route);
+        const size_t mask = capacity-1;
+        for (size_t i = typesHashCombine(route->inputHash, route->outputHash) & mask;; i = (i+1) & mask)
+        {
+            if (slots[i].load(std::memory_order_relaxed) != nullptr) continue;
+            slots[i].store(route.get(), std::memory_order_release);
+            numRoutes++;
+            return;
+        }
+    }
+
+    //! True when another insert would take the load over one half
+    bool full(void) const
+    {
+        return (numRoutes+1)*2 > capacity;
+    }
+
+    size_t numRoutes;
+    const size_t capacity; //power of 2 size
+    std::vector<ConvertRouteSptr> routes; //owns the routes in the slots
+    std::unique_ptr<std::atomic<const ConvertRoute *>[]> slots;
+};
+
+static const size_t ROUTE_TABLE_INITIAL_CAPACITY = 64;
+
+//the published table, modified and replaced under the registry mutex
+static std::atomic<ConvertRouteTable *> &getPublishedTable(void)
+{
+    static std::atomic<ConvertRouteTable *> table(new ConvertRouteTable(ROUTE_TABLE_INITIAL_CAPACITY));
+    return table;
+}
+
+//! Publish a new table and retire the old one, call with the registry mutex held
+static void publishRouteTable(ConvertRouteTable *table)
+{
+    static std::vector<std::unique_ptr<ConvertRouteTable>> retired;
+    retired.emplace_back(getPublishedTable().exchange(table, std::memory_order_acq_rel));
+}
+
+//! Find the direct conversion or the first two-hop route, call with the registry mutex held
+static ConvertRouteSptr resolveRoute(const size_t inputHash, const size_t outputHash)
+{
+    std::shared_ptr<ConvertRoute> route(new ConvertRoute());
+    route->inputHash = inputHash;
+    route->outputHash = outputHash;
+
+    const auto &map = getConvertMap();
+    auto it = map.find(std::make_pair(inputHash, outputHash));
+    if (it != map.end())
+    {
+        route->first = it->second;
+        return route;
+    }
+
+    //try an intermediate conversion
+    auto itIo = getConvertIoMap().find(inputHash);
+    if (itIo != getConvertIoMap().end()) for (const size_t intermHash : itIo->second)
+    {
+        auto it1 = map.find(std::make_pair(inputHash, intermHash));
+        auto it2 = map.find(std::make_pair(intermHash, outputHash));
+        if (it1 != map.end() and it2 != map.end())
+        {
+            route->first = it1->second;
+            route->second = it2->second;
+            break;
+        }
+    }
+    return route;
+}
+
+//! Get the route from the published table or resolve and publish it on first use
+static const ConvertRoute &lookupRoute(const size_t inputHash, const size_t outputHash)
+{
+    auto route = getPublishedTable().load(std::memory_order_acquire)->find(inputHash, outputHash);
+    if (route != nullptr) return *route;
+
+    std::lock_guard<std::mutex> lock(getRegistryMutex());
+
+    //another thread may have published the route
+    auto table = getPublishedTable().load(std::memory_order_relaxed);
+    route = table->find(inputHash, outputHash);
+    if (route != nullptr) return *route;
+
+    //insert in place, or publish a table of twice the size to keep the load under one half
+    const auto newRoute = resolveRoute(inputHash, outputHash);
+    if (table->full())
+    {
+        auto newTable = new ConvertRouteTable(table->capacity*2);
+        for (const auto &oldRoute : table->routes) newTable->insert(oldRoute);
+        publishRouteTable(newTable);
+        table = newTable;
+    }
+    table->insert(newRoute);
+    return *newRoute;
+}
+
 /***********************************************************************
  * Conversion registration handling
  **********************************************************************/
+//! Cached call resolutions are dropped when the set of conversions changes
+void clearManagedDispatchCache(void);
+
 static void handleConvertPluginEvent(const Pothos::Plugin &plugin, const std::string &event)
 {
     poco_debug_f2(Poco::Logger::get("Pothos.Object.handleConvertPluginEvent"), "plugin %s, event %s", plugin.toString(), event);
@@ -53,20 +200,31 @@ static void handleConvertPluginEvent(const Pothos::Plugin &plugin, const std::st
         if (call.getNumArgs() != 1) return;
 
         //extract type info used for map lookup
-        const std::type_info &inputType = call.type(0);
-        const std::type_info &outputType = call.type(-1);
+        const size_t inputHash = call.type(0).hash_code();
+        const size_t outputHash = call.type(-1).hash_code();
 
-        std::lock_guard<Pothos::Util::SpinLockRW> lock(getMapMutex());
-        if (event == "add")
-        {
-            getConvertMap()[typesHashCombine(inputType, outputType)] = plugin;
-            getConvertIoMap()[inputType.hash_code()].insert(outputType.hash_code());
-        }
-        if (event == "remove")
         {
-            getConvertMap()[typesHashCombine(inputType, outputType)] = Pothos::Plugin();
-            getConvertIoMap()[inputType.hash_code()].erase(outputType.hash_code());
+            std::lock_guard<std::mutex> lock(getRegistryMutex());
+            if (event == "add")
+            {
+                getConvertMap()[std::make_pair(inputHash, outputHash)] = call;
+                getConvertIoMap()[inputHash].insert(outputHash);
+            }
+            if (event == "remove")
+            {
+                getConvertMap().erase(std::make_pair(inputHash, outputHash));
+                getConvertIoMap()[inputHash].erase(outputHash);
+            }
+
+            //resolved routes may have changed, start over with an empty table
+            if (getPublishedTable().load(std::memory_order_relaxed)->numRoutes != 0)
+            {
+                publishRouteTable(new ConvertRouteTable(ROUTE_TABLE_INITIAL_CAPACITY));
+            }
         }
+
+        //overloads resolved by managed calls depend on which conversions exist
+        clearManagedDispatchCache();
     }
     POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
     {
@@ -88,37 +246,18 @@ pothos_static_block(pothosObjectConvertRegister)
  **********************************************************************/
 static Pothos::Object convertObject(const Pothos::Object &inputObj, const std::type_info &outputType)
 {
-    //find the plugin in the map, it will be null if not found
-    Pothos::Util::SpinLockRW::SharedLock lock(getMapMutex());
-    auto it = getConvertMap().find(typesHashCombine(inputObj.type(), outputType));
-
-    //try an intermediate conversion
-    if (it == getConvertMap().end())
-    {
-        auto itIo = getConvertIoMap().find(inputObj.type().hash_code());
-        if (itIo != getConvertIoMap().end()) for (const size_t intermHash : itIo->second)
-        {
-            auto it1 = getConvertMap().find(typesHashCombine(inputObj.type().hash_code(), intermHash));
-            auto it2 = getConvertMap().find(typesHashCombine(intermHash, outputType.hash_code()));
-            if (it1 != getConvertMap().end() and it2 != getConvertMap().end())
-            {
-                const auto &call1 = it1->second.getObject().extract<Pothos::Callable>();
-                const auto &call2 = it2->second.getObject().extract<Pothos::Callable>();
-                Pothos::Object intermediate = call1.opaqueCall(&inputObj, 1);
-                return call2.opaqueCall(&intermediate, 1);
-            }
-        }
-    }
+    const auto &route = lookupRoute(inputObj.type().hash_code(), outputType.hash_code());
 
     //thow an error when the conversion is not supported
-    if (it == getConvertMap().end()) throw Pothos::ObjectConvertError(
+    if (not route.first) throw Pothos::ObjectConvertError(
         "Pothos::Object::convert()",
         Poco::format("doesnt support %s to %s",
         inputObj.getTypeString(),
         Pothos::Util::typeInfoToString(outputType)));
 
-    const auto &call = it->second.getObject().extract<Pothos::Callable>();
-    return call.opaqueCall(&inputObj, 1);
+    if (not route.second) return route.first.opaqueCall(&inputObj, 1);
+    Pothos::Object intermediate = route.first.opaqueCall(&inputObj, 1);
+    return route.second.opaqueCall(&intermediate, 1);
 }
 
 Pothos::Object Pothos::Object::convert(const std::type_info &type) const
@@ -137,20 +276,5 @@ bool Pothos::Object::canConvert(const std::type_info &type) const
 bool Pothos::Object::canConvert(const std::type_info &srcType, const std::type_info &dstType)
 {
     if (srcType == dstType) return true;
-    Pothos::Util::SpinLockRW::SharedLock lock(getMapMutex());
-    auto it = getConvertMap().find(typesHashCombine(srcType, dstType));
-
-    //try an intermediate conversion
-    if (it == getConvertMap().end())
-    {
-        auto itIo = getConvertIoMap().find(srcType.hash_code());
-        if (itIo != getConvertIoMap().end()) for (const size_t intermHash : itIo->second)
-        {
-            auto it1 = getConvertMap().find(typesHashCombine(srcType.hash_code(), intermHash));
-            auto it2 = getConvertMap().find(typesHashCombine(intermHash, dstType.hash_code()));
-            if (it1 != getConvertMap().end() and it2 != getConvertMap().end()) return true;
-        }
-    }
-
-    return (it != getConvertMap().end());
+    return bool(lookupRoute(srcType.hash_code(), dstType.hash_code()).first);
 }
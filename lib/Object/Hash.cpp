@@ -1,32 +1,13 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
-#include <Pothos/Object/Object.hpp>
+#include "TypeMetadata.hpp"
+#include <Pothos/Object/ObjectImpl.hpp>
 #include <Pothos/Object/Exception.hpp>
-#include <Pothos/Util/SpinLockRW.hpp>
 #include <Pothos/Callable.hpp>
 #include <Pothos/Plugin.hpp>
 #include <Poco/Logger.h>
 #include <Poco/Format.h>
-#include <mutex>
-#include <map>
-
-/***********************************************************************
- * Global map structure for comparisons
- **********************************************************************/
-static Pothos::Util::SpinLockRW &getMapMutex(void)
-{
-    static Pothos::Util::SpinLockRW lock;
-    return lock;
-}
-
-//singleton global map for all supported comparisons
-typedef std::map<size_t, Pothos::Plugin> HashFcnMapType;
-static HashFcnMapType &getHashFcnMap(void)
-{
-    static HashFcnMapType map;
-    return map;
-}
 
 /***********************************************************************
  * Comparison registration handling
@@ -42,14 +23,13 @@ static void handleHashFcnPluginEvent(const Pothos::Plugin &plugin, const std::st
         if (call.type(-1) != typeid(size_t)) return;
         if (call.getNumArgs() != 1) return;
 
-        std::lock_guard<Pothos::Util::SpinLockRW> lock(getMapMutex());
         if (event == "add")
         {
-            getHashFcnMap()[call.type(0).hash_code()] = plugin;
+            updateTypeMetadata(call.type(0), [&plugin](TypeMetadata &m){m.hashFcn = plugin;});
         }
         if (event == "remove")
         {
-            getHashFcnMap()[call.type(0).hash_code()] = Pothos::Plugin();
+            updateTypeMetadata(call.type(0), [](TypeMetadata &m){m.hashFcn = Pothos::Plugin();});
         }
     }
     POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
@@ -72,13 +52,12 @@ pothos_static_block(pothosObjectHashFcnRegister)
  **********************************************************************/
 size_t Pothos::Object::hashCode(void) const
 {
-    //find the plugin in the map, it will be null if not found
-    Pothos::Util::SpinLockRW::SharedLock lock(getMapMutex());
-    auto it = getHashFcnMap().find(this->type().hash_code());
+    //find the plugin in the type metadata, it will be null if not found
+    const auto metadata = lookupTypeMetadata(this->type().hash_code());
 
     //return the address when no hash function found
-    if (it == getHashFcnMap().end()) return size_t(_impl);
+    if (not metadata or not metadata->hashFcn.getObject()) return size_t(_impl);
 
-    const auto &call = it->second.getObject().extract<Pothos::Callable>();
+    const auto &call = metadata->hashFcn.getObject().extract<Pothos::Callable>();
     return call.opaqueCall(this, 1).extract<size_t>();
 }
@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Object/ObjectImpl.hpp>
@@ -87,17 +87,21 @@ Pothos::Object::operator bool(void) const
 
 Pothos::Object &Pothos::Object::operator=(const Object &rhs)
 {
-    decr(_impl);
+    //take the new reference first, rhs may be owned by the old value
+    auto old = _impl;
     _impl = rhs._impl;
     incr(_impl);
+    decr(old);
     return *this;
 }
 
 Pothos::Object &Pothos::Object::operator=(Object &&rhs)
 {
-    decr(_impl);
+    if (this == &rhs) return *this;
+    auto old = _impl;
     _impl = rhs._impl;
     rhs._impl = nullptr;
+    decr(old);
     return *this;
 }
 
@@ -0,0 +1,81 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "TypeMetadata.hpp"
+#include "Util/PublishedTable.hpp"
+#include <cstdlib> //free
+#include <mutex>
+
+//demangle support for pretty strings
+#ifdef __GNUG__
+#include <cxxabi.h>
+#define HAVE_CXA_DEMANGLE
+#endif
+
+static std::string demangleTypeName(const std::type_info &type)
+{
+    //Since std::string is used a lot and often has a complicated template name,
+    //we just enforce returning a simple display name for the std::string type.
+    if (type == typeid(std::string)) return "std::string";
+
+    const char *name = type.name();
+    #ifdef HAVE_CXA_DEMANGLE
+    int status = -1;
+    char *res = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status == 0)
+    {
+        const std::string out(res);
+        std::free(res);
+        return out;
+    }
+    #endif
+    return name;
+}
+
+/***********************************************************************
+ * metadata storage
+ **********************************************************************/
+static std::mutex &getTypeMetadataMutex(void)
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+//! All entries, a new type or an update publishes one entry under the mutex
+static PublishedTable<size_t, TypeMetadata> &getTypeMetadataTable(void)
+{
+    static PublishedTable<size_t, TypeMetadata> table;
+    return table;
+}
+
+/***********************************************************************
+ * metadata implementation
+ **********************************************************************/
+const TypeMetadata *lookupTypeMetadata(const size_t typeHash)
+{
+    return getTypeMetadataTable().find(typeHash);
+}
+
+const TypeMetadata &getTypeMetadata(const std::type_info &type)
+{
+    auto entry = lookupTypeMetadata(type.hash_code());
+    if (entry != nullptr) return *entry;
+
+    //another thread may have recorded the type since the lookup
+    std::lock_guard<std::mutex> lock(getTypeMetadataMutex());
+    entry = lookupTypeMetadata(type.hash_code());
+    if (entry != nullptr) return *entry;
+    TypeMetadata newEntry;
+    newEntry.name = demangleTypeName(type);
+    return getTypeMetadataTable().publish(type.hash_code(), newEntry);
+}
+
+void updateTypeMetadata(const std::type_info &type, const std::function<void(TypeMetadata &)> &update)
+{
+    std::lock_guard<std::mutex> lock(getTypeMetadataMutex());
+    const auto current = lookupTypeMetadata(type.hash_code());
+    TypeMetadata entry(current?*current:TypeMetadata());
+    if (entry.name.empty()) entry.name = demangleTypeName(type);
+    update(entry);
+    getTypeMetadataTable().publish(type.hash_code(), entry);
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Plugin/Plugin.hpp>
+#include <typeinfo>
+#include <functional>
+#include <string>
+
+/*!
+ * Everything registered for a type, indexed by the type hash code.
+ * Entries are immutable once published, updates replace the entry,
+ * and a replaced entry stays valid so readers can keep a reference.
+ * Conversions and serialization keep their own tables:
+ * conversions are keyed by type pairs and cached per route,
+ * and serializers are keyed by the archive hash of a type name.
+ */
+struct TypeMetadata
+{
+    std::string name; //!< demangled type name for display
+    Pothos::Plugin managedClass; //!< ManagedClass for the type, pointer type, or shared type
+    Pothos::Plugin hashFcn; //!< hash function under /object/hash
+    Pothos::Plugin compareFcn; //!< comparison of two values of this type under /object/compare
+};
+
+/*!
+ * Get the metadata for a type hash without locking.
+ * \return the entry or null when nothing was recorded for the type
+ */
+const TypeMetadata *lookupTypeMetadata(const size_t typeHash);
+
+/*!
+ * Get the metadata for a type and record its demangled name when missing.
+ */
+const TypeMetadata &getTypeMetadata(const std::type_info &type);
+
+/*!
+ * Change the metadata for a type, called from registration handlers.
+ * The update operates on a copy of the entry that is then published.
+ */
+void updateTypeMetadata(const std::type_info &type, const std::function<void(TypeMetadata &)> &update);
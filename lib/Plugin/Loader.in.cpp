@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2016 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Plugin/Loader.hpp>
@@ -11,6 +11,7 @@
 #include <Poco/Path.h>
 #include <Poco/File.h>
 #include <future>
+#include <map>
 
 static std::vector<Poco::Path> getModulePaths(const Poco::Path &path)
 {
@@ -37,18 +38,60 @@ static std::vector<Poco::Path> getModulePaths(const Poco::Path &path)
     return paths;
 }
 
+//from lib/Plugin/ModuleIndex.cpp
+std::map<std::string, std::vector<std::string>> moduleIndexLoad(const std::vector<std::string> &modulePaths);
+void moduleIndexStore(const std::vector<Pothos::PluginModule> &modules);
+bool moduleIndexCanLoadLazy(const std::vector<std::string> &pluginPaths);
+void lazyModuleRegister(const std::string &modulePath, const std::vector<std::string> &pluginPaths);
+
+//from lib/Plugin/ModuleSafeLoad.cpp
+std::map<std::string, std::string> safeLoadValidateModules(const std::vector<std::string> &paths);
+
 std::vector<Pothos::PluginModule> Pothos::PluginLoader::loadModules(void)
 {
     const auto searchPaths = Pothos::System::getPothosModuleSearchPaths();
+    const bool lazy = Poco::Environment::get("POTHOS_LAZY_MODULES", "0") == "1";
 
-    //traverse the search paths and spawn futures
-    std::vector<std::future<Pothos::PluginModule>> futures;
+    //traverse the search paths for modules
+    std::vector<std::string> modulePaths;
     for (const auto &searchPath : searchPaths)
     {
         for (const auto &path : getModulePaths(searchPath))
         {
-            futures.push_back(std::async(std::launch::async, &Pothos::PluginModule::safeLoad, path.toString()));
+            modulePaths.push_back(path.toString());
+        }
+    }
+
+    //indexed modules with only block factories wait for their first lookup
+    std::map<std::string, std::vector<std::string>> index;
+    if (lazy) index = moduleIndexLoad(modulePaths);
+
+    std::vector<std::string> loadPaths;
+    for (const auto &path : modulePaths)
+    {
+        auto it = index.find(path);
+        if (it != index.end() and moduleIndexCanLoadLazy(it->second))
+        {
+            lazyModuleRegister(path, it->second);
         }
+        else loadPaths.push_back(path);
+    }
+
+    //validate new and changed modules together in helper processes
+    const auto errors = safeLoadValidateModules(loadPaths);
+
+    //spawn futures for the modules that load now
+    std::vector<std::future<Pothos::PluginModule>> futures;
+    for (const auto &path : loadPaths)
+    {
+        auto it = errors.find(path);
+        if (it != errors.end())
+        {
+            poco_error(Poco::Logger::get("Pothos.PluginLoader.load"),
+                Pothos::PluginModuleError("Pothos::PluginModule("+path+")", it->second).displayText());
+            continue;
+        }
+        futures.push_back(std::async(std::launch::async, &Pothos::PluginModule::safeLoad, path));
     }
 
     //wait for completion of future module load
@@ -64,5 +107,8 @@ std::vector<Pothos::PluginModule> Pothos::PluginLoader::loadModules(void)
             poco_error(Poco::Logger::get("Pothos.PluginLoader.load"), ex.displayText());
         }
     }
+
+    //record the plugin paths of the loaded modules for the next lazy startup
+    if (lazy) moduleIndexStore(modules);
     return modules;
 }
@@ -1,16 +1,18 @@
-// Copyright (c) 2013-2018 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/System/Paths.hpp>
 #include <Pothos/Plugin/Module.hpp>
 #include <Pothos/Plugin/Registry.hpp>
 #include <Pothos/Plugin/Exception.hpp>
+#include <Pothos/Plugin/Profile.hpp>
 #include <Pothos/Object.hpp> //pulls in full Object implementation
 #include <Poco/SharedLibrary.h>
 #include <Poco/Platform.h>
 #include <Poco/Logger.h>
 #include <Poco/Format.h>
 #include <mutex>
+#include <set>
 
 /***********************************************************************
  * Disabler for windows error messages
@@ -49,15 +51,28 @@ void registrySetActiveModuleLoading(const Pothos::PluginModule &module);
 
 std::vector<std::string> getPluginPaths(const Pothos::PluginModule &module);
 
-static std::mutex &getModuleMutex(void)
+/*!
+ * Modules load one at a time, the mutex is recursive so that a module
+ * can cause a lazy module to load from its static initialization.
+ * Also held by lib/Plugin/ModuleIndex.cpp around lazy module loads.
+ */
+std::recursive_mutex &getPluginModuleMutex(void)
 {
-    static std::mutex mutex;
+    static std::recursive_mutex mutex;
     return mutex;
 }
 
-//where to store the version during module load
+//the module being loaded by this thread, and where to store its version
+static thread_local Pothos::PluginModule *currentModule(nullptr);
 static thread_local std::string *currentModuleVersion(nullptr);
 
+//! File paths of the modules that registered serialization entries
+static std::set<std::string> &getArchiveEntryModules(void)
+{
+    static std::set<std::string> paths;
+    return paths;
+}
+
 /***********************************************************************
  * Shared implementation for module data
  **********************************************************************/
@@ -69,6 +84,30 @@ struct Pothos::PluginModule::Impl
     std::string version;
 };
 
+/*!
+ * Make the module the active module for the duration of its library load,
+ * and restore the outer module when the load was nested in another load.
+ */
+struct ActiveModuleGuard
+{
+    ActiveModuleGuard(Pothos::PluginModule &module, std::string &version):
+        outerModule(currentModule),
+        outerVersion(currentModuleVersion)
+    {
+        registrySetActiveModuleLoading(module);
+        currentModule = &module;
+        currentModuleVersion = &version;
+    }
+    ~ActiveModuleGuard(void)
+    {
+        registrySetActiveModuleLoading((outerModule == nullptr)?Pothos::PluginModule():*outerModule);
+        currentModule = outerModule;
+        currentModuleVersion = outerVersion;
+    }
+    Pothos::PluginModule *outerModule;
+    std::string *outerVersion;
+};
+
 /***********************************************************************
  * Module implementation
  **********************************************************************/
@@ -90,14 +129,15 @@ Pothos::PluginModule::PluginModule(const std::string &path):
     poco_debug(Poco::Logger::get("Pothos.PluginModule.load"), path);
     try
     {
-        std::lock_guard<std::mutex> lock(getModuleMutex());
-        registrySetActiveModuleLoading(*this);
-        currentModuleVersion = &(_impl->version);
-        ErrorMessageDisableGuard emdg;
-        _impl->sharedLibrary.load(path);
-        currentModuleVersion = nullptr;
-        registrySetActiveModuleLoading(PluginModule());
+        std::lock_guard<std::recursive_mutex> lock(getPluginModuleMutex());
+        PluginProfile::Scope profile("module", path);
+        {
+            ActiveModuleGuard active(*this, _impl->version);
+            ErrorMessageDisableGuard emdg;
+            _impl->sharedLibrary.load(path);
+        }
         _impl->pluginPaths = ::getPluginPaths(*this);
+        if (PluginProfile::isEnabled()) profile.setDetail(std::to_string(_impl->pluginPaths.size()) + " plugins");
     }
     catch(const Poco::LibraryLoadException &ex)
     {
@@ -146,6 +186,20 @@ Pothos::ModuleVersion::ModuleVersion(const std::string &version)
     if (currentModuleVersion != nullptr) *currentModuleVersion = version;
 }
 
+//! Called by lib/Archive/ArchiveEntry.cpp for entries in a loading module
+void pluginModuleNoteArchiveEntry(void)
+{
+    //made thread safe by the module mutex held during the load
+    if (currentModule != nullptr) getArchiveEntryModules().insert(currentModule->getFilePath());
+}
+
+//! Did the module register serialization entries? (used by the module index)
+bool pluginModuleHasArchiveEntries(const Pothos::PluginModule &module)
+{
+    std::lock_guard<std::recursive_mutex> lock(getPluginModuleMutex());
+    return getArchiveEntryModules().count(module.getFilePath()) != 0;
+}
+
 #include <Pothos/Managed.hpp>
 
 static auto managedPluginModule = Pothos::ManagedClass()
@@ -0,0 +1,332 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/System/Paths.hpp>
+#include <Pothos/Plugin/Module.hpp>
+#include <Pothos/Plugin/Exception.hpp>
+#include <Pothos/Util/FileLock.hpp>
+#include <Poco/StringTokenizer.h>
+#include <Poco/String.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/Logger.h>
+#include <Poco/AutoPtr.h>
+#include <Poco/Util/PropertyFileConfiguration.h>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <algorithm> //find_if
+#include <cctype>
+#include <map>
+#include <set>
+
+//from lib/Plugin/Module.cpp
+std::recursive_mutex &getPluginModuleMutex(void);
+bool pluginModuleHasArchiveEntries(const Pothos::PluginModule &module);
+
+//! The path used to store the module index
+static std::string getModuleIndexPath(void)
+{
+    Poco::Path path(Pothos::System::getUserConfigPath());
+    path.append("ModuleIndex.cache");
+    return path.toString();
+}
+
+/***********************************************************************
+ * named mutex for index protection
+ **********************************************************************/
+struct ModuleIndexFileLock : public Pothos::Util::FileLock
+{
+    ModuleIndexFileLock(void):
+        Pothos::Util::FileLock(getModuleIndexPath()+".lock")
+    {}
+};
+
+static Pothos::Util::FileLock &getModuleIndexFileLock(void)
+{
+    static ModuleIndexFileLock lock;
+    return lock;
+}
+
+/***********************************************************************
+ * persistent index: module path -> plugin paths
+ **********************************************************************/
+//! Identify a version of a file by its modification time and size
+static std::string getFileStamp(const std::string &path)
+{
+    const Poco::File file(path);
+    return std::to_string(file.getLastModified().epochMicroseconds()) + ":" + std::to_string(file.getSize());
+}
+
+//! Escape PropertyFile keys, problem with slashes
+static std::string escape(const std::string &in)
+{
+    std::string out;
+    for (const auto ch : in)
+    {
+        if (std::isalnum(ch)) out.push_back(ch);
+        else out.push_back('_');
+    }
+    return out;
+}
+
+static Poco::AutoPtr<Poco::Util::PropertyFileConfiguration> loadModuleIndexFile(const std::string &indexPath)
+{
+    Poco::AutoPtr<Poco::Util::PropertyFileConfiguration> index(new Poco::Util::PropertyFileConfiguration());
+    try {index->load(indexPath);} catch(...){}
+    return index;
+}
+
+/*!
+ * Get the indexed plugin paths for modules that did not change since indexing.
+ * Modules that registered serialization entries are left out of the result.
+ * A different runtime library invalidates the entire index.
+ */
+std::map<std::string, std::vector<std::string>> moduleIndexLoadFile(const std::string &indexPath, const std::vector<std::string> &modulePaths)
+{
+    std::map<std::string, std::vector<std::string>> result;
+    std::lock_guard<Pothos::Util::FileLock> fileLock(getModuleIndexFileLock());
+    const auto index = loadModuleIndexFile(indexPath);
+
+    try
+    {
+        const auto &libPath = Pothos::System::getPothosRuntimeLibraryPath();
+        if (index->getString(escape(libPath), "") != getFileStamp(libPath)) return result;
+        for (const auto &modulePath : modulePaths)
+        {
+            const auto key = escape(modulePath);
+            if (index->getString(key+".stamp", "") != getFileStamp(modulePath)) continue;
+            if (index->getBool(key+".archive", true)) continue;
+            auto &paths = result[modulePath];
+            for (const auto &path : Poco::StringTokenizer(index->getString(key+".paths", ""), ",",
+                Poco::StringTokenizer::TOK_IGNORE_EMPTY | Poco::StringTokenizer::TOK_TRIM)) paths.push_back(path);
+        }
+    }
+    catch (const Poco::Exception &ex)
+    {
+        poco_warning(Poco::Logger::get("Pothos.PluginLoader.index"), ex.displayText());
+        result.clear();
+    }
+    return result;
+}
+
+/*!
+ * Record the plugin paths of modules, keyed by module file path.
+ * The archive set names the modules that registered serialization entries:
+ * those entries are found by type or hash and not through a plugin path.
+ * The file is only written when an entry is missing or out of date.
+ */
+void moduleIndexStoreFile(const std::string &indexPath,
+    const std::map<std::string, std::vector<std::string>> &modules,
+    const std::set<std::string> &archive)
+{
+    std::lock_guard<Pothos::Util::FileLock> fileLock(getModuleIndexFileLock());
+    const auto index = loadModuleIndexFile(indexPath);
+
+    bool stale = false;
+    const auto update = [&index, &stale](const std::string &key, const std::string &value)
+    {
+        if (index->getString(key, "") == value) return;
+        index->setString(key, value);
+        stale = true;
+    };
+
+    try
+    {
+        const auto &libPath = Pothos::System::getPothosRuntimeLibraryPath();
+        update(escape(libPath), getFileStamp(libPath));
+        for (const auto &module : modules)
+        {
+            const auto key = escape(module.first);
+            update(key+".stamp", getFileStamp(module.first));
+            update(key+".paths", Poco::cat(std::string(","), module.second.begin(), module.second.end()));
+            update(key+".archive", (archive.count(module.first) != 0)?"true":"false");
+        }
+        if (stale) index->save(indexPath);
+    }
+    catch (const Poco::Exception &ex)
+    {
+        poco_warning(Poco::Logger::get("Pothos.PluginLoader.index"), ex.displayText());
+    }
+}
+
+std::map<std::string, std::vector<std::string>> moduleIndexLoad(const std::vector<std::string> &modulePaths)
+{
+    return moduleIndexLoadFile(getModuleIndexPath(), modulePaths);
+}
+
+//! Record the plugin paths of modules that were loaded into this process
+void moduleIndexStore(const std::vector<Pothos::PluginModule> &modules)
+{
+    std::map<std::string, std::vector<std::string>> entries;
+    std::set<std::string> archive;
+    for (const auto &module : modules)
+    {
+        entries[module.getFilePath()] = module.getPluginPaths();
+        if (pluginModuleHasArchiveEntries(module)) archive.insert(module.getFilePath());
+    }
+    moduleIndexStoreFile(getModuleIndexPath(), entries, archive);
+}
+
+/***********************************************************************
+ * lazy modules: loaded when one of their plugin paths is requested
+ **********************************************************************/
+struct LazyModule
+{
+    std::string path;
+    std::vector<std::string> pluginPaths;
+    std::shared_future<Pothos::PluginModule> future;
+};
+
+typedef std::shared_ptr<LazyModule> LazyModuleSptr;
+
+static std::mutex &getLazyModulesMutex(void)
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+//! Pending modules keyed by each plugin path that they provide
+static std::map<std::string, LazyModuleSptr> &getPendingLazyModules(void)
+{
+    static std::map<std::string, LazyModuleSptr> map;
+    return map;
+}
+
+//! Handles of the lazy modules that were loaded
+static std::vector<Pothos::PluginModule> &getLoadedLazyModules(void)
+{
+    static std::vector<Pothos::PluginModule> modules;
+    return modules;
+}
+
+//! Checked before any locking so that lookups are free without lazy modules
+static std::atomic<bool> &getHasPendingLazyModules(void)
+{
+    static std::atomic<bool> hasPending(false);
+    return hasPending;
+}
+
+//! Lazy modules whose load is in progress on this thread
+static thread_local std::vector<const LazyModule *> loadingInThisThread;
+
+static Pothos::PluginModule loadLazyModule(const std::string &path)
+{
+    poco_debug(Poco::Logger::get("Pothos.PluginLoader.lazy"), path);
+    return Pothos::PluginModule(path);
+}
+
+/*!
+ * Only modules that provide nothing but block factories are loaded lazily.
+ * Other modules register event handlers, conversions, and managed classes
+ * that are looked up by type or name rather than by their plugin path.
+ */
+bool moduleIndexCanLoadLazy(const std::vector<std::string> &pluginPaths)
+{
+    if (pluginPaths.empty()) return false;
+    for (const auto &path : pluginPaths)
+    {
+        if (path.compare(0, 8, "/blocks/") != 0) return false;
+    }
+    return true;
+}
+
+void lazyModuleRegister(const std::string &modulePath, const std::vector<std::string> &pluginPaths)
+{
+    LazyModuleSptr module(new LazyModule());
+    module->path = modulePath;
+    module->pluginPaths = pluginPaths;
+    module->future = std::async(std::launch::deferred, &loadLazyModule, modulePath);
+
+    std::lock_guard<std::mutex> lock(getLazyModulesMutex());
+    for (const auto &path : pluginPaths) getPendingLazyModules()[path] = module;
+    getHasPendingLazyModules() = true;
+}
+
+/*!
+ * Load the pending modules that provide the plugin path,
+ * or with subTree, any path at or below the plugin path.
+ */
+void lazyModuleLoad(const std::string &pluginPath, const bool subTree)
+{
+    if (not getHasPendingLazyModules()) return;
+
+    //the root path without a trailing slash is the empty prefix
+    std::string prefix(pluginPath);
+    while (not prefix.empty() and prefix.back() == '/') prefix.pop_back();
+
+    std::vector<LazyModuleSptr> modules;
+    {
+        std::lock_guard<std::mutex> lock(getLazyModulesMutex());
+        auto &pending = getPendingLazyModules();
+        auto it = pending.lower_bound(prefix);
+        while (it != pending.end() and it->first.compare(0, prefix.size(), prefix) == 0)
+        {
+            const auto &path = it->first;
+            const bool match = (path.size() == prefix.size()) or (subTree and path[prefix.size()] == '/');
+            if (match and std::find(modules.begin(), modules.end(), it->second) == modules.end())
+            {
+                modules.push_back(it->second);
+            }
+            if (not subTree and path.size() > prefix.size()) break;
+            ++it;
+        }
+    }
+
+    //the loads happen without the lazy modules lock, the registry calls back into here,
+    //other threads asking for the same paths wait on the same shared future
+    for (const auto &module : modules)
+    {
+        //a lookup from the static initialization of the module itself
+        if (std::find(loadingInThisThread.begin(), loadingInThisThread.end(), module.get()) != loadingInThisThread.end()) continue;
+
+        Pothos::PluginModule loaded;
+        try
+        {
+            //the future runs in the thread that holds the module mutex,
+            //so a load nested in another module load cannot wait on itself
+            std::lock_guard<std::recursive_mutex> moduleLock(getPluginModuleMutex());
+            loadingInThisThread.push_back(module.get());
+            try {loaded = module->future.get();}
+            catch (...) {loadingInThisThread.pop_back(); throw;}
+            loadingInThisThread.pop_back();
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            poco_error(Poco::Logger::get("Pothos.PluginLoader.lazy"), ex.displayText());
+        }
+
+        std::lock_guard<std::mutex> lock(getLazyModulesMutex());
+        auto &pending = getPendingLazyModules();
+        for (const auto &path : module->pluginPaths)
+        {
+            auto it = pending.find(path);
+            if (it != pending.end() and it->second == module) pending.erase(it);
+        }
+        if (pending.empty()) getHasPendingLazyModules() = false;
+        if (not loaded) continue;
+        auto &loadedModules = getLoadedLazyModules();
+        if (std::find_if(loadedModules.begin(), loadedModules.end(), [&loaded](const Pothos::PluginModule &m)
+            {return m.getFilePath() == loaded.getFilePath();}) == loadedModules.end()) loadedModules.push_back(loaded);
+    }
+}
+
+//! Is a module that provides the plugin path still waiting for its load?
+bool lazyModuleIsPending(const std::string &pluginPath)
+{
+    std::lock_guard<std::mutex> lock(getLazyModulesMutex());
+    return getPendingLazyModules().count(pluginPath) != 0;
+}
+
+//! Drop the pending modules and unload the lazy modules that were loaded
+void lazyModuleClear(void)
+{
+    std::vector<Pothos::PluginModule> loaded;
+    {
+        std::lock_guard<std::mutex> lock(getLazyModulesMutex());
+        getPendingLazyModules().clear();
+        getHasPendingLazyModules() = false;
+        loaded.swap(getLoadedLazyModules());
+    }
+    loaded.clear();
+}
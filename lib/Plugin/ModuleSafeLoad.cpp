@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/System/Paths.hpp>
@@ -7,12 +7,23 @@
 #include <Pothos/Util/FileLock.hpp>
 #include <Poco/Process.h>
 #include <Poco/Pipe.h>
+#include <Poco/PipeStream.h>
 #include <Poco/File.h>
 #include <Poco/Path.h>
+#include <Poco/TemporaryFile.h>
+#include <Poco/Logger.h>
+#include <Poco/Format.h>
 #include <Poco/AutoPtr.h>
 #include <Poco/Util/PropertyFileConfiguration.h>
+#include <algorithm> //min
+#include <fstream>
+#include <thread>
+#include <future>
+#include <chrono>
 #include <mutex>
 #include <cctype>
+#include <cstdlib> //strtoll
+#include <map>
 
 //! The path used to cache the safe loads
 static std::string getModuleLoaderCachePath(void)
@@ -85,8 +96,8 @@ static bool previousLoadWasSuccessful(const std::string &modulePath)
     return false;
 }
 
-//! Mark that the safe load of this module was successful
-static void markCurrentLoadSuccessful(const std::string &modulePath)
+//! Mark that the safe load of these modules was successful
+static void markCurrentLoadSuccessful(const std::vector<std::string> &modulePaths)
 {
     std::lock_guard<std::mutex> mutexLock(getLoaderMutex());
     std::lock_guard<Pothos::Util::FileLock> fileLock(getLoaderFileLock());
@@ -94,12 +105,207 @@ static void markCurrentLoadSuccessful(const std::string &modulePath)
     try {cache->load(getModuleLoaderCachePath());} catch(...){}
 
     auto libTime = getLastModifiedTimeStr(Pothos::System::getPothosRuntimeLibraryPath());
-    auto modTime = getLastModifiedTimeStr(modulePath);
     cache->setString(escape(Pothos::System::getPothosRuntimeLibraryPath()), libTime);
-    cache->setString(escape(modulePath), modTime);
+    for (const auto &modulePath : modulePaths)
+    {
+        cache->setString(escape(modulePath), getLastModifiedTimeStr(modulePath));
+    }
     try {cache->save(getModuleLoaderCachePath());} catch(...){}
 }
 
+static void markCurrentLoadSuccessful(const std::string &modulePath)
+{
+    markCurrentLoadSuccessful(std::vector<std::string>(1, modulePath));
+}
+
+/***********************************************************************
+ * batch validation in helper processes
+ **********************************************************************/
+//! Modules slower than this to load and unload are reported
+static const long long SLOW_MODULE_LOAD_US = 1000000;
+
+struct ModuleValidation
+{
+    ModuleValidation(void):
+        success(false),
+        loadTimeUs(-1){}
+    bool success;
+    long long loadTimeUs; //-1 when unknown
+    std::string error;
+};
+
+//! The prefix of the progress lines, see PothosUtilLoadModule.cpp
+static const std::string LOAD_MODULES_PREFIX("pothos-load-modules\t");
+
+/*!
+ * Parse a progress line from the helper into its fields.
+ * Return false for any other output and for malformed lines.
+ */
+static bool parseLoadModulesLine(const std::string &line, std::string &status, long long &loadTimeUs, std::string &path)
+{
+    if (line.compare(0, LOAD_MODULES_PREFIX.size(), LOAD_MODULES_PREFIX) != 0) return false;
+    const auto tab0 = line.find('\t', LOAD_MODULES_PREFIX.size());
+    if (tab0 == std::string::npos) return false;
+    status = line.substr(LOAD_MODULES_PREFIX.size(), tab0-LOAD_MODULES_PREFIX.size());
+    if (status == "loading")
+    {
+        loadTimeUs = -1;
+        path = line.substr(tab0+1);
+        return not path.empty();
+    }
+    if (status != "loaded" and status != "failed") return false;
+    const auto tab1 = line.find('\t', tab0+1);
+    if (tab1 == std::string::npos) return false;
+    const auto timeStr = line.substr(tab0+1, tab1-tab0-1);
+    char *end = nullptr;
+    loadTimeUs = std::strtoll(timeStr.c_str(), &end, 10);
+    if (timeStr.empty() or *end != '\0' or loadTimeUs < 0) return false;
+    path = line.substr(tab1+1);
+    return not path.empty();
+}
+
+/*!
+ * Test load a list of modules in one PothosUtil --load-modules process.
+ * A module that crashes the helper is marked failed,
+ * and a new helper continues with the modules after it.
+ */
+static void validateModulesInHelper(std::vector<std::string> paths, std::map<std::string, ModuleValidation> &results)
+{
+    while (not paths.empty())
+    {
+        //launch with a file that lists the paths
+        Poco::TemporaryFile listFile;
+        {
+            std::ofstream os(listFile.path().c_str());
+            for (const auto &path : paths) os << path << "\n";
+        }
+        Poco::Pipe outPipe;
+        Poco::Process::Args args;
+        args.push_back("--load-modules");
+        args.push_back("\""+listFile.path()+"\""); //add quotes for paths with spaces
+        Poco::Process::Env env;
+        Poco::ProcessHandle ph(Poco::Process::launch(
+            Pothos::System::getPothosUtilExecutablePath(),
+            args, nullptr, &outPipe, nullptr, env));
+
+        //parse the progress of each module, ignore other module output
+        std::string current;
+        Poco::PipeInputStream is(outPipe);
+        std::string line, status, path;
+        long long loadTimeUs(-1);
+        while (std::getline(is, line))
+        {
+            if (not parseLoadModulesLine(line, status, loadTimeUs, path)) continue;
+            if (status == "loading")
+            {
+                current = path;
+                continue;
+            }
+            auto &result = results[path];
+            result.success = (status == "loaded");
+            result.loadTimeUs = loadTimeUs;
+            if (not result.success) result.error = "failed safe load";
+            current.clear();
+        }
+        outPipe.close();
+        ph.wait();
+
+        //the module in progress took down the helper
+        if (not current.empty()) results[current].error = "crashed during safe load";
+
+        //continue with the unresolved modules, give up when none resolved
+        std::vector<std::string> remaining;
+        for (const auto &path : paths)
+        {
+            if (results.count(path) == 0) remaining.push_back(path);
+        }
+        if (remaining.size() == paths.size())
+        {
+            for (const auto &path : paths) results[path].error = "failed safe load";
+            break;
+        }
+        paths.swap(remaining);
+    }
+}
+
+//! Validate a group of modules, a helper that cannot run fails the group
+static std::map<std::string, ModuleValidation> validateModuleGroup(const std::vector<std::string> &paths)
+{
+    std::map<std::string, ModuleValidation> results;
+    std::string error;
+    try
+    {
+        validateModulesInHelper(paths, results);
+    }
+    catch (const Poco::Exception &ex)
+    {
+        error = ex.displayText();
+    }
+    catch (const std::exception &ex)
+    {
+        error = ex.what();
+    }
+    if (error.empty()) return results;
+
+    //keep the modules that were resolved before the failure
+    for (const auto &path : paths)
+    {
+        if (results.count(path) == 0) results[path].error = "safe load helper failed: " + error;
+    }
+    return results;
+}
+
+std::map<std::string, std::string> safeLoadValidateModules(const std::vector<std::string> &paths)
+{
+    //only modules without a successful previous load need validation
+    std::vector<std::string> unknownPaths;
+    for (const auto &path : paths)
+    {
+        if (not previousLoadWasSuccessful(path)) unknownPaths.push_back(path);
+    }
+    if (unknownPaths.empty()) return std::map<std::string, std::string>();
+
+    //split the modules among parallel helpers
+    const size_t numHelpers = std::min<size_t>(unknownPaths.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::vector<std::string>> groups(numHelpers);
+    for (size_t i = 0; i < unknownPaths.size(); i++) groups[i%numHelpers].push_back(unknownPaths[i]);
+
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    std::vector<std::future<std::map<std::string, ModuleValidation>>> futures;
+    for (const auto &group : groups)
+    {
+        futures.push_back(std::async(std::launch::async, &validateModuleGroup, group));
+    }
+    std::map<std::string, ModuleValidation> results;
+    for (auto &future : futures)
+    {
+        const auto groupResults = future.get();
+        results.insert(groupResults.begin(), groupResults.end());
+    }
+    const auto t1 = std::chrono::high_resolution_clock::now();
+
+    //report the timings and record the successful loads
+    auto &logger = Poco::Logger::get("Pothos.PluginModule.safeLoad");
+    std::vector<std::string> successPaths;
+    std::map<std::string, std::string> errors;
+    for (const auto &path : unknownPaths)
+    {
+        const auto &result = results[path];
+        if (result.success) successPaths.push_back(path);
+        else errors[path] = result.error.empty()?"failed safe load":result.error;
+
+        //modules without a time crashed or never ran, the loader logs their errors
+        if (result.loadTimeUs < 0) continue;
+        if (result.loadTimeUs >= SLOW_MODULE_LOAD_US) poco_warning_f2(logger,
+            "slow module load %s: %d ms", path, int(result.loadTimeUs/1000));
+        else poco_debug_f2(logger, "module load %s: %d us", path, int(result.loadTimeUs));
+    }
+    markCurrentLoadSuccessful(successPaths);
+    poco_information_f3(logger, "validated %z modules with %z helpers in %d ms", unknownPaths.size(), numHelpers,
+        int(std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0).count()));
+    return errors;
+}
+
 /***********************************************************************
  * module safe load implementation
  **********************************************************************/
@@ -0,0 +1,142 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Plugin/Profile.hpp>
+#include <Poco/Environment.h>
+#include <json.hpp>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+using json = nlohmann::json;
+
+/***********************************************************************
+ * profile storage
+ **********************************************************************/
+struct PluginProfileState
+{
+    PluginProfileState(void):
+        startTime(std::chrono::high_resolution_clock::now())
+    {}
+    std::mutex mutex;
+    std::chrono::high_resolution_clock::time_point startTime;
+    std::vector<Pothos::PluginProfile::Record> records;
+    std::unordered_map<std::thread::id, size_t> threadIndexes;
+};
+
+static PluginProfileState &getProfileState(void)
+{
+    static PluginProfileState state;
+    return state;
+}
+
+//! The environment variable enables the profile for the static initialization of the library itself
+static std::atomic<bool> &getProfileEnabled(void)
+{
+    static std::atomic<bool> enabled(Poco::Environment::get("POTHOS_STARTUP_PROFILE", "0") == "1");
+    return enabled;
+}
+
+static long long elapsedUs(const PluginProfileState &state)
+{
+    const auto now = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now - state.startTime).count();
+}
+
+/***********************************************************************
+ * profile implementation
+ **********************************************************************/
+Pothos::PluginProfile::Record::Record(void):
+    threadIndex(0),
+    startUs(0),
+    durationUs(0)
+{
+    return;
+}
+
+void Pothos::PluginProfile::setEnabled(const bool enabled)
+{
+    auto &state = getProfileState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (enabled and not getProfileEnabled())
+    {
+        state.startTime = std::chrono::high_resolution_clock::now();
+        state.records.clear();
+        state.threadIndexes.clear();
+    }
+    getProfileEnabled() = enabled;
+}
+
+bool Pothos::PluginProfile::isEnabled(void)
+{
+    return getProfileEnabled();
+}
+
+std::vector<Pothos::PluginProfile::Record> Pothos::PluginProfile::getRecords(void)
+{
+    auto &state = getProfileState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.records;
+}
+
+std::string Pothos::PluginProfile::toChromeTrace(void)
+{
+    json traceEvents(json::array());
+    for (const auto &record : getRecords())
+    {
+        json event;
+        event["name"] = record.name;
+        event["cat"] = record.category;
+        event["ph"] = "X"; //complete event with a duration
+        event["ts"] = record.startUs;
+        event["dur"] = record.durationUs;
+        event["pid"] = 1;
+        event["tid"] = record.threadIndex;
+        if (not record.detail.empty()) event["args"]["detail"] = record.detail;
+        traceEvents.push_back(event);
+    }
+    json top;
+    top["traceEvents"] = traceEvents;
+    top["displayTimeUnit"] = "ms";
+    return top.dump();
+}
+
+/***********************************************************************
+ * scope implementation
+ **********************************************************************/
+Pothos::PluginProfile::Scope::Scope(const char *category, const std::string &name, const std::string &detail):
+    _record(nullptr)
+{
+    if (not getProfileEnabled()) return;
+    _record = new Record();
+    _record->category = category;
+    _record->name = name;
+    _record->detail = detail;
+
+    auto &state = getProfileState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto &threadIndexes = state.threadIndexes;
+    auto it = threadIndexes.find(std::this_thread::get_id());
+    if (it == threadIndexes.end()) it = threadIndexes.emplace(std::this_thread::get_id(), threadIndexes.size()).first;
+    _record->threadIndex = it->second;
+    _record->startUs = elapsedUs(state);
+}
+
+Pothos::PluginProfile::Scope::~Scope(void)
+{
+    if (_record == nullptr) return;
+    auto &state = getProfileState();
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        _record->durationUs = elapsedUs(state) - _record->startUs;
+        if (getProfileEnabled()) state.records.push_back(std::move(*_record));
+    }
+    delete _record;
+}
+
+void Pothos::PluginProfile::Scope::setDetail(const std::string &detail)
+{
+    if (_record != nullptr) _record->detail = detail;
+}
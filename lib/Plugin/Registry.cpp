@@ -1,8 +1,10 @@
-// Copyright (c) 2013-2018 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "Util/PublishedTable.hpp"
 #include <Pothos/Plugin/Registry.hpp>
 #include <Pothos/Plugin/Exception.hpp>
+#include <Pothos/Plugin/Profile.hpp>
 #include <Pothos/Util/SpinLockRW.hpp>
 #include <Pothos/Callable.hpp> //gets call implementation
 #include <Poco/Logger.h>
@@ -22,23 +24,13 @@ static Pothos::Util::SpinLockRW &getRegistryMutex(void)
 struct RegistryEntry
 {
     RegistryEntry(void):
-        hasPlugin(false){}
+        hasPlugin(false),
+        numPlugins(0){}
     Pothos::Plugin plugin;
     bool hasPlugin;
+    size_t numPlugins; //number of plugins here and deeper
     std::vector<std::string> nodeNamesOrdered; //so we know the order that they were added
     std::map<std::string, RegistryEntry> nodes;
-
-    //count number of plugins here and deeper
-    size_t getNumPlugins(void) const
-    {
-        size_t count = 0;
-        if (this->hasPlugin) count++;
-        for (const auto &entry : this->nodes)
-        {
-            count += entry.second.getNumPlugins();
-        }
-        return count;
-    }
 };
 
 static RegistryEntry &getRegistryRoot(void)
@@ -47,6 +39,75 @@ static RegistryEntry &getRegistryRoot(void)
     return regRoot;
 }
 
+//! Find the entry at the path without creating nodes, call with the registry mutex held
+static const RegistryEntry *findRegistryEntry(const Pothos::PluginPath &path)
+{
+    const RegistryEntry *root = &getRegistryRoot();
+    for (const auto &name : path.listNodes())
+    {
+        //next node in the tree at this node name
+        auto it = root->nodes.find(name);
+        if (it == root->nodes.end()) return nullptr;
+        root = &it->second;
+    }
+    return root;
+}
+
+/***********************************************************************
+ * registry lookup table
+ **********************************************************************/
+struct RegistryLookupEntry
+{
+    Pothos::Plugin plugin;
+    bool hasPlugin;
+    size_t numPlugins;
+};
+
+/*!
+ * Lookups by path string, updated along with the tree on every change,
+ * so that get(), empty(), and exists() never take the registry lock.
+ * The table is written with the registry mutex held exclusively.
+ */
+static PublishedTable<std::string, RegistryLookupEntry> &getRegistryLookupTable(void)
+{
+    static PublishedTable<std::string, RegistryLookupEntry> table;
+    return table;
+}
+
+//! The lookup key: the path string without a trailing slash
+static std::string registryLookupKey(const Pothos::PluginPath &path)
+{
+    auto key = path.toString();
+    while (key.size() > 1 and key.back() == '/') key.pop_back();
+    return key;
+}
+
+//! Find the lookup entry for a path, null when there never were plugins here or deeper
+static const RegistryLookupEntry *findLookupEntry(const Pothos::PluginPath &path)
+{
+    return getRegistryLookupTable().find(registryLookupKey(path));
+}
+
+/*!
+ * Count a plugin that was added or removed at the path into the tree,
+ * and publish the lookup entries along the path.
+ * Call with the registry mutex held exclusively.
+ */
+static void updateRegistryPath(const std::vector<std::string> &pathNodes, const bool added)
+{
+    RegistryEntry *root = &getRegistryRoot();
+    std::string key("/");
+    for (size_t i = 0;; i++)
+    {
+        if (added) root->numPlugins++;
+        else root->numPlugins--;
+        getRegistryLookupTable().publish(key, RegistryLookupEntry{root->plugin, root->hasPlugin, root->numPlugins});
+        if (i == pathNodes.size()) return;
+        key += ((i == 0)?"":"/") + pathNodes[i];
+        root = &root->nodes.at(pathNodes[i]);
+    }
+}
+
 /***********************************************************************
  * plugin event handler
  **********************************************************************/
@@ -63,9 +124,15 @@ static bool canObjectHandleEvent(const Pothos::Object &obj)
     return true;
 }
 
-static void callPluginEventHandler(const Pothos::Object &handler, const Pothos::Plugin &plugin, const std::string &event)
+static void callPluginEventHandler(const Pothos::Plugin &handlerPlugin, const Pothos::Plugin &plugin, const std::string &event)
 {
+    const auto &handler = handlerPlugin.getObject();
     if (not canObjectHandleEvent(handler)) return;
+    //the path strings are only built when profiling, events happen for every plugin
+    const bool profiling = Pothos::PluginProfile::isEnabled();
+    Pothos::PluginProfile::Scope profile("event",
+        profiling?handlerPlugin.getPath().toString():std::string(),
+        profiling?plugin.getPath().toString():std::string());
     POTHOS_EXCEPTION_TRY
     {
         handler.extract<Pothos::Callable>().call(plugin, event);
@@ -87,27 +154,28 @@ static void handlePluginEvent(const Pothos::Plugin &plugin, const std::string &e
     {
         Pothos::Util::SpinLockRW::SharedLock lock(getRegistryMutex());
         const std::vector<std::string> pathNodes = path.listNodes();
-        RegistryEntry *root = &getRegistryRoot();
+        const RegistryEntry *root = &getRegistryRoot();
 
-        for (size_t i = 0; i+1 < pathNodes.size(); i++)
+        for (size_t i = 0; root != nullptr and i+1 < pathNodes.size(); i++)
         {
             parentPlugins.insert(parentPlugins.begin(), root->plugin);
             //next node in the tree at this node name
-            root = &root->nodes[pathNodes[i]];
+            auto it = root->nodes.find(pathNodes[i]);
+            root = (it == root->nodes.end())?nullptr:&it->second;
         }
-        parentPlugins.insert(parentPlugins.begin(), root->plugin);
+        if (root != nullptr) parentPlugins.insert(parentPlugins.begin(), root->plugin);
     }
 
     //traverse back up the plugin tree -- calling all potential handlers
     for (size_t i = 0; i < parentPlugins.size(); i++)
     {
-        callPluginEventHandler(parentPlugins[i].getObject(), plugin, event);
+        callPluginEventHandler(parentPlugins[i], plugin, event);
     }
 }
 
 //if the plugin is an event handler, and it just got added,
 //then what we do is do the event add on all sub-tree plugins
-static void handleMissedSubTreeEvents(const Pothos::Object &handler, const Pothos::PluginPath &path)
+static void handleMissedSubTreeEvents(const Pothos::Plugin &handler, const Pothos::PluginPath &path)
 {
     for (const auto &subdir : Pothos::PluginRegistry::list(path))
     {
@@ -138,8 +206,22 @@ void registrySetActiveModuleLoading(const Pothos::PluginModule &module)
     getActiveModuleLoading() = module;
 }
 
+/***********************************************************************
+ * lazy module loading on lookup
+ **********************************************************************/
+//from lib/Plugin/ModuleIndex.cpp
+void lazyModuleLoad(const std::string &pluginPath, const bool subTree);
+
+static void loadLazyModules(const Pothos::PluginPath &path, const bool subTree)
+{
+    lazyModuleLoad(path.toString(), subTree);
+}
+
 void updatePluginAssociation(const std::string &action, const Pothos::Plugin &plugin);
 
+//from lib/Framework/BlockRegistry.cpp
+void invalidateBlockFactoryCache(void);
+
 /***********************************************************************
  * Registry implementation
  **********************************************************************/
@@ -150,6 +232,8 @@ void Pothos::PluginRegistry::add(const Plugin &plugin_)
     const PluginPath &path = plugin.getPath();
 
     poco_debug(Poco::Logger::get("Pothos.PluginRegistry.add"), plugin.toString());
+    const bool profiling = PluginProfile::isEnabled();
+    PluginProfile::Scope profile("plugin", profiling?path.toString():std::string());
 
     {
         std::lock_guard<Pothos::Util::SpinLockRW> lock(getRegistryMutex());
@@ -179,31 +263,23 @@ void Pothos::PluginRegistry::add(const Plugin &plugin_)
         updatePluginAssociation("add", plugin);
         root->hasPlugin = true;
         root->plugin = plugin;
+        updateRegistryPath(pathNodes, true);
     }
 
     handlePluginEvent(plugin, "add");
-    handleMissedSubTreeEvents(plugin.getObject(), plugin.getPath());
+    if (not canObjectHandleEvent(plugin.getObject())) return;
+    PluginProfile::Scope subTreeProfile("subtree", profiling?path.toString():std::string());
+    handleMissedSubTreeEvents(plugin, plugin.getPath());
 }
 
 Pothos::Plugin Pothos::PluginRegistry::get(const PluginPath &path)
 {
-    Pothos::Util::SpinLockRW::SharedLock lock(getRegistryMutex());
-    const std::vector<std::string> pathNodes = path.listNodes();
-    RegistryEntry *root = &getRegistryRoot();
-
-    for (size_t i = 0; i < pathNodes.size(); i++)
-    {
-        //next node in the tree at this node name
-        root = &root->nodes[pathNodes[i]];
-    }
+    loadLazyModules(path, false);
+    const auto entry = findLookupEntry(path);
+    if (entry != nullptr and entry->hasPlugin) return entry->plugin;
 
     //throw if the root does not have a plugin
-    if (not root->hasPlugin)
-    {
-        throw Pothos::PluginRegistryError("Pothos::PluginRegistry::get("+path.toString()+")", "plugin path not found");
-    }
-
-    return root->plugin;
+    throw Pothos::PluginRegistryError("Pothos::PluginRegistry::get("+path.toString()+")", "plugin path not found");
 }
 
 Pothos::Plugin Pothos::PluginRegistry::remove(const PluginPath &path)
@@ -233,58 +309,40 @@ Pothos::Plugin Pothos::PluginRegistry::remove(const PluginPath &path)
         updatePluginAssociation("remove", plugin);
         root->hasPlugin = false;
         root->plugin = Plugin(); //clears
+        updateRegistryPath(pathNodes, false);
     }
 
+    //block factories resolved from the removed plugin are stale
+    const auto pathNodes = path.listNodes();
+    if (not pathNodes.empty() and pathNodes.front() == "blocks") invalidateBlockFactoryCache();
+
     handlePluginEvent(plugin, "remove");
     return plugin;
 }
 
 bool Pothos::PluginRegistry::empty(const PluginPath &path)
 {
-    Pothos::Util::SpinLockRW::SharedLock lock(getRegistryMutex());
-    const std::vector<std::string> pathNodes = path.listNodes();
-    RegistryEntry *root = &getRegistryRoot();
-
-    for (size_t i = 0; i < pathNodes.size(); i++)
-    {
-        //next node in the tree at this node name
-        root = &root->nodes[pathNodes[i]];
-    }
-
-    return not root->hasPlugin;
+    loadLazyModules(path, false);
+    const auto entry = findLookupEntry(path);
+    return entry == nullptr or not entry->hasPlugin;
 }
 
 bool Pothos::PluginRegistry::exists(const PluginPath &path)
 {
-    Pothos::Util::SpinLockRW::SharedLock lock(getRegistryMutex());
-    const std::vector<std::string> pathNodes = path.listNodes();
-    RegistryEntry *root = &getRegistryRoot();
-
-    for (size_t i = 0; i < pathNodes.size(); i++)
-    {
-        //next node in the tree at this node name
-        root = &root->nodes[pathNodes[i]];
-    }
-
-    return root->getNumPlugins() != 0;
+    loadLazyModules(path, true);
+    const auto entry = findLookupEntry(path);
+    return entry != nullptr and entry->numPlugins != 0;
 }
 
 std::vector<std::string> Pothos::PluginRegistry::list(const PluginPath &path)
 {
+    loadLazyModules(path, true);
     Pothos::Util::SpinLockRW::SharedLock lock(getRegistryMutex());
-    const std::vector<std::string> pathNodes = path.listNodes();
-    RegistryEntry *root = &getRegistryRoot();
-
-    for (size_t i = 0; i < pathNodes.size(); i++)
-    {
-        //next node in the tree at this node name
-        root = &root->nodes[pathNodes[i]];
-    }
-
+    const auto root = findRegistryEntry(path);
     std::vector<std::string> nodes;
-    for (const auto &name : root->nodeNamesOrdered)
+    if (root != nullptr) for (const auto &name : root->nodeNamesOrdered)
     {
-        if (root->nodes[name].getNumPlugins() != 0) nodes.push_back(name);
+        if (root->nodes.at(name).numPlugins != 0) nodes.push_back(name);
     }
     return nodes;
 }
@@ -314,6 +372,7 @@ static void loadInfoDump(const Pothos::PluginPath &path, const RegistryEntry &en
 
 Pothos::PluginRegistryInfoDump Pothos::PluginRegistry::dump(void)
 {
+    loadLazyModules(PluginPath(), true);
     Pothos::Util::SpinLockRW::SharedLock lock(getRegistryMutex());
     PluginRegistryInfoDump dump;
     loadInfoDump(PluginPath(), getRegistryRoot(), dump);
@@ -1,12 +1,25 @@
-// Copyright (c) 2013-2014 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Plugin.hpp>
 #include <Pothos/Testing.hpp>
+#include <Poco/TemporaryFile.h>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <fstream>
 #include <algorithm>
+#include <map>
+#include <set>
+
+//from lib/Plugin/ModuleIndex.cpp
+std::map<std::string, std::vector<std::string>> moduleIndexLoadFile(const std::string &indexPath, const std::vector<std::string> &modulePaths);
+void moduleIndexStoreFile(const std::string &indexPath,
+    const std::map<std::string, std::vector<std::string>> &modules,
+    const std::set<std::string> &archive);
+void lazyModuleRegister(const std::string &modulePath, const std::vector<std::string> &pluginPaths);
+void lazyModuleLoad(const std::string &pluginPath, const bool subTree);
+bool lazyModuleIsPending(const std::string &pluginPath);
 
 POTHOS_TEST_BLOCK("/plugin/tests", test_plugin_path)
 {
@@ -57,3 +70,100 @@ POTHOS_TEST_BLOCK("/plugin/tests", test_plugin_registry)
     POTHOS_TEST_THROWS(Pothos::PluginRegistry::get(Pothos::PluginPath("/tests")), Pothos::PluginRegistryError);
     POTHOS_TEST_THROWS(Pothos::PluginRegistry::remove(Pothos::PluginPath("/tests/foo")), Pothos::PluginRegistryError);
 }
+
+POTHOS_TEST_BLOCK("/plugin/tests", test_plugin_registry_snapshot)
+{
+    Pothos::PluginRegistry::add(Pothos::Plugin("/tests/snapshot/s0", Pothos::Object(0)));
+    Pothos::PluginRegistry::add(Pothos::Plugin("/tests/snapshot/sub/s1", Pothos::Object(1)));
+
+    //lookups without the lock agree with the tree
+    for (size_t i = 0; i < 200; i++)
+    {
+        POTHOS_TEST_EQUAL(Pothos::PluginRegistry::get(Pothos::PluginPath("/tests/snapshot/s0")).getObject().extract<int>(), 0);
+        POTHOS_TEST_EQUAL(Pothos::PluginRegistry::get(Pothos::PluginPath("/tests/snapshot/sub/s1")).getObject().extract<int>(), 1);
+        POTHOS_TEST_TRUE(Pothos::PluginRegistry::exists(Pothos::PluginPath("/tests/snapshot/sub")));
+        POTHOS_TEST_TRUE(Pothos::PluginRegistry::empty(Pothos::PluginPath("/tests/snapshot/sub")));
+        POTHOS_TEST_FALSE(Pothos::PluginRegistry::exists(Pothos::PluginPath("/tests/snapshot/nope")));
+        POTHOS_TEST_EQUAL(Pothos::PluginRegistry::list(Pothos::PluginPath("/tests/snapshot")).size(), 2);
+    }
+
+    //changes are visible immediately
+    Pothos::PluginRegistry::remove(Pothos::PluginPath("/tests/snapshot/sub/s1"));
+    POTHOS_TEST_FALSE(Pothos::PluginRegistry::exists(Pothos::PluginPath("/tests/snapshot/sub")));
+    POTHOS_TEST_THROWS(Pothos::PluginRegistry::get(Pothos::PluginPath("/tests/snapshot/sub/s1")), Pothos::PluginRegistryError);
+    for (size_t i = 0; i < 200; i++)
+    {
+        POTHOS_TEST_EQUAL(Pothos::PluginRegistry::list(Pothos::PluginPath("/tests/snapshot")).size(), 1);
+    }
+    Pothos::PluginRegistry::remove(Pothos::PluginPath("/tests/snapshot/s0"));
+    POTHOS_TEST_FALSE(Pothos::PluginRegistry::exists(Pothos::PluginPath("/tests/snapshot")));
+
+    //a path that is added again publishes its new plugin
+    Pothos::PluginRegistry::add(Pothos::Plugin("/tests/snapshot/s0", Pothos::Object(2)));
+    POTHOS_TEST_EQUAL(Pothos::PluginRegistry::get(Pothos::PluginPath("/tests/snapshot/s0")).getObject().extract<int>(), 2);
+    POTHOS_TEST_TRUE(Pothos::PluginRegistry::exists(Pothos::PluginPath("/tests/snapshot")));
+    Pothos::PluginRegistry::remove(Pothos::PluginPath("/tests/snapshot/s0"));
+}
+
+POTHOS_TEST_BLOCK("/plugin/tests", test_plugin_profile)
+{
+    Pothos::PluginProfile::setEnabled(true);
+    Pothos::PluginRegistry::add(Pothos::Plugin("/tests/profile/p0", Pothos::Object(0)));
+    Pothos::PluginProfile::setEnabled(false);
+    Pothos::PluginRegistry::remove(Pothos::PluginPath("/tests/profile/p0"));
+
+    //the add was recorded, the remove after disabling was not
+    const auto records = Pothos::PluginProfile::getRecords();
+    const auto found = std::find_if(records.begin(), records.end(), [](const Pothos::PluginProfile::Record &r)
+    {
+        return r.category == "plugin" and r.name == "/tests/profile/p0";
+    });
+    POTHOS_TEST_TRUE(found != records.end());
+    POTHOS_TEST_TRUE(found->durationUs >= 0);
+    POTHOS_TEST_TRUE(Pothos::PluginProfile::toChromeTrace().find("/tests/profile/p0") != std::string::npos);
+}
+
+POTHOS_TEST_BLOCK("/plugin/tests", test_module_index)
+{
+    Poco::TemporaryFile indexFile, blocksFile, archiveFile;
+    std::ofstream(blocksFile.path()) << "blocks";
+    std::ofstream(archiveFile.path()) << "archive";
+
+    std::map<std::string, std::vector<std::string>> modules;
+    modules[blocksFile.path()] = {"/blocks/tests/b0", "/blocks/tests/b1"};
+    modules[archiveFile.path()] = {"/blocks/tests/b2"};
+    moduleIndexStoreFile(indexFile.path(), modules, {archiveFile.path()});
+
+    //the plugin paths round trip, modules with serialization entries are left out
+    auto index = moduleIndexLoadFile(indexFile.path(), {blocksFile.path(), archiveFile.path()});
+    POTHOS_TEST_EQUAL(index.size(), 1);
+    POTHOS_TEST_EQUAL(index[blocksFile.path()].size(), 2);
+    POTHOS_TEST_EQUAL(index[blocksFile.path()][0], "/blocks/tests/b0");
+    POTHOS_TEST_EQUAL(index[blocksFile.path()][1], "/blocks/tests/b1");
+
+    //a module that changed since indexing is not in the index
+    std::ofstream(blocksFile.path(), std::ios::app) << "changed";
+    index = moduleIndexLoadFile(indexFile.path(), {blocksFile.path(), archiveFile.path()});
+    POTHOS_TEST_TRUE(index.empty());
+}
+
+POTHOS_TEST_BLOCK("/plugin/tests", test_lazy_module_lookup)
+{
+    //the module files do not exist, a load attempt logs an error and drops the module
+    lazyModuleRegister("/tests/lazy/m0", {"/blocks/tests_lazy/m0"});
+    lazyModuleRegister("/tests/lazy/m1", {"/blocks/tests_lazy/sub/m1"});
+
+    //an exact lookup only matches the path itself
+    lazyModuleLoad("/blocks/tests_lazy", false);
+    POTHOS_TEST_TRUE(lazyModuleIsPending("/blocks/tests_lazy/m0"));
+    POTHOS_TEST_TRUE(lazyModuleIsPending("/blocks/tests_lazy/sub/m1"));
+    lazyModuleLoad("/blocks/tests_lazy/m0", false);
+    POTHOS_TEST_FALSE(lazyModuleIsPending("/blocks/tests_lazy/m0"));
+    POTHOS_TEST_TRUE(lazyModuleIsPending("/blocks/tests_lazy/sub/m1"));
+
+    //a subtree lookup matches paths below, but not paths sharing a name prefix
+    lazyModuleLoad("/blocks/tests_lazy/su", true);
+    POTHOS_TEST_TRUE(lazyModuleIsPending("/blocks/tests_lazy/sub/m1"));
+    lazyModuleLoad("/blocks/tests_lazy", true);
+    POTHOS_TEST_FALSE(lazyModuleIsPending("/blocks/tests_lazy/sub/m1"));
+}
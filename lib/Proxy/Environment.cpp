@@ -1,8 +1,10 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Proxy/Exception.hpp>
 #include <Pothos/Proxy/Environment.hpp>
+#include <Pothos/Proxy/Containers.hpp>
+#include <Pothos/Proxy/Handle.hpp>
 #include <Pothos/Callable.hpp>
 #include <Pothos/Plugin.hpp>
 #include <Pothos/System/HostInfo.hpp>
@@ -50,6 +52,64 @@ std::string Pothos::ProxyEnvironment::getPeeringAddress(void)
     return "local";
 }
 
+Pothos::ProxyBatchCall::ProxyBatchCall(const Proxy &object, const std::string &name, const ObjectVector &args):
+    object(object),
+    resultIndex(0),
+    name(name),
+    args(args),
+    toLocal(false)
+{
+    return;
+}
+
+Pothos::ProxyBatchCall::ProxyBatchCall(const size_t resultIndex, const std::string &name, const ObjectVector &args):
+    resultIndex(resultIndex),
+    name(name),
+    args(args),
+    toLocal(false)
+{
+    return;
+}
+
+std::vector<std::future<Pothos::Object>> Pothos::ProxyEnvironment::callBatch(const std::vector<ProxyBatchCall> &calls)
+{
+    std::vector<Proxy> results(calls.size());
+    std::vector<std::future<Object>> futures;
+    futures.reserve(calls.size());
+    for (size_t i = 0; i < calls.size(); i++)
+    {
+        const auto &call = calls[i];
+        std::promise<Object> promise;
+        try
+        {
+            auto object = call.object;
+            if (not object)
+            {
+                if (call.resultIndex >= i or not results[call.resultIndex]) throw Pothos::ProxyHandleCallError(
+                    "Pothos::ProxyEnvironment::callBatch("+call.name+")", "no result at index "+std::to_string(call.resultIndex));
+                object = results[call.resultIndex];
+            }
+
+            ProxyVector args;
+            for (const auto &arg : call.args)
+            {
+                if (arg.type() == typeid(Proxy)) args.push_back(arg.extract<Proxy>());
+                else args.push_back(this->convertObjectToProxy(arg));
+            }
+
+            auto result = object.getHandle()->call(call.name, args.data(), args.size());
+            if (call.toLocal) promise.set_value(this->convertProxyToObject(result));
+            else promise.set_value(Object(results[i] = result));
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+        futures.push_back(promise.get_future());
+    }
+    return futures;
+}
+
 #include <Pothos/Managed.hpp>
 
 static auto managedProxyEnvironment = Pothos::ManagedClass()
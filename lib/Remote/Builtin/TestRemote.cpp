@@ -1,21 +1,30 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "Remote/RemoteProxyDatagram.hpp"
 #include <Pothos/Testing.hpp>
 #include <Pothos/Plugin.hpp>
 #include <Pothos/Proxy.hpp>
 #include <Pothos/Remote.hpp>
 #include <Pothos/Managed.hpp>
+#include <Pothos/Framework/BufferChunk.hpp>
 #include <Pothos/Util/Network.hpp>
+#include <Poco/Net/StreamSocket.h>
+#include <Poco/Net/SocketStream.h>
+#include <Poco/Net/SocketAddress.h>
 #include <Poco/Pipe.h>
 #include <Poco/PipeStream.h>
 #include <Poco/URI.h>
 #include <iostream>
+#include <sstream>
 #include <future>
+#include <atomic>
 #include <thread>
 #include <cstdlib>
 #include <complex>
 #include <algorithm>
+#include <chrono>
+#include <memory>
 #include <cstdlib> //atoi
 
 class SuperBar
@@ -120,6 +129,19 @@ static void test_simple_runner(Pothos::ProxyEnvironment::Sptr env)
     auto superBarInstance4 = superFooProxy.call("makeShared", 987);
     POTHOS_TEST_EQUAL(superBarInstance4.call<int>("getBar"), 987);
 
+    //test a batch of calls with earlier results and local arguments
+    std::vector<Pothos::ProxyBatchCall> calls;
+    calls.emplace_back(superFooProxy, "make", Pothos::ObjectVector{Pothos::Object(11)});
+    calls.emplace_back(size_t(0), "setBar", Pothos::ObjectVector{Pothos::Object(22)});
+    calls.emplace_back(size_t(0), "getBar");
+    calls.back().toLocal = true;
+    calls.emplace_back(superFooProxy, "doesNotExist");
+    auto results = env->callBatch(calls);
+    POTHOS_TEST_EQUAL(results.size(), calls.size());
+    POTHOS_TEST_EQUAL(results[0].get().extract<Pothos::Proxy>().call<int>("getBar"), 22);
+    POTHOS_TEST_EQUAL(results[2].get().convert<int>(), 22);
+    POTHOS_TEST_THROWS(results[3].get(), Pothos::ProxyHandleCallError);
+
     //runtime registration does not associate the module
     //therefore to be safe, we unregister these classes now
     Pothos::ManagedClass::unload("SuperBar");
@@ -181,6 +203,46 @@ POTHOS_TEST_BLOCK("/proxy/remote/tests", test_server)
     std::cout << "Env peering address " << env->getPeeringAddress() << std::endl;
 }
 
+#ifndef _WIN32
+POTHOS_TEST_BLOCK("/proxy/remote/tests", test_ipc_transport)
+{
+    //handle a shared memory connection within this process
+    Pothos::RemoteIpcListener listener("");
+    std::thread t0([&listener]
+    {
+        auto io = listener.accept(10000000);
+        POTHOS_TEST_TRUE(io);
+        Pothos::RemoteHandler handler;
+        handler.runHandler(*io);
+    });
+    {
+        Pothos::RemoteClient client("ipc://"+listener.getName());
+        test_simple_runner(client.makeEnvironment("managed"));
+    }
+    t0.join();
+
+    //closing the accepted connections returns the handler of an idle client
+    std::thread t1([&listener]
+    {
+        auto io = listener.accept(10000000);
+        POTHOS_TEST_TRUE(io);
+        Pothos::RemoteHandler handler;
+        handler.runHandler(*io);
+    });
+    {
+        auto io = Pothos::RemoteIpcListener::connect(listener.getName(), 10000000);
+        listener.closeConnections();
+        t1.join();
+    }
+
+    //spawn a server process that serves over shared memory
+    Pothos::RemoteServer server("ipc://");
+    Pothos::RemoteClient client("ipc://"+server.getActualPort());
+    auto env = client.makeEnvironment("managed");
+    POTHOS_TEST_EQUAL(env->getNodeId(), Pothos::ProxyEnvironment::make("managed")->getNodeId());
+}
+#endif //_WIN32
+
 struct EchoTester
 {
     static int echo(int x)
@@ -230,3 +292,325 @@ POTHOS_TEST_BLOCK("/proxy/remote/tests", test_multithread_safe)
     //therefore to be safe, we unregister these classes now
     Pothos::ManagedClass::unload("EchoTester");
 }
+
+POTHOS_TEST_BLOCK("/proxy/remote/tests", test_handler_pool)
+{
+    Pothos::ManagedClass()
+        .registerClass<EchoTester>()
+        .registerStaticMethod(POTHOS_FCN_TUPLE(EchoTester, echo))
+        .commit("EchoTester");
+    {
+        std::atomic<size_t> numConnections(0);
+        Pothos::RemoteHandlerPool pool(Pothos::Util::getLoopbackAddr(), "0", 2,
+            [&numConnections](const size_t num){numConnections = num;});
+        const auto uri = "tcp://"+Pothos::Util::getLoopbackAddr(pool.getActualPort());
+
+        //several clients are served concurrently by two workers
+        std::vector<Pothos::ProxyEnvironment::Sptr> envs;
+        std::vector<std::future<int>> futures;
+        for (int i = 0; i < 4; i++)
+        {
+            envs.push_back(Pothos::RemoteClient(uri).makeEnvironment("managed"));
+            futures.push_back(std::async(std::launch::async, &callRemoteEcho, envs.back(), i));
+        }
+        for (int i = 0; i < 4; i++) POTHOS_TEST_EQUAL(futures[i].get(), i);
+        POTHOS_TEST_EQUAL(numConnections.load(), 4);
+
+        //one connection runs the complete test
+        Pothos::RemoteClient client(uri);
+        test_simple_runner(client.makeEnvironment("managed"));
+    }
+    Pothos::ManagedClass::unload("EchoTester");
+}
+
+POTHOS_TEST_BLOCK("/proxy/remote/tests", test_handler_pool_shutdown)
+{
+    std::unique_ptr<Pothos::RemoteHandlerPool> pool(new Pothos::RemoteHandlerPool(Pothos::Util::getLoopbackAddr(), "0", 1));
+    Poco::Net::StreamSocket socket(Poco::Net::SocketAddress(Pothos::Util::getLoopbackAddr(), pool->getActualPort()));
+    Poco::Net::SocketStream stream(socket);
+    uint32_t version = 0;
+
+    //open an environment and upload a large object
+    RemoteMessage openReq(REMOTE_OP_OPEN_ENV);
+    openReq.name = "managed";
+    openReq.object = Pothos::Object(Pothos::ObjectKwargs());
+    sendDatagram(stream, openReq, POTHOS_REMOTE_PROTOCOL_LEGACY);
+    const auto envID = recvDatagram(stream, version).envID;
+
+    RemoteMessage convertReq(REMOTE_OP_CONVERT_OBJECT_TO_PROXY);
+    convertReq.envID = envID;
+    convertReq.object = Pothos::Object(std::string(4*1024*1024, 'x'));
+    sendDatagram(stream, convertReq, POTHOS_REMOTE_PROTOCOL_LEGACY);
+    const auto handleID = recvDatagram(stream, version).handleID;
+
+    //request the object many times without reading the replies,
+    //the worker blocks once the socket buffers fill up
+    RemoteMessage fetchReq(REMOTE_OP_CONVERT_PROXY_TO_OBJECT);
+    fetchReq.envID = envID;
+    fetchReq.handleID = handleID;
+    for (size_t i = 0; i < 32; i++) sendDatagram(stream, fetchReq, POTHOS_REMOTE_PROTOCOL_LEGACY);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    //the pool unblocks the worker rather than wait on the client
+    auto destroyed = std::async(std::launch::async, [&pool]{pool.reset();});
+    const bool stopped = destroyed.wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+    socket.close(); //unblocks a hung pool so that the failure is reported
+    destroyed.wait();
+    POTHOS_TEST_TRUE(stopped);
+}
+
+POTHOS_TEST_BLOCK("/proxy/remote/tests", test_environment_pool)
+{
+    Pothos::RemoteEnvironmentPool::clear();
+    std::unique_ptr<Pothos::RemoteHandlerPool> server(new Pothos::RemoteHandlerPool(Pothos::Util::getLoopbackAddr(), "0"));
+    const auto uri = "tcp://"+Pothos::Util::getLoopbackAddr(server->getActualPort());
+
+    //loopback harness: the cost of a new connection versus a pooled one
+    const size_t numIters = 20;
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < numIters; i++)
+    {
+        Pothos::RemoteClient(uri).makeEnvironment("managed")->findProxy("Pothos/RemoteClient");
+    }
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < numIters; i++)
+    {
+        Pothos::RemoteEnvironmentPool::get(uri)->findProxy("Pothos/RemoteClient");
+    }
+    const auto t2 = std::chrono::high_resolution_clock::now();
+    const auto reconnectUs = std::chrono::duration_cast<std::chrono::microseconds>(t1-t0).count()/numIters;
+    const auto pooledUs = std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count()/numIters;
+    std::cout << "Reconnect " << reconnectUs << " us, pooled " << pooledUs << " us" << std::endl;
+
+    //the same key shares one environment, other keys do not
+    auto env = Pothos::RemoteEnvironmentPool::get(uri);
+    POTHOS_TEST_TRUE(env == Pothos::RemoteEnvironmentPool::get(uri, "managed"));
+    POTHOS_TEST_EQUAL(Pothos::RemoteEnvironmentPool::size(), 1);
+    Pothos::ProxyEnvironmentArgs args;
+    args["key"] = "value";
+    POTHOS_TEST_TRUE(env != Pothos::RemoteEnvironmentPool::get(uri, "managed", args));
+    POTHOS_TEST_EQUAL(Pothos::RemoteEnvironmentPool::size(), 2);
+    env.reset();
+
+    //a dead server fails the health check after the idle time
+    server.reset();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    POTHOS_TEST_THROWS(Pothos::RemoteEnvironmentPool::get(uri), Pothos::RemoteClientError);
+    POTHOS_TEST_EQUAL(Pothos::RemoteEnvironmentPool::size(), 1);
+    Pothos::RemoteEnvironmentPool::remove(uri);
+    POTHOS_TEST_EQUAL(Pothos::RemoteEnvironmentPool::size(), 0);
+}
+
+POTHOS_TEST_BLOCK("/proxy/remote/tests", test_async_calls)
+{
+    Pothos::ManagedClass()
+        .registerClass<EchoTester>()
+        .registerStaticMethod(POTHOS_FCN_TUPLE(EchoTester, echo))
+        .commit("EchoTester");
+    Poco::Pipe p0, p1;
+    Poco::PipeInputStream is(p1);
+    Poco::PipeOutputStream os(p0);
+    std::thread t0(&runRemoteProxy, std::ref(p0), std::ref(p1));
+    {
+        auto env = Pothos::RemoteClient::makeEnvironment(is, os, "managed");
+        auto echoTester = env->findProxy("EchoTester");
+
+        //pipeline more requests than the outstanding limit before any reply
+        std::vector<std::future<Pothos::Proxy>> futures;
+        for (int i = 0; i < 200; i++) futures.push_back(echoTester.callAsync("echo", i));
+        for (int i = 0; i < 200; i++) POTHOS_TEST_EQUAL(futures[i].get().convert<int>(), i);
+
+        //drop a future without waiting, the next reply is still matched
+        echoTester.callAsync("echo", 1);
+        const int two = echoTester.call("echo", 2);
+        POTHOS_TEST_EQUAL(two, 2);
+
+        //errors are reported through the future
+        auto badCall = echoTester.callAsync("doesNotExist");
+        POTHOS_TEST_THROWS(badCall.get(), Pothos::ProxyHandleCallError);
+
+        //local arguments are sent inline, and proxy arguments by ID
+        auto proxyArg = env->makeProxy(3);
+        auto inlineCall = echoTester.callAsync("echo", 4);
+        auto proxyCall = echoTester.callAsync("echo", proxyArg);
+        POTHOS_TEST_EQUAL(inlineCall.get().convert<int>(), 4);
+        POTHOS_TEST_EQUAL(proxyCall.get().convert<int>(), 3);
+
+        //an inline argument that does not convert fails the call
+        auto badArg = echoTester.callAsync("echo", std::string("four"));
+        POTHOS_TEST_THROWS(badArg.get(), Pothos::ProxyHandleCallError);
+    }
+
+    //local environments convert the arguments and return a ready future
+    {
+        auto echoTester = Pothos::ProxyEnvironment::make("managed")->findProxy("EchoTester");
+        POTHOS_TEST_EQUAL(echoTester.callAsync("echo", 5).get().convert<int>(), 5);
+    }
+
+    t0.join();
+
+    Pothos::ManagedClass::unload("EchoTester");
+}
+
+POTHOS_TEST_BLOCK("/proxy/remote/tests", test_datagram_formats)
+{
+    RemoteMessage req(REMOTE_OP_CALL);
+    req.tid = 1234;
+    req.handleID = 42;
+    req.name = "setBar";
+    req.argIDs = {7, 8, 9};
+
+    RemoteMessage reply(REMOTE_OP_CONVERT_PROXY_TO_OBJECT, REMOTE_STATUS_OK);
+    reply.tid = 5678;
+    reply.object = Pothos::Object(std::string("hello"));
+
+    //both encodings carry the same message across the stream
+    for (const uint32_t version : {POTHOS_REMOTE_PROTOCOL_LEGACY, POTHOS_REMOTE_PROTOCOL_BINARY})
+    {
+        std::stringstream ss;
+        sendDatagram(ss, req, version);
+        sendDatagram(ss, reply, version);
+
+        uint32_t rxVersion(0);
+        const auto rxReq = recvDatagram(ss, rxVersion);
+        POTHOS_TEST_EQUAL(rxVersion, version);
+        POTHOS_TEST_EQUAL(int(rxReq.opcode), int(REMOTE_OP_CALL));
+        POTHOS_TEST_EQUAL(int(rxReq.status), int(REMOTE_STATUS_REQUEST));
+        POTHOS_TEST_EQUAL(rxReq.tid, req.tid);
+        POTHOS_TEST_EQUAL(rxReq.handleID, req.handleID);
+        POTHOS_TEST_EQUAL(rxReq.name, req.name);
+        POTHOS_TEST_EQUALV(rxReq.argIDs, req.argIDs);
+
+        const auto rxReply = recvDatagram(ss, rxVersion);
+        POTHOS_TEST_EQUAL(rxVersion, version);
+        POTHOS_TEST_EQUAL(int(rxReply.status), int(REMOTE_STATUS_OK));
+        POTHOS_TEST_EQUAL(rxReply.tid, reply.tid);
+        POTHOS_TEST_EQUAL(rxReply.object.extract<std::string>(), "hello");
+    }
+
+    //a large buffer is referenced by the payload rather than copied into it
+    Pothos::BufferChunk chunk("int32", 1 << 18);
+    for (size_t i = 0; i < chunk.elements(); i++) chunk.as<int *>()[i] = int(i);
+    RemoteMessage bufferReply(REMOTE_OP_CONVERT_PROXY_TO_OBJECT, REMOTE_STATUS_OK);
+    bufferReply.object = Pothos::Object(chunk);
+    for (const uint32_t version : {POTHOS_REMOTE_PROTOCOL_LEGACY, POTHOS_REMOTE_PROTOCOL_BINARY})
+    {
+        std::stringstream ss;
+        sendDatagram(ss, bufferReply, version);
+        sendDatagram(ss, reply, version);
+
+        uint32_t rxVersion(0);
+        const auto rxChunk = recvDatagram(ss, rxVersion).object.extract<Pothos::BufferChunk>();
+        POTHOS_TEST_EQUAL(rxChunk.dtype, chunk.dtype);
+        POTHOS_TEST_EQUALA(rxChunk.as<const int *>(), chunk.as<const int *>(), chunk.elements());
+
+        //the next datagram is framed correctly after the gathered one
+        POTHOS_TEST_EQUAL(recvDatagram(ss, rxVersion).object.extract<std::string>(), "hello");
+    }
+}
+
+POTHOS_TEST_BLOCK("/proxy/remote/tests", test_batch_datagram)
+{
+    RemoteMessage req(REMOTE_OP_BATCH);
+    req.tid = 1234;
+    req.batch.emplace_back(REMOTE_OP_CALL);
+    req.batch.back().handleID = 42;
+    req.batch.back().name = "make";
+    req.batch.back().argIDs = {REMOTE_INLINE_OBJECT_ID | 0};
+    req.batch.back().object = Pothos::Object(Pothos::ObjectVector{Pothos::Object(11)});
+    req.batch.emplace_back(REMOTE_OP_CALL);
+    req.batch.back().handleID = REMOTE_BATCH_RESULT_ID | 0;
+    req.batch.back().name = "getBar";
+    req.batch.back().toLocal = true;
+
+    //the batched calls follow the argument IDs of the outer message
+    std::stringstream ss;
+    sendDatagram(ss, req, POTHOS_REMOTE_PROTOCOL_BATCH);
+    uint32_t rxVersion(0);
+    const auto rxReq = recvDatagram(ss, rxVersion);
+    POTHOS_TEST_EQUAL(int(rxReq.opcode), int(REMOTE_OP_BATCH));
+    POTHOS_TEST_EQUAL(rxReq.tid, req.tid);
+    POTHOS_TEST_EQUAL(rxReq.batch.size(), 2);
+    POTHOS_TEST_EQUAL(rxReq.batch[0].handleID, 42);
+    POTHOS_TEST_EQUAL(rxReq.batch[0].name, "make");
+    POTHOS_TEST_EQUALV(rxReq.batch[0].argIDs, req.batch[0].argIDs);
+    POTHOS_TEST_EQUAL(rxReq.batch[0].object.extract<Pothos::ObjectVector>().at(0).extract<int>(), 11);
+    POTHOS_TEST_EQUAL(rxReq.batch[1].handleID, REMOTE_BATCH_RESULT_ID | 0);
+    POTHOS_TEST_TRUE(rxReq.batch[1].toLocal);
+    POTHOS_TEST_TRUE(not rxReq.batch[1].object);
+
+    //a message without a batch is not flagged and has no batch fields
+    RemoteMessage call(REMOTE_OP_CALL);
+    call.name = "getBar";
+    std::stringstream plain;
+    sendDatagram(plain, call, POTHOS_REMOTE_PROTOCOL_BATCH);
+    const auto rxCall = recvDatagram(plain, rxVersion);
+    POTHOS_TEST_EQUAL(rxCall.name, "getBar");
+    POTHOS_TEST_TRUE(rxCall.batch.empty());
+
+    //legacy peers cannot carry a batch
+    std::stringstream legacy;
+    POTHOS_TEST_THROWS(sendDatagram(legacy, req, POTHOS_REMOTE_PROTOCOL_LEGACY), Pothos::NotImplementedException);
+}
+
+static RemoteMessage transactHandler(Pothos::RemoteHandler &handler, const RemoteMessage &req, const uint32_t version)
+{
+    std::stringstream request, reply;
+    sendDatagram(request, req, version);
+    handler.runHandlerOnce(request, reply);
+    uint32_t rxVersion(0);
+    return recvDatagram(reply, rxVersion);
+}
+
+static uint64_t openHandlerEnv(Pothos::RemoteHandler &handler)
+{
+    RemoteMessage req(REMOTE_OP_OPEN_ENV);
+    req.name = "managed";
+    req.object = Pothos::Object(Pothos::ObjectKwargs());
+    req.version = POTHOS_REMOTE_PROTOCOL_VERSION;
+    return transactHandler(handler, req, POTHOS_REMOTE_PROTOCOL_LEGACY).envID;
+}
+
+static uint64_t makeHandlerObject(Pothos::RemoteHandler &handler, const uint64_t envID, const int value)
+{
+    RemoteMessage req(REMOTE_OP_CONVERT_OBJECT_TO_PROXY);
+    req.envID = envID;
+    req.object = Pothos::Object(value);
+    return transactHandler(handler, req, POTHOS_REMOTE_PROTOCOL_VERSION).handleID;
+}
+
+static RemoteStatus handlerObjectStatus(Pothos::RemoteHandler &handler, const uint64_t handleID)
+{
+    RemoteMessage req(REMOTE_OP_TO_STRING);
+    req.handleID = handleID;
+    return transactHandler(handler, req, POTHOS_REMOTE_PROTOCOL_VERSION).status;
+}
+
+POTHOS_TEST_BLOCK("/proxy/remote/tests", test_handler_object_table)
+{
+    std::unique_ptr<Pothos::RemoteHandler> handler(new Pothos::RemoteHandler());
+    const auto envID = openHandlerEnv(*handler);
+
+    //a deleted handle is rejected, even once its slot holds another object
+    const auto staleID = makeHandlerObject(*handler, envID, 42);
+    RemoteMessage deleteReq(REMOTE_OP_DELETE_HANDLE);
+    deleteReq.envID = envID;
+    deleteReq.handleID = staleID;
+    transactHandler(*handler, deleteReq, POTHOS_REMOTE_PROTOCOL_VERSION);
+    const auto handleID = makeHandlerObject(*handler, envID, 43);
+    POTHOS_TEST_EQUAL(handleID & 0xffffffff, staleID & 0xffffffff);
+    POTHOS_TEST_EQUAL(int(handlerObjectStatus(*handler, staleID)), int(REMOTE_STATUS_ERROR));
+    POTHOS_TEST_EQUAL(int(handlerObjectStatus(*handler, handleID)), int(REMOTE_STATUS_OK));
+
+    //closing the environment frees the objects that it owns
+    RemoteMessage closeReq(REMOTE_OP_CLOSE_ENV);
+    closeReq.envID = envID;
+    transactHandler(*handler, closeReq, POTHOS_REMOTE_PROTOCOL_VERSION);
+    POTHOS_TEST_EQUAL(int(handlerObjectStatus(*handler, handleID)), int(REMOTE_STATUS_ERROR));
+
+    //a client that disconnects without closing still frees its objects
+    const auto leftID = makeHandlerObject(*handler, openHandlerEnv(*handler), 44);
+    POTHOS_TEST_EQUAL(int(handlerObjectStatus(*handler, leftID)), int(REMOTE_STATUS_OK));
+    handler.reset(new Pothos::RemoteHandler());
+    POTHOS_TEST_EQUAL(int(handlerObjectStatus(*handler, leftID)), int(REMOTE_STATUS_ERROR));
+}
@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Remote.hpp>
@@ -105,15 +105,23 @@ struct Pothos::RemoteClient::Impl
         POTHOS_EXCEPTION_TRY
         {
             Poco::URI uri(uriStr);
-            if (uri.getScheme() != "tcp") throw InvalidArgumentException("unsupported URI scheme");
+            if (uri.getScheme() != "tcp" and uri.getScheme() != "ipc") throw InvalidArgumentException("unsupported URI scheme");
         }
         POTHOS_EXCEPTION_CATCH(const Exception &ex)
         {
             throw RemoteClientError("Pothos::RemoteClient("+uriStr+")", ex);
         }
 
-        //extract port, for unspecified port -- use the default locator port
+        //the ipc transport connects to a listener on this host by name
         Poco::URI uri(uriStr);
+        if (uri.getScheme() == "ipc")
+        {
+            ipcStream = RemoteIpcListener::connect(uri.getHost(), timeoutUs);
+            this->sa = Poco::Net::SocketAddress("127.0.0.1", 0);
+            return;
+        }
+
+        //extract port, for unspecified port -- use the default locator port
         auto port = uri.getPort();
         if (port == 0) port = std::stoi(RemoteServer::getLocatorPort());
 
@@ -141,6 +149,7 @@ struct Pothos::RemoteClient::Impl
     }
     Poco::Net::StreamSocket clientSocket;
     Poco::Net::SocketStream socketStream;
+    std::shared_ptr<std::iostream> ipcStream;
     const std::string uriStr;
     Poco::Net::SocketAddress sa;
 };
@@ -170,6 +179,7 @@ Pothos::RemoteClient::operator bool(void) const
 std::iostream &Pothos::RemoteClient::getIoStream(void) const
 {
     assert(_impl);
+    if (_impl->ipcStream) return *_impl->ipcStream;
     return _impl->socketStream;
 }
 
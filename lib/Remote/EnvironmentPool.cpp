@@ -0,0 +1,185 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "RemoteProxy.hpp"
+#include <Pothos/Remote/EnvironmentPool.hpp>
+#include <Pothos/Remote/Client.hpp>
+#include <Pothos/Remote/Exception.hpp>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <map>
+
+/*!
+ * An environment that was idle for longer than this
+ * is checked with a round trip before it is reused.
+ * Recently used environments are only checked for
+ * a connection error seen by a previous call.
+ */
+static const std::chrono::seconds HEALTH_CHECK_IDLE_TIME(1);
+
+/***********************************************************************
+ * pool storage
+ **********************************************************************/
+struct PooledEnvironment
+{
+    std::string uri;
+    std::shared_future<Pothos::ProxyEnvironment::Sptr> future;
+    std::chrono::steady_clock::time_point lastUsed;
+};
+
+typedef std::shared_ptr<PooledEnvironment> PooledEnvironmentSptr;
+
+static std::mutex &getPoolMutex(void)
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::map<std::string, PooledEnvironmentSptr> &getPool(void)
+{
+    static std::map<std::string, PooledEnvironmentSptr> map;
+    return map;
+}
+
+static std::string makePoolKey(const std::string &uri, const std::string &name, const Pothos::ProxyEnvironmentArgs &args)
+{
+    std::string key = uri + "\n" + name;
+    for (const auto &pair : args) key += "\n" + pair.first + "=" + pair.second;
+    return key;
+}
+
+//! Remove the entry unless another thread already replaced it
+static void dropPooledEnvironment(const std::string &key, const PooledEnvironmentSptr &entry)
+{
+    std::lock_guard<std::mutex> lock(getPoolMutex());
+    auto it = getPool().find(key);
+    if (it != getPool().end() and it->second == entry) getPool().erase(it);
+}
+
+/***********************************************************************
+ * connect and health check
+ **********************************************************************/
+static Pothos::ProxyEnvironment::Sptr connectEnvironment(
+    const std::string &uri, const std::string &name,
+    const Pothos::ProxyEnvironmentArgs &args, const long timeoutUs)
+{
+    try
+    {
+        return Pothos::RemoteClient(uri, timeoutUs).makeEnvironment(name, args);
+    }
+    catch (const Pothos::RemoteClientError &)
+    {
+        throw;
+    }
+    catch (const Pothos::Exception &ex)
+    {
+        throw Pothos::RemoteClientError("Pothos::RemoteEnvironmentPool::get("+uri+")", ex);
+    }
+}
+
+static bool checkHealth(const Pothos::ProxyEnvironment::Sptr &env, const bool roundTrip)
+{
+    //a previous call already saw the connection fail
+    auto remoteEnv = std::dynamic_pointer_cast<RemoteProxyEnvironment>(env);
+    if (remoteEnv and not remoteEnv->connectionActive) return false;
+    if (not roundTrip) return true;
+
+    //a class lookup is a complete request and reply with the server
+    try
+    {
+        env->findProxy("Pothos/RemoteEnvironmentPool");
+    }
+    catch (const Pothos::Exception &)
+    {
+        return false;
+    }
+    return true;
+}
+
+/***********************************************************************
+ * environment pool implementation
+ **********************************************************************/
+Pothos::ProxyEnvironment::Sptr Pothos::RemoteEnvironmentPool::get(
+    const std::string &uri, const std::string &name,
+    const ProxyEnvironmentArgs &args, const long timeoutUs)
+{
+    const auto key = makePoolKey(uri, name, args);
+
+    //a broken environment is replaced once by a new connection
+    for (int attempt = 0;; attempt++)
+    {
+        PooledEnvironmentSptr entry;
+        bool roundTrip = false;
+        {
+            std::lock_guard<std::mutex> lock(getPoolMutex());
+            auto &pool = getPool();
+            auto &slot = pool[key];
+            if (not slot)
+            {
+                //the first thread to wait on the deferred future connects,
+                //concurrent requests for the same key wait for its result
+                slot.reset(new PooledEnvironment());
+                slot->uri = uri;
+                slot->future = std::async(std::launch::deferred, &connectEnvironment, uri, name, args, timeoutUs);
+            }
+            else
+            {
+                roundTrip = (std::chrono::steady_clock::now() - slot->lastUsed) > HEALTH_CHECK_IDLE_TIME;
+            }
+            entry = slot;
+            entry->lastUsed = std::chrono::steady_clock::now();
+        }
+
+        Pothos::ProxyEnvironment::Sptr env;
+        try
+        {
+            env = entry->future.get();
+        }
+        catch (const Pothos::Exception &)
+        {
+            dropPooledEnvironment(key, entry);
+            throw;
+        }
+
+        if (checkHealth(env, roundTrip)) return env;
+        dropPooledEnvironment(key, entry);
+        if (attempt != 0) throw Pothos::RemoteClientError(
+            "Pothos::RemoteEnvironmentPool::get("+uri+")", "connection not healthy");
+    }
+}
+
+void Pothos::RemoteEnvironmentPool::remove(const std::string &uri)
+{
+    std::lock_guard<std::mutex> lock(getPoolMutex());
+    auto &pool = getPool();
+    for (auto it = pool.begin(); it != pool.end();)
+    {
+        if (it->second->uri == uri) it = pool.erase(it);
+        else ++it;
+    }
+}
+
+void Pothos::RemoteEnvironmentPool::clear(void)
+{
+    std::lock_guard<std::mutex> lock(getPoolMutex());
+    getPool().clear();
+}
+
+size_t Pothos::RemoteEnvironmentPool::size(void)
+{
+    std::lock_guard<std::mutex> lock(getPoolMutex());
+    return getPool().size();
+}
+
+#include <Pothos/Managed.hpp>
+
+static auto managedRemoteEnvironmentPool = Pothos::ManagedClass()
+    .registerClass<Pothos::RemoteEnvironmentPool>()
+    .registerStaticMethod(POTHOS_FCN_TUPLE(Pothos::RemoteEnvironmentPool, get))
+    .registerStaticMethod("get", Pothos::Callable(&Pothos::RemoteEnvironmentPool::get).bind(100000L, 3))
+    .registerStaticMethod("get", Pothos::Callable(&Pothos::RemoteEnvironmentPool::get).bind(100000L, 3).bind(Pothos::ProxyEnvironmentArgs(), 2))
+    .registerStaticMethod(POTHOS_FCN_TUPLE(Pothos::RemoteEnvironmentPool, remove))
+    .registerStaticMethod(POTHOS_FCN_TUPLE(Pothos::RemoteEnvironmentPool, clear))
+    .registerStaticMethod(POTHOS_FCN_TUPLE(Pothos::RemoteEnvironmentPool, size))
+    .commit("Pothos/RemoteEnvironmentPool");
@@ -0,0 +1,440 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "RemoteProxyDatagram.hpp"
+#include <Pothos/Remote/HandlerPool.hpp>
+#include <Pothos/Remote/Handler.hpp>
+#include <Pothos/Remote/Exception.hpp>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/StreamSocket.h>
+#include <Poco/Net/SocketStream.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Logger.h>
+#include <condition_variable>
+#include <algorithm>
+#include <atomic>
+#include <istream>
+#include <memory>
+#include <vector>
+#include <cstring> //memcpy
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <map>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h> //close
+#include <cerrno> //errno
+#include <cstring> //strerror
+#endif
+#ifndef _WIN32
+#include <csignal>
+#include <pthread.h>
+#endif
+
+/***********************************************************************
+ * Socket poller: epoll on linux, select on other platforms
+ **********************************************************************/
+class RemoteSocketPoller
+{
+public:
+    #ifdef __linux__
+    RemoteSocketPoller(void):
+        _epollFd(epoll_create1(EPOLL_CLOEXEC))
+    {
+        if (_epollFd < 0) throw Pothos::SystemException("epoll_create1()", std::strerror(errno));
+    }
+
+    ~RemoteSocketPoller(void)
+    {
+        close(_epollFd);
+    }
+    #endif //__linux__
+
+    void add(const Poco::Net::Socket &socket)
+    {
+        const int fd = int(socket.impl()->sockfd());
+        #ifdef __linux__
+        epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            throw Pothos::SystemException("epoll_ctl()", std::strerror(errno));
+        }
+        #endif //__linux__
+        _sockets[fd] = socket;
+    }
+
+    void remove(const Poco::Net::Socket &socket)
+    {
+        const int fd = int(socket.impl()->sockfd());
+        #ifdef __linux__
+        epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        #endif //__linux__
+        _sockets.erase(fd);
+    }
+
+    //! Wait for readable sockets or the timeout
+    Poco::Net::Socket::SocketList wait(const long timeoutUs)
+    {
+        Poco::Net::Socket::SocketList readList;
+        #ifdef __linux__
+        epoll_event events[64];
+        const int n = epoll_wait(_epollFd, events, 64, int(timeoutUs/1000));
+        for (int i = 0; i < n; i++)
+        {
+            auto it = _sockets.find(events[i].data.fd);
+            if (it != _sockets.end()) readList.push_back(it->second);
+        }
+        #else
+        for (const auto &pair : _sockets) readList.push_back(pair.second);
+        Poco::Net::Socket::SocketList writeList, exceptList;
+        Poco::Net::Socket::select(readList, writeList, exceptList, Poco::Timespan(0, timeoutUs));
+        #endif //__linux__
+        return readList;
+    }
+
+private:
+    #ifdef __linux__
+    const int _epollFd;
+    #endif //__linux__
+    std::map<int, Poco::Net::Socket> _sockets;
+};
+
+/***********************************************************************
+ * Received frames: slices of a shared receive block
+ **********************************************************************/
+typedef std::shared_ptr<std::vector<char>> RemoteRxBlock;
+
+struct RemoteFrame
+{
+    RemoteRxBlock block;
+    size_t offset;
+    size_t size;
+};
+
+//! Read-only stream buffer over the bytes of a frame
+class RemoteFrameBuf : public std::streambuf
+{
+public:
+    RemoteFrameBuf(const RemoteFrame &frame)
+    {
+        char *begin = frame.block->data()+frame.offset;
+        this->setg(begin, begin, begin+frame.size);
+    }
+};
+
+static const size_t RX_BLOCK_SIZE = 64*1024; //default receive block size
+static const size_t RX_MIN_READ = 4*1024; //a new block when less space remains
+
+/***********************************************************************
+ * Connection state
+ **********************************************************************/
+struct RemoteConnection
+{
+    RemoteConnection(const Poco::Net::StreamSocket &socket):
+        socket(socket),
+        stream(this->socket),
+        handler(socket.peerAddress().host().toString()),
+        rxBegin(0),
+        rxEnd(0),
+        rxFrameSize(0),
+        busy(false)
+    {
+        return;
+    }
+
+    Poco::Net::StreamSocket socket;
+    Poco::Net::SocketStream stream;
+    Pothos::RemoteHandler handler;
+
+    //owned by the poller thread: the bytes of the incomplete frame
+    //are rxBlock[rxBegin, rxEnd), rxFrameSize is its size once known
+    RemoteRxBlock rxBlock;
+    size_t rxBegin;
+    size_t rxEnd;
+    size_t rxFrameSize;
+
+    std::mutex mutex;
+    std::deque<RemoteFrame> frames; //complete frames in the order received
+    bool busy; //a worker owns the connection
+};
+
+typedef std::shared_ptr<RemoteConnection> RemoteConnectionSptr;
+
+/***********************************************************************
+ * Handler pool implementation
+ **********************************************************************/
+struct Pothos::RemoteHandlerPool::Impl
+{
+    Impl(const ConnectionCallback &callback):
+        callback(callback),
+        running(true),
+        maxWorkers(0),
+        numIdle(0)
+    {
+        return;
+    }
+
+    void pollerLoop(void);
+    void workerLoop(void);
+    void acceptConnection(void);
+    void receive(const RemoteConnectionSptr &conn);
+    void disconnect(const RemoteConnectionSptr &conn);
+    void enqueue(const RemoteConnectionSptr &conn);
+
+    Poco::Net::ServerSocket serverSocket;
+    const ConnectionCallback callback;
+    std::atomic<bool> running;
+
+    //owned by the poller thread
+    RemoteSocketPoller poller;
+    std::map<Poco::Net::Socket, RemoteConnectionSptr> connections;
+    std::thread pollerThread;
+
+    //connections with frames ready for a worker
+    std::mutex workMutex;
+    std::condition_variable workCond;
+    std::deque<RemoteConnectionSptr> workQueue;
+    std::vector<std::thread> workerThreads;
+    size_t maxWorkers; //the pool grows up to this many threads
+    size_t numIdle; //workers waiting on the work queue
+};
+
+void Pothos::RemoteHandlerPool::Impl::pollerLoop(void)
+{
+    while (running)
+    {
+        for (const auto &socket : poller.wait(100000))
+        {
+            if (socket == serverSocket) this->acceptConnection();
+            else
+            {
+                auto it = connections.find(socket);
+                if (it != connections.end()) this->receive(it->second);
+            }
+        }
+    }
+}
+
+void Pothos::RemoteHandlerPool::Impl::acceptConnection(void)
+{
+    try
+    {
+        auto socket = serverSocket.acceptConnection();
+        socket.setNoDelay(true);
+        RemoteConnectionSptr conn(new RemoteConnection(socket));
+        poller.add(conn->socket);
+        connections[conn->socket] = conn;
+    }
+    catch (const Poco::Exception &ex)
+    {
+        poco_error(Poco::Logger::get("Pothos.RemoteHandlerPool"), "accept: "+ex.displayText());
+        return;
+    }
+    if (callback) callback(connections.size());
+}
+
+void Pothos::RemoteHandlerPool::Impl::receive(const RemoteConnectionSptr &conn)
+{
+    //complete frames keep their block while a worker reads them,
+    //so a full block is replaced and only the incomplete frame moves
+    const size_t pending = conn->rxEnd - conn->rxBegin;
+    const size_t needed = std::max(pending + RX_MIN_READ, conn->rxFrameSize);
+    if (not conn->rxBlock or conn->rxBegin + needed > conn->rxBlock->size())
+    {
+        RemoteRxBlock block(new std::vector<char>(std::max(RX_BLOCK_SIZE, needed)));
+        if (pending != 0) std::memcpy(block->data(), conn->rxBlock->data()+conn->rxBegin, pending);
+        conn->rxBlock = block;
+        conn->rxBegin = 0;
+        conn->rxEnd = pending;
+    }
+
+    //the socket is readable, zero bytes means the peer disconnected
+    auto &block = *conn->rxBlock;
+    int n = 0;
+    try
+    {
+        n = conn->socket.receiveBytes(block.data()+conn->rxEnd, int(block.size()-conn->rxEnd));
+    }
+    catch (const Poco::Exception &){}
+
+    if (n <= 0) return this->disconnect(conn);
+    conn->rxEnd += size_t(n);
+
+    //split off complete frames in place and schedule the connection
+    std::unique_lock<std::mutex> lock(conn->mutex);
+    bool ready = false;
+    while (true)
+    {
+        const size_t available = conn->rxEnd - conn->rxBegin;
+        try
+        {
+            conn->rxFrameSize = datagramFrameSize(block.data()+conn->rxBegin, available);
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            //not a datagram stream or an oversized frame: drop the client
+            poco_error(Poco::Logger::get("Pothos.RemoteHandlerPool"), "receive: "+ex.displayText());
+            lock.unlock();
+            return this->disconnect(conn);
+        }
+        if (conn->rxFrameSize == 0 or conn->rxFrameSize > available) break;
+        conn->frames.push_back(RemoteFrame{conn->rxBlock, conn->rxBegin, conn->rxFrameSize});
+        conn->rxBegin += conn->rxFrameSize;
+        conn->rxFrameSize = 0;
+        ready = true;
+    }
+    if (ready and not conn->busy)
+    {
+        conn->busy = true;
+        this->enqueue(conn);
+    }
+}
+
+void Pothos::RemoteHandlerPool::Impl::disconnect(const RemoteConnectionSptr &conn)
+{
+    //a worker may still hold the connection, it closes on release
+    poller.remove(conn->socket);
+    connections.erase(conn->socket);
+    if (callback) callback(connections.size());
+}
+
+void Pothos::RemoteHandlerPool::Impl::enqueue(const RemoteConnectionSptr &conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        workQueue.push_back(conn);
+
+        //every worker is busy, possibly blocked inside of a call,
+        //so add a worker rather than starve the other connections
+        if (running and numIdle < workQueue.size() and workerThreads.size() < maxWorkers)
+        {
+            workerThreads.emplace_back(&Impl::workerLoop, this);
+        }
+    }
+    workCond.notify_one();
+}
+
+void Pothos::RemoteHandlerPool::Impl::workerLoop(void)
+{
+    //a reply to a closed connection fails with EPIPE rather than raising SIGPIPE,
+    //the blocked signal stays pending on this thread and is discarded on exit
+    #ifndef _WIN32
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+    #endif //_WIN32
+
+    while (true)
+    {
+        RemoteConnectionSptr conn;
+        {
+            std::unique_lock<std::mutex> lock(workMutex);
+            numIdle++;
+            workCond.wait(lock, [this]{return not running or not workQueue.empty();});
+            numIdle--;
+            if (not running) return;
+            conn = workQueue.front();
+            workQueue.pop_front();
+        }
+
+        RemoteFrame frame;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            frame = std::move(conn->frames.front());
+            conn->frames.pop_front();
+        }
+
+        //process one request, the reply is written directly to the socket
+        bool done = false;
+        try
+        {
+            RemoteFrameBuf buf(frame);
+            std::istream is(&buf);
+            done = conn->handler.runHandlerOnce(is, conn->stream);
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            poco_error(Poco::Logger::get("Pothos.RemoteHandlerPool"), ex.displayText());
+            done = true;
+        }
+
+        //the poller sees the shutdown as a disconnect and removes the connection
+        if (done) try
+        {
+            conn->socket.shutdown();
+        }
+        catch (const Poco::Exception &){}
+
+        //requeue behind other connections for fairness, or release
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        if (done or conn->frames.empty()) conn->busy = false;
+        else this->enqueue(conn);
+    }
+}
+
+/***********************************************************************
+ * Handler pool interface
+ **********************************************************************/
+static const size_t MAX_WORKERS_FACTOR = 8; //growth limit per initial worker
+static const size_t MIN_MAX_WORKERS = 64; //growth limit for small pools
+
+Pothos::RemoteHandlerPool::RemoteHandlerPool(const std::string &host, const std::string &port, const size_t numWorkers, const ConnectionCallback &callback):
+    _impl(new Impl(callback))
+{
+    try
+    {
+        _impl->serverSocket = Poco::Net::ServerSocket(Poco::Net::SocketAddress(host, port));
+    }
+    catch (const Poco::Exception &ex)
+    {
+        throw Pothos::RemoteServerError("Pothos::RemoteHandlerPool("+host+":"+port+")", ex.displayText());
+    }
+    _impl->poller.add(_impl->serverSocket);
+
+    const size_t numThreads = (numWorkers == 0)?std::max<size_t>(std::thread::hardware_concurrency(), 2):numWorkers;
+    _impl->maxWorkers = std::max<size_t>(numThreads*MAX_WORKERS_FACTOR, MIN_MAX_WORKERS);
+    {
+        std::lock_guard<std::mutex> lock(_impl->workMutex);
+        for (size_t i = 0; i < numThreads; i++)
+        {
+            _impl->workerThreads.emplace_back(&Impl::workerLoop, _impl.get());
+        }
+    }
+    _impl->pollerThread = std::thread(&Impl::pollerLoop, _impl.get());
+}
+
+Pothos::RemoteHandlerPool::~RemoteHandlerPool(void)
+{
+    //stop under the work lock so a worker cannot miss the notification
+    {
+        std::lock_guard<std::mutex> lock(_impl->workMutex);
+        _impl->running = false;
+    }
+    _impl->workCond.notify_all();
+    _impl->pollerThread.join();
+
+    //a worker may be blocked writing a reply to a client that stopped reading,
+    //the socket shutdown fails that write so the worker can exit;
+    //a request that is blocked inside of the called code cannot be interrupted
+    for (const auto &pair : _impl->connections) try
+    {
+        pair.second->socket.shutdown();
+    }
+    catch (const Poco::Exception &){}
+    for (auto &thread : _impl->workerThreads) thread.join();
+}
+
+std::string Pothos::RemoteHandlerPool::getActualHost(void) const
+{
+    return _impl->serverSocket.address().host().toString();
+}
+
+std::string Pothos::RemoteHandlerPool::getActualPort(void) const
+{
+    return std::to_string(_impl->serverSocket.address().port());
+}
@@ -0,0 +1,594 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Remote/Ipc.hpp>
+#include <Pothos/Remote/Exception.hpp>
+#include <Poco/Format.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <streambuf>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstring> //memcpy, strerror
+#include <cerrno> //errno
+#include <ctime> //clock_gettime
+#include <fcntl.h> //O_* constants
+#include <unistd.h> //ftruncate, getpid
+#include <signal.h> //kill
+#include <pthread.h>
+#include <sys/mman.h> //shm_open, mmap
+#include <sys/stat.h> //mode constants, fstat
+
+/***********************************************************************
+ * Shared memory layout
+ *  - a listener segment hands connection names to the server
+ *  - a connection segment holds one byte ring per direction
+ **********************************************************************/
+#define IPC_RING_SIZE (1 << 20)
+#define IPC_POLL_US 100000 //check on the peer process at this interval
+#define IPC_LOCK_RETRY_US 1000 //lock retry interval without robust mutexes
+#define IPC_SIZE_RETRIES 1000 //wait for a new segment to be sized this many retries
+#define IPC_NAME_SIZE 64
+
+struct IpcSync
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int32_t ownerPid; //process holding the mutex or zero
+};
+
+//! A single producer, single consumer byte ring
+struct IpcRing
+{
+    IpcSync sync;
+    uint64_t writeCount; //total bytes written
+    uint64_t readCount; //total bytes read
+    int32_t closed; //either end closed the ring
+    char data[IPC_RING_SIZE];
+};
+
+struct IpcConnectionShm
+{
+    int32_t clientPid;
+    int32_t serverPid;
+    int32_t accepted; //signaled on the server to client ring
+    IpcRing rings[2]; //client to server, server to client
+};
+
+struct IpcListenerShm
+{
+    std::atomic<int32_t> ready; //set once the sync is initialized
+    IpcSync sync;
+    int32_t serverPid;
+    int32_t pending; //a connection name is waiting in the slot
+    char connName[IPC_NAME_SIZE];
+};
+
+static std::string listenerShmName(const std::string &name)
+{
+    return "/pothos-"+name;
+}
+
+//! False only when the process is known to have exited
+static bool processAlive(const int32_t pid)
+{
+    if (pid == 0) return true;
+    return kill(pid_t(pid), 0) == 0 or errno != ESRCH;
+}
+
+/***********************************************************************
+ * Process shared synchronization
+ **********************************************************************/
+static void initSync(IpcSync &sync)
+{
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    #ifdef __linux__
+    pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+    #endif
+    pthread_mutex_init(&sync.mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&sync.cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+    sync.ownerPid = 0;
+}
+
+//! Recover the mutex when the owner process died while holding it
+static void checkOwnerDead(IpcSync &sync, const int ret)
+{
+    #ifdef __linux__
+    if (ret == EOWNERDEAD) pthread_mutex_consistent(&sync.mutex);
+    #else
+    (void)sync; (void)ret;
+    #endif
+}
+
+/*!
+ * Acquire the process shared mutex.
+ * Without robust mutexes, a mutex held by a process that exited is never released:
+ * retry the lock and re-initialize the sync once the recorded owner is gone.
+ * Only the other end of a connection can be the owner, so no one else uses it.
+ */
+static void lockSync(IpcSync &sync)
+{
+    #ifdef __linux__
+    checkOwnerDead(sync, pthread_mutex_lock(&sync.mutex));
+    #else
+    while (pthread_mutex_trylock(&sync.mutex) != 0)
+    {
+        const int32_t owner = sync.ownerPid;
+        if (owner != 0 and owner != int32_t(getpid()) and not processAlive(owner)) initSync(sync);
+        else usleep(IPC_LOCK_RETRY_US);
+    }
+    #endif
+    sync.ownerPid = int32_t(getpid());
+}
+
+static void unlockSync(IpcSync &sync)
+{
+    sync.ownerPid = 0;
+    pthread_mutex_unlock(&sync.mutex);
+}
+
+class IpcLock
+{
+public:
+    IpcLock(IpcSync &sync):
+        _sync(sync)
+    {
+        lockSync(_sync);
+    }
+
+    ~IpcLock(void)
+    {
+        unlockSync(_sync);
+    }
+
+    //! Wait for a notification or the timeout
+    void wait(const long timeoutUs = IPC_POLL_US)
+    {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        const long long nsecs = ts.tv_nsec + (long long)(std::min<long>(timeoutUs, IPC_POLL_US))*1000;
+        ts.tv_sec += time_t(nsecs/1000000000);
+        ts.tv_nsec = long(nsecs%1000000000);
+        _sync.ownerPid = 0;
+        checkOwnerDead(_sync, pthread_cond_timedwait(&_sync.cond, &_sync.mutex, &ts));
+        _sync.ownerPid = int32_t(getpid());
+    }
+
+    void notify(void)
+    {
+        pthread_cond_broadcast(&_sync.cond);
+    }
+
+private:
+    IpcSync &_sync;
+};
+
+/***********************************************************************
+ * Shared memory segment mapping
+ **********************************************************************/
+template <typename T>
+class IpcMapping
+{
+public:
+    IpcMapping(const std::string &name, const bool create):
+        _name(name),
+        _shm(nullptr)
+    {
+        const int fd = shm_open(name.c_str(), create?(O_RDWR | O_CREAT | O_EXCL):O_RDWR, S_IRUSR | S_IWUSR);
+        if (fd < 0) throw Pothos::SystemException("shm_open("+name+")", std::strerror(errno));
+
+        if (create and ftruncate(fd, sizeof(T)) != 0)
+        {
+            const int err = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            throw Pothos::SystemException("ftruncate("+name+")", std::strerror(err));
+        }
+
+        //the creator sizes the segment after shm_open(), and touching
+        //a mapping beyond the size of the segment raises SIGBUS
+        for (size_t retry = 0; not create; retry++)
+        {
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+            {
+                const int err = errno;
+                close(fd);
+                throw Pothos::SystemException("fstat("+name+")", std::strerror(err));
+            }
+            if (size_t(st.st_size) >= sizeof(T)) break;
+            if (retry == IPC_SIZE_RETRIES)
+            {
+                close(fd);
+                throw Pothos::SystemException("shm_open("+name+")", "segment was not sized");
+            }
+            usleep(IPC_LOCK_RETRY_US);
+        }
+
+        void *ptr = mmap(nullptr, sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED)
+        {
+            const int err = errno;
+            if (create) shm_unlink(name.c_str());
+            throw Pothos::SystemException("mmap("+name+")", std::strerror(err));
+        }
+        _shm = reinterpret_cast<T *>(ptr);
+    }
+
+    ~IpcMapping(void)
+    {
+        munmap(_shm, sizeof(T));
+    }
+
+    //! Remove the name, the memory remains mapped until all users unmap it
+    void unlink(void)
+    {
+        shm_unlink(_name.c_str());
+    }
+
+    T *operator->(void) const
+    {
+        return _shm;
+    }
+
+private:
+    const std::string _name;
+    T *_shm;
+};
+
+typedef IpcMapping<IpcConnectionShm> IpcConnection;
+typedef IpcMapping<IpcListenerShm> IpcListener;
+
+/***********************************************************************
+ * Connection stream over a pair of rings
+ **********************************************************************/
+class IpcStreamBuf : public std::streambuf
+{
+public:
+    IpcStreamBuf(const std::shared_ptr<IpcConnection> &conn, const bool isServer):
+        _conn(conn),
+        _tx((*conn)->rings[isServer?1:0]),
+        _rx((*conn)->rings[isServer?0:1]),
+        _peerPid(isServer?(*conn)->clientPid:(*conn)->serverPid)
+    {
+        this->setg(_rxBuff, _rxBuff, _rxBuff);
+        this->setp(_txBuff, _txBuff+sizeof(_txBuff));
+    }
+
+    ~IpcStreamBuf(void)
+    {
+        this->flushTx();
+        for (auto ring : {&_tx, &_rx})
+        {
+            IpcLock lock(ring->sync);
+            ring->closed = 1;
+            lock.notify();
+        }
+    }
+
+protected:
+    int_type underflow(void)
+    {
+        const size_t n = this->readRing(_rxBuff, sizeof(_rxBuff));
+        if (n == 0) return traits_type::eof();
+        this->setg(_rxBuff, _rxBuff, _rxBuff+n);
+        return traits_type::to_int_type(*this->gptr());
+    }
+
+    int_type overflow(int_type ch)
+    {
+        if (this->flushTx() != 0) return traits_type::eof();
+        if (not traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            *this->pptr() = traits_type::to_char_type(ch);
+            this->pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync(void)
+    {
+        return this->flushTx();
+    }
+
+    //! Large writes skip the put area and go straight into the ring
+    std::streamsize xsputn(const char *s, std::streamsize n)
+    {
+        if (size_t(n) < sizeof(_txBuff)) return std::streambuf::xsputn(s, n);
+        if (this->flushTx() != 0 or not this->writeRing(s, size_t(n))) return 0;
+        return n;
+    }
+
+private:
+    int flushTx(void)
+    {
+        const size_t n = size_t(this->pptr()-this->pbase());
+        if (n != 0 and not this->writeRing(this->pbase(), n)) return -1;
+        this->setp(_txBuff, _txBuff+sizeof(_txBuff));
+        return 0;
+    }
+
+    //! Block until all bytes are written, false when the connection closed
+    bool writeRing(const char *buff, size_t len)
+    {
+        IpcLock lock(_tx.sync);
+        while (len != 0)
+        {
+            if (_tx.closed != 0) return false;
+            const size_t space = IPC_RING_SIZE - size_t(_tx.writeCount - _tx.readCount);
+            if (space == 0)
+            {
+                if (not processAlive(_peerPid)) return false;
+                lock.wait();
+                continue;
+            }
+            const size_t n = std::min(space, len);
+            const size_t offset = size_t(_tx.writeCount % IPC_RING_SIZE);
+            const size_t first = std::min(n, IPC_RING_SIZE-offset);
+            std::memcpy(_tx.data+offset, buff, first);
+            std::memcpy(_tx.data, buff+first, n-first);
+            _tx.writeCount += n;
+            buff += n;
+            len -= n;
+            lock.notify();
+        }
+        return true;
+    }
+
+    //! Block until bytes are available, zero when the connection closed
+    size_t readRing(char *buff, const size_t len)
+    {
+        IpcLock lock(_rx.sync);
+        while (_rx.writeCount == _rx.readCount)
+        {
+            if (_rx.closed != 0 or not processAlive(_peerPid)) return 0;
+            lock.wait();
+        }
+        const size_t n = std::min(len, size_t(_rx.writeCount - _rx.readCount));
+        const size_t offset = size_t(_rx.readCount % IPC_RING_SIZE);
+        const size_t first = std::min(n, IPC_RING_SIZE-offset);
+        std::memcpy(buff, _rx.data+offset, first);
+        std::memcpy(buff+first, _rx.data, n-first);
+        _rx.readCount += n;
+        lock.notify();
+        return n;
+    }
+
+    std::shared_ptr<IpcConnection> _conn;
+    IpcRing &_tx, &_rx;
+    const int32_t _peerPid;
+    char _rxBuff[64*1024];
+    char _txBuff[64*1024];
+};
+
+class IpcStream : public std::iostream
+{
+public:
+    IpcStream(const std::shared_ptr<IpcConnection> &conn, const bool isServer):
+        std::iostream(nullptr),
+        _buf(conn, isServer)
+    {
+        this->rdbuf(&_buf);
+    }
+
+    ~IpcStream(void)
+    {
+        this->rdbuf(nullptr);
+    }
+
+private:
+    IpcStreamBuf _buf;
+};
+
+/***********************************************************************
+ * Listener implementation
+ **********************************************************************/
+struct Pothos::RemoteIpcListener::Impl
+{
+    std::string name;
+    std::shared_ptr<IpcListener> listener;
+    std::mutex mutex;
+    std::vector<std::weak_ptr<IpcConnection>> connections;
+};
+
+static std::atomic<unsigned> ipcNameCount(0);
+
+static std::string uniqueIpcName(const std::string &prefix)
+{
+    return Poco::format("%s%d-%u", prefix, int(getpid()), unsigned(ipcNameCount++));
+}
+
+Pothos::RemoteIpcListener::RemoteIpcListener(const std::string &name):
+    _impl(new Impl())
+{
+    _impl->name = name.empty()?uniqueIpcName(""):name;
+    const auto shmName = listenerShmName(_impl->name);
+
+    try
+    {
+        //remove a listener that was left behind by a process that exited
+        try
+        {
+            IpcListener stale(shmName, false);
+            if (not processAlive(stale->serverPid)) stale.unlink();
+        }
+        catch (const Pothos::SystemException &){}
+
+        _impl->listener.reset(new IpcListener(shmName, true));
+    }
+    catch (const Pothos::Exception &ex)
+    {
+        throw Pothos::RemoteServerError("Pothos::RemoteIpcListener("+name+")", ex);
+    }
+
+    //clients only use the listener once the sync is initialized
+    initSync((*_impl->listener)->sync);
+    (*_impl->listener)->serverPid = int32_t(getpid());
+    (*_impl->listener)->ready.store(1, std::memory_order_release);
+}
+
+Pothos::RemoteIpcListener::~RemoteIpcListener(void)
+{
+    _impl->listener->unlink();
+}
+
+const std::string &Pothos::RemoteIpcListener::getName(void) const
+{
+    return _impl->name;
+}
+
+std::shared_ptr<std::iostream> Pothos::RemoteIpcListener::accept(const long timeoutUs)
+{
+    const auto exitTime = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+    auto &listener = *_impl->listener;
+
+    while (true)
+    {
+        //wait for a client to hand over its connection name
+        std::string connName;
+        {
+            IpcLock lock(listener->sync);
+            while (listener->pending == 0)
+            {
+                const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(exitTime - std::chrono::steady_clock::now());
+                if (remaining.count() <= 0) return nullptr;
+                lock.wait(long(remaining.count()));
+            }
+            connName.assign(listener->connName, strnlen(listener->connName, IPC_NAME_SIZE));
+            listener->pending = 0;
+            lock.notify();
+        }
+
+        //attach to the connection, the client may have given up already
+        std::shared_ptr<IpcConnection> conn;
+        try
+        {
+            conn.reset(new IpcConnection(connName, false));
+        }
+        catch (const Pothos::SystemException &)
+        {
+            continue;
+        }
+        conn->unlink(); //both ends are mapped, the name is no longer needed
+
+        //remember the connection for closeConnections() before the client sees it
+        {
+            std::lock_guard<std::mutex> lock(_impl->mutex);
+            auto &conns = _impl->connections;
+            conns.erase(std::remove_if(conns.begin(), conns.end(),
+                [](const std::weak_ptr<IpcConnection> &c){return c.expired();}), conns.end());
+            conns.push_back(conn);
+        }
+
+        //notify the client of the accepted connection,
+        //unless the client timed out and closed the connection already
+        {
+            IpcLock lock((*conn)->rings[1].sync);
+            if ((*conn)->rings[1].closed != 0) continue;
+            (*conn)->serverPid = int32_t(getpid());
+            (*conn)->accepted = 1;
+            lock.notify();
+        }
+
+        return std::make_shared<IpcStream>(conn, true);
+    }
+}
+
+void Pothos::RemoteIpcListener::closeConnections(void)
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    for (const auto &weakConn : _impl->connections)
+    {
+        const auto conn = weakConn.lock();
+        if (not conn) continue;
+        for (auto &ring : (*conn)->rings)
+        {
+            IpcLock ringLock(ring.sync);
+            ring.closed = 1;
+            ringLock.notify();
+        }
+    }
+    _impl->connections.clear();
+}
+
+/***********************************************************************
+ * Client connection
+ **********************************************************************/
+std::shared_ptr<std::iostream> Pothos::RemoteIpcListener::connect(const std::string &name, const long timeoutUs)
+{
+    const auto exitTime = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+    const auto timedOut = [exitTime]{return std::chrono::steady_clock::now() >= exitTime;};
+
+    //open the listener and create the connection segment
+    std::shared_ptr<IpcListener> listener;
+    std::shared_ptr<IpcConnection> conn;
+    const auto connName = uniqueIpcName("/pothos-c");
+    try
+    {
+        listener.reset(new IpcListener(listenerShmName(name), false));
+        conn.reset(new IpcConnection(connName, true));
+    }
+    catch (const Pothos::Exception &ex)
+    {
+        throw Pothos::RemoteClientError("Pothos::RemoteIpcListener::connect("+name+")", ex);
+    }
+    for (auto &ring : (*conn)->rings) initSync(ring.sync);
+    (*conn)->clientPid = int32_t(getpid());
+
+    //wait for the server to finish initializing the listener
+    while ((*listener)->ready.load(std::memory_order_acquire) == 0)
+    {
+        if (timedOut())
+        {
+            conn->unlink();
+            throw Pothos::RemoteClientError("Pothos::RemoteIpcListener::connect("+name+")", "listener not ready");
+        }
+        usleep(IPC_LOCK_RETRY_US);
+    }
+
+    //hand the connection name to the listener once the slot is free
+    {
+        IpcLock lock((*listener)->sync);
+        while ((*listener)->pending != 0)
+        {
+            if (timedOut() or not processAlive((*listener)->serverPid))
+            {
+                conn->unlink();
+                throw Pothos::RemoteClientError("Pothos::RemoteIpcListener::connect("+name+")", "listener not responding");
+            }
+            lock.wait();
+        }
+        std::strncpy((*listener)->connName, connName.c_str(), IPC_NAME_SIZE-1);
+        (*listener)->pending = 1;
+        lock.notify();
+    }
+
+    //wait for the server to attach to the connection
+    {
+        IpcLock lock((*conn)->rings[1].sync);
+        while ((*conn)->accepted == 0)
+        {
+            if (timedOut() or not processAlive((*listener)->serverPid))
+            {
+                //a server that attaches late sees the closed ring and skips the connection
+                (*conn)->rings[1].closed = 1;
+                conn->unlink();
+                throw Pothos::RemoteClientError("Pothos::RemoteIpcListener::connect("+name+")", "connection not accepted");
+            }
+            lock.wait();
+        }
+    }
+    return std::make_shared<IpcStream>(conn, false);
+}
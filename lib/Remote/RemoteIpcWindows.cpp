@@ -0,0 +1,44 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Remote/Ipc.hpp>
+#include <Pothos/Remote/Exception.hpp>
+#include <iostream>
+
+/***********************************************************************
+ * The shared memory transport is not implemented on this platform
+ **********************************************************************/
+struct Pothos::RemoteIpcListener::Impl
+{
+    std::string name;
+};
+
+Pothos::RemoteIpcListener::RemoteIpcListener(const std::string &name)
+{
+    throw Pothos::RemoteServerError("Pothos::RemoteIpcListener("+name+")", "not supported on this platform");
+}
+
+Pothos::RemoteIpcListener::~RemoteIpcListener(void)
+{
+    return;
+}
+
+const std::string &Pothos::RemoteIpcListener::getName(void) const
+{
+    return _impl->name;
+}
+
+std::shared_ptr<std::iostream> Pothos::RemoteIpcListener::accept(const long)
+{
+    return nullptr;
+}
+
+void Pothos::RemoteIpcListener::closeConnections(void)
+{
+    return;
+}
+
+std::shared_ptr<std::iostream> Pothos::RemoteIpcListener::connect(const std::string &name, const long)
+{
+    throw Pothos::RemoteClientError("Pothos::RemoteIpcListener::connect("+name+")", "not supported on this platform");
+}
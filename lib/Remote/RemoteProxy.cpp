@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "RemoteProxy.hpp"
@@ -10,46 +10,23 @@
 #include <sstream>
 #include <thread>
 #include <cstdint>
+#include <algorithm> //min/max
 
-Pothos::ObjectKwargs RemoteProxyEnvironment::transact(const Pothos::ObjectKwargs &reqArgs_)
-{
-    if (not connectionActive)
-    {
-        throw Pothos::IOException("RemoteProxyEnvironment::transact()", "connection inactive");
-    }
-
-    //add the thread ID to the args
-    //tid must be a fixed size type so it doesn't get truncated through serialization
-    const auto tid = uint32_t(std::hash<std::thread::id>()(std::this_thread::get_id()));
-    auto reqArgs = reqArgs_;
-    reqArgs["tid"] = Pothos::Object(tid);
-
-    //send request object over output stream
-    POTHOS_EXCEPTION_TRY
-    {
-        std::lock_guard<std::mutex> lock(osMutex);
-        sendDatagram(os, reqArgs);
-    }
-    POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
-    {
-        connectionActive = false;
-        throw Pothos::IOException("RemoteProxyEnvironment::sendDatagram()", ex.message());
-    }
+/*!
+ * The maximum number of pipelined requests without a reply read from the stream.
+ * A sender past this limit reads replies first, so that neither peer
+ * can block indefinitely on a full stream buffer in the other direction.
+ */
+static const size_t MAX_OUTSTANDING_REQUESTS = 64;
 
-    //wait for reply object
-    while (true)
+template <typename Predicate>
+void RemoteProxyEnvironment::waitReplies(std::unique_lock<std::mutex> &lock, Predicate done)
+{
+    while (not done())
     {
-        std::unique_lock<std::mutex> lock(isMutex);
-
-        //is there a reply in the cache?
-        auto it = tidToReply.find(tid);
-        if (it != tidToReply.end())
+        if (not connectionActive)
         {
-            auto reply = it->second;
-            tidToReply.erase(it);
-            lock.unlock();
-            isCond.notify_all();
-            return reply;
+            throw Pothos::IOException("RemoteProxyEnvironment::recvDatagram()", "connection inactive");
         }
 
         //a thread is blocking on the input stream wait here
@@ -63,72 +40,155 @@ Pothos::ObjectKwargs RemoteProxyEnvironment::transact(const Pothos::ObjectKwargs
         //so that other threads can access the reply cache or wait.
         isBlocking = true;
         lock.unlock();
-        Pothos::ObjectKwargs replyArgs;
+        RemoteMessage reply;
         POTHOS_EXCEPTION_TRY
         {
-            replyArgs = recvDatagram(is);
+            uint32_t replyVersion(0);
+            reply = recvDatagram(is, replyVersion);
         }
         POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
         {
+            lock.lock();
             isBlocking = false;
-            isCond.notify_all();
             connectionActive = false;
+            isCond.notify_all();
             throw Pothos::IOException("RemoteProxyEnvironment::recvDatagram()", ex.message());
         }
         lock.lock();
         isBlocking = false;
 
-        //this is our thread ID, reply args
-        const size_t replyTid(replyArgs.at("tid"));
-        if (replyTid == tid)
+        //store to the reply cache for the waiting thread
+        //or keep only the result handle of an abandoned call to release it
+        numOutstanding--;
+        if (abandonedTids.erase(reply.tid) == 0) tidToReply[reply.tid] = std::move(reply);
+        else if (reply.status == REMOTE_STATUS_OK) abandonedHandles.push_back(reply.handleID);
+        isCond.notify_all();
+    }
+}
+
+uint32_t RemoteProxyEnvironment::sendRequest(const RemoteMessage &request_)
+{
+    if (not connectionActive)
+    {
+        throw Pothos::IOException("RemoteProxyEnvironment::transact()", "connection inactive");
+    }
+
+    //add a unique transaction ID to the request
+    //the reply is matched by this ID, so requests from any thread can be pipelined
+    auto request = request_;
+    request.tid = nextTid++;
+
+    //limit the number of requests in-flight
+    if (not request.noReply)
+    {
+        std::unique_lock<std::mutex> lock(isMutex);
+        waitReplies(lock, [this]{return numOutstanding < MAX_OUTSTANDING_REQUESTS;});
+        numOutstanding++;
+    }
+
+    //send request object over output stream
+    POTHOS_EXCEPTION_TRY
+    {
+        std::lock_guard<std::mutex> lock(osMutex);
+        sendDatagram(os, request, (request.opcode == REMOTE_OP_OPEN_ENV)?POTHOS_REMOTE_PROTOCOL_LEGACY:protocolVersion);
+    }
+    POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
+    {
+        connectionActive = false;
+        throw Pothos::IOException("RemoteProxyEnvironment::sendDatagram()", ex.message());
+    }
+
+    return request.tid;
+}
+
+RemoteMessage RemoteProxyEnvironment::recvReply(const uint32_t tid)
+{
+    std::unique_lock<std::mutex> lock(isMutex);
+    waitReplies(lock, [this, tid]{return tidToReply.count(tid) != 0;});
+    auto it = tidToReply.find(tid);
+    auto reply = std::move(it->second);
+    tidToReply.erase(it);
+    const bool release = not abandonedHandles.empty();
+    lock.unlock();
+    if (release) this->releaseAbandonedHandles();
+    return reply;
+}
+
+void RemoteProxyEnvironment::abandonReply(const uint32_t tid)
+{
+    {
+        std::lock_guard<std::mutex> lock(isMutex);
+        auto it = tidToReply.find(tid);
+        if (it == tidToReply.end())
         {
-            lock.unlock();
-            isCond.notify_all();
-            return replyArgs;
+            abandonedTids.insert(tid);
+            return;
         }
+        if (it->second.status == REMOTE_STATUS_OK) abandonedHandles.push_back(it->second.handleID);
+        tidToReply.erase(it);
+    }
+    this->releaseAbandonedHandles();
+}
 
-        //otherwise store to the reply cache
-        tidToReply[replyTid] = replyArgs;
-        lock.unlock();
-        isCond.notify_all();
+void RemoteProxyEnvironment::releaseAbandonedHandles(void)
+{
+    std::vector<uint64_t> handles;
+    {
+        std::lock_guard<std::mutex> lock(isMutex);
+        handles.swap(abandonedHandles);
     }
+
+    //the handle destructor releases the object on the server
+    for (const auto handleID : handles) this->makeHandle(handleID);
+}
+
+RemoteMessage RemoteProxyEnvironment::transact(const RemoteMessage &request)
+{
+    return this->recvReply(this->sendRequest(request));
 }
 
 RemoteProxyEnvironment::RemoteProxyEnvironment(
     std::istream &is, std::ostream &os,
     const std::string &name, const Pothos::ProxyEnvironmentArgs &args
 ):
-    is(is), os(os), name(name), connectionActive(true), isBlocking(false)
+    protocolVersion(POTHOS_REMOTE_PROTOCOL_LEGACY),
+    is(is), os(os), name(name), connectionActive(true), isBlocking(false),
+    nextTid(0), numOutstanding(0)
 {
     //create request
-    Pothos::ObjectKwargs req;
+    //The open request is always in the legacy format so that any server can parse it.
+    //The server replies with the negotiated version, or without one if it predates it.
+    Pothos::ObjectKwargs envArgs;
     for (const auto &entry : args)
     {
-        req[entry.first] = Pothos::Object(entry.second);
+        envArgs[entry.first] = Pothos::Object(entry.second);
     }
-    req["action"] = Pothos::Object("RemoteProxyEnvironment");
-    req["name"] = Pothos::Object(name);
+    RemoteMessage req(REMOTE_OP_OPEN_ENV);
+    req.name = name;
+    req.object = Pothos::Object(envArgs);
+    req.version = POTHOS_REMOTE_PROTOCOL_VERSION;
 
-    auto reply = this->transact(req);
+    const auto reply = this->transact(req);
 
     //check for an error
-    auto errorMsgIt = reply.find("errorMsg");
-    if (errorMsgIt != reply.end()) throw Pothos::ProxyEnvironmentFactoryError(
-        "RemoteProxyEnvironment()", errorMsgIt->second.extract<std::string>());
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyEnvironmentFactoryError(
+        "RemoteProxyEnvironment()", reply.name);
 
     //set the remote ID for this env
-    remoteID = reply["envID"];
-    upid = reply["upid"].convert<std::string>();
-    nodeId = reply["nodeId"].convert<std::string>();
-    peerAddr = reply["peerAddr"].convert<std::string>();
+    const auto &info = reply.object.extract<Pothos::ObjectKwargs>();
+    remoteID = reply.envID;
+    upid = info.at("upid").convert<std::string>();
+    nodeId = info.at("nodeId").convert<std::string>();
+    peerAddr = info.at("peerAddr").convert<std::string>();
+    protocolVersion = std::max<uint32_t>(POTHOS_REMOTE_PROTOCOL_LEGACY,
+        std::min<uint32_t>(POTHOS_REMOTE_PROTOCOL_VERSION, reply.version));
 }
 
 RemoteProxyEnvironment::~RemoteProxyEnvironment(void)
 {
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("~RemoteProxyEnvironment");
-    req["envID"] = Pothos::Object(this->remoteID);
+    RemoteMessage req(REMOTE_OP_CLOSE_ENV);
+    req.envID = this->remoteID;
 
     try
     {
@@ -141,7 +201,7 @@ RemoteProxyEnvironment::~RemoteProxyEnvironment(void)
     }
 }
 
-Pothos::Proxy RemoteProxyEnvironment::makeHandle(const size_t remoteID)
+Pothos::Proxy RemoteProxyEnvironment::makeHandle(const uint64_t remoteID)
 {
     auto env = std::dynamic_pointer_cast<RemoteProxyEnvironment>(this->shared_from_this());
     return Pothos::Proxy(new RemoteProxyHandle(env, remoteID));
@@ -164,39 +224,35 @@ std::shared_ptr<RemoteProxyHandle> RemoteProxyEnvironment::getHandle(const Potho
 Pothos::Proxy RemoteProxyEnvironment::findProxy(const std::string &name)
 {
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("findProxy");
-    req["envID"] = Pothos::Object(this->remoteID);
-    req["name"] = Pothos::Object(name);
+    RemoteMessage req(REMOTE_OP_FIND_PROXY);
+    req.envID = this->remoteID;
+    req.name = name;
 
-    auto reply = this->transact(req);
+    const auto reply = this->transact(req);
 
     //check for an error
-    auto errorMsgIt = reply.find("errorMsg");
-    if (errorMsgIt != reply.end()) throw Pothos::ProxyEnvironmentFindError(
-        "RemoteProxyEnvironment::findProxy("+name+")", errorMsgIt->second.extract<std::string>());
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyEnvironmentFindError(
+        "RemoteProxyEnvironment::findProxy("+name+")", reply.name);
 
     //otherwise make a handle
-    return this->makeHandle(reply["handleID"]);
+    return this->makeHandle(reply.handleID);
 }
 
 Pothos::Proxy RemoteProxyEnvironment::convertObjectToProxy(const Pothos::Object &local)
 {
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("convertObjectToProxy");
-    req["envID"] = Pothos::Object(this->remoteID);
-    req["local"] = local;
+    RemoteMessage req(REMOTE_OP_CONVERT_OBJECT_TO_PROXY);
+    req.envID = this->remoteID;
+    req.object = local;
 
-    auto reply = this->transact(req);
+    const auto reply = this->transact(req);
 
     //check for an error
-    auto errorMsgIt = reply.find("errorMsg");
-    if (errorMsgIt != reply.end()) throw Pothos::ProxyEnvironmentConvertError(
-        "RemoteProxyEnvironment::convertObjectToProxy()", errorMsgIt->second.extract<std::string>());
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyEnvironmentConvertError(
+        "RemoteProxyEnvironment::convertObjectToProxy()", reply.name);
 
     //otherwise make a handle
-    return this->makeHandle(reply["handleID"]);
+    return this->makeHandle(reply.handleID);
 }
 
 Pothos::Object RemoteProxyEnvironment::convertProxyToObject(const Pothos::Proxy &proxy)
@@ -204,19 +260,82 @@ Pothos::Object RemoteProxyEnvironment::convertProxyToObject(const Pothos::Proxy
     auto handle = this->getHandle(proxy);
 
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("convertProxyToObject");
-    req["envID"] = Pothos::Object(this->remoteID);
-    req["handleID"] = Pothos::Object(handle->remoteID);
+    RemoteMessage req(REMOTE_OP_CONVERT_PROXY_TO_OBJECT);
+    req.envID = this->remoteID;
+    req.handleID = handle->remoteID;
 
-    auto reply = this->transact(req);
+    const auto reply = this->transact(req);
 
     //check for an error
-    auto errorMsgIt = reply.find("errorMsg");
-    if (errorMsgIt != reply.end()) throw Pothos::ProxyEnvironmentConvertError(
-        "RemoteProxyEnvironment::convertProxyToObject()", errorMsgIt->second.extract<std::string>());
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyEnvironmentConvertError(
+        "RemoteProxyEnvironment::convertProxyToObject()", reply.name);
 
-    return reply["local"];
+    return reply.object;
+}
+
+std::vector<std::future<Pothos::Object>> RemoteProxyEnvironment::callBatch(const std::vector<Pothos::ProxyBatchCall> &calls)
+{
+    //servers before the batch protocol cannot execute a batch, make the calls one at a time
+    if (protocolVersion < POTHOS_REMOTE_PROTOCOL_BATCH) return Pothos::ProxyEnvironment::callBatch(calls);
+
+    //create request
+    //hold converted handles until the request is sent
+    RemoteMessage req(REMOTE_OP_BATCH);
+    req.batch.reserve(calls.size());
+    std::vector<std::shared_ptr<RemoteProxyHandle>> handles;
+    for (const auto &call : calls)
+    {
+        RemoteMessage callReq(REMOTE_OP_CALL);
+        callReq.name = call.name;
+        callReq.toLocal = call.toLocal;
+        if (call.object)
+        {
+            handles.push_back(this->getHandle(call.object));
+            callReq.handleID = handles.back()->remoteID;
+        }
+        else callReq.handleID = REMOTE_BATCH_RESULT_ID | call.resultIndex;
+
+        //proxy arguments are passed by ID, and local objects are sent inline
+        Pothos::ObjectVector inlineArgs;
+        for (const auto &arg : call.args)
+        {
+            if (arg.type() == typeid(Pothos::Proxy))
+            {
+                handles.push_back(this->getHandle(arg.extract<Pothos::Proxy>()));
+                callReq.argIDs.push_back(handles.back()->remoteID);
+            }
+            else
+            {
+                callReq.argIDs.push_back(REMOTE_INLINE_OBJECT_ID | inlineArgs.size());
+                inlineArgs.push_back(arg);
+            }
+        }
+        if (not inlineArgs.empty()) callReq.object = Pothos::Object(inlineArgs);
+        req.batch.push_back(std::move(callReq));
+    }
+
+    const auto reply = this->transact(req);
+
+    //check for an error
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyHandleCallError(
+        "RemoteProxyEnvironment::callBatch()", reply.name);
+
+    //load the result of each call
+    std::vector<std::future<Pothos::Object>> futures;
+    futures.reserve(calls.size());
+    for (size_t i = 0; i < calls.size(); i++)
+    {
+        const auto &callReply = reply.batch.at(i);
+        std::promise<Pothos::Object> promise;
+        if (callReply.status == REMOTE_STATUS_ERROR) promise.set_exception(std::make_exception_ptr(
+            Pothos::ProxyHandleCallError("RemoteProxyEnvironment::callBatch("+calls[i].name+")", callReply.name)));
+        else if (callReply.status == REMOTE_STATUS_MESSAGE) promise.set_exception(std::make_exception_ptr(
+            Pothos::ProxyExceptionMessage(callReply.name)));
+        else if (calls[i].toLocal) promise.set_value(callReply.object);
+        else promise.set_value(Pothos::Object(this->makeHandle(callReply.handleID)));
+        futures.push_back(promise.get_future());
+    }
+    return futures;
 }
 
 /***********************************************************************
@@ -1,11 +1,15 @@
-// Copyright (c) 2013-2015 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
 #include <Pothos/Config.hpp>
 #include <Pothos/Proxy.hpp>
 #include <Pothos/Object/Containers.hpp>
+#include "RemoteProxyDatagram.hpp"
 #include <mutex>
+#include <set>
+#include <vector>
+#include <atomic>
 #include <condition_variable>
 
 class RemoteProxyHandle;
@@ -22,7 +26,7 @@ public:
 
     ~RemoteProxyEnvironment(void);
 
-    Pothos::Proxy makeHandle(const size_t remoteID);
+    Pothos::Proxy makeHandle(const uint64_t remoteID);
 
     std::shared_ptr<RemoteProxyHandle> getHandle(const Pothos::Proxy &proxy);
 
@@ -52,6 +56,8 @@ public:
 
     Pothos::Object convertProxyToObject(const Pothos::Proxy &proxy);
 
+    std::vector<std::future<Pothos::Object>> callBatch(const std::vector<Pothos::ProxyBatchCall> &calls);
+
     void serialize(const Pothos::Proxy &, std::ostream &)
     {
         throw Pothos::ProxySerializeError("RemoteProxyEnvironment::serialize()", "not supported");
@@ -62,12 +68,30 @@ public:
         throw Pothos::ProxySerializeError("RemoteProxyEnvironment::deserialize()", "not supported");
     }
 
-    Pothos::ObjectKwargs transact(const Pothos::ObjectKwargs &request);
+    //! Send a request and wait for its reply
+    RemoteMessage transact(const RemoteMessage &request);
+
+    //! Send a request without waiting, return the tid to wait on
+    uint32_t sendRequest(const RemoteMessage &request);
+
+    //! Wait for the reply to a request sent with sendRequest()
+    RemoteMessage recvReply(const uint32_t tid);
+
+    //! Discard the reply to a call request when it arrives without waiting on it
+    void abandonReply(const uint32_t tid);
+
+    //! Release result handles from abandoned replies (call without isMutex held)
+    void releaseAbandonedHandles(void);
 
-    size_t remoteID;
+    //! Read replies from the input stream until the predicate is satisfied
+    template <typename Predicate>
+    void waitReplies(std::unique_lock<std::mutex> &lock, Predicate done);
+
+    uint64_t remoteID;
     std::string upid;
     std::string nodeId;
     std::string peerAddr;
+    uint32_t protocolVersion; //negotiated when the environment is opened
 
     std::istream &is;
     std::ostream &os;
@@ -78,7 +102,11 @@ public:
     std::mutex isMutex;
     std::condition_variable isCond;
     bool isBlocking;
-    std::map<size_t, Pothos::ObjectKwargs> tidToReply;
+    std::map<uint32_t, RemoteMessage> tidToReply;
+    std::set<uint32_t> abandonedTids; //replies to drop on arrival
+    std::vector<uint64_t> abandonedHandles; //result handles to release
+    std::atomic<uint32_t> nextTid;
+    size_t numOutstanding; //requests sent and not yet read from the stream
 };
 
 /***********************************************************************
@@ -88,7 +116,7 @@ class RemoteProxyHandle : public Pothos::ProxyHandle
 {
 public:
 
-    RemoteProxyHandle(std::shared_ptr<RemoteProxyEnvironment> env, const size_t remoteID);
+    RemoteProxyHandle(std::shared_ptr<RemoteProxyEnvironment> env, const uint64_t remoteID);
 
     ~RemoteProxyHandle(void);
 
@@ -99,6 +127,17 @@ public:
 
     Pothos::Proxy call(const std::string &name, const Pothos::Proxy *args, const size_t numArgs);
 
+    std::future<Pothos::Proxy> callAsync(const std::string &name, const Pothos::Object *args, const size_t numArgs);
+
+    //! Send a call request without waiting for the reply
+    uint32_t sendCall(const std::string &name, const Pothos::Proxy *args, const size_t numArgs);
+
+    //! Send a call request with local arguments inline, without waiting for the reply
+    uint32_t sendCall(const std::string &name, const Pothos::Object *args, const size_t numArgs);
+
+    //! Wait for the reply to a call request and make the result handle
+    static Pothos::Proxy recvCall(const std::shared_ptr<RemoteProxyEnvironment> &env, const std::string &name, const uint32_t tid);
+
     int compareTo(const Pothos::Proxy &proxy) const;
     size_t hashCode(void) const;
     std::string toString(void) const;
@@ -106,5 +145,5 @@ public:
 
     std::shared_ptr<RemoteProxyEnvironment> env;
 
-    size_t remoteID;
+    uint64_t remoteID;
 };
@@ -1,14 +1,23 @@
-// Copyright (c) 2013-2015 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "RemoteProxyDatagram.hpp"
+#include "Archive/NoCopyStreamBuf.hpp"
 #include <Pothos/Exception.hpp>
 #include <Poco/ByteOrder.h>
+#include <Poco/Net/SocketStream.h>
+#include <Poco/Net/StreamSocketImpl.h>
 #include <streambuf>
 #include <iostream>
 #include <cstdint>
 #include <algorithm> //min/max
 #include <cstring> //memcpy
+#ifndef _WIN32
+#include <cerrno> //errno
+#include <climits> //IOV_MAX
+#include <sys/socket.h> //sendmsg
+#include <sys/uio.h> //iovec
+#endif
 
 /***********************************************************************
  * Header structure and constants
@@ -20,6 +29,7 @@
     (uint32_t(str[3]) << 0)
 
 static const uint32_t PothosRPCHeaderWord = POTHOS_PACKET_WORD32("PRPC");
+static const uint32_t PothosRPCBinaryHeaderWord = POTHOS_PACKET_WORD32("PRP2");
 static const uint32_t PothosRPCTrailerWord = POTHOS_PACKET_WORD32("CPRP");
 
 struct PothosRPCHeader
@@ -34,110 +44,89 @@ struct PothosRPCTrailer
 };
 
 /***********************************************************************
- * Serialization streambuf
+ * Datagram payload - packed bytes and referenced blocks
  **********************************************************************/
-class PRPCDatagramObuf : public std::streambuf
+struct DatagramPayload
 {
-public:
-    PRPCDatagramObuf(std::ostream &os, const Pothos::Object &data):
-        _bytesWritten(0),
-        _payloadData(1024)
+    DatagramPayload(void):
+        refBytes(0)
     {
-        //serialize to a temporary buffer
-        std::ostream oser(this);
-        data.serialize(oser);
+        return;
+    }
 
-        //load the header and trailer
-        PothosRPCHeader header;
-        header.headerWord = Poco::ByteOrder::toNetwork(PothosRPCHeaderWord);
-        header.payloadBytes = Poco::ByteOrder::toNetwork(uint32_t(_bytesWritten));
+    //! The total number of bytes in the payload
+    size_t size(void) const
+    {
+        return bytes.size() + refBytes;
+    }
 
-        PothosRPCTrailer trailer;
-        trailer.trailerWord = Poco::ByteOrder::toNetwork(PothosRPCTrailerWord);
+    //! A block of memory that is inserted before bytes[offset]
+    struct Ref
+    {
+        size_t offset;
+        const char *data;
+        size_t size;
+    };
 
-        //write to the output stream
-        os.write((const char *)&header, sizeof(header));
-        os.write(_payloadData.data(), _bytesWritten);
-        os.write((const char *)&trailer, sizeof(trailer));
-        os.flush();
-    }
+    std::vector<char> bytes;
+    std::vector<Ref> refs;
+    size_t refBytes;
+};
 
-    void ensureSize(const std::streamsize count)
+/***********************************************************************
+ * Serialization streambuf - appends to a payload
+ **********************************************************************/
+class PRPCDatagramObuf : public NoCopyStreamBuf
+{
+public:
+    PRPCDatagramObuf(DatagramPayload &payload):
+        _payload(payload)
     {
-        //resize temporary buffer to hold the msg
-        while (size_t(_bytesWritten + count) > _payloadData.size())
-        {
-            _payloadData.resize(_payloadData.size()*2);
-        }
+        return;
     }
 
     int_type overflow(int_type c)
     {
         if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::eof();
-        const char_type t = traits_type::to_char_type(c);
-        this->ensureSize(1);
-        _payloadData[_bytesWritten++] = t;
+        _payload.bytes.push_back(traits_type::to_char_type(c));
         return c;
     }
 
     std::streamsize xsputn(const char *s, std::streamsize count)
     {
-        this->ensureSize(count);
-
-        //append the message to the payload
-        std::memcpy(_payloadData.data()+_bytesWritten, s, count);
-        _bytesWritten += count;
-
+        _payload.bytes.insert(_payload.bytes.end(), s, s+count);
         return count;
     }
 
+    //! Large blocks are referenced and gathered when the frame is written
+    void putNoCopy(const char *s, const size_t n)
+    {
+        if (n < MIN_REF_BYTES) return void(this->xsputn(s, std::streamsize(n)));
+        DatagramPayload::Ref ref;
+        ref.offset = _payload.bytes.size();
+        ref.data = s;
+        ref.size = n;
+        _payload.refs.push_back(ref);
+        _payload.refBytes += n;
+    }
+
 private:
-    std::streamsize _bytesWritten;
-    std::vector<char_type> _payloadData;
+    static const size_t MIN_REF_BYTES = 4096;
+    DatagramPayload &_payload;
 };
 
 /***********************************************************************
- * Deserialization streambuf
+ * Deserialization streambuf - reads from a payload buffer
  **********************************************************************/
 class PRPCDatagramIbuf : public std::streambuf
 {
 public:
-    PRPCDatagramIbuf(std::istream &is, Pothos::Object &data):
-        _bytesRead(0)
+    PRPCDatagramIbuf(const char *payloadData, const size_t payloadBytes):
+        _bytesRead(0),
+        _payloadData(payloadData),
+        _payloadBytes(payloadBytes)
     {
-        //read the header
-        PothosRPCHeader header;
-        is.read((char *)&header, sizeof(header));
-        if (is.eof()) throw Pothos::IOException("recvDatagram()", "stream end");
-        if (not is) throw Pothos::IOException("recvDatagram()", "stream error");
-
-        //parse the header
-        if (Poco::ByteOrder::fromNetwork(header.headerWord) != PothosRPCHeaderWord)
-        {
-            throw Pothos::IOException("recvDatagram()", "headerWord fail");
-        }
-        _payloadData.resize(Poco::ByteOrder::fromNetwork(header.payloadBytes));
-
-        //read the payload
-        is.read(_payloadData.data(), _payloadData.size());
-        if (is.eof()) throw Pothos::IOException("recvDatagram()", "stream end");
-        if (not is) throw Pothos::IOException("recvDatagram()", "stream error");
-
-        //read the trailer
-        PothosRPCTrailer trailer;
-        is.read((char *)&trailer, sizeof(trailer));
-        if (is.eof()) throw Pothos::IOException("recvDatagram()", "stream end");
-        if (not is) throw Pothos::IOException("recvDatagram()", "stream error");
-
-        //parse the trailer
-        if (Poco::ByteOrder::fromNetwork(trailer.trailerWord) != PothosRPCTrailerWord)
-        {
-            throw Pothos::IOException("recvDatagram()", "trailerWord fail");
-        }
-
-        //deserialize from temporary buffer
-        std::istream iser(this);
-        data.deserialize(iser);
+        return;
     }
 
     int_type underflow(void)
@@ -156,7 +145,7 @@ public:
 
     std::streamsize showmanyc(void)
     {
-        return _payloadData.size()-_bytesRead;
+        return _payloadBytes-_bytesRead;
     }
 
     int_type pbackfail(int_type c)
@@ -174,28 +163,552 @@ public:
         const auto available = this->showmanyc();
         if (available == 0) return traits_type::eof();
         n = std::min<std::streamsize>(n, available);
-        std::memcpy(s, _payloadData.data()+_bytesRead, n);
+        std::memcpy(s, _payloadData+_bytesRead, n);
         _bytesRead += n;
         return n;
     }
 
 private:
     std::streamsize _bytesRead;
-    std::vector<char_type> _payloadData;
+    const char *_payloadData;
+    const std::streamsize _payloadBytes;
+};
+
+/***********************************************************************
+ * Datagram framing: header, payload, trailer
+ **********************************************************************/
+#ifndef _WIN32
+//! Write the frame segments to a socket stream with gather IO
+static bool sendFrameGather(std::ostream &os, std::vector<iovec> &iov)
+{
+    auto socketBuf = dynamic_cast<Poco::Net::SocketStreamBuf *>(os.rdbuf());
+    if (socketBuf == nullptr) return false;
+    os.flush(); //anything buffered goes first
+    if (not os) throw Pothos::IOException("sendDatagram()", "stream error");
+
+    #ifdef MSG_NOSIGNAL
+    static const int flags = MSG_NOSIGNAL;
+    #else
+    static const int flags = 0;
+    #endif
+
+    const auto fd = socketBuf->socketImpl()->sockfd();
+    size_t index = 0;
+    while (index < iov.size())
+    {
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov.data()+index;
+        msg.msg_iovlen = std::min<size_t>(iov.size()-index, IOV_MAX);
+        const auto ret = sendmsg(fd, &msg, flags);
+        if (ret < 0 and errno == EINTR) continue;
+        if (ret < 0) throw Pothos::IOException("sendDatagram()", std::strerror(errno));
+
+        //advance past the segments that were written
+        size_t n = size_t(ret);
+        while (index < iov.size() and n >= iov[index].iov_len) n -= iov[index++].iov_len;
+        if (n == 0) continue;
+        iov[index].iov_base = (char *)iov[index].iov_base + n;
+        iov[index].iov_len -= n;
+    }
+    return true;
+}
+#endif //_WIN32
+
+static void writeFrame(std::ostream &os, const uint32_t headerWord, const DatagramPayload &payload)
+{
+    //load the header and trailer
+    PothosRPCHeader header;
+    header.headerWord = Poco::ByteOrder::toNetwork(headerWord);
+    header.payloadBytes = Poco::ByteOrder::toNetwork(uint32_t(payload.size()));
+
+    PothosRPCTrailer trailer;
+    trailer.trailerWord = Poco::ByteOrder::toNetwork(PothosRPCTrailerWord);
+
+    //list the segments: header, packed bytes interleaved with references, trailer
+    std::vector<std::pair<const char *, size_t>> segments;
+    segments.reserve(payload.refs.size()*2 + 3);
+    segments.emplace_back((const char *)&header, sizeof(header));
+    size_t offset = 0;
+    for (const auto &ref : payload.refs)
+    {
+        segments.emplace_back(payload.bytes.data()+offset, ref.offset-offset);
+        segments.emplace_back(ref.data, ref.size);
+        offset = ref.offset;
+    }
+    segments.emplace_back(payload.bytes.data()+offset, payload.bytes.size()-offset);
+    segments.emplace_back((const char *)&trailer, sizeof(trailer));
+
+    //referenced blocks go straight from their memory to the socket
+    #ifndef _WIN32
+    if (not payload.refs.empty())
+    {
+        std::vector<iovec> iov;
+        iov.reserve(segments.size());
+        for (const auto &segment : segments)
+        {
+            if (segment.second == 0) continue;
+            iovec v;
+            v.iov_base = const_cast<char *>(segment.first);
+            v.iov_len = segment.second;
+            iov.push_back(v);
+        }
+        if (sendFrameGather(os, iov)) return;
+    }
+    #endif //_WIN32
+
+    //write to the output stream
+    for (const auto &segment : segments)
+    {
+        os.write(segment.first, segment.second);
+    }
+    os.flush();
+}
+
+size_t datagramFrameSize(const char *buff, const size_t len)
+{
+    PothosRPCHeader header;
+    if (len < sizeof(header)) return 0;
+    std::memcpy(&header, buff, sizeof(header));
+    const auto headerWord = Poco::ByteOrder::fromNetwork(header.headerWord);
+    if (headerWord != PothosRPCHeaderWord and headerWord != PothosRPCBinaryHeaderWord)
+    {
+        throw Pothos::IOException("datagramFrameSize()", "headerWord fail");
+    }
+    const size_t payloadBytes = Poco::ByteOrder::fromNetwork(header.payloadBytes);
+    if (payloadBytes > POTHOS_REMOTE_MAX_PAYLOAD_BYTES)
+    {
+        throw Pothos::IOException("datagramFrameSize()", "payload too large");
+    }
+    return sizeof(header) + payloadBytes + sizeof(PothosRPCTrailer);
+}
+
+static uint32_t readFrame(std::istream &is, std::vector<char> &payloadData)
+{
+    //read the header
+    PothosRPCHeader header;
+    is.read((char *)&header, sizeof(header));
+    if (is.eof()) throw Pothos::IOException("recvDatagram()", "stream end");
+    if (not is) throw Pothos::IOException("recvDatagram()", "stream error");
+
+    //parse the header
+    const auto headerWord = Poco::ByteOrder::fromNetwork(header.headerWord);
+    if (headerWord != PothosRPCHeaderWord and headerWord != PothosRPCBinaryHeaderWord)
+    {
+        throw Pothos::IOException("recvDatagram()", "headerWord fail");
+    }
+    const size_t payloadBytes = Poco::ByteOrder::fromNetwork(header.payloadBytes);
+    if (payloadBytes > POTHOS_REMOTE_MAX_PAYLOAD_BYTES)
+    {
+        throw Pothos::IOException("recvDatagram()", "payload too large");
+    }
+    payloadData.resize(payloadBytes);
+
+    //read the payload
+    is.read(payloadData.data(), payloadData.size());
+    if (is.eof()) throw Pothos::IOException("recvDatagram()", "stream end");
+    if (not is) throw Pothos::IOException("recvDatagram()", "stream error");
+
+    //read the trailer
+    PothosRPCTrailer trailer;
+    is.read((char *)&trailer, sizeof(trailer));
+    if (is.eof()) throw Pothos::IOException("recvDatagram()", "stream end");
+    if (not is) throw Pothos::IOException("recvDatagram()", "stream error");
+
+    //parse the trailer
+    if (Poco::ByteOrder::fromNetwork(trailer.trailerWord) != PothosRPCTrailerWord)
+    {
+        throw Pothos::IOException("recvDatagram()", "trailerWord fail");
+    }
+
+    return headerWord;
+}
+
+/***********************************************************************
+ * Legacy protocol: messages as ObjectKwargs with action strings
+ **********************************************************************/
+static const char *opcodeToAction(const RemoteOpcode opcode)
+{
+    switch (opcode)
+    {
+    case REMOTE_OP_OPEN_ENV: return "RemoteProxyEnvironment";
+    case REMOTE_OP_CLOSE_ENV: return "~RemoteProxyEnvironment";
+    case REMOTE_OP_FIND_PROXY: return "findProxy";
+    case REMOTE_OP_CONVERT_OBJECT_TO_PROXY: return "convertObjectToProxy";
+    case REMOTE_OP_CONVERT_PROXY_TO_OBJECT: return "convertProxyToObject";
+    case REMOTE_OP_DELETE_HANDLE: return "~RemoteProxyHandle";
+    case REMOTE_OP_CALL: return "call";
+    case REMOTE_OP_COMPARE_TO: return "compareTo";
+    case REMOTE_OP_HASH_CODE: return "hashCode";
+    case REMOTE_OP_TO_STRING: return "toString";
+    case REMOTE_OP_GET_CLASS_NAME: return "getClassName";
+    case REMOTE_OP_BATCH: return "batch";
+    default: return "";
+    }
+}
+
+static RemoteOpcode actionToOpcode(const std::string &action)
+{
+    for (int op = REMOTE_OP_OPEN_ENV; op < REMOTE_OP_BATCH; op++)
+    {
+        if (action == opcodeToAction(RemoteOpcode(op))) return RemoteOpcode(op);
+    }
+    return REMOTE_OP_NONE;
+}
+
+static const char *openEnvInfoKeys[] = {"upid", "nodeId", "peerAddr"};
+
+static Pothos::ObjectKwargs requestToKwargs(const RemoteMessage &msg)
+{
+    //batches, local results, and inline call arguments are batch protocol features
+    if (msg.opcode == REMOTE_OP_BATCH or msg.toLocal or (msg.opcode == REMOTE_OP_CALL and msg.object))
+    {
+        throw Pothos::NotImplementedException("sendDatagram()",
+            std::string(opcodeToAction(msg.opcode))+" request requires the batch protocol");
+    }
+
+    //IDs are sent as size_t as expected by legacy peers
+    Pothos::ObjectKwargs args;
+    args["action"] = Pothos::Object(std::string(opcodeToAction(msg.opcode)));
+    args["tid"] = Pothos::Object(msg.tid);
+    switch (msg.opcode)
+    {
+    case REMOTE_OP_OPEN_ENV:
+        //environment args are the string entries of the request
+        if (msg.object) for (const auto &entry : msg.object.extract<Pothos::ObjectKwargs>())
+        {
+            args[entry.first] = entry.second;
+        }
+        args["name"] = Pothos::Object(msg.name);
+        if (msg.version != 0) args["protocolVersion"] = Pothos::Object(msg.version);
+        break;
+    case REMOTE_OP_CLOSE_ENV:
+        args["envID"] = Pothos::Object(size_t(msg.envID));
+        break;
+    case REMOTE_OP_FIND_PROXY:
+        args["envID"] = Pothos::Object(size_t(msg.envID));
+        args["name"] = Pothos::Object(msg.name);
+        break;
+    case REMOTE_OP_CONVERT_OBJECT_TO_PROXY:
+        args["envID"] = Pothos::Object(size_t(msg.envID));
+        args["local"] = msg.object;
+        break;
+    case REMOTE_OP_CONVERT_PROXY_TO_OBJECT:
+        args["envID"] = Pothos::Object(size_t(msg.envID));
+        args["handleID"] = Pothos::Object(size_t(msg.handleID));
+        break;
+    case REMOTE_OP_CALL:
+        args["handleID"] = Pothos::Object(size_t(msg.handleID));
+        args["name"] = Pothos::Object(msg.name);
+        for (size_t i = 0; i < msg.argIDs.size(); i++)
+        {
+            args[std::to_string(i)] = Pothos::Object(size_t(msg.argIDs[i]));
+        }
+        break;
+    case REMOTE_OP_COMPARE_TO:
+        args["handleID"] = Pothos::Object(size_t(msg.handleID));
+        args["otherID"] = Pothos::Object(size_t(msg.otherID));
+        break;
+    default:
+        args["handleID"] = Pothos::Object(size_t(msg.handleID));
+    }
+    return args;
+}
+
+static Pothos::ObjectKwargs replyToKwargs(const RemoteMessage &msg)
+{
+    Pothos::ObjectKwargs args;
+    args["tid"] = Pothos::Object(msg.tid);
+    if (msg.status == REMOTE_STATUS_ERROR)
+    {
+        args["errorMsg"] = Pothos::Object(msg.name);
+        return args;
+    }
+    if (msg.status == REMOTE_STATUS_MESSAGE)
+    {
+        args["message"] = Pothos::Object(msg.name);
+        return args;
+    }
+    switch (msg.opcode)
+    {
+    case REMOTE_OP_OPEN_ENV:
+        args["envID"] = Pothos::Object(size_t(msg.envID));
+        if (msg.object) for (const auto &entry : msg.object.extract<Pothos::ObjectKwargs>())
+        {
+            args[entry.first] = entry.second;
+        }
+        if (msg.version != 0) args["protocolVersion"] = Pothos::Object(msg.version);
+        break;
+    case REMOTE_OP_FIND_PROXY:
+    case REMOTE_OP_CONVERT_OBJECT_TO_PROXY:
+    case REMOTE_OP_CALL:
+        args["handleID"] = Pothos::Object(size_t(msg.handleID));
+        break;
+    case REMOTE_OP_CONVERT_PROXY_TO_OBJECT:
+        args["local"] = msg.object;
+        break;
+    case REMOTE_OP_COMPARE_TO:
+        args["result"] = Pothos::Object(int(msg.value));
+        break;
+    case REMOTE_OP_HASH_CODE:
+        args["result"] = Pothos::Object(size_t(msg.value));
+        break;
+    case REMOTE_OP_TO_STRING:
+    case REMOTE_OP_GET_CLASS_NAME:
+        args["result"] = Pothos::Object(msg.name);
+        break;
+    default: break;
+    }
+    return args;
+}
+
+static uint64_t idFromObject(const Pothos::Object &obj)
+{
+    return obj.convert<unsigned long long>();
+}
+
+static RemoteMessage kwargsToMessage(const Pothos::ObjectKwargs &args)
+{
+    RemoteMessage msg;
+    msg.tid = args.at("tid").convert<uint32_t>();
+
+    //a request is identified by its action, replies do not echo the action
+    auto actionIt = args.find("action");
+    const bool isRequest = actionIt != args.end();
+    if (isRequest) msg.opcode = actionToOpcode(actionIt->second.extract<std::string>());
+    else msg.status = REMOTE_STATUS_OK;
+
+    //the remaining fields are mapped by name
+    Pothos::ObjectKwargs envArgs, envInfo;
+    for (const auto &entry : args)
+    {
+        const auto &key = entry.first;
+        const auto &value = entry.second;
+        if (key == "envID") msg.envID = idFromObject(value);
+        else if (key == "handleID") msg.handleID = idFromObject(value);
+        else if (key == "otherID") msg.otherID = idFromObject(value);
+        else if (key == "protocolVersion") msg.version = value.convert<uint32_t>();
+        else if (key == "local") msg.object = value;
+        else if (key == "errorMsg")
+        {
+            msg.status = REMOTE_STATUS_ERROR;
+            msg.name = value.extract<std::string>();
+        }
+        else if (key == "message")
+        {
+            msg.status = REMOTE_STATUS_MESSAGE;
+            msg.name = value.extract<std::string>();
+        }
+        else if (key == "result")
+        {
+            if (value.type() == typeid(std::string)) msg.name = value.extract<std::string>();
+            else if (value.type() == typeid(size_t)) msg.value = int64_t(value.extract<size_t>());
+            else msg.value = value.convert<long long>();
+        }
+        else if (not isRequest and std::find(std::begin(openEnvInfoKeys), std::end(openEnvInfoKeys), key) != std::end(openEnvInfoKeys))
+        {
+            envInfo[key] = value;
+        }
+        else if (key == "name" and value.type() == typeid(std::string)) msg.name = value.extract<std::string>();
+    }
+
+    //call arguments are stored by index
+    for (size_t i = 0;; i++)
+    {
+        auto it = args.find(std::to_string(i));
+        if (it == args.end()) break;
+        msg.argIDs.push_back(idFromObject(it->second));
+    }
+
+    //the environment args are all string entries of the request
+    if (msg.opcode == REMOTE_OP_OPEN_ENV)
+    {
+        for (const auto &entry : args)
+        {
+            if (entry.second.type() == typeid(std::string)) envArgs[entry.first] = entry.second;
+        }
+        msg.object = Pothos::Object(envArgs);
+    }
+    if (not envInfo.empty()) msg.object = Pothos::Object(envInfo);
+
+    return msg;
+}
+
+/***********************************************************************
+ * Binary protocol: fixed fields in network byte order
+ *
+ * u8 opcode, u8 status, u8 flags, u8 reserved,
+ * u32 tid, u32 version, u32 nameLen, u32 numArgs,
+ * u64 envID, u64 handleID, u64 otherID, i64 value,
+ * name bytes, u64 argIDs[numArgs],
+ * when flagged: u32 batchSize, then u32 length and packed bytes
+ * for each batched message (batches need protocol version 3),
+ * then the serialized object when flagged.
+ **********************************************************************/
+static const uint8_t BINARY_FLAG_HAS_OBJECT = 0x1;
+static const uint8_t BINARY_FLAG_NO_REPLY = 0x2;
+static const uint8_t BINARY_FLAG_TO_LOCAL = 0x4;
+static const uint8_t BINARY_FLAG_HAS_BATCH = 0x8;
+
+template <typename T>
+static void packWord(std::vector<char> &bytes, const T &word)
+{
+    const auto netWord = Poco::ByteOrder::toNetwork(word);
+    const auto p = (const char *)&netWord;
+    bytes.insert(bytes.end(), p, p+sizeof(netWord));
+}
+
+static void packBinary(const RemoteMessage &msg, DatagramPayload &payload)
+{
+    auto &bytes = payload.bytes;
+    bytes.reserve(bytes.size() + 48 + msg.name.size() + msg.argIDs.size()*8);
+    bytes.push_back(char(msg.opcode));
+    bytes.push_back(char(msg.status));
+    bytes.push_back(char(
+        (msg.object?BINARY_FLAG_HAS_OBJECT:0) |
+        (msg.noReply?BINARY_FLAG_NO_REPLY:0) |
+        (msg.toLocal?BINARY_FLAG_TO_LOCAL:0) |
+        (msg.batch.empty()?0:BINARY_FLAG_HAS_BATCH)));
+    bytes.push_back(char(0));
+    packWord(bytes, Poco::UInt32(msg.tid));
+    packWord(bytes, Poco::UInt32(msg.version));
+    packWord(bytes, Poco::UInt32(msg.name.size()));
+    packWord(bytes, Poco::UInt32(msg.argIDs.size()));
+    packWord(bytes, Poco::UInt64(msg.envID));
+    packWord(bytes, Poco::UInt64(msg.handleID));
+    packWord(bytes, Poco::UInt64(msg.otherID));
+    packWord(bytes, Poco::Int64(msg.value));
+    bytes.insert(bytes.end(), msg.name.begin(), msg.name.end());
+    for (const auto &id : msg.argIDs) packWord(bytes, Poco::UInt64(id));
+    if (not msg.batch.empty()) packWord(bytes, Poco::UInt32(msg.batch.size()));
+    for (const auto &sub : msg.batch)
+    {
+        //reserve the length word and fill it in after packing
+        const auto lengthOffset = bytes.size();
+        packWord(bytes, Poco::UInt32(0));
+        const auto start = payload.size();
+        packBinary(sub, payload);
+        const auto length = Poco::ByteOrder::toNetwork(Poco::UInt32(payload.size()-start));
+        std::memcpy(bytes.data()+lengthOffset, &length, sizeof(length));
+    }
+    if (not msg.object) return;
+    PRPCDatagramObuf obuf(payload);
+    std::ostream oser(&obuf);
+    msg.object.serialize(oser);
+}
+
+class BinaryUnpacker
+{
+public:
+    BinaryUnpacker(const char *payloadData, const size_t payloadBytes):
+        _payloadData(payloadData),
+        _payloadBytes(payloadBytes),
+        _offset(0)
+    {
+        return;
+    }
+
+    const char *take(const size_t numBytes)
+    {
+        if (_offset + numBytes > _payloadBytes)
+        {
+            throw Pothos::IOException("recvDatagram()", "payload truncated");
+        }
+        const auto p = _payloadData+_offset;
+        _offset += numBytes;
+        return p;
+    }
+
+    template <typename T>
+    T word(void)
+    {
+        T netWord;
+        std::memcpy(&netWord, this->take(sizeof(netWord)), sizeof(netWord));
+        return Poco::ByteOrder::fromNetwork(netWord);
+    }
+
+    size_t remaining(void) const
+    {
+        return _payloadBytes-_offset;
+    }
+
+private:
+    const char *_payloadData;
+    const size_t _payloadBytes;
+    size_t _offset;
 };
 
+static RemoteMessage unpackBinary(const char *payloadData, const size_t payloadBytes)
+{
+    BinaryUnpacker unpacker(payloadData, payloadBytes);
+    RemoteMessage msg;
+    const auto bytes = (const uint8_t *)unpacker.take(4);
+    msg.opcode = RemoteOpcode(bytes[0]);
+    msg.status = RemoteStatus(bytes[1]);
+    const auto flags = bytes[2]; //bytes[3] reserved
+    msg.tid = unpacker.word<Poco::UInt32>();
+    msg.version = unpacker.word<Poco::UInt32>();
+    const size_t nameLen = unpacker.word<Poco::UInt32>();
+    const size_t numArgs = unpacker.word<Poco::UInt32>();
+    msg.envID = unpacker.word<Poco::UInt64>();
+    msg.handleID = unpacker.word<Poco::UInt64>();
+    msg.otherID = unpacker.word<Poco::UInt64>();
+    msg.value = unpacker.word<Poco::Int64>();
+    msg.name.assign(unpacker.take(nameLen), nameLen);
+    msg.argIDs.resize(numArgs);
+    for (auto &id : msg.argIDs) id = unpacker.word<Poco::UInt64>();
+    msg.noReply = (flags & BINARY_FLAG_NO_REPLY) != 0;
+    msg.toLocal = (flags & BINARY_FLAG_TO_LOCAL) != 0;
+    const size_t batchSize = ((flags & BINARY_FLAG_HAS_BATCH) == 0)?0:unpacker.word<Poco::UInt32>();
+    msg.batch.reserve(batchSize);
+    for (size_t i = 0; i < batchSize; i++)
+    {
+        const size_t length = unpacker.word<Poco::UInt32>();
+        msg.batch.push_back(unpackBinary(unpacker.take(length), length));
+    }
+    if ((flags & BINARY_FLAG_HAS_OBJECT) == 0) return msg;
+    const auto remaining = unpacker.remaining();
+    PRPCDatagramIbuf ibuf(unpacker.take(remaining), remaining);
+    std::istream iser(&ibuf);
+    msg.object.deserialize(iser);
+    return msg;
+}
+
 /***********************************************************************
  * Wrapper calls for datagram interface
  **********************************************************************/
-void sendDatagram(std::ostream &os, const Pothos::ObjectKwargs &reqArgs)
+void sendDatagram(std::ostream &os, const RemoteMessage &msg, const uint32_t version)
 {
-    Pothos::Object request(reqArgs);
-    PRPCDatagramObuf(os, request);
+    DatagramPayload payload;
+    if (version >= POTHOS_REMOTE_PROTOCOL_BINARY)
+    {
+        packBinary(msg, payload);
+        return writeFrame(os, PothosRPCBinaryHeaderWord, payload);
+    }
+
+    payload.bytes.reserve(1024);
+    const Pothos::Object request((msg.status == REMOTE_STATUS_REQUEST)?requestToKwargs(msg):replyToKwargs(msg));
+    PRPCDatagramObuf obuf(payload);
+    std::ostream oser(&obuf);
+    request.serialize(oser);
+    writeFrame(os, PothosRPCHeaderWord, payload);
 }
 
-Pothos::ObjectKwargs recvDatagram(std::istream &is)
+RemoteMessage recvDatagram(std::istream &is, uint32_t &version)
 {
+    //Only sends are gathered without copies. Received objects are deserialized
+    //from the payload, and a BufferChunk copies its bytes into an aligned buffer.
+    std::vector<char> payloadData;
+    if (readFrame(is, payloadData) == PothosRPCBinaryHeaderWord)
+    {
+        version = POTHOS_REMOTE_PROTOCOL_BINARY;
+        return unpackBinary(payloadData.data(), payloadData.size());
+    }
+
+    version = POTHOS_REMOTE_PROTOCOL_LEGACY;
     Pothos::Object reply;
-    PRPCDatagramIbuf(is, reply);
-    return std::move(reply.ref<Pothos::ObjectKwargs>());
+    PRPCDatagramIbuf ibuf(payloadData.data(), payloadData.size());
+    std::istream iser(&ibuf);
+    reply.deserialize(iser);
+    return kwargsToMessage(reply.extract<Pothos::ObjectKwargs>());
 }
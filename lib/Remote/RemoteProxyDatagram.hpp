@@ -1,16 +1,147 @@
-// Copyright (c) 2013-2015 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
 #include <Pothos/Object/Containers.hpp>
 #include <iosfwd>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 /*!
- * Serialize a request object to an output stream
+ * Remote protocol versions:
+ * The legacy protocol serializes each message as an ObjectKwargs map.
+ * The binary protocol encodes messages as fixed fields with opcodes.
+ * The batch protocol adds batched requests, inline call arguments,
+ * and local results to the binary encoding of the same frames.
+ * The version is negotiated when the environment is opened;
+ * the open environment message is always sent in the legacy format,
+ * so peers that predate the negotiation keep working with legacy.
  */
-void sendDatagram(std::ostream &os, const Pothos::ObjectKwargs &reqArgs);
+#define POTHOS_REMOTE_PROTOCOL_LEGACY 1
+#define POTHOS_REMOTE_PROTOCOL_BINARY 2
+#define POTHOS_REMOTE_PROTOCOL_BATCH 3
+#define POTHOS_REMOTE_PROTOCOL_VERSION POTHOS_REMOTE_PROTOCOL_BATCH
 
 /*!
- * Deserialize a reply object from an input stream
+ * Remote protocol opcodes - one per request type.
+ * The numeric values are part of the wire format.
  */
-Pothos::ObjectKwargs recvDatagram(std::istream &is);
+enum RemoteOpcode : uint8_t
+{
+    REMOTE_OP_NONE = 0,
+    REMOTE_OP_OPEN_ENV = 1, //!< name, object=env args, version
+    REMOTE_OP_CLOSE_ENV = 2, //!< envID
+    REMOTE_OP_FIND_PROXY = 3, //!< envID, name
+    REMOTE_OP_CONVERT_OBJECT_TO_PROXY = 4, //!< envID, object
+    REMOTE_OP_CONVERT_PROXY_TO_OBJECT = 5, //!< envID, handleID
+    REMOTE_OP_DELETE_HANDLE = 6, //!< handleID
+    REMOTE_OP_CALL = 7, //!< handleID, name, argIDs
+    REMOTE_OP_COMPARE_TO = 8, //!< handleID, otherID
+    REMOTE_OP_HASH_CODE = 9, //!< handleID
+    REMOTE_OP_TO_STRING = 10, //!< handleID
+    REMOTE_OP_GET_CLASS_NAME = 11, //!< handleID
+    REMOTE_OP_BATCH = 12, //!< batch of call requests (batch protocol only)
+};
+
+/*!
+ * Batched requests can refer to the result handle
+ * of an earlier request in the same batch by index.
+ */
+#define REMOTE_BATCH_RESULT_ID (uint64_t(1) << 63)
+
+/*!
+ * Call arguments can be passed as local objects:
+ * the argument ID refers to an index in the ObjectVector
+ * of the request object, and the server converts it.
+ * Inline arguments need the batch protocol version.
+ */
+#define REMOTE_INLINE_OBJECT_ID (uint64_t(1) << 62)
+
+/*!
+ * The status distinguishes requests from replies.
+ * A reply echoes the opcode of its request when known.
+ */
+enum RemoteStatus : uint8_t
+{
+    REMOTE_STATUS_REQUEST = 0,
+    REMOTE_STATUS_OK = 1,
+    REMOTE_STATUS_ERROR = 2, //!< name holds the error message
+    REMOTE_STATUS_MESSAGE = 3, //!< name holds the exception message
+};
+
+/*!
+ * A remote proxy protocol message: either a request or a reply.
+ * The fields used depend on the opcode (see RemoteOpcode).
+ * Replies carry handles in handleID, numeric results in value,
+ * string results in name, and object results in object.
+ */
+struct RemoteMessage
+{
+    RemoteMessage(const RemoteOpcode opcode = REMOTE_OP_NONE, const RemoteStatus status = REMOTE_STATUS_REQUEST):
+        opcode(opcode),
+        status(status),
+        tid(0),
+        version(0),
+        envID(0),
+        handleID(0),
+        otherID(0),
+        value(0),
+        noReply(false),
+        toLocal(false)
+    {
+        return;
+    }
+
+    RemoteOpcode opcode;
+    RemoteStatus status;
+    uint32_t tid; //!< thread ID used to match replies to requests
+    uint32_t version; //!< protocol version (open environment only)
+    uint64_t envID; //!< remote environment ID
+    uint64_t handleID; //!< remote object ID or the resulting handle
+    uint64_t otherID; //!< other remote object ID for comparisons
+    int64_t value; //!< numeric result
+    std::string name; //!< method name, string result, or error message
+    std::vector<uint64_t> argIDs; //!< remote object IDs for call arguments
+    Pothos::Object object; //!< local object, environment args or info
+
+    /*!
+     * The server does not reply to a request with this flag.
+     * Only the binary protocol can carry the flag,
+     * legacy peers reply to every request regardless.
+     */
+    bool noReply;
+
+    //! Reply with the call result converted to a local object
+    bool toLocal;
+
+    //! The requests of a batch, or the replies to each request
+    std::vector<RemoteMessage> batch;
+};
+
+/*!
+ * Serialize a message to an output stream.
+ * The message is encoded as specified by the protocol version.
+ */
+void sendDatagram(std::ostream &os, const RemoteMessage &msg, const uint32_t version);
+
+/*!
+ * Deserialize a message from an input stream.
+ * The protocol version of the datagram is detected from its header.
+ * \param [out] version the protocol version of the received datagram
+ */
+RemoteMessage recvDatagram(std::istream &is, uint32_t &version);
+
+/*!
+ * The largest datagram payload accepted from a peer.
+ * Larger frames are rejected before any memory is allocated for them.
+ */
+#define POTHOS_REMOTE_MAX_PAYLOAD_BYTES (256*1024*1024)
+
+/*!
+ * Get the size of the datagram frame at the front of a buffer.
+ * Only the header is inspected, the payload is validated on receive.
+ * \throws IOException for an unknown header word or an oversized payload
+ * \return the frame size in bytes or 0 when the header is incomplete
+ */
+size_t datagramFrameSize(const char *buff, const size_t len);
@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "RemoteProxy.hpp"
@@ -6,7 +6,7 @@
 #include <Poco/Logger.h>
 #include <iostream>
 
-RemoteProxyHandle::RemoteProxyHandle(std::shared_ptr<RemoteProxyEnvironment> env, const size_t remoteID):
+RemoteProxyHandle::RemoteProxyHandle(std::shared_ptr<RemoteProxyEnvironment> env, const uint64_t remoteID):
     env(env), remoteID(remoteID)
 {
     return;
@@ -15,13 +15,16 @@ RemoteProxyHandle::RemoteProxyHandle(std::shared_ptr<RemoteProxyEnvironment> env
 RemoteProxyHandle::~RemoteProxyHandle(void)
 {
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("~RemoteProxyHandle");
-    req["handleID"] = Pothos::Object(this->remoteID);
+    //servers that speak the binary protocol release the handle without a reply,
+    //so the destructor does not have to wait on a round trip to the server
+    RemoteMessage req(REMOTE_OP_DELETE_HANDLE);
+    req.handleID = this->remoteID;
+    req.noReply = env->protocolVersion >= POTHOS_REMOTE_PROTOCOL_BINARY;
 
     try
     {
-        env->transact(req);
+        if (req.noReply) env->sendRequest(req);
+        else env->transact(req);
     }
     catch(const Pothos::Exception &ex)
     {
@@ -30,41 +33,134 @@ RemoteProxyHandle::~RemoteProxyHandle(void)
     }
 }
 
-Pothos::Proxy RemoteProxyHandle::call(const std::string &name, const Pothos::Proxy *args, const size_t numArgs)
+uint32_t RemoteProxyHandle::sendCall(const std::string &name, const Pothos::Proxy *args, const size_t numArgs)
+{
+    //create request
+    RemoteMessage req(REMOTE_OP_CALL);
+    req.handleID = this->remoteID;
+    req.name = name;
+    req.argIDs.reserve(numArgs);
+
+    //hold converted argument handles until the request is sent
+    std::vector<std::shared_ptr<RemoteProxyHandle>> handles;
+    for (size_t i = 0; i < numArgs; i++)
+    {
+        try
+        {
+            handles.push_back(env->getHandle(args[i]));
+        }
+        catch(const std::exception &ex)
+        {
+            throw Pothos::ProxyHandleCallError("RemoteProxyHandle::call("+name+")",
+                Poco::format("convert arg %z - %s", i, std::string(ex.what())));
+        }
+        req.argIDs.push_back(handles.back()->remoteID);
+    }
+
+    return env->sendRequest(req);
+}
+
+uint32_t RemoteProxyHandle::sendCall(const std::string &name, const Pothos::Object *args, const size_t numArgs)
 {
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("call");
-    req["handleID"] = Pothos::Object(this->remoteID);
-    req["name"] = Pothos::Object(name);
+    RemoteMessage req(REMOTE_OP_CALL);
+    req.handleID = this->remoteID;
+    req.name = name;
+    req.argIDs.reserve(numArgs);
+
+    //proxy arguments are passed by ID, and local objects are sent inline,
+    //servers before the batch protocol only take IDs so local objects are converted first
+    std::vector<std::shared_ptr<RemoteProxyHandle>> handles;
+    Pothos::ObjectVector inlineArgs;
     for (size_t i = 0; i < numArgs; i++)
     {
-        std::shared_ptr<RemoteProxyHandle> handle;
+        const bool isProxy = args[i].type() == typeid(Pothos::Proxy);
+        if (not isProxy and env->protocolVersion >= POTHOS_REMOTE_PROTOCOL_BATCH)
+        {
+            req.argIDs.push_back(REMOTE_INLINE_OBJECT_ID | inlineArgs.size());
+            inlineArgs.push_back(args[i]);
+            continue;
+        }
         try
         {
-            handle = env->getHandle(args[i]);
+            if (isProxy) handles.push_back(env->getHandle(args[i].extract<Pothos::Proxy>()));
+            else handles.push_back(env->getHandle(env->convertObjectToProxy(args[i])));
         }
         catch(const std::exception &ex)
         {
             throw Pothos::ProxyHandleCallError("RemoteProxyHandle::call("+name+")",
                 Poco::format("convert arg %z - %s", i, std::string(ex.what())));
         }
-        req[std::to_string(i)] = Pothos::Object(handle->remoteID);
+        req.argIDs.push_back(handles.back()->remoteID);
     }
+    if (not inlineArgs.empty()) req.object = Pothos::Object(inlineArgs);
 
-    auto reply = env->transact(req);
+    return env->sendRequest(req);
+}
+
+Pothos::Proxy RemoteProxyHandle::recvCall(const std::shared_ptr<RemoteProxyEnvironment> &env, const std::string &name, const uint32_t tid)
+{
+    const auto reply = env->recvReply(tid);
 
     //check for an error
-    auto errorMsgIt = reply.find("errorMsg");
-    if (errorMsgIt != reply.end()) throw Pothos::ProxyHandleCallError(
-        "RemoteProxyEnvironment::call("+name+")", errorMsgIt->second.extract<std::string>());
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyHandleCallError(
+        "RemoteProxyEnvironment::call("+name+")", reply.name);
 
     //check for a message
-    auto messageIt = reply.find("message");
-    if (messageIt != reply.end()) throw Pothos::ProxyExceptionMessage(messageIt->second.extract<std::string>());
+    if (reply.status == REMOTE_STATUS_MESSAGE) throw Pothos::ProxyExceptionMessage(reply.name);
 
     //otherwise make a handle
-    return env->makeHandle(reply["handleID"]);
+    return env->makeHandle(reply.handleID);
+}
+
+Pothos::Proxy RemoteProxyHandle::call(const std::string &name, const Pothos::Proxy *args, const size_t numArgs)
+{
+    return recvCall(env, name, this->sendCall(name, args, numArgs));
+}
+
+/***********************************************************************
+ * Asynchronous calls
+ **********************************************************************/
+struct RemotePendingCall
+{
+    RemotePendingCall(const std::shared_ptr<RemoteProxyEnvironment> &env, const std::string &name, const uint32_t tid):
+        env(env), name(name), tid(tid), done(false)
+    {
+        return;
+    }
+
+    //A future that was dropped without waiting does not block on the reply:
+    //the reply is discarded when it arrives and the result handle is released.
+    ~RemotePendingCall(void)
+    {
+        if (done) return;
+        try
+        {
+            env->abandonReply(tid);
+        }
+        catch (const Pothos::Exception &)
+        {
+            //the caller did not want the result or any error
+        }
+    }
+
+    Pothos::Proxy get(void)
+    {
+        done = true;
+        return RemoteProxyHandle::recvCall(env, name, tid);
+    }
+
+    std::shared_ptr<RemoteProxyEnvironment> env;
+    const std::string name;
+    const uint32_t tid;
+    bool done;
+};
+
+std::future<Pothos::Proxy> RemoteProxyHandle::callAsync(const std::string &name, const Pothos::Object *args, const size_t numArgs)
+{
+    //the request is sent now, and the reply is read when the future is waited on
+    std::shared_ptr<RemotePendingCall> pending(new RemotePendingCall(env, name, this->sendCall(name, args, numArgs)));
+    return std::async(std::launch::deferred, [pending]{return pending->get();});
 }
 
 int RemoteProxyHandle::compareTo(const Pothos::Proxy &proxy) const
@@ -81,53 +177,60 @@ int RemoteProxyHandle::compareTo(const Pothos::Proxy &proxy) const
     }
 
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("compareTo");
-    req["handleID"] = Pothos::Object(this->remoteID);
-    req["otherID"] = Pothos::Object(handle->remoteID);
+    RemoteMessage req(REMOTE_OP_COMPARE_TO);
+    req.handleID = this->remoteID;
+    req.otherID = handle->remoteID;
 
-    auto reply = env->transact(req);
+    const auto reply = env->transact(req);
 
     //check for an error
-    auto errorMsgIt = reply.find("errorMsg");
-    if (errorMsgIt != reply.end()) throw Pothos::ProxyCompareError(
-        "RemoteProxyEnvironment::compareTo()", errorMsgIt->second.extract<std::string>());
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyCompareError(
+        "RemoteProxyEnvironment::compareTo()", reply.name);
 
-    return reply["result"];
+    return int(reply.value);
 }
 
 size_t RemoteProxyHandle::hashCode(void) const
 {
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("hashCode");
-    req["handleID"] = Pothos::Object(this->remoteID);
+    RemoteMessage req(REMOTE_OP_HASH_CODE);
+    req.handleID = this->remoteID;
 
-    auto reply = env->transact(req);
+    const auto reply = env->transact(req);
 
-    return reply["result"];
+    //check for an error
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyHandleCallError(
+        "RemoteProxyHandle::hashCode()", reply.name);
+
+    return size_t(reply.value);
 }
 
 std::string RemoteProxyHandle::toString(void) const
 {
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("toString");
-    req["handleID"] = Pothos::Object(this->remoteID);
+    RemoteMessage req(REMOTE_OP_TO_STRING);
+    req.handleID = this->remoteID;
+
+    const auto reply = env->transact(req);
 
-    auto reply = env->transact(req);
+    //check for an error
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyHandleCallError(
+        "RemoteProxyHandle::toString()", reply.name);
 
-    return reply["result"];
+    return reply.name;
 }
 
 std::string RemoteProxyHandle::getClassName(void) const
 {
     //create request
-    Pothos::ObjectKwargs req;
-    req["action"] = Pothos::Object("getClassName");
-    req["handleID"] = Pothos::Object(this->remoteID);
+    RemoteMessage req(REMOTE_OP_GET_CLASS_NAME);
+    req.handleID = this->remoteID;
+
+    const auto reply = env->transact(req);
 
-    auto reply = env->transact(req);
+    //check for an error
+    if (reply.status == REMOTE_STATUS_ERROR) throw Pothos::ProxyHandleCallError(
+        "RemoteProxyHandle::getClassName()", reply.name);
 
-    return reply["result"];
+    return reply.name;
 }
@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2018 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Remote.hpp>
@@ -61,7 +61,7 @@ Pothos::RemoteServer::RemoteServer(const std::string &uriStr, const bool closePi
     if (not uriStr.empty()) POTHOS_EXCEPTION_TRY
     {
         Poco::URI uri(uriStr);
-        if (uri.getScheme() != "tcp") throw InvalidArgumentException("unsupported URI scheme");
+        if (uri.getScheme() != "tcp" and uri.getScheme() != "ipc") throw InvalidArgumentException("unsupported URI scheme");
     }
     POTHOS_EXCEPTION_CATCH(const Exception &ex)
     {
@@ -140,6 +140,11 @@ Pothos::RemoteServer::RemoteServer(const std::string &uriStr, const bool closePi
 
     //Try to connect to the server.
     //Store an open connection within this server wrapper.
+    if (Poco::URI(uriStr).getScheme() == "ipc")
+    {
+        _impl->client = RemoteClient("ipc://"+this->getActualPort());
+    }
+    else
     {
         Poco::URI uri(uriStr);
         uri.setPort(std::stoul(this->getActualPort()));
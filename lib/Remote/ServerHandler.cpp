@@ -1,188 +1,464 @@
-// Copyright (c) 2013-2017 Josh Blum
+// Copyright (c) 2013-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "RemoteProxyDatagram.hpp"
 #include <Pothos/Object.hpp>
 #include <Pothos/Object/Containers.hpp>
 #include <Pothos/Proxy.hpp>
+#include <Pothos/Proxy/Exception.hpp>
 #include <Pothos/Remote/Handler.hpp>
 #include <Pothos/System/HostInfo.hpp>
+#include <Pothos/Util/SpinLock.hpp>
 #include <Poco/Exception.h>
-#include <Poco/Bugcheck.h>
+#include <Poco/Logger.h>
 #include <iostream>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
 #include <mutex>
-#include <map>
+#include <algorithm> //min
 
 /***********************************************************************
- * Active objects on the server
+ * Active objects on the server: generation indexed slots
+ *  - an ID holds the slot index and the generation of the slot,
+ *    freeing a slot bumps the generation so that stale IDs are detected
+ *  - legacy protocol peers may hold IDs in a 32-bit size_t,
+ *    so they get untagged IDs: the slot index plus one, without generation
+ *  - slots are allocated in segments that never move or free,
+ *    so a lookup only takes the lock of its slot
+ *  - freed slots are reused, the table grows to the peak handle count
+ *  - each object is owned by an environment, closing it frees them all
  **********************************************************************/
-static std::mutex &getObjectsMutex(void)
+static const size_t HANDLE_SEGMENT_SIZE = 1 << 14;
+static const size_t HANDLE_MAX_SEGMENTS = 1 << 14;
+static const uint32_t HANDLE_GEN_MASK = (1 << 30) - 1; //stay below the batch and inline ID flags
+
+struct ServerObjectSlot
+{
+    ServerObjectSlot(void):
+        generation(1),
+        owner(0),
+        used(false)
+    {
+        return;
+    }
+
+    Pothos::Util::SpinLock lock;
+    uint32_t generation;
+    uint64_t owner;
+    bool used;
+    Pothos::Object object;
+};
+
+class ServerObjectTable
+{
+public:
+    ServerObjectTable(void):
+        _numSlots(0)
+    {
+        for (auto &segment : _segments) segment = nullptr;
+    }
+
+    uint64_t insert(const Pothos::Object &obj, const uint64_t owner, const bool tagged)
+    {
+        size_t index(0);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (not _freeList.empty())
+            {
+                index = _freeList.back();
+                _freeList.pop_back();
+            }
+            else
+            {
+                index = _numSlots;
+                if (index/HANDLE_SEGMENT_SIZE >= HANDLE_MAX_SEGMENTS) throw Pothos::RangeException(
+                    "Pothos::RemoteHandler", "server object table full");
+                auto &segment = _segments[index/HANDLE_SEGMENT_SIZE];
+                if (segment == nullptr) segment = new ServerObjectSlot[HANDLE_SEGMENT_SIZE];
+                _numSlots = index+1;
+            }
+            if (owner != 0) _owned[owner].insert(index);
+        }
+
+        auto &slot = this->slotAt(index);
+        std::lock_guard<Pothos::Util::SpinLock> lock(slot.lock);
+        slot.used = true;
+        slot.owner = owner;
+        slot.object = obj;
+        if (not tagged) return uint64_t(index)+1;
+        return (uint64_t(slot.generation) << 32) | index;
+    }
+
+    Pothos::Object get(const uint64_t id, uint64_t *owner = nullptr) const
+    {
+        auto slot = this->find(id);
+        if (slot != nullptr)
+        {
+            std::lock_guard<Pothos::Util::SpinLock> lock(slot->lock);
+            const uint32_t generation(id >> 32);
+            if (slot->used and (generation == 0 or slot->generation == generation))
+            {
+                if (owner != nullptr) *owner = slot->owner;
+                return slot->object;
+            }
+        }
+        throw Pothos::NotFoundException("Pothos::RemoteHandler", "stale or unknown handle "+std::to_string(id));
+    }
+
+    void remove(const uint64_t id)
+    {
+        auto slot = this->find(id);
+        if (slot != nullptr) this->release(*slot, slotIndex(id), uint32_t(id >> 32), 0);
+    }
+
+    //! Remove every object owned by the environment
+    void removeOwned(const uint64_t owner)
+    {
+        std::unordered_set<size_t> indexes;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _owned.find(owner);
+            if (it == _owned.end()) return;
+            indexes.swap(it->second);
+            _owned.erase(it);
+        }
+        for (const auto index : indexes)
+        {
+            this->release(this->slotAt(index), index, 0, owner);
+        }
+    }
+
+private:
+    ServerObjectSlot &slotAt(const size_t index) const
+    {
+        return _segments[index/HANDLE_SEGMENT_SIZE].load()[index%HANDLE_SEGMENT_SIZE];
+    }
+
+    //! The slot index of a tagged or untagged ID, zero is never valid
+    static size_t slotIndex(const uint64_t id)
+    {
+        if ((id >> 32) == 0) return size_t(id)-1;
+        return size_t(id & 0xffffffff);
+    }
+
+    ServerObjectSlot *find(const uint64_t id) const
+    {
+        const size_t index(slotIndex(id));
+        if (index >= _numSlots) return nullptr;
+        return &this->slotAt(index);
+    }
+
+    //! Free the slot when the generation or owner matches
+    void release(ServerObjectSlot &slot, const size_t index, const uint32_t generation, const uint64_t owner)
+    {
+        Pothos::Object obj; //destruct outside of the locks
+        uint64_t slotOwner(0);
+        {
+            std::lock_guard<Pothos::Util::SpinLock> lock(slot.lock);
+            if (not slot.used) return;
+            if (generation != 0 and slot.generation != generation) return;
+            if (owner != 0 and slot.owner != owner) return;
+            slotOwner = slot.owner;
+            obj = std::move(slot.object);
+            slot.object = Pothos::Object();
+            slot.used = false;
+            slot.generation = (slot.generation+1) & HANDLE_GEN_MASK;
+            if (slot.generation == 0) slot.generation = 1;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _freeList.push_back(index);
+
+        //removeOwned() already took the index set of the owner
+        if (owner != 0 or slotOwner == 0) return;
+        auto it = _owned.find(slotOwner);
+        if (it == _owned.end()) return;
+        it->second.erase(index);
+        if (it->second.empty()) _owned.erase(it);
+    }
+
+    std::mutex _mutex; //protects allocation, the free list, and the owned index
+    std::vector<size_t> _freeList;
+    std::unordered_map<uint64_t, std::unordered_set<size_t>> _owned; //slot indexes per owner
+    std::atomic<size_t> _numSlots;
+    std::atomic<ServerObjectSlot *> _segments[HANDLE_MAX_SEGMENTS];
+};
+
+static ServerObjectTable &getObjectTable(void)
 {
-    static std::mutex mutex;
-    return mutex;
+    static ServerObjectTable table;
+    return table;
 }
 
-typedef std::map<size_t, Pothos::Object> ServerObjectsMapType;
-static ServerObjectsMapType &getObjectsMap(void)
+static uint64_t getNewObjectId(const Pothos::Object &obj, const uint64_t owner, const bool tagged)
 {
-    static ServerObjectsMapType map;
-    return map;
+    return getObjectTable().insert(obj, owner, tagged);
 }
 
-static Pothos::Object getNewObjectId(const Pothos::Object &obj)
+static Pothos::Object getObjectAtId(const uint64_t id, uint64_t *owner = nullptr)
 {
-    std::lock_guard<std::mutex> lock(getObjectsMutex());
-    static size_t id = 0;
-    getObjectsMap()[++id] = obj;
-    return Pothos::Object(id);
+    return getObjectTable().get(id, owner);
 }
 
-static Pothos::Object getObjectAtId(const Pothos::Object &id)
+static void removeObjectAtId(const uint64_t id)
 {
-    const size_t key(id);
-    std::lock_guard<std::mutex> lock(getObjectsMutex());
-    return getObjectsMap()[key];
+    getObjectTable().remove(id);
 }
 
-static void removeObjectAtId(const Pothos::Object &id)
+//! Free the environment and every object that it owns
+static void removeEnvironment(const uint64_t envID)
 {
-    const size_t key(id);
-    std::lock_guard<std::mutex> lock(getObjectsMutex());
-    getObjectsMap().erase(key);
+    getObjectTable().removeOwned(envID);
+    getObjectTable().remove(envID);
 }
 
 /***********************************************************************
- * Handler implementation
+ * Resolve batch result and inline object IDs
  **********************************************************************/
-bool Pothos::RemoteHandler::runHandlerOnce(std::istream &is, std::ostream &os)
+static uint64_t resolveBatchID(const uint64_t id, const std::vector<RemoteMessage> &replies)
 {
-    bool done = false;
+    if ((id & REMOTE_BATCH_RESULT_ID) == 0) return id;
+    const size_t index(id & ~REMOTE_BATCH_RESULT_ID);
+    if (index+1 >= replies.size()) throw Pothos::ProxyHandleCallError(
+        "Pothos::RemoteHandler::batch()", "no result at index "+std::to_string(index));
+    const auto &result = replies[index];
+    if (result.status != REMOTE_STATUS_OK or result.handleID == 0) throw Pothos::ProxyHandleCallError(
+        "Pothos::RemoteHandler::batch()", "no result at index "+std::to_string(index));
+    return result.handleID;
+}
 
-    //deserialize the request
-    const auto reqArgs = recvDatagram(is);
+static Pothos::Proxy getArgAtId(const uint64_t id, const RemoteMessage &req, const Pothos::Proxy &proxy)
+{
+    if ((id & REMOTE_INLINE_OBJECT_ID) == 0) return getObjectAtId(id).extract<Pothos::Proxy>();
+    const auto &local = req.object.extract<Pothos::ObjectVector>().at(size_t(id & ~REMOTE_INLINE_OBJECT_ID));
+    return proxy.getEnvironment()->convertObjectToProxy(local);
+}
+
+/***********************************************************************
+ * Process a single request
+ **********************************************************************/
+static void processRequest(const RemoteMessage &req, RemoteMessage &reply, bool &done, const std::string &peerAddr, std::set<uint64_t> &envIDs, const uint32_t version)
+{
+    //generation tagged IDs need the 64-bit IDs of the binary protocol
+    const bool tagged = version >= POTHOS_REMOTE_PROTOCOL_BINARY;
 
-    //process the request and form the reply
-    Pothos::ObjectKwargs replyArgs;
-    replyArgs["tid"] = reqArgs.at("tid");
     POTHOS_EXCEPTION_TRY
     {
-        const auto &action = reqArgs.at("action").extract<std::string>();
-        if (action == "RemoteProxyEnvironment")
+        switch (req.opcode)
+        {
+        case REMOTE_OP_OPEN_ENV:
         {
             Pothos::ProxyEnvironmentArgs envArgs;
-            for (const auto &entry : reqArgs)
+            for (const auto &entry : req.object.extract<Pothos::ObjectKwargs>())
             {
-                if (entry.second.type() != typeid(std::string)) continue;
                 envArgs[entry.first] = entry.second.extract<std::string>();
             }
-            const auto &name = reqArgs.at("name").extract<std::string>();
-            const auto &env = Pothos::ProxyEnvironment::make(name, envArgs);
-            replyArgs["envID"] = getNewObjectId(Pothos::Object(env));
+            const auto &env = Pothos::ProxyEnvironment::make(req.name, envArgs);
+            //the open request is in the legacy format for every client,
+            //so an environment ID is always untagged
+            reply.envID = getNewObjectId(Pothos::Object(env), 0, false);
+            envIDs.insert(reply.envID);
 
             //a unique process ID for this server
             const auto info = Pothos::System::HostInfo::get();
-            replyArgs["upid"] = Pothos::Object(Pothos::ProxyEnvironment::getLocalUniquePid());
-            replyArgs["nodeId"] = Pothos::Object(info.nodeId);
-            replyArgs["peerAddr"] = Pothos::Object(_peerAddr);
-        }
-        else if (action == "~RemoteProxyEnvironment")
+            Pothos::ObjectKwargs envInfo;
+            envInfo["upid"] = Pothos::Object(Pothos::ProxyEnvironment::getLocalUniquePid());
+            envInfo["nodeId"] = Pothos::Object(info.nodeId);
+            envInfo["peerAddr"] = Pothos::Object(peerAddr);
+            reply.object = Pothos::Object(envInfo);
+
+            //negotiate the protocol version, zero means the client predates negotiation
+            if (req.version != 0) reply.version = std::min<uint32_t>(req.version, POTHOS_REMOTE_PROTOCOL_VERSION);
+        } break;
+
+        case REMOTE_OP_CLOSE_ENV:
         {
-            removeObjectAtId(reqArgs.at("envID"));
+            removeEnvironment(req.envID);
+            envIDs.erase(req.envID);
             done = true;
-        }
-        else if (action == "findProxy")
+        } break;
+
+        case REMOTE_OP_FIND_PROXY:
         {
-            const auto &env = getObjectAtId(reqArgs.at("envID")).extract<Pothos::ProxyEnvironment::Sptr>();
-            const auto &proxy = env->findProxy(reqArgs.at("name").extract<std::string>());
-            replyArgs["handleID"] = getNewObjectId(Pothos::Object(proxy));
-        }
-        else if (action == "convertObjectToProxy")
+            const auto &env = getObjectAtId(req.envID).extract<Pothos::ProxyEnvironment::Sptr>();
+            const auto &proxy = env->findProxy(req.name);
+            reply.handleID = getNewObjectId(Pothos::Object(proxy), req.envID, tagged);
+        } break;
+
+        case REMOTE_OP_CONVERT_OBJECT_TO_PROXY:
         {
-            const auto &env = getObjectAtId(reqArgs.at("envID")).extract<Pothos::ProxyEnvironment::Sptr>();
-            const auto &proxy = env->convertObjectToProxy(reqArgs.at("local"));
-            replyArgs["handleID"] = getNewObjectId(Pothos::Object(proxy));
-        }
-        else if (action == "convertProxyToObject")
+            const auto &env = getObjectAtId(req.envID).extract<Pothos::ProxyEnvironment::Sptr>();
+            const auto &proxy = env->convertObjectToProxy(req.object);
+            reply.handleID = getNewObjectId(Pothos::Object(proxy), req.envID, tagged);
+        } break;
+
+        case REMOTE_OP_CONVERT_PROXY_TO_OBJECT:
         {
-            const auto &env = getObjectAtId(reqArgs.at("envID")).extract<Pothos::ProxyEnvironment::Sptr>();
-            const auto &proxy = getObjectAtId(reqArgs.at("handleID")).extract<Pothos::Proxy>();
-            auto local = env->convertProxyToObject(proxy);
-            replyArgs["local"] = local;
-        }
-        else if (action == "~RemoteProxyHandle")
+            const auto &env = getObjectAtId(req.envID).extract<Pothos::ProxyEnvironment::Sptr>();
+            const auto &proxy = getObjectAtId(req.handleID).extract<Pothos::Proxy>();
+            reply.object = env->convertProxyToObject(proxy);
+        } break;
+
+        case REMOTE_OP_DELETE_HANDLE:
         {
-            removeObjectAtId(reqArgs.at("handleID"));
-        }
-        else if (action == "call")
+            removeObjectAtId(req.handleID);
+        } break;
+
+        case REMOTE_OP_CALL:
         {
-            const auto &proxy = getObjectAtId(reqArgs.at("handleID")).extract<Pothos::Proxy>();
+            //the result belongs to the environment of the called object
+            uint64_t owner(0);
+            const auto &proxy = getObjectAtId(req.handleID, &owner).extract<Pothos::Proxy>();
 
             //load the args
             std::vector<Pothos::Proxy> args;
-            size_t argNo = 0;
-            while (true)
+            args.reserve(req.argIDs.size());
+            for (const auto &argID : req.argIDs)
             {
-                auto it = reqArgs.find(std::to_string(argNo++));
-                if (it == reqArgs.end()) break;
-                args.push_back(getObjectAtId(it->second).extract<Pothos::Proxy>());
+                args.push_back(getArgAtId(argID, req, proxy));
             }
 
             //make the call
             try
             {
-                const auto &name = reqArgs.at("name").extract<std::string>();
-                auto result = proxy.getHandle()->call(name, args.data(), args.size());
-                replyArgs["handleID"] = getNewObjectId(Pothos::Object(result));
+                auto result = proxy.getHandle()->call(req.name, args.data(), args.size());
+                if (req.toLocal) reply.object = result.getEnvironment()->convertProxyToObject(result);
+                else reply.handleID = getNewObjectId(Pothos::Object(result), owner, tagged);
             }
             catch (const Pothos::ProxyExceptionMessage &ex)
             {
-                replyArgs["message"] = Pothos::Object(ex.message());
+                reply.status = REMOTE_STATUS_MESSAGE;
+                reply.name = ex.message();
             }
-        }
-        else if (action == "compareTo")
+        } break;
+
+        case REMOTE_OP_COMPARE_TO:
         {
-            const auto &proxy = getObjectAtId(reqArgs.at("handleID")).extract<Pothos::Proxy>();
-            const auto &other = getObjectAtId(reqArgs.at("otherID")).extract<Pothos::Proxy>();
-            replyArgs["result"] = Pothos::Object(proxy.compareTo(other));
-        }
-        else if (action == "hashCode")
+            const auto &proxy = getObjectAtId(req.handleID).extract<Pothos::Proxy>();
+            const auto &other = getObjectAtId(req.otherID).extract<Pothos::Proxy>();
+            reply.value = proxy.compareTo(other);
+        } break;
+
+        case REMOTE_OP_HASH_CODE:
         {
-            const auto &proxy = getObjectAtId(reqArgs.at("handleID")).extract<Pothos::Proxy>();
-            replyArgs["result"] = Pothos::Object(proxy.hashCode());
-        }
-        else if (action == "toString")
+            const auto &proxy = getObjectAtId(req.handleID).extract<Pothos::Proxy>();
+            reply.value = int64_t(proxy.hashCode());
+        } break;
+
+        case REMOTE_OP_TO_STRING:
         {
-            const auto &proxy = getObjectAtId(reqArgs.at("handleID")).extract<Pothos::Proxy>();
-            replyArgs["result"] = Pothos::Object(proxy.toString());
-        }
-        else if (action == "getClassName")
+            const auto &proxy = getObjectAtId(req.handleID).extract<Pothos::Proxy>();
+            reply.name = proxy.toString();
+        } break;
+
+        case REMOTE_OP_GET_CLASS_NAME:
         {
-            const auto &proxy = getObjectAtId(reqArgs.at("handleID")).extract<Pothos::Proxy>();
-            replyArgs["result"] = Pothos::Object(proxy.getClassName());
-        }
-        else
+            const auto &proxy = getObjectAtId(req.handleID).extract<Pothos::Proxy>();
+            reply.name = proxy.getClassName();
+        } break;
+
+        case REMOTE_OP_BATCH:
         {
-            poco_bugcheck_msg(action.c_str());
+            //make each request in order, referring to earlier results by index
+            reply.batch.reserve(req.batch.size());
+            for (const auto &batchReq : req.batch)
+            {
+                reply.batch.emplace_back(batchReq.opcode, REMOTE_STATUS_OK);
+                auto &batchReply = reply.batch.back();
+                POTHOS_EXCEPTION_TRY
+                {
+                    //only calls are batched: environment and handle lifetime
+                    //requests such as CLOSE_ENV must not take effect mid-batch
+                    if (batchReq.opcode != REMOTE_OP_CALL) throw Pothos::InvalidArgumentException(
+                        "Pothos::RemoteHandler::batch()", "opcode not allowed in batch " + std::to_string(int(batchReq.opcode)));
+                    auto resolved = batchReq;
+                    resolved.handleID = resolveBatchID(resolved.handleID, reply.batch);
+                    resolved.otherID = resolveBatchID(resolved.otherID, reply.batch);
+                    for (auto &argID : resolved.argIDs) argID = resolveBatchID(argID, reply.batch);
+                    processRequest(resolved, batchReply, done, peerAddr, envIDs, version);
+                }
+                POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
+                {
+                    batchReply.status = REMOTE_STATUS_ERROR;
+                    batchReply.name = ex.displayText();
+                }
+            }
+        } break;
+
+        default: throw Pothos::InvalidArgumentException("Pothos::RemoteHandler::runHandlerOnce()",
+            "unknown opcode " + std::to_string(int(req.opcode)));
         }
     }
     POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
     {
-        replyArgs["errorMsg"] = Pothos::Object(ex.displayText());
+        reply.status = REMOTE_STATUS_ERROR;
+        reply.name = ex.displayText();
     }
+}
 
-    //serialize the reply
-    sendDatagram(os, replyArgs);
+/***********************************************************************
+ * Handler implementation
+ **********************************************************************/
+struct Pothos::RemoteHandler::Impl
+{
+    Impl(const std::string &peerAddr):
+        peerAddr(peerAddr)
+    {
+        return;
+    }
+
+    //a client that disconnects without closing still frees its objects
+    ~Impl(void)
+    {
+        for (const auto &envID : envIDs) removeEnvironment(envID);
+    }
+
+    const std::string peerAddr;
+    std::set<uint64_t> envIDs; //environments opened by this client
+};
+
+bool Pothos::RemoteHandler::runHandlerOnce(std::istream &is, std::ostream &os)
+{
+    bool done = false;
+
+    //deserialize the request
+    uint32_t version(0);
+    const auto req = recvDatagram(is, version);
+
+    //process the request and form the reply
+    RemoteMessage reply(req.opcode, REMOTE_STATUS_OK);
+    reply.tid = req.tid;
+    processRequest(req, reply, done, _impl->peerAddr, _impl->envIDs, version);
+
+    //fire and forget requests only report errors to the server log
+    if (req.noReply)
+    {
+        if (reply.status == REMOTE_STATUS_ERROR) poco_error(
+            Poco::Logger::get("Pothos.RemoteHandler"), reply.name);
+        return done;
+    }
+
+    //serialize the reply in the format of the request
+    sendDatagram(os, reply, version);
 
     return done;
 }
 
-Pothos::RemoteHandler::RemoteHandler(void)
+Pothos::RemoteHandler::RemoteHandler(void):
+    _impl(new Impl(""))
 {
     return;
 }
 
 Pothos::RemoteHandler::RemoteHandler(const std::string &peerAddr):
-    _peerAddr(peerAddr)
+    _impl(new Impl(peerAddr))
+{
+    return;
+}
+
+Pothos::RemoteHandler::~RemoteHandler(void)
 {
     return;
 }
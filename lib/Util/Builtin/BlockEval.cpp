@@ -1,21 +1,20 @@
-// Copyright (c) 2014-2017 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "BlockEval.hpp"
 
 ProxyBlockEval::ProxyBlockEval(const std::string &path, const std::shared_ptr<Pothos::Util::EvalEnvironment> &evalEnv):
+    _env(Pothos::ProxyEnvironment::make("managed")),
     _path(path),
     _evalEnv(evalEnv)
 {
-    auto env = Pothos::ProxyEnvironment::make("managed");
-    auto proxy = env->findProxy("Pothos/Util/DocUtils");
+    auto proxy = _env->findProxy("Pothos/Util/DocUtils");
     _blockDesc = json::parse(proxy.call<std::string>("dumpJsonAt", path));
 }
 
 void ProxyBlockEval::eval(const std::string &id)
 {
-    auto env = Pothos::ProxyEnvironment::make("managed");
-    auto registry = env->findProxy("Pothos/BlockRegistry");
+    auto registry = _env->findProxy("Pothos/BlockRegistry");
     _proxyBlock = Pothos::Proxy(); //release old handle
 
     //load up the constructor args
@@ -23,7 +22,7 @@ void ProxyBlockEval::eval(const std::string &id)
     for (const auto &arg : _blockDesc["args"])
     {
         const auto obj = this->lookupOrEvalAsType(arg);
-        ctorArgs.push_back(env->convertObjectToProxy(obj));
+        ctorArgs.push_back(_env->convertObjectToProxy(obj));
     }
 
     //create the block
@@ -61,13 +60,12 @@ void ProxyBlockEval::handleCall(const std::string &callName)
 
 void ProxyBlockEval::_handleCall(const json &callObj)
 {
-    auto env = Pothos::ProxyEnvironment::make("managed");
     const std::string callName = callObj["name"];
     std::vector<Pothos::Proxy> callArgs;
     if (callObj.count("args")) for (const auto &arg : callObj["args"])
     {
         const auto obj = this->lookupOrEvalAsType(arg);
-        callArgs.push_back(env->convertObjectToProxy(obj));
+        callArgs.push_back(_env->convertObjectToProxy(obj));
     }
     try
     {
@@ -1,4 +1,4 @@
-// Copyright (c) 2014-2017 Josh Blum
+// Copyright (c) 2014-2020 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
@@ -53,6 +53,7 @@ private:
     void _handleCall(const json &callObj);
     Pothos::Object lookupOrEvalAsType(const json &arg);
 
+    Pothos::ProxyEnvironment::Sptr _env;
     std::map<std::string, Pothos::Object> _properties;
     Pothos::Proxy _proxyBlock;
     const std::string _path;
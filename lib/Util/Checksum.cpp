@@ -0,0 +1,83 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Util/Checksum.hpp>
+#include <cstring> //memcpy
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#ifndef __SSE4_2__
+
+/***********************************************************************
+ * Slicing-by-8 tables for the reflected Castagnoli polynomial
+ **********************************************************************/
+struct Crc32cTables
+{
+    Crc32cTables(void)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; j++) crc = (crc >> 1) ^ ((crc & 1)?0x82F63B78:0);
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            for (size_t k = 1; k < 8; k++)
+            {
+                table[k][i] = (table[k-1][i] >> 8) ^ table[0][table[k-1][i] & 0xff];
+            }
+        }
+    }
+    uint32_t table[8][256];
+};
+
+static const Crc32cTables &getCrc32cTables(void)
+{
+    static const Crc32cTables tables;
+    return tables;
+}
+
+#endif //__SSE4_2__
+
+/***********************************************************************
+ * CRC-32C implementation
+ **********************************************************************/
+uint32_t Pothos::Util::crc32c(const void *data, const size_t size, const uint32_t crc)
+{
+    auto p = reinterpret_cast<const uint8_t *>(data);
+    auto end = p + size;
+    uint32_t c = ~crc;
+
+    #ifdef __SSE4_2__
+    #ifdef __x86_64__
+    uint64_t c64 = c;
+    for (; p + 8 <= end; p += 8)
+    {
+        uint64_t word; std::memcpy(&word, p, 8);
+        c64 = _mm_crc32_u64(c64, word);
+    }
+    c = uint32_t(c64);
+    #else //_mm_crc32_u64 is only available in 64-bit mode
+    for (; p + 4 <= end; p += 4)
+    {
+        uint32_t word; std::memcpy(&word, p, 4);
+        c = _mm_crc32_u32(c, word);
+    }
+    #endif //__x86_64__
+    for (; p < end; p++) c = _mm_crc32_u8(c, *p);
+
+    #else
+    const auto &t = getCrc32cTables().table;
+    for (; p + 8 <= end; p += 8)
+    {
+        const uint32_t lo = c ^ (uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24));
+        c = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+            t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; p < end; p++) c = (c >> 8) ^ t[0][(c ^ *p) & 0xff];
+    #endif //__SSE4_2__
+
+    return ~c;
+}
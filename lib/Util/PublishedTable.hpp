@@ -0,0 +1,113 @@
+// Copyright (c) 2020 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <functional> //hash
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/*!
+ * A hash table for read-mostly data that readers probe without locks.
+ * Each key maps to an immutable value. Writers serialize on a mutex of
+ * their own and publish a new value for a key by storing a pointer into
+ * its slot, so an update copies one value rather than the whole table.
+ *
+ * Replaced values and outgrown slot arrays are retired rather than freed,
+ * because a reader may still hold them: a value returned by find() stays
+ * valid for the life of the table, and readers never touch a reference count.
+ * Retired memory grows with the number of updates, so the table is meant
+ * for data that changes when things are registered, not per lookup.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class PublishedTable
+{
+public:
+    PublishedTable(void):
+        _numKeys(0),
+        _slots(new SlotArray(16))
+    {
+        return;
+    }
+
+    ~PublishedTable(void)
+    {
+        delete _slots.load();
+    }
+
+    //! Find the value for a key without locking, null when it was never published
+    const Value *find(const Key &key) const
+    {
+        const auto slots = _slots.load(std::memory_order_acquire);
+        const size_t mask = slots->capacity-1;
+        for (size_t i = Hash()(key) & mask;; i = (i+1) & mask)
+        {
+            const auto node = slots->nodes[i].load(std::memory_order_acquire);
+            if (node == nullptr) return nullptr;
+            if (node->key == key) return &node->value;
+        }
+    }
+
+    //! Publish the value for a key, call with the writer's mutex held
+    const Value &publish(const Key &key, const Value &value)
+    {
+        _nodes.emplace_back(new Node{Hash()(key), key, value});
+        const Node *node = _nodes.back().get();
+
+        //keep the load under one half, readers of the old array still find every key
+        auto slots = _slots.load(std::memory_order_relaxed);
+        if ((_numKeys+1)*2 > slots->capacity)
+        {
+            auto bigger = new SlotArray(slots->capacity*2);
+            for (size_t i = 0; i < slots->capacity; i++)
+            {
+                const auto old = slots->nodes[i].load(std::memory_order_relaxed);
+                if (old != nullptr) bigger->store(old);
+            }
+            _retiredSlots.emplace_back(slots);
+            _slots.store(bigger, std::memory_order_release);
+            slots = bigger;
+        }
+        if (slots->store(node)) _numKeys++;
+        return node->value;
+    }
+
+private:
+    struct Node
+    {
+        size_t hash;
+        Key key;
+        Value value;
+    };
+
+    struct SlotArray
+    {
+        SlotArray(const size_t capacity):
+            capacity(capacity),
+            nodes(new std::atomic<const Node *>[capacity])
+        {
+            for (size_t i = 0; i < capacity; i++) nodes[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        //! Store the node in the empty slot or the slot of its key, true for a new key
+        bool store(const Node *node)
+        {
+            const size_t mask = capacity-1;
+            for (size_t i = node->hash & mask;; i = (i+1) & mask)
+            {
+                const auto old = nodes[i].load(std::memory_order_relaxed);
+                if (old != nullptr and not (old->key == node->key)) continue;
+                nodes[i].store(node, std::memory_order_release);
+                return old == nullptr;
+            }
+        }
+
+        const size_t capacity; //power of 2 size
+        std::unique_ptr<std::atomic<const Node *>[]> nodes;
+    };
+
+    size_t _numKeys;
+    std::atomic<SlotArray *> _slots;
+    std::vector<std::unique_ptr<SlotArray>> _retiredSlots;
+    std::vector<std::unique_ptr<Node>> _nodes; //every published value, current and retired
+};